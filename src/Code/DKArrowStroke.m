@@ -725,6 +725,25 @@ NSString*				kDKDimensionUnitsKey		= @"DKDimensionUnits";
 }
 
 
+#pragma mark -
+#pragma mark As a DKRasterizer
+
+- (BOOL)			isSafeForConcurrentRendering
+{
+	// dimension text is laid out and drawn with the string drawing methods, which are main thread only
+	
+	return [self dimensioningLineOptions] == kDKDimensionNone && [super isSafeForConcurrentRendering];
+}
+
+
+- (BOOL)			canBeRasterCached
+{
+	// the dimension text depends on the drawing's units, which aren't part of the object's geometry
+	
+	return [self dimensioningLineOptions] == kDKDimensionNone && [super canBeRasterCached];
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 
@@ -7,6 +7,7 @@
 //
 
 #import "DKBezierLayoutManager.h"
+#import "NSBezierPath+Text.h"
 
 
 @implementation DKBezierLayoutManager
@@ -65,7 +66,7 @@
 				font = [[[self textStorage] attributesAtIndex:g effectiveRange:NULL] objectForKey:NSFontAttributeName];
 				
 				[temp moveToPoint:ploc];
-				[temp appendBezierPathWithGlyph:[self glyphAtIndex:g] inFont:font];
+				[temp appendCachedOutlineOfGlyph:[self glyphAtIndex:g] inFont:font];
 				
 				// need to vertically flip and offset each glyph as it is created. The glyph is flipped around its given location to
 				// ensure that any unusual baseline requirements are taken into consideration.
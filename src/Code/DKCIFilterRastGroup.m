@@ -60,6 +60,31 @@
 }
 
 
+#pragma mark -
+#pragma mark As a DKRasterizer
+- (BOOL)					isSafeForConcurrentRendering
+{
+	// the group renders via a cached image that it rebuilds in place
+	
+	return NO;
+}
+
+
+- (BOOL)					isExpensiveToRender
+{
+	return YES;
+}
+
+
+- (DKContentHash)			contentHash
+{
+	DKContentHash h = [super contentHash];
+	
+	h = DKHashObject( h, [self filter]);
+	return DKHashObject( h, [self arguments]);
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 + (NSArray*)				observableKeyPaths
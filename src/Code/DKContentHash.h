@@ -0,0 +1,61 @@
+///**********************************************************************************************************************************
+///  DKContentHash.h
+///  DrawKit ©2005-2008 Apptree.net
+///
+///  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file. 
+///
+///**********************************************************************************************************************************
+
+#import <Cocoa/Cocoa.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// 64-bit content hashes, used wherever a cache needs to know whether the thing it was built from has changed. These are fast and well mixed
+// but not cryptographic. Values are only meaningful within a single run - never archive or persist them.
+
+typedef uint64_t		DKContentHash;
+
+#define		kDKContentHashSeed		14695981039346656037ULL
+
+DKContentHash		DKHashCombine( DKContentHash h, uint64_t value );
+DKContentHash		DKHashFloat( DKContentHash h, CGFloat value );
+DKContentHash		DKHashPoint( DKContentHash h, const NSPoint p );
+DKContentHash		DKHashRect( DKContentHash h, const NSRect r );
+DKContentHash		DKHashBytes( DKContentHash h, const void* bytes, size_t length );
+DKContentHash		DKHashObject( DKContentHash h, id object );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+// objects that can supply a content hash for DKHashObject() implement this:
+
+@protocol DKContentHashing <NSObject>
+
+- (DKContentHash)	contentHash;
+
+@end
+
+
+
+/*
+
+DKHashCombine() is the primitive - it mixes a 64-bit value into a running hash with a full avalanche, so that small differences in the input
+(e.g. coordinates that differ in the last bit) give completely different results. The other functions feed their data through it:
+
+DKHashFloat() hashes the exact bit pattern of the value, after folding -0 onto 0 and all NaNs onto one value, so no rounding is involved.
+DKHashBytes() hashes raw memory eight bytes at a time.
+DKHashObject() handles the value classes found in styles and metadata - strings, numbers, data, colours, shadows, values, arrays and
+dictionaries - and any object that conforms to DKContentHashing. An image contributes a number unique to that image object rather than its
+pixels, so an image that is drawn into after being hashed isn't detected as changed. Anything else contributes its -hash.
+
+Start each hash from kDKContentHashSeed.
+
+*/
@@ -0,0 +1,206 @@
+///**********************************************************************************************************************************
+///  DKContentHash.m
+///  DrawKit ©2005-2008 Apptree.net
+///
+///  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file. 
+///
+///**********************************************************************************************************************************
+
+#import "DKContentHash.h"
+#import <objc/runtime.h>
+
+
+static char			sImageGenerationKey;
+static uint64_t		sImageGeneration = 0;
+
+
+static inline uint64_t	mix64( uint64_t x )
+{
+	// the splitmix64 finalizer - every input bit affects every output bit
+	
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	
+	return x;
+}
+
+
+DKContentHash		DKHashCombine( DKContentHash h, uint64_t value )
+{
+	return mix64( h ^ ( value + 0x9e3779b97f4a7c15ULL + ( h << 6 ) + ( h >> 2 )));
+}
+
+
+DKContentHash		DKHashFloat( DKContentHash h, CGFloat value )
+{
+	double		d = value;
+	uint64_t	bits;
+	
+	if( d == 0.0 )
+		d = 0.0;		// folds -0 onto +0
+	else if( isnan( d ))
+		d = NAN;
+	
+	memcpy( &bits, &d, sizeof( bits ));
+	return DKHashCombine( h, bits );
+}
+
+
+DKContentHash		DKHashPoint( DKContentHash h, const NSPoint p )
+{
+	return DKHashFloat( DKHashFloat( h, p.x ), p.y );
+}
+
+
+DKContentHash		DKHashRect( DKContentHash h, const NSRect r )
+{
+	h = DKHashPoint( h, r.origin );
+	h = DKHashFloat( h, r.size.width );
+	return DKHashFloat( h, r.size.height );
+}
+
+
+DKContentHash		DKHashBytes( DKContentHash h, const void* bytes, size_t length )
+{
+	const uint8_t*	p = (const uint8_t*) bytes;
+	uint64_t		word;
+	
+	h = DKHashCombine( h, (uint64_t) length );
+	
+	while( length >= sizeof( word ))
+	{
+		memcpy( &word, p, sizeof( word ));
+		h = DKHashCombine( h, word );
+		p += sizeof( word );
+		length -= sizeof( word );
+	}
+	
+	if( length > 0 )
+	{
+		word = 0;
+		memcpy( &word, p, length );
+		h = DKHashCombine( h, word );
+	}
+	
+	return h;
+}
+
+
+DKContentHash		DKHashObject( DKContentHash h, id object )
+{
+	if( object == nil )
+		return DKHashCombine( h, 0 );
+	
+	if([object conformsToProtocol:@protocol(DKContentHashing)])
+		return DKHashCombine( h, [object contentHash]);
+	
+	if([object isKindOfClass:[NSString class]])
+	{
+		const char* s = [object UTF8String];
+		return DKHashBytes( h, s, strlen( s ));
+	}
+	
+	if([object isKindOfClass:[NSNumber class]])
+	{
+		const char* type = [object objCType];
+		
+		if( *type == 'f' || *type == 'd' )
+			return DKHashFloat( h, [object doubleValue]);
+		else
+			return DKHashCombine( h, (uint64_t)[object longLongValue]);
+	}
+	
+	if([object isKindOfClass:[NSValue class]])
+	{
+		NSUInteger	size = 0;
+		
+		NSGetSizeAndAlignment([object objCType], &size, NULL );
+		
+		void*		buffer = calloc( 1, size );
+		
+		[object getValue:buffer];
+		h = DKHashBytes( h, buffer, size );
+		free( buffer );
+		
+		return h;
+	}
+	
+	if([object isKindOfClass:[NSData class]])
+		return DKHashBytes( h, [object bytes], [object length]);
+	
+	if([object isKindOfClass:[NSColor class]])
+	{
+		NSColor* rgb = [object colorUsingColorSpace:[NSColorSpace genericRGBColorSpace]];
+		
+		if( rgb )
+		{
+			h = DKHashFloat( h, [rgb redComponent]);
+			h = DKHashFloat( h, [rgb greenComponent]);
+			h = DKHashFloat( h, [rgb blueComponent]);
+			return DKHashFloat( h, [rgb alphaComponent]);
+		}
+	}
+	
+	if([object isKindOfClass:[NSShadow class]])
+	{
+		h = DKHashFloat( h, [object shadowOffset].width );
+		h = DKHashFloat( h, [object shadowOffset].height );
+		h = DKHashFloat( h, [object shadowBlurRadius]);
+		return DKHashObject( h, [object shadowColor]);
+	}
+	
+	if([object isKindOfClass:[NSImage class]])
+	{
+		// hashing the pixels would be far too slow, and the address can be reused once the image is freed, so each image is given a
+		// number the first time it's hashed that no other image will ever have
+		
+		NSNumber* generation;
+		
+		@synchronized([NSImage class])
+		{
+			generation = objc_getAssociatedObject( object, &sImageGenerationKey );
+			
+			if( generation == nil )
+			{
+				generation = [NSNumber numberWithUnsignedLongLong:++sImageGeneration];
+				objc_setAssociatedObject( object, &sImageGenerationKey, generation, OBJC_ASSOCIATION_RETAIN_NONATOMIC );
+			}
+		}
+		
+		return DKHashCombine( h, [generation unsignedLongLongValue]);
+	}
+	
+	if([object isKindOfClass:[NSArray class]])
+	{
+		NSEnumerator*	iter = [object objectEnumerator];
+		id				item;
+		
+		h = DKHashCombine( h, [object count]);
+		
+		while(( item = [iter nextObject]))
+			h = DKHashObject( h, item );
+		
+		return h;
+	}
+	
+	if([object isKindOfClass:[NSDictionary class]])
+	{
+		// order-independent, so that equal dictionaries hash alike whatever their internal ordering
+		
+		NSEnumerator*	iter = [object keyEnumerator];
+		id				key;
+		uint64_t		sum = 0;
+		
+		while(( key = [iter nextObject]))
+			sum += DKHashObject( DKHashObject( kDKContentHashSeed, key ), [object objectForKey:key]);
+		
+		return DKHashCombine( DKHashCombine( h, [object count]), sum );
+	}
+	
+	return DKHashCombine( h, [object hash]);
+}
@@ -104,6 +104,12 @@
 #import "NSMutableArray+DKAdditions.h"
 #import "NSImage+DKAdditions.h"
 #import "DKQuartzCache.h"
+#import "DKLRUCache.h"
+#import "DKContentHash.h"
+#import "DKRenderPlan.h"
+#import "DKFrameBudget.h"
+#import "DKImagePyramid.h"
+#import "DKTiledImagePyramid.h"
 
 #ifdef qUseLogEvent
  #import "LogEvent.h"
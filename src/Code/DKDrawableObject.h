@@ -13,11 +13,16 @@
 #import "DKObjectStorageProtocol.h"
 #import "DKRasterizerProtocol.h"
 #import "DKDrawableContainerProtocol.h"
+#import "DKContentHash.h"
 
 
 @class DKObjectOwnerLayer, DKStyle, DKDrawing, DKDrawingTool, DKShapeGroup;
 
 
+#define		kDKDrawableRasterCacheDefaultBudget			(32 * 1024 * 1024)	// default memory budget for the shared raster cache, in bytes
+#define		kDKDrawableRasterCacheMaximumPixelDimension	2048				// objects larger than this many device pixels across are drawn directly
+
+
 /*!
  A drawable object is owned by a DKObjectDrawingLayer, which is responsible for drawing it when required and handling
  selections. This object is responsible for the visual representation of the selection as well as any content.
@@ -35,6 +40,12 @@
  The user info is a dictionary attached to an object. It plays no part in the graphics system, but can be used by applications
  to attach arbitrary data to any drawable object.
  
+ Objects whose style includes an expensive renderer (shadows, rough strokes, hatching, path decorators or core image filters - see
+ -[DKRasterizer isExpensiveToRender]) draw to the screen from a bitmap of their content. The bitmap is rendered at the current zoom
+ rounded up to the next quarter octave, so that small zoom changes reuse it, and is redrawn when the object's geometry, metadata or style
+ changes. All objects share one cache, limited by the memory used and discarding the least recently drawn objects first. Objects using only
+ simple fills and strokes are drawn directly as before, as are printing, PDF output and hit-testing.
+ 
  */
 @interface DKDrawableObject : NSObject <DKStorableObject, DKRenderable, NSCoding, NSCopying>
 {
@@ -55,6 +66,7 @@
 	BOOL				mGhosted;				// YES if object is drawn ghosted
 	BOOL				mIsHitTesting;			// YES when drawContent is called for the purposes of hit-testing
 	NSMutableDictionary*	mRenderingCache;	// a dictionary to support general caching by renderers
+	NSColor*			mProxyColour;			// average colour of the style, used to stand in for the object when it's tiny on screen
 @protected
 	BOOL				m_showBBox:1;			// debugging - display the object's bounding box
 	BOOL				m_clipToBBox:1;			// debugging - force clip region to the bbox
@@ -73,6 +85,12 @@
 
 @property (class, retain) NSColor *ghostColour;
 
+// raster cache settings:
+
+@property (class) BOOL rasterCacheEnabled;
+@property (class) NSUInteger rasterCacheByteBudget;
++ (void)				purgeRasterCache;
+
 // pasteboard types for drag/drop:
 
 + (NSArray<NSPasteboardType>*)pasteboardTypesForOperation:(DKPasteboardOperationType) op;
@@ -143,6 +161,7 @@
 - (void)				drawGhostedContent;
 - (void)				drawSelectedState;
 - (void)				drawSelectionPath:(NSBezierPath*) path;
+- (BOOL)				isSafeForConcurrentRendering;
 
 // refresh notifiers:
 
@@ -159,6 +178,7 @@
 @property (readonly) BOOL useLowQualityDrawing;
 
 - (NSUInteger)			geometryChecksum;
+- (DKContentHash)		geometryHash;
 
 // specialised drawing:
 
@@ -284,6 +304,9 @@
 
 - (void)				invalidateRenderingCache;
 - (NSImage*)			cachedImage;
+- (BOOL)				shouldUseRasterCacheForStyle:(DKStyle*) aStyle;
+- (BOOL)				drawContentFromRasterCacheWithStyle:(DKStyle*) aStyle;
+- (NSColor*)			proxyColour;
 
 // pasteboard:
 
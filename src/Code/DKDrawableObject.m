@@ -26,6 +26,9 @@
 #import "DKAuxiliaryMenus.h"
 #import "DKSelectionPDFView.h"
 #import "DKPasteboardInfo.h"
+#import "DKLRUCache.h"
+#import "DKQuartzCache.h"
+#import "DKFrameBudget.h"
 
 
 #ifdef qIncludeGraphicDebugging
@@ -47,12 +50,16 @@ NSString*		kDKGhostColourPreferencesKey = @"kDKGhostColourPreferencesKey";
 NSString*		kDKDragFeedbackEnabledPreferencesKey = @"kDKDragFeedbackEnabledPreferencesKey";
 
 NSString*		kDKDrawableCachedImageKey	= @"DKD_Cached_Img";
+NSString*		kDKDrawableRasterCacheKey	= @"DKD_Raster_Cache_Key";
 
 
 #pragma mark Static vars
 
 static NSColor*			s_ghostColour = nil;
 static NSDictionary*	s_interconversionTable = nil;
+static DKLRUCache*		sRasterCache = nil;
+static BOOL				sRasterCacheEnabled = YES;
+static NSUInteger		sRasterCacheByteBudget = kDKDrawableRasterCacheDefaultBudget;
 
 #pragma mark -
 @implementation DKDrawableObject
@@ -99,6 +106,112 @@ static NSDictionary*	s_interconversionTable = nil;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			setRasterCacheEnabled:
+/// scope:			class method
+/// overrides:		
+/// description:	set whether objects with expensive styles are drawn from a cached bitmap of their content
+/// 
+/// parameters:		<enable> YES to use the raster cache, NO to always draw objects directly
+/// result:			none
+///
+/// notes:			disabling the cache discards everything in it. Enabled by default.
+///
+///********************************************************************************************************************
+
++ (void)				setRasterCacheEnabled:(BOOL) enable
+{
+	sRasterCacheEnabled = enable;
+	
+	if( !enable )
+		[self purgeRasterCache];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			rasterCacheEnabled
+/// scope:			class method
+/// overrides:		
+/// description:	are objects with expensive styles drawn from a cached bitmap of their content?
+/// 
+/// parameters:		none
+/// result:			YES if the raster cache is used
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
++ (BOOL)				rasterCacheEnabled
+{
+	return sRasterCacheEnabled;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setRasterCacheByteBudget:
+/// scope:			class method
+/// overrides:		
+/// description:	set the approximate memory that cached object bitmaps may use
+/// 
+/// parameters:		<bytes> the budget, in bytes
+/// result:			none
+///
+/// notes:			the budget is shared by all objects in all drawings. Reducing it discards the least recently drawn
+///					bitmaps as necessary.
+///
+///********************************************************************************************************************
+
++ (void)				setRasterCacheByteBudget:(NSUInteger) bytes
+{
+	sRasterCacheByteBudget = bytes;
+	[sRasterCache setCostLimit:bytes];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			rasterCacheByteBudget
+/// scope:			class method
+/// overrides:		
+/// description:	the approximate memory that cached object bitmaps may use
+/// 
+/// parameters:		none
+/// result:			the budget, in bytes
+///
+/// notes:			the default is kDKDrawableRasterCacheDefaultBudget
+///
+///********************************************************************************************************************
+
++ (NSUInteger)			rasterCacheByteBudget
+{
+	return sRasterCacheByteBudget;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			purgeRasterCache
+/// scope:			class method
+/// overrides:		
+/// description:	discard all cached object bitmaps
+/// 
+/// parameters:		none
+/// result:			none
+///
+/// notes:			objects rebuild their bitmaps as they are next drawn. There's normally no need to call this as changes
+///					to an object are detected, but it can be used to release memory.
+///
+///********************************************************************************************************************
+
++ (void)				purgeRasterCache
+{
+	[sRasterCache removeAllObjects];
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			unionOfBoundsOfDrawablesInArray:
@@ -1260,7 +1373,8 @@ static NSDictionary*	s_interconversionTable = nil;
 	{
 		@try
 		{
-			[aStyle render:self];
+			if(![self drawContentFromRasterCacheWithStyle:aStyle])
+				[aStyle render:self];
 		}
 		@catch( id exc )
 		{
@@ -1317,6 +1431,32 @@ static NSDictionary*	s_interconversionTable = nil;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			isSafeForConcurrentRendering
+/// scope:			public instance method
+/// overrides:
+/// description:	can the object's content be drawn on a secondary thread?
+/// 
+/// parameters:		none
+/// result:			YES if the object may be drawn on a secondary thread at the same time as other objects
+///
+/// notes:			used by the view's tile renderer to decide whether an area can be drawn in parallel. The default
+///					defers to the style. Subclasses that draw text, images or anything else that relies on main thread
+///					only parts of Cocoa, or that build caches of their own while drawing, should return NO. Selection
+///					highlights are never drawn concurrently so aren't considered.
+///
+///********************************************************************************************************************
+
+- (BOOL)			isSafeForConcurrentRendering
+{
+	if([self isGhosted])
+		return NO;
+	
+	return [self style] == nil || [[self style] isSafeForConcurrentRendering];
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			drawSelectedState
@@ -1351,11 +1491,18 @@ static NSDictionary*	s_interconversionTable = nil;
 ///
 /// notes:			this is a convenient utility method your subclasses can use as needed to make selections consistent
 ///					among different objects and layers. A side effect is that the line width of the path may be changed.
+///					When the layer is aggregating the highlights of a large selection, the path is handed to it to be
+///					stroked along with all the others instead of being stroked here.
 ///
 ///********************************************************************************************************************
 
 - (void)			drawSelectionPath:(NSBezierPath*) path
 {
+	DKObjectOwnerLayer* layer = [self layer];
+	
+	if([layer isKindOfClass:[DKObjectDrawingLayer class]] && [(DKObjectDrawingLayer*)layer gatherSelectionHighlightPath:path locked:[self locked]])
+		return;
+	
 	if ([self locked])
 		[[NSColor lightGrayColor] set];
 	else
@@ -1668,6 +1815,9 @@ static NSDictionary*	s_interconversionTable = nil;
 		[m_style release];
 		m_style = [newStyle retain];
 		
+		[mProxyColour release];
+		mProxyColour = nil;
+		
 		// set the style's undo manager to ours if it's actually set
 		
 		if([self undoManager] != nil )
@@ -1748,6 +1898,12 @@ static NSRect s_oldBounds;
 {
 	if([note object] == [self style])
 	{
+		@synchronized( self )
+		{
+			[mProxyColour release];
+			mProxyColour = nil;
+		}
+		
 		[self notifyVisualChange];
 		[self notifyGeometryChange:s_oldBounds];
 	}
@@ -2210,16 +2366,98 @@ static NSRect s_oldBounds;
 ///
 /// notes:			the rendering cache is simply emptied. The contents of the cache are generally set by individual
 ///					renderers to speed up drawing, and are not known to this object. The cache is invalidated by any
-///					change that alters the object's appearance - size, position, angle, style, etc.
+///					change that alters the object's appearance - size, position, angle, style, etc. The object's bitmap
+///					in the shared raster cache, if any, is discarded too.
 ///
 ///********************************************************************************************************************
 
 - (void)				invalidateRenderingCache
 {
+	NSNumber* rasterKey = [mRenderingCache objectForKey:kDKDrawableRasterCacheKey];
+	
+	if( rasterKey )
+		[sRasterCache removeObjectForKey:rasterKey];
+	
 	[mRenderingCache removeAllObjects];
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			proxyColour
+/// scope:			public instance method
+/// overrides:		
+/// description:	returns a single colour that stands in for the object's appearance
+/// 
+/// parameters:		none
+/// result:			the average colour of the object's style, or nil if it has no style
+///
+/// notes:			used by the layer to draw objects that are too small on screen to be worth rendering in full. The colour
+///					is the average of the style's standard swatch, including its alpha, so a faint or sparse style gives a
+///					correspondingly faint colour. It is cached until the style changes. Making the swatch isn't thread safe, so
+///					the colour is only computed on the main thread - on a tile drawing thread, nil is returned unless the colour
+///					has already been cached, and the object is drawn in full instead.
+///
+///********************************************************************************************************************
+
+- (NSColor*)			proxyColour
+{
+	NSColor* colour;
+	
+	@synchronized( self )
+	{
+		if( mProxyColour == nil && [self style] != nil && [NSThread isMainThread])
+		{
+			// reduce the swatch to a few pixels and average those
+			
+			NSImage*		swatch = [[self style] standardStyleSwatch];
+			unsigned char	pixels[8 * 8 * 4];
+			CGColorSpaceRef	cs = CGColorSpaceCreateDeviceRGB();
+			CGContextRef	bm = CGBitmapContextCreate( pixels, 8, 8, 8, 8 * 4, cs, kCGImageAlphaPremultipliedLast );
+			
+			CGColorSpaceRelease( cs );
+			
+			if( bm == NULL || swatch == nil )
+			{
+				CGContextRelease( bm );
+				return nil;
+			}
+
+			CGContextClearRect( bm, CGRectMake( 0, 0, 8, 8 ));
+			CGContextSetInterpolationQuality( bm, kCGInterpolationHigh );
+			
+			[NSGraphicsContext saveGraphicsState];
+			[NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithGraphicsPort:bm flipped:NO]];
+			[swatch drawInRect:NSMakeRect( 0, 0, 8, 8 ) fromRect:NSZeroRect operation:NSCompositeSourceOver fraction:1.0];
+			[NSGraphicsContext restoreGraphicsState];
+			CGContextRelease( bm );
+			
+			CGFloat		r = 0, g = 0, b = 0, a = 0;
+			NSUInteger	i;
+			
+			for( i = 0; i < 8 * 8 * 4; i += 4 )
+			{
+				r += pixels[i];
+				g += pixels[i + 1];
+				b += pixels[i + 2];
+				a += pixels[i + 3];
+			}
+			
+			// the pixels are premultiplied, so dividing the colour sums by the alpha sum gives the average of the visible colour
+			
+			if( a > 0 )
+				mProxyColour = [[NSColor colorWithDeviceRed:r / a green:g / a blue:b / a alpha:a / ( 8 * 8 * 255.0 )] retain];
+			else
+				mProxyColour = [[NSColor clearColor] retain];
+		}
+		
+		colour = [[mProxyColour retain] autorelease];
+	}
+	
+	return colour;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			cachedImage
@@ -2242,12 +2480,143 @@ static NSRect s_oldBounds;
 	if( img == nil )
 	{
 		img = [self swatchImageWithSize:NSZeroSize];
-		[mRenderingCache setObject:img forKey:kDKDrawableCachedImageKey];
+		[[self renderingCache] setObject:img forKey:kDKDrawableCachedImageKey];
 	}
 	
 	return img;
 }
 
+
+///*********************************************************************************************************************
+///
+/// method:			shouldUseRasterCacheForStyle:
+/// scope:			public instance method
+/// overrides:		
+/// description:	should the object be drawn from the raster cache when rendered with the given style?
+/// 
+/// parameters:		<aStyle> the style the object is to be drawn with
+/// result:			YES to draw from a cached bitmap, NO to draw the style directly
+///
+/// notes:			only screen drawing on the main thread uses the cache, and only for styles that are expensive enough
+///					to benefit from it and whose output doesn't depend on anything the cache can't detect. Subclasses
+///					can override this to exclude themselves, or to force caching for a cheap style.
+///
+///********************************************************************************************************************
+
+- (BOOL)				shouldUseRasterCacheForStyle:(DKStyle*) aStyle
+{
+	if( !sRasterCacheEnabled || aStyle == nil )
+		return NO;
+	
+	if(![NSThread isMainThread] || [self isBeingHitTested] || ![NSGraphicsContext currentContextDrawingToScreen])
+		return NO;
+	
+	return [aStyle isExpensiveToRender] && [aStyle canBeRasterCached];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawContentFromRasterCacheWithStyle:
+/// scope:			public instance method
+/// overrides:		
+/// description:	draw the object's content using a cached bitmap of the style's rendering
+/// 
+/// parameters:		<aStyle> the style to draw the object with
+/// result:			YES if the content was drawn, NO if the caller should render the style itself
+///
+/// notes:			the bitmap covers the object's bounds at the current device scale rounded up to the next quarter
+///					octave, so small zoom changes reuse it at no visible cost. It is keyed by the object, that scale,
+///					the geometry hash, the style's content hash, the metadata checksum and the drawing's text greeking
+///					and hiding thresholds, so any change to these renders a new bitmap, replacing the object's old one. A
+///					bitmap that's missing is not built while drawing at low quality, as the object is probably being
+///					dragged, or when it would be unreasonably large.
+///
+///********************************************************************************************************************
+
+- (BOOL)				drawContentFromRasterCacheWithStyle:(DKStyle*) aStyle
+{
+	if(![self shouldUseRasterCacheForStyle:aStyle])
+		return NO;
+	
+	NSRect br = [self bounds];
+	
+	if( NSIsEmptyRect( br ))
+		return NO;
+	
+	// the scale from drawing units to device pixels, taken from the CTM so that the view scale, any container transforms and the
+	// screen's backing scale are all included, then quantized to quarter octaves
+	
+	CGContextRef		context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGAffineTransform	ctm = CGContextGetCTM( context );
+	CGFloat				det = fabs( ctm.a * ctm.d - ctm.b * ctm.c );
+	
+	if( det <= 0.0 )
+		return NO;
+	
+	CGFloat scale = pow( 2.0, ceil( log2( sqrt( det )) * 4.0 ) / 4.0 );
+	NSSize	pixels = NSMakeSize( ceil( NSWidth( br ) * scale ), ceil( NSHeight( br ) * scale ));
+	
+	if( pixels.width > kDKDrawableRasterCacheMaximumPixelDimension || pixels.height > kDKDrawableRasterCacheMaximumPixelDimension )
+		return NO;
+	
+	DKContentHash h = DKHashCombine( kDKContentHashSeed, (uint64_t)(uintptr_t) self );
+	
+	h = DKHashFloat( h, scale );
+	h = DKHashRect( h, br );
+	h = DKHashCombine( h, [self geometryHash]);
+	h = DKHashCombine( h, [aStyle contentHash]);
+	h = DKHashCombine( h, [self metadataChecksum]);
+	
+	// text is greeked or hidden on screen according to the drawing's thresholds, so a bitmap is only good for the thresholds
+	// it was rendered with
+	
+	h = DKHashFloat( h, [[self drawing] textGreekingThreshold]);
+	h = DKHashFloat( h, [[self drawing] textHidingThreshold]);
+	
+	NSNumber*		key = [NSNumber numberWithUnsignedLongLong:h];
+	
+	if( sRasterCache == nil )
+		sRasterCache = [[DKLRUCache alloc] initWithCostLimit:sRasterCacheByteBudget];
+	
+	DKQuartzCache*	content = [sRasterCache objectForKey:key];
+	
+	if( content == nil )
+	{
+		if([self useLowQualityDrawing] || [[DKFrameBudget activeBudget] isDegrading])
+			return NO;
+		
+		content = [[DKQuartzCache alloc] initWithContext:[NSGraphicsContext currentContext] forRect:NSMakeRect( 0, 0, pixels.width, pixels.height )];
+		
+		NSAffineTransform* tfm = [NSAffineTransform transform];
+		[tfm scaleBy:scale];
+		[tfm translateXBy:-br.origin.x yBy:-br.origin.y];
+		
+		[content lockFocus];
+		[tfm concat];
+		[aStyle render:self];
+		[content unlockFocus];
+		
+		// only the bitmap for the object's current appearance is kept
+		
+		NSNumber* oldKey = [[self renderingCache] objectForKey:kDKDrawableRasterCacheKey];
+		
+		if( oldKey )
+			[sRasterCache removeObjectForKey:oldKey];
+		
+		[sRasterCache setObject:content forKey:key cost:(NSUInteger)( pixels.width * pixels.height * 4 )];
+		[[self renderingCache] setObject:key forKey:kDKDrawableRasterCacheKey];
+		[content autorelease];
+	}
+	
+	// the bitmap's size was rounded up to whole pixels, so it's drawn at its own size rather than stretched to the bounds
+	
+	br.size = NSMakeSize( pixels.width / scale, pixels.height / scale );
+	[content drawInRect:br];
+	
+	return YES;
+}
+
 #pragma mark -
 ///*********************************************************************************************************************
 ///
@@ -3609,6 +3978,13 @@ static NSRect s_oldBounds;
 		[m_style release];
 	}
 	[mUserInfo release];
+	[mProxyColour release];
+	
+	NSNumber* rasterKey = [mRenderingCache objectForKey:kDKDrawableRasterCacheKey];
+	
+	if( rasterKey )
+		[sRasterCache removeObjectForKey:rasterKey];
+	
 	[mRenderingCache release];
 	[super dealloc];
 }
@@ -3955,30 +4331,55 @@ static NSRect s_oldBounds;
 /// result:			a number
 ///
 /// notes:			do not rely on what the number is, only whether it has changed. Also, do not persist it in any way.
+///					This is the geometry hash, truncated to NSUInteger where necessary.
 ///
 ///********************************************************************************************************************
 
 - (NSUInteger)		geometryChecksum
 {
-	NSUInteger cd = 282735623;	// arbitrary
-	NSPoint	loc;
-	NSSize	size;
-	CGFloat	angle;
-	NSSize	offset;
-	
-	loc = [self location];
-	size = [self size];
-	angle = [self angleInDegrees] * 10;
-	offset = [self offset];
+	return (NSUInteger)[self geometryHash];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			geometryHash
+/// scope:			public instance method
+/// overrides:
+/// description:	return a 64-bit hash of the object's geometry
+/// 
+/// parameters:		none
+/// result:			a hash value
+///
+/// notes:			the location, size, angle and offset are hashed at full precision, so that objects which differ only
+///					by a fraction of a unit, or whose rounded values happen to cancel out, give different values. This
+///					makes it suitable as a key for caches of rendered or computed information. Subclasses whose
+///					geometry isn't fully described by these properties should mix in their own data. Do not persist it.
+///
+///********************************************************************************************************************
+
+- (DKContentHash)	geometryHash
+{
+	DKContentHash h = DKHashCombine( kDKContentHashSeed, (uint64_t)[[self class] hash]);
 	
-	cd ^= lround( loc.x ) ^ lround( loc.y ) ^ lround( size.width ) ^ lround( size.height ) ^ lround( angle ) ^ lround( offset.width ) ^ lround( offset.height );
+	h = DKHashPoint( h, [self location]);
+	h = DKHashFloat( h, [self size].width );
+	h = DKHashFloat( h, [self size].height );
+	h = DKHashFloat( h, [self angle]);
+	h = DKHashFloat( h, [self offset].width );
+	h = DKHashFloat( h, [self offset].height );
 	
-	return cd;
+	return h;
 }
 
 
 - (NSMutableDictionary*)	renderingCache
 {
+	// created on demand, but only by the main thread - secondary threads rendering tiles only read what's already cached
+	
+	if( mRenderingCache == nil && [NSThread isMainThread])
+		mRenderingCache = [[NSMutableDictionary alloc] init];
+	
 	return mRenderingCache;
 }
 
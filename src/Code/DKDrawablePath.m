@@ -3137,6 +3137,26 @@ finish:
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			geometryHash
+/// scope:			public instance method
+/// overrides:		DKDrawableObject
+/// description:	return a 64-bit hash of the object's geometry
+/// 
+/// parameters:		none
+/// result:			a hash value
+///
+/// notes:			vertices can be moved without changing the bounds, so the path's content is included
+///
+///********************************************************************************************************************
+
+- (DKContentHash)	geometryHash
+{
+	return DKHashCombine([super geometryHash], [[self path] contentHash]);
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			rotateToAngle:
@@ -3237,6 +3237,26 @@ static NSSize			sTempSavedOffset;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			geometryHash
+/// scope:			public instance method
+/// overrides:		DKDrawableObject
+/// description:	return a 64-bit hash of the object's geometry
+/// 
+/// parameters:		none
+/// result:			a hash value
+///
+/// notes:			the shape's path can change without the bounds changing, so its content is included
+///
+///********************************************************************************************************************
+
+- (DKContentHash)		geometryHash
+{
+	return DKHashCombine([super geometryHash], [[self path] contentHash]);
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			rotateToAngle:
@@ -11,7 +11,7 @@
 #import "DKLayerGroup.h"
 
 
-@class DKGridLayer, DKGuideLayer, DKKnob, DKViewController, DKImageDataManager, DKUndoManager;
+@class DKGridLayer, DKGuideLayer, DKKnob, DKViewController, DKImageDataManager, DKUndoManager, DKFrameBudget;
 
 
 @interface DKDrawing : DKLayerGroup <NSCoding, NSCopying>
@@ -32,13 +32,13 @@
 	BOOL					m_snapsToGrid;			// YES if grid snapping enabled
 	BOOL					m_snapsToGuides;		// YES if guide snapping enabled
 	BOOL					m_useQandDRendering;	// if YES, renderers have the option to use a fast but low quality drawing method
-	BOOL					m_isForcedHQUpdate;		// YES while refreshing to HQ after a LQ series
 	BOOL					m_qualityModEnabled;	// YES if the quality modulation is enabled
 	BOOL					mPaperColourIsPrinted;	// YES if paper colour should be printed (default is NO)
-	NSTimer*				m_renderQualityTimer;	// a timer used to set up high or low quality rendering dynamically
+	DKFrameBudget*			mFrameBudget;			// decides which renderers draw at low quality to keep updates within their time
 	NSTimeInterval			m_lastRenderTime;		// time the last render operation occurred
-	NSTimeInterval			mTriggerPeriod;			// the time interval to use to trigger low quality rendering
-	NSRect					m_lastRectUpdated;		// for refresh in HQ mode
+	NSTimeInterval			mTriggerPeriod;			// the idle time after which degraded content is refined
+	CGFloat					mTextGreekingThreshold;	// text smaller than this many device pixels is drawn greeked on screen
+	CGFloat					mTextHidingThreshold;	// text smaller than this many device pixels isn't drawn on screen
 	NSMutableSet*			mControllers;			// the set of current controllers
 	DKImageDataManager*		mImageManager;			// internal object used to substantially improve efficiency of image archiving
 	id						mDelegateRef;			// delegate, if any
@@ -132,6 +132,14 @@
 - (void)					qualityTimerCallback:(NSTimer*) timer;
 - (void)					setLowQualityTriggerInterval:(NSTimeInterval) t;
 - (NSTimeInterval)			lowQualityTriggerInterval;
+- (DKFrameBudget*)			frameBudget;
+
+// greeking text too small to read:
+
+- (void)					setTextGreekingThreshold:(CGFloat) pixels;
+- (CGFloat)					textGreekingThreshold;
+- (void)					setTextHidingThreshold:(CGFloat) pixels;
+- (CGFloat)					textHidingThreshold;
 
 // setting the undo manager:
 
@@ -150,6 +158,10 @@
 - (void)					setPaperColourIsPrinted:(BOOL) printIt;
 - (BOOL)					paperColourIsPrinted;
 
+- (void)					drawPaperInRect:(NSRect) rect;
+- (BOOL)					beginDrawingRect:(NSRect) rect inView:(DKDrawingView*) aView;
+- (void)					endDrawingRect:(NSRect) rect inView:(DKDrawingView*) aView;
+
 // active layer
 
 - (BOOL)					setActiveLayer:(DKLayer*) aLayer;
@@ -239,6 +251,11 @@ extern NSString*		kDKDrawingSnapToGridUserDefault;		// BOOL
 extern NSString*		kDKDrawingSnapToGuidesUserDefault;		// BOOL
 extern NSString*		kDKDrawingUnitAbbreviationsUserDefault;	// NSDictionary
 
+// default sizes, in device pixels, below which text is greeked or hidden on screen
+
+#define kDKDefaultTextGreekingThreshold		5.0
+#define kDKDefaultTextHidingThreshold		1.0
+
 // delegate methods
 
 @interface NSObject (DKDrawingDelegate)
@@ -25,6 +25,7 @@
 #import "LogEvent.h"
 #import "DKLayer+Metadata.h"
 #import "DKImageDataManager.h"
+#import "DKFrameBudget.h"
 #import "DKKeyedUnarchiver.h"
 #import "DKUnarchivingHelper.h"
 #import "DKUndoManager.h"
@@ -581,6 +582,8 @@ static id	sDearchivingHelper = nil;
 		
 		[self setDynamicQualityModulationEnabled:NO];
 		[self setLowQualityTriggerInterval:0.2];
+		[self setTextGreekingThreshold:kDKDefaultTextGreekingThreshold];
+		[self setTextHidingThreshold:kDKDefaultTextHidingThreshold];
 		
 		mImageManager = [[DKImageDataManager alloc] init];
 		
@@ -1391,7 +1394,9 @@ static id	sDearchivingHelper = nil;
 /// result:			none
 ///
 /// notes:			rasterizers are able to use a low quality drawing mode for rapid updates when DKDrawing detects
-///					the need for it. This flag allows that behaviour to be turned on or off.
+///					the need for it. This flag allows that behaviour to be turned on or off. When on, each screen update is
+///					timed by the frame budget, which degrades only the most expensive renderers and only while updates
+///					are running over their time.
 ///
 ///********************************************************************************************************************
 
@@ -1467,46 +1472,17 @@ static id	sDearchivingHelper = nil;
 /// parameters:		none
 /// result:			none
 ///
-/// notes:			called from the drawing method, this starts or extends a timer which will set high quality after
-///					a delay. Thus if rapid updates are happening, it will switch to low quality, and switch to high
-///					quality after a delay.
+/// notes:			called from the drawing method, this starts timing the update against the frame budget, which must be
+///					ended by -endDrawingRect:inView:. If updates run over budget, the most expensive renderers are switched
+///					to low quality until updates go idle, then refined one by one. Printing and other offscreen drawing
+///					is never timed, so is always drawn at high quality.
 ///
 ///********************************************************************************************************************
 
 - (void)				checkIfLowQualityRequired
 {
-	// if this is being called frequently, set low quality and start a timer to restore high quality after a delay. If the timer is
-	// already running, retrigger it.
-	
-	// if not drawing to screen, don't do this - always use HQ
-	
-	if (![[NSGraphicsContext currentContext] isDrawingToScreen])
-	{
-		[self setLowRenderingQuality:NO];
-		return;
-	}
-
-	if([self dynamicQualityModulationEnabled])
-	{
-		
-		[self setLowRenderingQuality:YES];
-		
-		if ( m_renderQualityTimer == nil )
-		{
-			// start the timer:
-			
-			m_renderQualityTimer = [[NSTimer scheduledTimerWithTimeInterval:mTriggerPeriod target:self selector:@selector(qualityTimerCallback:) userInfo:nil repeats:YES] retain];
-			[[NSRunLoop currentRunLoop] addTimer:m_renderQualityTimer forMode:NSEventTrackingRunLoopMode];
-		}
-		else
-		{
-			// already running - retrigger it:
-			
-			[m_renderQualityTimer setFireDate:[NSDate dateWithTimeIntervalSinceNow:mTriggerPeriod]];
-		}
-	}
-	else
-		[self setLowRenderingQuality:NO];
+	if([[NSGraphicsContext currentContext] isDrawingToScreen] && [self dynamicQualityModulationEnabled])
+		[[self frameBudget] beginFrame];
 }
 
 
@@ -1514,21 +1490,16 @@ static id	sDearchivingHelper = nil;
 {
 	#pragma unused(timer)
 	
-	// if the timer ever fires it calls this, so we simply invalidate it and set high quality
+	// restores high quality to everything straight away rather than one renderer at a time
 	
-	[m_renderQualityTimer invalidate];
-	[m_renderQualityTimer release];
-	m_renderQualityTimer = nil;
-	[self setLowRenderingQuality:NO];
-	m_isForcedHQUpdate = YES;
-	[self setNeedsDisplayInRect:m_lastRectUpdated];
-	m_lastRectUpdated = NSZeroRect;
+	[mFrameBudget refineAll];
 }
 
 
 - (void)				setLowQualityTriggerInterval:(NSTimeInterval) t
 {
 	mTriggerPeriod = t;
+	[mFrameBudget setRefinementDelay:t];
 }
 
 
@@ -1538,6 +1509,99 @@ static id	sDearchivingHelper = nil;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			frameBudget
+/// scope:			public method
+/// overrides:
+/// description:	returns the object that times screen updates and decides which renderers draw at low quality
+/// 
+/// parameters:		none
+/// result:			the frame budget
+///
+/// notes:			created when first needed. The refinement delay is the low quality trigger interval.
+///
+///********************************************************************************************************************
+
+- (DKFrameBudget*)		frameBudget
+{
+	if( mFrameBudget == nil )
+	{
+		mFrameBudget = [[DKFrameBudget alloc] initWithOwner:self];
+		
+		if( mTriggerPeriod > 0 )
+			[mFrameBudget setRefinementDelay:mTriggerPeriod];
+	}
+	
+	return mFrameBudget;
+}
+
+
+#pragma mark -
+#pragma mark - greeking text too small to read
+
+///*********************************************************************************************************************
+///
+/// method:			setTextGreekingThreshold:
+/// scope:			public method
+/// overrides:
+/// description:	sets the size below which text is drawn greeked on screen
+/// 
+/// parameters:		<pixels> the projected font size, in device pixels. 0 turns automatic greeking off.
+/// result:			none
+///
+/// notes:			text adornments - and so text shapes and text paths - compare the size of their font at the current
+///					view scale with this and draw a bar for each line instead of laying out glyphs nobody can read. Text that
+///					has its own greeking setting, or that is printed or exported, is unaffected.
+///
+///********************************************************************************************************************
+
+- (void)				setTextGreekingThreshold:(CGFloat) pixels
+{
+	if( pixels != mTextGreekingThreshold )
+	{
+		mTextGreekingThreshold = MAX( 0, pixels );
+		[self setNeedsDisplay:YES];
+	}
+}
+
+
+- (CGFloat)				textGreekingThreshold
+{
+	return mTextGreekingThreshold;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setTextHidingThreshold:
+/// scope:			public method
+/// overrides:
+/// description:	sets the size below which text is not drawn at all on screen
+/// 
+/// parameters:		<pixels> the projected font size, in device pixels. 0 turns automatic hiding off.
+/// result:			none
+///
+/// notes:			text this small wouldn't even show as a greeked bar. Should be less than the greeking threshold.
+///
+///********************************************************************************************************************
+
+- (void)				setTextHidingThreshold:(CGFloat) pixels
+{
+	if( pixels != mTextHidingThreshold )
+	{
+		mTextHidingThreshold = MAX( 0, pixels );
+		[self setNeedsDisplay:YES];
+	}
+}
+
+
+- (CGFloat)				textHidingThreshold
+{
+	return mTextHidingThreshold;
+}
+
+
 #pragma mark -
 #pragma mark - setting the undo manager
 ///*********************************************************************************************************************
@@ -2823,44 +2887,21 @@ static id	sDearchivingHelper = nil;
 	// save the graphics context on entry so that we can restore it when we return. This allows recovery from an exception
 	// that could leave the context stack unbalanced.
 	
-	NSGraphicsContext* topContext = [[NSGraphicsContext currentContext] retain];
+	NSGraphicsContext*	topContext = [[NSGraphicsContext currentContext] retain];
+	BOOL				drawing = NO;
 	
 	@try
 	{
-		// paint the paper colour over the view area. Not printed unless explictly set to do so.
-		
-		if([NSGraphicsContext currentContextDrawingToScreen] || [self paperColourIsPrinted])
-		{
-			[[self paperColour] set];
-			NSRectFillUsingOperation( rect, NSCompositeSourceOver );
-		}
+		[self drawPaperInRect:rect];
 		
-		// if no layers, nothing to draw
+		// draw all the layer content
 		
-		if ([self visible] && [self countOfLayers] > 0 )
+		if([self beginDrawingRect:rect inView:aView])
 		{
-			// if not forcing a high quality render, set low quality and start the timer
-			
-			if ( !m_isForcedHQUpdate )
-			{
-				[self checkIfLowQualityRequired];
-				m_lastRectUpdated = NSUnionRect( m_lastRectUpdated, rect );
-			}
-			
-			if ([self knobsShouldAdjustToViewScale] && aView != nil )
-				[[self knobs] setControlKnobSizeForViewScale:[aView scale]];
-
-			// draw all the layer content
-			
-			if([[self delegate] respondsToSelector:@selector(drawing:willDrawRect:inView:)])
-				[[self delegate] drawing:self willDrawRect:rect inView:aView];
-			
-			[self beginDrawing];
+			drawing = YES;
 			[super drawRect:rect inView:aView];
-			[self endDrawing];
-
-			if([[self delegate] respondsToSelector:@selector(drawing:didDrawRect:inView:)])
-				[[self delegate] drawing:self didDrawRect:rect inView:aView];
+			drawing = NO;
+			[self endDrawingRect:rect inView:aView];
 		}
 	}
 	@catch(id exc)
@@ -2869,7 +2910,10 @@ static id	sDearchivingHelper = nil;
 	}
 	@finally
 	{
-		m_isForcedHQUpdate = NO;
+		// if the layers threw, the frame that -beginDrawingRect:inView: started must still be ended
+		
+		if( drawing )
+			[mFrameBudget endFrame];
 	}
 	
 	[NSGraphicsContext setCurrentContext:topContext];
@@ -2877,6 +2921,94 @@ static id	sDearchivingHelper = nil;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			drawPaperInRect:
+/// scope:			public method
+/// overrides:
+/// description:	paints the paper colour over an area of the drawing
+/// 
+/// parameters:		<rect> the area being drawn
+/// result:			none
+///
+/// notes:			not printed unless explictly set to do so.
+///
+///********************************************************************************************************************
+
+- (void)				drawPaperInRect:(NSRect) rect
+{
+	if([NSGraphicsContext currentContextDrawingToScreen] || [self paperColourIsPrinted])
+	{
+		[[self paperColour] set];
+		NSRectFillUsingOperation( rect, NSCompositeSourceOver );
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			beginDrawingRect:inView:
+/// scope:			public method
+/// overrides:
+/// description:	prepares the drawing to draw its layers in an area
+/// 
+/// parameters:		<rect> the update rect being drawn
+///					<aView> the view that is drawing
+/// result:			YES if there are layers to draw, in which case -endDrawingRect:inView: must be called after drawing
+///					them. NO if there's nothing to draw.
+///
+/// notes:			-drawRect:inView: calls this before drawing the layers. It starts the frame budget's timing,
+///					sizes the knobs for the view and informs the delegate. It's separate so that the view's tile renderer
+///					can do this once on the main thread while the layers themselves are drawn tile by tile.
+///
+///********************************************************************************************************************
+
+- (BOOL)				beginDrawingRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	// if no layers, nothing to draw
+	
+	if (![self visible] || [self countOfLayers] == 0 )
+		return NO;
+	
+	[self checkIfLowQualityRequired];
+	
+	if ([self knobsShouldAdjustToViewScale] && aView != nil )
+		[[self knobs] setControlKnobSizeForViewScale:[aView scale]];
+
+	if([[self delegate] respondsToSelector:@selector(drawing:willDrawRect:inView:)])
+		[[self delegate] drawing:self willDrawRect:rect inView:aView];
+	
+	[self beginDrawing];
+	return YES;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			endDrawingRect:inView:
+/// scope:			public method
+/// overrides:
+/// description:	completes drawing an area begun with -beginDrawingRect:inView:
+/// 
+/// parameters:		<rect> the update rect that was drawn
+///					<aView> the view that is drawing
+/// result:			none
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (void)				endDrawingRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	[self endDrawing];
+
+	if([[self delegate] respondsToSelector:@selector(drawing:didDrawRect:inView:)])
+		[[self delegate] drawing:self didDrawRect:rect inView:aView];
+	
+	[mFrameBudget endFrame];
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			setNeedsDisplay:
@@ -3080,12 +3212,10 @@ static id	sDearchivingHelper = nil;
 	m_activeLayerRef = nil;
 	mDelegateRef = nil;
 	
-	if (m_renderQualityTimer != nil)
-	{
-		[m_renderQualityTimer invalidate];
-		[m_renderQualityTimer release];
-		m_renderQualityTimer = nil;
-	}
+	// the budget's refinement timer retains it, so it must be invalidated to be released
+	
+	[mFrameBudget invalidate];
+	[mFrameBudget release];
 	
 	[m_paperColour release];
 	[mColourSpace release];
@@ -3205,6 +3335,9 @@ static id	sDearchivingHelper = nil;
 
 		m_lastRenderTime = [NSDate timeIntervalSinceReferenceDate];
 		
+		[self setTextGreekingThreshold:kDKDefaultTextGreekingThreshold];
+		[self setTextHidingThreshold:kDKDefaultTextHidingThreshold];
+		
 		// older files handled the knobs differently, so if at this point there are no knobs, Supply a default set
 		
 		if([self knobs] == nil )
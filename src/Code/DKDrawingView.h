@@ -11,7 +11,14 @@
 #import "GCZoomView.h"
 
 
-@class DKDrawing, DKLayer, DKViewController;
+@class DKDrawing, DKLayer, DKViewController, DKLRUCache;
+
+
+// tile cache:
+
+#define		kDKDrawingViewTileSize					256					// tile width and height, in view points (not drawing units)
+#define		kDKDrawingViewDefaultTileCacheBudget	(64 * 1024 * 1024)	// default memory budget for each view's tile cache, in bytes
+#define		kDKDrawingViewMinimumConcurrentTiles	4					// fewer missing tiles than this are rendered on the main thread only
 
 
 typedef NS_ENUM(NSInteger, DKCropMarkKind)
@@ -36,6 +43,10 @@ typedef NS_ENUM(NSInteger, DKCropMarkKind)
 	NSRect				mEditorFrame;			// tracks current frame of text editor
 	NSTimeInterval		mLastMouseDragTime;		// time of last mouseDragged: event
 	NSDictionary*		mRulerMarkersDict;		// tracks ruler markers
+	DKLRUCache*			mTileCache;				// rendered tiles of drawing content, keyed by tile position and view scale
+	BOOL				mTilingUnavailable;		// set if tiles can't be rendered for this view's context, so it draws directly
+	BOOL				mRenderingTile;			// YES while tiles are being rendered
+	NSRect				mTileRect;				// the area being rendered into tiles - becomes the update region while mRenderingTile is set
 }
 
 + (DKDrawingView*)		currentlyDrawingView;
@@ -56,6 +67,16 @@ typedef NS_ENUM(NSInteger, DKCropMarkKind)
 @property (assign) DKViewController *controller;
 - (void)				replaceControllerWithController:(DKViewController*) newController;
 
+// tile cache
+
+@property (class) BOOL tileCacheEnabled;
+@property (class) NSUInteger tileCacheByteBudget;
+@property (class) BOOL concurrentTileRenderingEnabled;
+
+- (DKLRUCache*)			tileCache;
+- (void)				invalidateTilesInRect:(NSRect) rect;
+- (void)				invalidateAllTiles;
+
 // automatic drawing info
 
 - (DKDrawing*)			drawing;
@@ -144,6 +165,19 @@ one view. The views are not required to be in the same window.
 
 The actual contents of the drawing are all supplied by DKDrawing - all this does is call it to render its contents.
 
+To make scrolling and exposure cheap, the view keeps the drawing content it renders as a cache of tiles, each kDKDrawingViewTileSize
+points square and rendered at the current scale. An update draws whatever tiles it can from the cache and renders only those that are
+missing. Tiles are discarded whenever an area of the view is marked as needing display, so content changes are
+always picked up; tiles at other scales are kept so zooming back is fast too. The cache holds tiles up to a byte budget, discarding the
+least recently used. Tiling is bypassed when printing or exporting, during live resize and while the scale is changing. The controller's
+own drawing (tool feedback, etc.) and page breaks are always drawn directly, on top.
+
+When many tiles are missing at once, such as a full redraw or a zoom, they are rendered in parallel. Each tile gets its own bitmap
+context, and a pool of secondary threads (one per core) draws the tiles into them while the main thread waits, then composites the
+results. Only layers that say they can be drawn concurrently (-canRenderConcurrentlyInRect:inView:) are drawn this way - an object layer
+can if none of the objects in the area draw text or images or use other main-thread-only features. Any other layer is drawn into each
+tile in turn on the main thread, so stacking order is preserved.
+
 If the drawing system is built by hand, the drawing owns the view controller(s), and some other object (a document for example) will own the
 drawing. However, like NSTextView, if you don't build a system by hand, this creates a default one for you which it takes ownership
 of. By default this consists of 3 layers - a grid layer, a guide layer and a standard object layer. You can change this however you like, it's
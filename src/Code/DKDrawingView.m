@@ -12,8 +12,11 @@
 #import "DKDrawingView.h"
 #import "DKToolController.h"
 #import "DKDrawing.h"
+#import "DKFrameBudget.h"
 #import "DKGridLayer.h"
 #import "GCThreadQueue.h"
+#import "DKLRUCache.h"
+#import "DKQuartzCache.h"
 #import "LogEvent.h"
 #import "NSBezierPath+Shapes.h"
 #import "NSColor+DKAdditions.h"
@@ -50,6 +53,15 @@ NSString*		kDKDrawingViewVerticalBottomMarkerName		= @"marker_v_bottom";
 static NSMutableArray*	sDrawingViewStack = nil;	// stack of view refs
 static NSColor*			sPageBreakColour = nil;
 static NSPoint			sLastContextMenuClick = {0,0};
+static BOOL				sTileCacheEnabled = YES;
+static NSUInteger		sTileCacheByteBudget = kDKDrawingViewDefaultTileCacheBudget;
+static BOOL				sConcurrentTileRenderingEnabled = YES;
+static BOOL				sConcurrentTileRenderingUnavailable = NO;
+static GCThreadQueue*	sTileRenderQueue = nil;		// tiles waiting for a secondary thread to render them
+static NSUInteger		sTileRenderThreadCount = 0;
+
+static NSString*		kDKDrawingViewStackThreadKey = @"kDKDrawingViewStack";
+static NSString*		kDKDrawingViewTileRectThreadKey = @"kDKDrawingViewTileRect";
 
 NSString* kDKTextEditorUndoesTypingPrefsKey					= @"kDKTextEditorUndoesTyping";
 
@@ -57,12 +69,270 @@ NSString* kDKTextEditorUndoesTypingPrefsKey					= @"kDKTextEditorUndoesTyping";
 @interface DKDrawingView (Private)
 
 + (void)				secondaryThreadEntryPoint:(id) obj;
-+ (BOOL)				secondaryThreadShouldRun;
-+ (void)				signalSecondaryThreadShouldDrawInRect:(NSRect) rect withView:(DKDrawingView*) aView;
++ (NSUInteger)			startSecondaryThreads;
++ (void)				signalSecondaryThreadsShouldRender:(NSArray*) renderers;
 - (void)				postMouseLocationInfo:(NSString*) operation event:(NSEvent*) event;
 + (void)				pushCurrentViewAndSet:(DKDrawingView*) aView;
 - (void)				setRulerMarkerInfo:(NSDictionary*) dict;
 - (NSDictionary*)		rulerMarkerInfo;
+- (BOOL)				drawTilesInRect:(NSRect) rect;
+- (DKQuartzCache*)		renderContentInRect:(NSRect) area;
+- (NSArray*)			renderTilesConcurrently:(NSArray*) rects inArea:(NSRect) area;
+- (void)				setRenderingTileRect:(const NSRect*) rect;
+- (const NSRect*)		renderingTileRect;
+
+@end
+
+
+// a rendered tile - the cached content and the area of the drawing it covers
+
+@interface DKDrawingViewTile : NSObject
+{
+@private
+	DKQuartzCache*		mContent;
+	CGImageRef			mImage;
+	NSRect				mRect;
+	CGFloat				mBackingScale;
+}
+
+- (id)					initWithContent:(DKQuartzCache*) content rect:(NSRect) rect backingScale:(CGFloat) backing;
+- (id)					initWithImage:(CGImageRef) image rect:(NSRect) rect;
+- (NSRect)				rect;
+- (NSUInteger)			byteCost;
+- (void)				draw;
+
+@end
+
+
+@implementation DKDrawingViewTile
+
+- (id)					initWithContent:(DKQuartzCache*) content rect:(NSRect) rect backingScale:(CGFloat) backing
+{
+	self = [super init];
+	if( self )
+	{
+		mContent = [content retain];
+		mRect = rect;
+		mBackingScale = MAX( 1.0, backing );
+	}
+	
+	return self;
+}
+
+
+- (id)					initWithImage:(CGImageRef) image rect:(NSRect) rect
+{
+	self = [super init];
+	if( self )
+	{
+		mImage = CGImageRetain( image );
+		mRect = rect;
+	}
+	
+	return self;
+}
+
+
+- (NSRect)				rect
+{
+	return mRect;
+}
+
+
+- (NSUInteger)			byteCost
+{
+	// the memory the tile's pixels occupy, for the tile cache's budget. Layers are sized in points, but made from the window's context they
+	// have a backing store at the window's backing scale.
+	
+	if( mImage )
+		return CGImageGetBytesPerRow( mImage ) * CGImageGetHeight( mImage );
+	else
+	{
+		NSSize size = [mContent size];
+		return (NSUInteger)( ceil( size.width * mBackingScale ) * ceil( size.height * mBackingScale ) * 4 );
+	}
+}
+
+
+- (void)				draw
+{
+	// tiles rendered on the main thread are CGLayers, those rendered concurrently are bitmap images
+	
+	if( mContent )
+		[mContent drawInRect:mRect];
+	else if( mImage )
+		CGContextDrawImage([[NSGraphicsContext currentContext] graphicsPort], NSRectToCGRect( mRect ), mImage );
+}
+
+
+- (void)				dealloc
+{
+	[mContent release];
+	CGImageRelease( mImage );
+	[super dealloc];
+}
+
+@end
+
+
+// renders one tile of the drawing into a private bitmap context. The same renderer is used on the main thread and on the secondary
+// threads - each call to -render draws the layers it has been given into the bitmap, on top of whatever the previous calls drew.
+
+@interface DKDrawingViewTileRenderer : NSObject
+{
+@private
+	DKDrawingView*		mViewRef;
+	NSRect				mRect;
+	CGContextRef		mContext;
+	NSArray*			mLayers;
+	BOOL				mDrawsPaper;
+	NSConditionLock*	mBatchRef;
+}
+
+- (id)					initWithView:(DKDrawingView*) aView rect:(NSRect) rect;
+- (NSRect)				rect;
+- (BOOL)				isDrawingToScreen;
+- (void)				setLayers:(NSArray*) layers drawsPaper:(BOOL) paper;
+- (void)				setBatch:(NSConditionLock*) batch;
+- (void)				render;
+- (CGImageRef)			createImage;
+
+@end
+
+
+@implementation DKDrawingViewTileRenderer
+
+- (id)					initWithView:(DKDrawingView*) aView rect:(NSRect) rect
+{
+	self = [super init];
+	if( self )
+	{
+		CGFloat			backing = MAX( 1.0, [[aView window] backingScaleFactor]);
+		size_t			pixels = (size_t) ceil( kDKDrawingViewTileSize * backing );
+		NSColorSpace*	windowSpace = [[aView window] colorSpace];
+		CGColorSpaceRef	space;
+		
+		if( windowSpace && [windowSpace colorSpaceModel] == NSRGBColorSpaceModel )
+			space = CGColorSpaceRetain([windowSpace CGColorSpace]);
+		else
+			space = CGColorSpaceCreateDeviceRGB();
+		
+		mContext = CGBitmapContextCreate( NULL, pixels, pixels, 8, 0, space, kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Host );
+		CGColorSpaceRelease( space );
+		
+		if( mContext == NULL )
+		{
+			[self release];
+			return nil;
+		}
+		
+		CGContextScaleCTM( mContext, backing, backing );
+		mViewRef = aView;
+		mRect = rect;
+	}
+	
+	return self;
+}
+
+
+- (NSRect)				rect
+{
+	return mRect;
+}
+
+
+- (BOOL)				isDrawingToScreen
+{
+	// the drawing omits screen-only content (selection, etc) when this is NO, so tiles can't be rendered this way
+	
+	return [[NSGraphicsContext graphicsContextWithGraphicsPort:mContext flipped:[mViewRef isFlipped]] isDrawingToScreen];
+}
+
+
+- (void)				setLayers:(NSArray*) layers drawsPaper:(BOOL) paper
+{
+	[layers retain];
+	[mLayers release];
+	mLayers = layers;
+	mDrawsPaper = paper;
+}
+
+
+- (void)				setBatch:(NSConditionLock*) batch
+{
+	mBatchRef = batch;
+}
+
+
+- (void)				render
+{
+	// draws the layers into the bitmap exactly as the view would draw them for this area. The view is made the current view,
+	// and the tile the area being drawn, for this thread only. If part of a batch, decrements the batch's count when done.
+	
+	NSAutoreleasePool*	pool = [NSAutoreleasePool new];
+	DKDrawing*			drawing = [mViewRef drawing];
+	CGFloat				scale = [mViewRef scale];
+	NSEnumerator*		iter = [mLayers objectEnumerator];
+	DKLayer*			layer;
+	
+	[NSGraphicsContext saveGraphicsState];
+	[NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithGraphicsPort:mContext flipped:[mViewRef isFlipped]]];
+	CGContextSaveGState( mContext );
+	
+	[DKDrawingView pushCurrentViewAndSet:mViewRef];
+	[mViewRef setRenderingTileRect:&mRect];
+	
+	NSAffineTransform* tfm = [NSAffineTransform transform];
+	[tfm scaleBy:scale];
+	[tfm translateXBy:-mRect.origin.x yBy:-mRect.origin.y];
+	[tfm concat];
+	
+	NSRectClip( mRect );
+	
+	if([drawing clipsDrawingToInterior])
+		[NSBezierPath clipRect:[drawing interior]];
+	
+	@try
+	{
+		if( mDrawsPaper )
+			[drawing drawPaperInRect:mRect];
+		
+		while(( layer = [iter nextObject]))
+			[drawing drawLayer:layer inRect:mRect inView:mViewRef];
+	}
+	@catch( id exc )
+	{
+		NSLog(@"### DK: An exception occurred while rendering a tile - (%@) - will be ignored ###", exc );
+	}
+	
+	[mViewRef setRenderingTileRect:NULL];
+	[DKDrawingView pop];
+	
+	CGContextRestoreGState( mContext );
+	[NSGraphicsContext restoreGraphicsState];
+	
+	if( mBatchRef )
+	{
+		[mBatchRef lock];
+		[mBatchRef unlockWithCondition:[mBatchRef condition] - 1];
+	}
+	
+	[pool drain];
+}
+
+
+- (CGImageRef)			createImage
+{
+	return CGBitmapContextCreateImage( mContext );
+}
+
+
+- (void)				dealloc
+{
+	CGContextRelease( mContext );
+	[mLayers release];
+	[super dealloc];
+}
 
 @end
 
@@ -84,33 +354,58 @@ NSString* kDKTextEditorUndoesTypingPrefsKey					= @"kDKTextEditorUndoesTyping";
 /// result:			the current view that is drawing
 ///
 /// notes:			this is only valid during a drawRect: call - some internal parts of DK use this to obtain the
-///					view doing the drawing when they do not have a direct parameter to it.
+///					view doing the drawing when they do not have a direct parameter to it. Secondary threads rendering
+///					tiles each get the view they are rendering.
 ///
 ///********************************************************************************************************************
 
+static NSMutableArray*	drawingViewStackForCurrentThread( void )
+{
+	// the main thread's stack is static. A secondary thread rendering tiles has its own, kept in its thread dictionary, so that each
+	// thread sees the view it's drawing
+	
+	if([NSThread isMainThread])
+	{
+		if( sDrawingViewStack == nil )
+			sDrawingViewStack = [[NSMutableArray alloc] init];
+		
+		return sDrawingViewStack;
+	}
+	
+	NSMutableDictionary*	threadDict = [[NSThread currentThread] threadDictionary];
+	NSMutableArray*			stack = [threadDict objectForKey:kDKDrawingViewStackThreadKey];
+	
+	if( stack == nil )
+	{
+		stack = [NSMutableArray array];
+		[threadDict setObject:stack forKey:kDKDrawingViewStackThreadKey];
+	}
+	
+	return stack;
+}
+
+
 + (DKDrawingView*)		currentlyDrawingView
 {
-	return [sDrawingViewStack lastObject];
+	return [drawingViewStackForCurrentThread() lastObject];
 }
 
 
 + (void)				pushCurrentViewAndSet:(DKDrawingView*) aView
 {
-	if( sDrawingViewStack == nil )
-		sDrawingViewStack = [[NSMutableArray alloc] init];
-		
 	//NSLog(@"pushing %@; setting %@", [self currentlyDrawingView], aView);
 		
-	[sDrawingViewStack addObject:aView];
+	[drawingViewStackForCurrentThread() addObject:aView];
 }
 
 
 + (void)				pop
 {
-	NSUInteger stackSize = [sDrawingViewStack count];
+	NSMutableArray*	stack = drawingViewStackForCurrentThread();
+	NSUInteger		stackSize = [stack count];
 	
 	if( stackSize > 0 )
-		[sDrawingViewStack removeObjectAtIndex:stackSize - 1];
+		[stack removeObjectAtIndex:stackSize - 1];
 
 	//NSLog(@"popping %@", [self currentlyDrawingView]);
 }
@@ -1334,10 +1629,556 @@ static Class	s_textEditorClass = Nil;
 	else
 		[[self enclosingScrollView] setBackgroundColor:[NSColor veryLightGrey]];
 	
+	[self invalidateAllTiles];
 	[self setNeedsDisplay:YES];
 }
 
 
+#pragma mark -
+#pragma mark - tile cache
+
+///*********************************************************************************************************************
+///
+/// method:			setTileCacheEnabled:
+/// scope:			public class method
+/// overrides:
+/// description:	set whether views cache their rendered content as tiles
+/// 
+/// parameters:		<enable> YES to use the tile cache (the default), NO to always render the drawing directly
+/// result:			none
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
++ (void)				setTileCacheEnabled:(BOOL) enable
+{
+	sTileCacheEnabled = enable;
+}
+
+
++ (BOOL)				tileCacheEnabled
+{
+	return sTileCacheEnabled;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setTileCacheByteBudget:
+/// scope:			public class method
+/// overrides:
+/// description:	set the approximate memory each view's tile cache may use
+/// 
+/// parameters:		<bytes> the budget in bytes
+/// result:			none
+///
+/// notes:			when the budget is exceeded, the least recently drawn tiles are discarded. Applies to existing views
+///					the next time they draw.
+///
+///********************************************************************************************************************
+
++ (void)				setTileCacheByteBudget:(NSUInteger) bytes
+{
+	sTileCacheByteBudget = bytes;
+}
+
+
++ (NSUInteger)			tileCacheByteBudget
+{
+	return sTileCacheByteBudget;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setConcurrentTileRenderingEnabled:
+/// scope:			public class method
+/// overrides:
+/// description:	set whether missing tiles may be rendered in parallel on secondary threads
+/// 
+/// parameters:		<enable> YES to render tiles concurrently where possible (the default), NO to render on the main thread only
+/// result:			none
+///
+/// notes:			has no effect unless the tile cache is enabled, or on a single core machine
+///
+///********************************************************************************************************************
+
++ (void)				setConcurrentTileRenderingEnabled:(BOOL) enable
+{
+	sConcurrentTileRenderingEnabled = enable;
+}
+
+
++ (BOOL)				concurrentTileRenderingEnabled
+{
+	return sConcurrentTileRenderingEnabled;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			startSecondaryThreads
+/// scope:			private class method
+/// overrides:
+/// description:	starts the pool of threads that render tiles, if it hasn't been started already
+/// 
+/// parameters:		none
+/// result:			the number of threads in the pool
+///
+/// notes:			one thread per active core. The threads live for the life of the app, blocked on the queue when idle.
+///					There's no point with just one core, so no threads are started and the result is 0.
+///
+///********************************************************************************************************************
+
++ (NSUInteger)			startSecondaryThreads
+{
+	if( sTileRenderQueue == nil )
+	{
+		NSUInteger cores = [[NSProcessInfo processInfo] activeProcessorCount];
+		
+		sTileRenderQueue = [[GCThreadQueue alloc] init];
+		
+		if( cores > 1 )
+		{
+			for( sTileRenderThreadCount = 0; sTileRenderThreadCount < cores; ++sTileRenderThreadCount )
+				[NSThread detachNewThreadSelector:@selector(secondaryThreadEntryPoint:) toTarget:[DKDrawingView class] withObject:nil];
+		}
+	}
+	
+	return sTileRenderThreadCount;
+}
+
+
++ (void)				secondaryThreadEntryPoint:(id) obj
+{
+	#pragma unused(obj)
+	
+	// renders each tile that arrives on the queue, forever
+	
+	NSAutoreleasePool*	pool;
+	
+	while( YES )
+	{
+		pool = [NSAutoreleasePool new];
+		[(DKDrawingViewTileRenderer*)[sTileRenderQueue dequeue] render];
+		[pool drain];
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			signalSecondaryThreadsShouldRender:
+/// scope:			private class method
+/// overrides:
+/// description:	renders a batch of tiles on the secondary threads, returning when they are all done
+/// 
+/// parameters:		<renderers> the tile renderers, already given the layers to draw
+/// result:			none
+///
+/// notes:			the main thread is blocked until the batch completes. This is deliberate - the drawing can't change
+///					while the threads are drawing it, and anything the drawing caches on the main thread (or that isn't
+///					safe to draw concurrently) isn't touched at the same time.
+///
+///********************************************************************************************************************
+
++ (void)				signalSecondaryThreadsShouldRender:(NSArray*) renderers
+{
+	NSConditionLock*			batch = [[NSConditionLock alloc] initWithCondition:[renderers count]];
+	NSEnumerator*				iter = [renderers objectEnumerator];
+	DKDrawingViewTileRenderer*	renderer;
+	
+	while(( renderer = [iter nextObject]))
+	{
+		[renderer setBatch:batch];
+		[sTileRenderQueue enqueue:renderer];
+	}
+	
+	[batch lockWhenCondition:0];
+	[batch unlock];
+	
+	[renderers makeObjectsPerformSelector:@selector(setBatch:) withObject:nil];
+	[batch release];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			tileCache
+/// scope:			public instance method
+/// overrides:
+/// description:	return the view's cache of rendered tiles
+/// 
+/// parameters:		none
+/// result:			the cache
+///
+/// notes:			the cache's statistics can be used to tune the byte budget
+///
+///********************************************************************************************************************
+
+- (DKLRUCache*)			tileCache
+{
+	if( mTileCache == nil )
+		mTileCache = [[DKLRUCache alloc] initWithCostLimit:[[self class] tileCacheByteBudget]];
+	else if([mTileCache costLimit] != [[self class] tileCacheByteBudget])
+		[mTileCache setCostLimit:[[self class] tileCacheByteBudget]];
+	
+	return mTileCache;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			invalidateTilesInRect:
+/// scope:			public instance method
+/// overrides:
+/// description:	discard any cached tiles, at any scale, that overlap the given area of the drawing
+/// 
+/// parameters:		<rect> the area that has changed, in drawing coordinates
+/// result:			none
+///
+/// notes:			called whenever an area of the view is marked as needing display. The area is
+///					expanded slightly so that antialiased edges just outside it are refreshed too.
+///
+///********************************************************************************************************************
+
+- (void)				invalidateTilesInRect:(NSRect) rect
+{
+	if([mTileCache count] == 0 || NSIsEmptyRect( rect ))
+		return;
+	
+	NSEnumerator*		iter = [[mTileCache allKeys] objectEnumerator];
+	NSString*			key;
+	DKDrawingViewTile*	tile;
+	
+	rect = NSInsetRect( rect, -1.0, -1.0 );
+	
+	while(( key = [iter nextObject]))
+	{
+		tile = [mTileCache peekObjectForKey:key];
+		
+		if( tile && NSIntersectsRect([tile rect], rect ))
+			[mTileCache removeObjectForKey:key];
+	}
+}
+
+
+- (void)				invalidateAllTiles
+{
+	[mTileCache removeAllObjects];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawTilesInRect:
+/// scope:			private instance method
+/// overrides:
+/// description:	draws the drawing content in <rect> from the tile cache, rendering any missing tiles
+/// 
+/// parameters:		<rect> the area being updated
+/// result:			YES if the content was drawn, NO if the caller should render the drawing directly
+///
+/// notes:			the tile grid is fixed relative to the drawing origin, so scrolling reuses the same tiles. Missing
+///					tiles are rendered together in one pass of the drawing, then cut up - a single pass keeps the drawing's
+///					quality modulation consistent across the update. If enough are missing they are rendered in parallel
+///					instead, still as a single pass as far as the drawing is concerned. Content rendered in low quality is
+///					shown but not cached, so the cache only ever holds final-quality tiles - when the frame budget has
+///					degraded some renderers, only the tiles containing objects they drew are left out.
+///
+///********************************************************************************************************************
+
+- (BOOL)				drawTilesInRect:(NSRect) rect
+{
+	if( ![[self class] tileCacheEnabled] || mTilingUnavailable || mRenderingTile )
+		return NO;
+	
+	if( ![NSGraphicsContext currentContextDrawingToScreen] || [self inLiveResize] || [self isChangingScale] || [self drawing] == nil )
+		return NO;
+	
+	NSRect		dr = NSIntersectionRect( rect, [self bounds]);
+	
+	if( NSIsEmptyRect( dr ))
+		return NO;
+	
+	DKLRUCache*			cache = [self tileCache];
+	CGFloat				scale = [self scale];
+	CGFloat				span = kDKDrawingViewTileSize / scale;
+	NSMutableArray*		missingKeys = [NSMutableArray array];
+	NSMutableArray*		missingRects = [NSMutableArray array];
+	NSRect				missingArea = NSZeroRect;
+	NSRect				tileRect;
+	NSInteger			x, y, x0, x1, y0, y1;
+	NSString*			key;
+	DKDrawingViewTile*	tile;
+	
+	x0 = (NSInteger) floor( NSMinX( dr ) / span );
+	x1 = (NSInteger) ceil( NSMaxX( dr ) / span );
+	y0 = (NSInteger) floor( NSMinY( dr ) / span );
+	y1 = (NSInteger) ceil( NSMaxY( dr ) / span );
+	
+	// draw what's already cached, and note what isn't
+	
+	for( y = y0; y < y1; ++y )
+	{
+		for( x = x0; x < x1; ++x )
+		{
+			key = [NSString stringWithFormat:@"%ld,%ld,%a", (long) x, (long) y, (double) scale];
+			tile = [cache objectForKey:key];
+			
+			if( tile )
+				[tile draw];
+			else
+			{
+				tileRect = NSMakeRect( x * span, y * span, span, span );
+				missingArea = NSUnionRect( missingArea, tileRect );
+				[missingKeys addObject:key];
+				[missingRects addObject:[NSValue valueWithRect:tileRect]];
+			}
+		}
+	}
+	
+	if([missingKeys count] == 0 )
+		return YES;
+	
+	NSUInteger	i;
+	
+	if([missingKeys count] >= kDKDrawingViewMinimumConcurrentTiles && [[self class] concurrentTileRenderingEnabled])
+	{
+		NSArray* rendered = [self renderTilesConcurrently:missingRects inArea:missingArea];
+		
+		if( rendered )
+		{
+			BOOL			cacheTiles = ![[self drawing] lowRenderingQuality];
+			DKFrameBudget*	budget = [[self drawing] frameBudget];
+			
+			for( i = 0; i < [rendered count]; ++i )
+			{
+				tile = [rendered objectAtIndex:i];
+				[tile draw];
+				
+				if( cacheTiles && ![budget hasDegradedContentInRect:[tile rect]])
+					[cache setObject:tile forKey:[missingKeys objectAtIndex:i] cost:[tile byteCost]];
+			}
+			
+			return YES;
+		}
+	}
+	
+	DKQuartzCache* content = [self renderContentInRect:missingArea];
+	
+	if( content == nil )
+	{
+		// tiles can't be used in this context - the caller will draw over whatever has been done so far
+		
+		mTilingUnavailable = YES;
+		return NO;
+	}
+	
+	[content drawInRect:missingArea];
+	
+	// low quality content is only drawn, never cached, so that it's refined when redrawn. Only the tiles containing objects
+	// that the frame budget degraded are left out
+	
+	if(![[self drawing] lowRenderingQuality])
+	{
+		DKFrameBudget* budget = [[self drawing] frameBudget];
+		
+		for( i = 0; i < [missingKeys count]; ++i )
+		{
+			tileRect = [[missingRects objectAtIndex:i] rectValue];
+			
+			if([budget hasDegradedContentInRect:tileRect])
+				continue;
+			
+			DKQuartzCache* tileContent = [DKQuartzCache cacheForCurrentContextWithSize:NSMakeSize( kDKDrawingViewTileSize, kDKDrawingViewTileSize )];
+			
+			[tileContent lockFocus];
+			[content drawAtPoint:NSMakePoint(( NSMinX( missingArea ) - NSMinX( tileRect )) * scale, ( NSMinY( missingArea ) - NSMinY( tileRect )) * scale ) operation:kCGBlendModeCopy fraction:1.0];
+			[tileContent unlockFocus];
+			
+			tile = [[DKDrawingViewTile alloc] initWithContent:tileContent rect:tileRect backingScale:[[self window] backingScaleFactor]];
+			[cache setObject:tile forKey:[missingKeys objectAtIndex:i] cost:[tile byteCost]];
+			[tile release];
+		}
+	}
+	
+	return YES;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			renderContentInRect:
+/// scope:			private instance method
+/// overrides:
+/// description:	renders the drawing content in an area into an offscreen layer at the current scale
+/// 
+/// parameters:		<area> the area of the drawing to render
+/// result:			the rendered content, or nil if it couldn't be rendered
+///
+/// notes:			while rendering, -needsToDrawRect: and -getRectsBeingDrawn:count: report <area> as the update region,
+///					so that nothing is culled because it lies outside the view's current update area. Rendering fails if
+///					the offscreen context doesn't count as a screen context, as the drawing would then omit selection
+///					highlights and other screen-only content.
+///
+///********************************************************************************************************************
+
+- (DKQuartzCache*)		renderContentInRect:(NSRect) area
+{
+	CGFloat			scale = [self scale];
+	DKQuartzCache*	content = [DKQuartzCache cacheForCurrentContextWithSize:NSMakeSize( NSWidth( area ) * scale, NSHeight( area ) * scale )];
+	
+	[content lockFocus];
+	
+	if( ![NSGraphicsContext currentContextDrawingToScreen])
+	{
+		[content unlockFocus];
+		return nil;
+	}
+	
+	NSAffineTransform* tfm = [NSAffineTransform transform];
+	[tfm scaleBy:scale];
+	[tfm translateXBy:-area.origin.x yBy:-area.origin.y];
+	[tfm concat];
+	
+	NSRectClip( area );
+	
+	[self setRenderingTileRect:&area];
+	[[self drawing] drawRect:area inView:self];
+	[self setRenderingTileRect:NULL];
+	
+	[content unlockFocus];
+	
+	return content;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			renderTilesConcurrently:inArea:
+/// scope:			private instance method
+/// overrides:
+/// description:	renders a set of tiles, in parallel where possible
+/// 
+/// parameters:		<rects> the areas of the drawing covered by the tiles, as NSValues
+///					<area> the union of <rects>
+/// result:			the rendered tiles, in the same order as <rects>, or nil if they weren't rendered
+///
+/// notes:			the drawing's layers are taken in runs, bottom first. A run of layers that can render concurrently is
+///					drawn into every tile at once by the secondary threads; any other run is drawn into each tile in turn
+///					on the main thread. The drawing is begun and ended once for the whole area, on the main thread, so
+///					quality modulation and delegate callbacks are the same as when it draws in one pass. Returns nil
+///					(so that the caller renders in one pass instead) if no layer could be drawn concurrently, there's only
+///					one core, or bitmap contexts don't count as screen contexts.
+///
+///********************************************************************************************************************
+
+- (NSArray*)			renderTilesConcurrently:(NSArray*) rects inArea:(NSRect) area
+{
+	if( sConcurrentTileRenderingUnavailable || [[self class] startSecondaryThreads] == 0 )
+		return nil;
+	
+	DKDrawing*			drawing = [self drawing];
+	NSArray*			layers = [drawing layersForDrawing];
+	NSMutableArray*		concurrent = [NSMutableArray array];
+	NSEnumerator*		iter = [layers objectEnumerator];
+	DKLayer*			layer;
+	BOOL				anyConcurrent = NO;
+	BOOL				canRender;
+	
+	// which layers can be drawn in parallel? If none can, there's no gain.
+	
+	while(( layer = [iter nextObject]))
+	{
+		canRender = [layer canRenderConcurrentlyInRect:area inView:self];
+		anyConcurrent |= canRender;
+		[concurrent addObject:[NSNumber numberWithBool:canRender]];
+	}
+	
+	if( !anyConcurrent )
+		return nil;
+	
+	NSMutableArray*				renderers = [NSMutableArray array];
+	DKDrawingViewTileRenderer*	renderer;
+	NSUInteger					i, k;
+	
+	for( i = 0; i < [rects count]; ++i )
+	{
+		renderer = [[DKDrawingViewTileRenderer alloc] initWithView:self rect:[[rects objectAtIndex:i] rectValue]];
+		
+		if( renderer == nil )
+			return nil;
+		
+		[renderers addObject:renderer];
+		[renderer release];
+	}
+	
+	if(![[renderers objectAtIndex:0] isDrawingToScreen])
+	{
+		sConcurrentTileRenderingUnavailable = YES;
+		return nil;
+	}
+	
+	// draw the paper with the first run of layers, then each run of layers in turn
+	
+	BOOL hasLayers = [drawing beginDrawingRect:area inView:self];
+	
+	if( !hasLayers )
+		layers = [NSArray array];
+	
+	i = 0;
+	
+	do
+	{
+		NSArray*	run;
+		
+		canRender = ([layers count] > 0 ) && [[concurrent objectAtIndex:i] boolValue];
+		
+		for( k = i; k < [layers count] && [[concurrent objectAtIndex:k] boolValue] == canRender; ++k )
+			;
+		
+		run = [layers subarrayWithRange:NSMakeRange( i, k - i )];
+		iter = [renderers objectEnumerator];
+		
+		while(( renderer = [iter nextObject]))
+			[renderer setLayers:run drawsPaper:( i == 0 )];
+		
+		if( canRender )
+			[[self class] signalSecondaryThreadsShouldRender:renderers];
+		else
+			[renderers makeObjectsPerformSelector:@selector(render)];
+		
+		i = k;
+	}
+	while( i < [layers count]);
+	
+	if( hasLayers )
+		[drawing endDrawingRect:area inView:self];
+	
+	// wrap the results up as tiles
+	
+	NSMutableArray*		tiles = [NSMutableArray array];
+	DKDrawingViewTile*	tile;
+	CGImageRef			image;
+	
+	iter = [renderers objectEnumerator];
+	
+	while(( renderer = [iter nextObject]))
+	{
+		image = [renderer createImage];
+		tile = [[DKDrawingViewTile alloc] initWithImage:image rect:[renderer rect]];
+		CGImageRelease( image );
+		
+		[tiles addObject:tile];
+		[tile release];
+	}
+	
+	return tiles;
+}
+
+
 #pragma mark -
 
 - (void)				set
@@ -1352,6 +2193,28 @@ static Class	s_textEditorClass = Nil;
 #pragma mark -
 #pragma mark As an NSView
 
+///*********************************************************************************************************************
+///
+/// method:			setNeedsDisplayInRect:
+/// scope:			public instance method
+/// overrides:		NSView
+/// description:	marks an area for update, discarding any cached tiles that cover it
+/// 
+/// parameters:		<rect> the area to update
+/// result:			none
+///
+/// notes:			the view's bounds are in drawing coordinates, so the rect is also the area of the drawing whose tiles
+///					are stale. Done here rather than only in the view controller so that a direct call is also picked up.
+///
+///********************************************************************************************************************
+
+- (void)				setNeedsDisplayInRect:(NSRect) rect
+{
+	[self invalidateTilesInRect:rect];
+	[super setNeedsDisplayInRect:rect];
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			drawRect:
@@ -1362,7 +2225,8 @@ static Class	s_textEditorClass = Nil;
 /// parameters:		<rect> the rect to update
 /// result:			none
 ///
-/// notes:			draws the entire drawing content, then any controller-based content, then finally the pagebreaks.
+/// notes:			draws the entire drawing content (from the tile cache where possible), then any controller-based content,
+///					then finally the pagebreaks.
 ///					If at this point there is no drawing, one is automatically created so that you can get a working
 ///					DK system simply by dropping a DKDrawingView into a window in a nib, and away you go.
 ///
@@ -1373,7 +2237,9 @@ static Class	s_textEditorClass = Nil;
 	// draw the entire content of the drawing:
 	
 	[self set];
-	[[self drawing] drawRect:rect inView:self];
+	
+	if(![self drawTilesInRect:rect])
+		[[self drawing] drawRect:rect inView:self];
 	
 	// if our controller implements a drawRect: method, call it - the default controller doesn't but subclasses can.
 	// any drawing done by a controller will be "on top" of any drawing content. Typically this is used by tools
@@ -1396,6 +2262,88 @@ static Class	s_textEditorClass = Nil;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			needsToDrawRect:
+/// scope:			public instance method
+/// overrides:		NSView
+/// description:	is <aRect> part of the area being drawn?
+/// 
+/// parameters:		<aRect> a rect in the view's coordinates
+/// result:			YES if it should be drawn
+///
+/// notes:			while a tile is being rendered, the tile is the area being drawn, whatever the view's update region
+///
+///********************************************************************************************************************
+
+- (BOOL)				needsToDrawRect:(NSRect) aRect
+{
+	const NSRect* tileRect = [self renderingTileRect];
+	
+	if( tileRect )
+		return NSIntersectsRect( aRect, *tileRect );
+	
+	return [super needsToDrawRect:aRect];
+}
+
+
+- (void)				getRectsBeingDrawn:(const NSRect**) rects count:(NSInteger*) count
+{
+	const NSRect* tileRect = [self renderingTileRect];
+	
+	if( tileRect )
+	{
+		if( rects )
+			*rects = tileRect;
+		
+		if( count )
+			*count = 1;
+	}
+	else
+		[super getRectsBeingDrawn:rects count:count];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setRenderingTileRect:
+/// scope:			private instance method
+/// overrides:
+/// description:	sets the tile being rendered on the current thread, which becomes the area being drawn
+/// 
+/// parameters:		<rect> pointer to the tile's rect, or NULL when rendering is finished
+/// result:			none
+///
+/// notes:			the main thread uses ivars; secondary threads keep the rect in their thread dictionary, as several
+///					may be rendering different tiles of the view at once.
+///
+///********************************************************************************************************************
+
+- (void)				setRenderingTileRect:(const NSRect*) rect
+{
+	if([NSThread isMainThread])
+	{
+		mRenderingTile = ( rect != NULL );
+		
+		if( rect )
+			mTileRect = *rect;
+	}
+	else if( rect )
+		[[[NSThread currentThread] threadDictionary] setObject:[NSData dataWithBytes:rect length:sizeof(NSRect)] forKey:kDKDrawingViewTileRectThreadKey];
+	else
+		[[[NSThread currentThread] threadDictionary] removeObjectForKey:kDKDrawingViewTileRectThreadKey];
+}
+
+
+- (const NSRect*)		renderingTileRect
+{
+	if([NSThread isMainThread])
+		return mRenderingTile? &mTileRect : NULL;
+	
+	return (const NSRect*)[[[[NSThread currentThread] threadDictionary] objectForKey:kDKDrawingViewTileRectThreadKey] bytes];
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			isFlipped
@@ -1858,6 +2806,7 @@ static Class	s_textEditorClass = Nil;
 	}
 	
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[mTileCache release];
 	[mPrintInfo release];
 	[mRulerMarkersDict release];
 	[m_textEditViewRef release];
@@ -166,6 +166,30 @@
 }
 
 
+- (BOOL)		isSafeForConcurrentRendering
+{
+	// gradient shading callbacks keep their place in the colour stops in static variables
+	
+	return m_gradient == nil;
+}
+
+
+- (BOOL)		isExpensiveToRender
+{
+	// blurred shadows are slow to draw, so a shadowed fill is worth caching
+	
+	return [self shadow] != nil && [DKStyle willDrawShadows];
+}
+
+
+- (BOOL)		supportsLowQualityDrawing
+{
+	// at low quality the shadow is approximated
+	
+	return [self shadow] != nil && [DKStyle willDrawShadows];
+}
+
+
 
 
 #pragma mark -
@@ -251,12 +275,20 @@
 		
 		// if low quality, don't bother with shadow - shadows really sap performance
 		
-		BOOL lowQuality = [obj useLowQualityDrawing];
+		BOOL lowQuality = [self useLowQualityDrawingForObject:obj];
 		
 		if([self shadow] != nil && [DKStyle willDrawShadows])
 		{
 			if ( !lowQuality)
-				[[self shadow] setAbsolute];
+			{
+				// a solid colour fill can draw its shadow from the shadow cache, which is much faster than having Quartz blur it.
+				// Pattern colours and gradients vary in opacity, so are shadowed in the usual way.
+				
+				NSColor* rgb = [[self colour] colorUsingColorSpaceName:NSDeviceRGBColorSpace];
+				
+				if([self gradient] != nil || rgb == nil || ![[self shadow] drawCachedShadowWithPath:path operation:kDKShadowDrawFill opacity:[rgb alphaComponent]])
+					[[self shadow] setAbsolute];
+			}
 			else
 				[[self shadow] drawApproximateShadowWithPath:path operation:kDKShadowDrawFill strokeWidth:0];
 		}
@@ -8,6 +8,7 @@
 //
 
 #import "DKPathDecorator.h"
+#import "DKContentHash.h"
 
 
 @interface DKFillPattern : DKPathDecorator <NSCoding, NSCopying>
@@ -23,6 +24,8 @@
 	BOOL				m_motifAngleRelativeToPattern;
 	BOOL				m_noClippedElements;
 	NSMutableArray*		mMotifAngleRandCache;
+	CGImageRef			mTileImage;
+	DKContentHash		mTileHash;
 }
 
 + (DKFillPattern*)	defaultPattern;
@@ -33,6 +36,7 @@
 
 - (void)			fillRect:(NSRect) rect;
 - (void)			drawPatternInPath:(NSBezierPath*) aPath;
+- (BOOL)			drawTiledPatternAtCentre:(NSPoint) cp angle:(CGFloat) angle motifAngle:(CGFloat) mangle spacing:(NSSize) spacing;
 
 - (void)			setAngle:(CGFloat) radians;
 - (CGFloat)			angle;
@@ -57,6 +61,9 @@
 
 @end
 
+#define		kDKFillPatternRandomTileRepeats			4
+#define		kDKFillPatternMaximumTileDimension		2048
+
 
 
 extern NSString* kDKDrawingViewDidChangeScale;
@@ -68,4 +75,10 @@ This object represents a pattern consisting of a repeated motif spaced out at in
 This subclasses DKPathDecorator which carries out the bulk of the work - it stores the image and caches it, this
 just sets up the path clipping and calls the rendering method for each location of the repeating pattern.
 
+When drawing to the screen, the pattern is normally drawn by tiling a bitmap of one repeat of the pattern - two rows and two columns of
+the motif, so that the alternate offsets are included - so a large area costs about the same as a solid fill. Where motifs have random
+angles, scales or positions, the tile instead holds kDKFillPatternRandomTileRepeats repeats with randomness that is fixed for each
+position in the tile. The tile is rebuilt when the pattern's settings or the view scale change. Printing, or patterns that suppress
+clipped elements or offset motifs laterally, still place every motif individually.
+
 */
@@ -14,6 +14,10 @@
 #import "DKGeometryUtilities.h"
 #import "LogEvent.h"
 #import "DKRandom.h"
+#import "DKGradient.h"
+
+
+static CGFloat		tileRandom( NSInteger x, NSInteger y, NSInteger which );
 
 
 @implementation DKFillPattern
@@ -120,6 +124,18 @@
 	if([self motifAngleIsRelativeToPattern])
 		mangle += [self angle];
 	
+	// use a pre-rendered tile if possible. The tile fills the whole clip, so it's clipped to the path here in case the caller hasn't done so.
+	
+	BOOL tiled;
+	
+	SAVE_GRAPHICS_CONTEXT
+	[aPath addClip];
+	tiled = [self drawTiledPatternAtCentre:cp angle:angle motifAngle:mangle spacing:NSMakeSize( dx, dy )];
+	RESTORE_GRAPHICS_CONTEXT
+	
+	if( tiled )
+		return;
+	
 	// how many rows and columns of the motif will we need to fill the rect?
 	// n.b. div by 2 because we go from -cols to +cols etc
 	
@@ -229,6 +245,155 @@
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			drawTiledPatternAtCentre:angle:motifAngle:spacing:
+/// scope:			public instance method
+/// overrides:
+/// description:	draws the pattern by tiling a pre-rendered bitmap of a repeat of the pattern, if possible
+/// 
+/// parameters:		<cp> the centre of the pattern, where the motif at row and column 0 is placed
+///					<angle> the angle of the pattern as a whole
+///					<mangle> the angle of each motif
+///					<spacing> the distance between rows and columns of motifs
+/// result:			YES if the pattern was drawn, NO if the caller needs to place the motifs individually
+///
+/// notes:			the current clip is filled with the tile. The tile contains 2 x 2 motifs (so alternate offsets repeat),
+///					or kDKFillPatternRandomTileRepeats times that if the motifs have any randomness, in which case the random
+///					values are fixed for each position in the tile. The bitmap is cached, and is rebuilt at a resolution
+///					quantized to quarter octaves of the view scale, and is keyed by the image's generation number rather than its
+///					address, which may be reused once the image is freed. Only used when drawing to the screen, so printed patterns
+///					remain vector-based.
+///
+///********************************************************************************************************************
+
+- (BOOL)			drawTiledPatternAtCentre:(NSPoint) cp angle:(CGFloat) angle motifAngle:(CGFloat) mangle spacing:(NSSize) spacing
+{
+	if( m_noClippedElements || [self lateralOffset] != 0.0 || ![NSGraphicsContext currentContextDrawingToScreen])
+		return NO;
+	
+	BOOL		random = [self motifAngleRandomness] > 0.0 || [self wobblyness] > 0.0 || [self scaleRandomness] > 0.0;
+	NSInteger	repeats = random? kDKFillPatternRandomTileRepeats : 1;
+	
+	CGContextRef		context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGAffineTransform	ctm = CGContextGetCTM( context );
+	CGFloat				devScale = sqrt( fabs( ctm.a * ctm.d - ctm.b * ctm.c ));
+	
+	if( devScale <= 0.0 )
+		return NO;
+	
+	// quantize the scale so that zooming doesn't rebuild the tile at every step
+	
+	devScale = pow( 2.0, ceil( log2( devScale ) * 4.0 ) / 4.0 );
+	
+	// a tile that would be too large is made with fewer repeats, and if even one is too large, the motifs are placed individually
+	
+	NSSize	tileSize;
+	size_t	pw, ph;
+	
+	do
+	{
+		tileSize = NSMakeSize( spacing.width * 2 * repeats, spacing.height * 2 * repeats );
+		pw = (size_t) ceil( tileSize.width * devScale );
+		ph = (size_t) ceil( tileSize.height * devScale );
+	}
+	while(( pw > kDKFillPatternMaximumTileDimension || ph > kDKFillPatternMaximumTileDimension ) && ( repeats /= 2 ) > 0 );
+	
+	if( repeats == 0 || pw == 0 || ph == 0 )
+		return NO;
+	
+	NSImage*		image = [self image];
+	NSSize			mb = [image size];
+	BOOL			flipped = [[NSGraphicsContext currentContext] isFlipped];
+	DKContentHash	h = DKHashObject( kDKContentHashSeed, image );
+	
+	h = DKHashFloat( DKHashFloat( DKHashFloat( h, mb.width ), mb.height ), devScale );
+	h = DKHashFloat( DKHashFloat( DKHashFloat( h, spacing.width ), spacing.height ), mangle );
+	h = DKHashFloat( DKHashFloat( DKHashFloat( h, m_altXOffset ), m_altYOffset ), [self scale] );
+	h = DKHashFloat( DKHashFloat( DKHashFloat( h, [self motifAngleRandomness]), [self wobblyness]), [self scaleRandomness]);
+	h = DKHashCombine( DKHashCombine( DKHashCombine( h, [self normalToPath]), flipped ), repeats );
+	
+	if( mTileImage == NULL || h != mTileHash )
+	{
+		CGImageRelease( mTileImage );
+		mTileImage = NULL;
+		
+		CGContextRef bm = CGBitmapContextCreate( NULL, pw, ph, 8, 0, [DKGradient sharedGradientColorSpace], kCGImageAlphaPremultipliedFirst );
+		
+		if( bm == NULL )
+			return NO;
+		
+		CGContextScaleCTM( bm, pw / tileSize.width, ph / tileSize.height );
+		
+		// draw the motifs exactly as -placeObjectAtPoint:... would, with the tile's origin at the motif in row and column 0. Motifs
+		// are also drawn one row and column beyond each edge so that parts overlapping the edges appear on the opposite side.
+		
+		NSInteger	x, y, cols = repeats * 2, rows = repeats * 2;
+		NSPoint		mp;
+		CGFloat		slope, rs;
+		
+		SAVE_GRAPHICS_CONTEXT
+		[NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithGraphicsPort:bm flipped:flipped]];
+		
+		for( y = -1; y <= rows; ++y )
+		{
+			for( x = -1; x <= cols; ++x )
+			{
+				NSInteger tx = ( x + cols ) % cols;
+				NSInteger ty = ( y + rows ) % rows;
+				
+				mp.x = ( y & 1 )? spacing.width * ( x + m_altXOffset ) : x * spacing.width;
+				mp.y = ( x & 1 )? spacing.height * ( y + m_altYOffset ) : y * spacing.height;
+				slope = mangle;
+				rs = 1.0;
+				
+				if( random )
+				{
+					mp.x += tileRandom( tx, ty, 0 ) * spacing.width * [self wobblyness];
+					mp.y += tileRandom( tx, ty, 1 ) * spacing.height * [self wobblyness];
+					slope += tileRandom( tx, ty, 2 ) * 2.0 * M_PI * [self motifAngleRandomness];
+					rs += tileRandom( tx, ty, 3 ) * [self scaleRandomness];
+				}
+				
+				NSAffineTransform* tfm = [NSAffineTransform transform];
+				
+				[tfm translateXBy:mp.x yBy:mp.y];
+				[tfm scaleXBy:[self scale] * rs yBy:[self scale] * -1.0 * rs];
+				
+				if([self normalToPath])
+					[tfm rotateByRadians:-slope];
+				
+				[tfm translateXBy:-( mb.width / 2 ) yBy:-( mb.height / 2 )];
+				
+				[NSGraphicsContext saveGraphicsState];
+				[tfm concat];
+				[image drawAtPoint:NSZeroPoint fromRect:NSZeroRect operation:NSCompositeSourceOver fraction:1.0];
+				[NSGraphicsContext restoreGraphicsState];
+			}
+		}
+		RESTORE_GRAPHICS_CONTEXT
+		
+		mTileImage = CGBitmapContextCreateImage( bm );
+		mTileHash = h;
+		CGContextRelease( bm );
+		
+		if( mTileImage == NULL )
+			return NO;
+	}
+	
+	// the motifs are composited with "source atop" when placed individually, so the tile is too
+	
+	CGContextSaveGState( context );
+	CGContextTranslateCTM( context, cp.x, cp.y );
+	CGContextRotateCTM( context, angle );
+	CGContextSetBlendMode( context, kCGBlendModeSourceAtop );
+	CGContextDrawTiledImage( context, CGRectMake( 0, 0, tileSize.width, tileSize.height ), mTileImage );
+	CGContextRestoreGState( context );
+	
+	return YES;
+}
+
+
 #pragma mark -
 - (void)			setAngle:(CGFloat) radians
 {
@@ -411,6 +576,7 @@
 - (void)			dealloc
 {
 	[mMotifAngleRandCache release];
+	CGImageRelease( mTileImage );
 	[super dealloc];
 }
 
@@ -515,3 +681,14 @@
 }
 
 @end
+
+
+#pragma mark -
+static CGFloat		tileRandom( NSInteger x, NSInteger y, NSInteger which )
+{
+	// a repeatable pseudo-random value in the range -0.5..0.5 for the motif at x, y in a randomised pattern tile
+	
+	DKContentHash h = DKHashCombine( DKHashCombine( DKHashCombine( kDKContentHashSeed, (uint64_t) x ), (uint64_t) y ), (uint64_t) which );
+	
+	return (CGFloat)( h & 0xFFFF ) / 65535.0 - 0.5;
+}
@@ -0,0 +1,88 @@
+//
+//  DKFrameBudget.h
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file.
+//
+
+#import <Cocoa/Cocoa.h>
+#import "DKRasterizerProtocol.h"
+
+
+@class DKDrawing;
+
+
+@interface DKFrameBudget : NSObject
+{
+@private
+	DKDrawing*				mOwnerRef;				// the drawing whose frames are being managed (weak)
+	NSMutableDictionary*	mTimings;				// DKRendererTiming objects keyed by rasterizer class
+	NSTimeInterval			mTargetFrameTime;		// the frame time to aim for
+	NSTimeInterval			mRefinementDelay;		// idle time before degraded areas start to be refined
+	NSTimeInterval			mFrameStart;			// when the current frame began
+	NSUInteger				mFrameDepth;			// nesting count of -beginFrame calls
+	NSUInteger				mDegradedCount;			// number of rasterizer classes currently degraded
+	BOOL					mRefining;				// YES if the next frame is a refinement, so mustn't cause degradation
+	NSTimer*				mRefinementTimer;		// fires to refine one degraded class once drawing goes idle
+	NSLock*					mLock;
+}
+
++ (DKFrameBudget*)		activeBudget;
+
+- (id)					initWithOwner:(DKDrawing*) owner;
+
+- (void)				setTargetFrameTime:(NSTimeInterval) t;
+- (NSTimeInterval)		targetFrameTime;
+- (void)				setRefinementDelay:(NSTimeInterval) t;
+- (NSTimeInterval)		refinementDelay;
+
+// bracketing the drawing of a frame (main thread only):
+
+- (void)				beginFrame;
+- (void)				endFrame;
+
+// used while rendering (any thread):
+
+- (BOOL)				shouldDegradeRenderer:(id<DKRasterizer>) renderer;
+- (void)				renderer:(id<DKRasterizer>) renderer didRenderObject:(id<DKRenderable>) obj inTime:(NSTimeInterval) t;
+- (BOOL)				isDegrading;
+- (BOOL)				hasDegradedContentInRect:(NSRect) rect;
+
+// restoring full quality:
+
+- (void)				refineNextRenderer;
+- (void)				refineAll;
+- (void)				invalidate;
+
+@end
+
+
+#define kDKFrameBudgetDefaultTargetFrameTime		( 1.0 / 30.0 )	// seconds per frame to aim for
+#define kDKFrameBudgetDefaultRefinementDelay		0.2				// seconds without drawing before refinement begins
+#define kDKFrameBudgetMinimumShareOfOverrun			0.25			// fraction of a frame's overrun a class must account for to be degraded
+
+
+/*
+
+A frame budget decides which renderers may draw at low quality so that interactive redraws of a complex drawing keep up. DKDrawing owns
+one and brackets each update with -beginFrame and -endFrame. While a frame is in progress, the budget is the +activeBudget, which the render
+plan uses to time every rasterizer that has a low quality mode (see -[DKRasterizer supportsLowQualityDrawing]), keeping the time per class
+of rasterizer for the frame and a running average of the time per object.
+
+If a frame takes longer than the target, the class of rasterizer that accounted for the most time in that frame is degraded - its
+-useLowQualityDrawingForObject: starts returning YES - and the next frame is measured again, so only as many classes are degraded as it
+takes to meet the target, most expensive first. A class is only degraded if its time in the frame is a meaningful share of the overrun
+(kDKFrameBudgetMinimumShareOfOverrun) - when the frame is dominated by rendering that has no low quality mode, degrading a class that
+costs next to nothing wouldn't help, so nothing is degraded. Shadows, path decorators, roughened hatching and rough strokes all have low quality modes.
+
+The bounds of every object drawn at low quality are recorded against its rasterizer class. Once no frame has been drawn for the refinement
+delay, the budget restores one class at a time, cheapest first, redrawing only the areas that class degraded, with a frame's grace between
+each. A refinement frame never causes further degradation. So instead of the whole view flickering between low and high quality, only the
+expensive parts are simplified, and only for as long as needed.
+
+Low quality content is never kept in the view's tile cache - a tile is only cached if -hasDegradedContentInRect: says nothing in it
+was drawn at low quality.
+
+*/
@@ -0,0 +1,518 @@
+//
+//  DKFrameBudget.m
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file.
+//
+
+#import "DKFrameBudget.h"
+#import "DKDrawing.h"
+
+
+// what is known about one class of rasterizer
+
+@interface DKRendererTiming : NSObject
+{
+@public
+	NSTimeInterval		mAverageCost;		// running average of the time taken to render one object
+	NSTimeInterval		mFrameCost;			// total time spent rendering in the current frame
+	NSUInteger			mFrameCalls;		// number of objects rendered in the current frame
+	BOOL				mDegraded;			// YES if the class is currently drawing at low quality
+	NSRect				mDegradedArea;		// union of the bounds of the objects drawn at low quality
+}
+
+@end
+
+
+@implementation DKRendererTiming
+
+@end
+
+
+#pragma mark -
+
+@interface DKFrameBudget (Private)
+
+- (void)				scheduleRefinement;
+- (void)				refinementTimerCallback:(NSTimer*) timer;
+
+@end
+
+
+#pragma mark -
+
+@implementation DKFrameBudget
+
+static DKFrameBudget*	sActiveBudget = nil;
+
+
+///*********************************************************************************************************************
+///
+/// method:			activeBudget
+/// scope:			public class method
+/// overrides:
+/// description:	returns the budget of the frame currently being drawn
+///
+/// parameters:		none
+/// result:			the budget, or nil if no frame is being drawn or quality modulation is disabled
+///
+/// notes:			may be called from any thread - tiles of a frame may be rendered concurrently
+///
+///********************************************************************************************************************
+
++ (DKFrameBudget*)		activeBudget
+{
+	return sActiveBudget;
+}
+
+
+- (id)					initWithOwner:(DKDrawing*) owner
+{
+	self = [super init];
+	if( self )
+	{
+		mOwnerRef = owner;
+		mTimings = [[NSMutableDictionary alloc] init];
+		mLock = [[NSLock alloc] init];
+		mTargetFrameTime = kDKFrameBudgetDefaultTargetFrameTime;
+		mRefinementDelay = kDKFrameBudgetDefaultRefinementDelay;
+	}
+
+	return self;
+}
+
+
+- (void)				setTargetFrameTime:(NSTimeInterval) t
+{
+	mTargetFrameTime = MAX( 0.001, t );
+}
+
+
+- (NSTimeInterval)		targetFrameTime
+{
+	return mTargetFrameTime;
+}
+
+
+- (void)				setRefinementDelay:(NSTimeInterval) t
+{
+	mRefinementDelay = MAX( 0, t );
+}
+
+
+- (NSTimeInterval)		refinementDelay
+{
+	return mRefinementDelay;
+}
+
+
+#pragma mark -
+
+///*********************************************************************************************************************
+///
+/// method:			beginFrame
+/// scope:			public instance method
+/// overrides:
+/// description:	starts timing a frame
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			calls may be nested, in which case only the outermost pair counts as a frame. Main thread only.
+///
+///********************************************************************************************************************
+
+- (void)				beginFrame
+{
+	if( mFrameDepth++ == 0 )
+	{
+		mFrameStart = [NSDate timeIntervalSinceReferenceDate];
+		sActiveBudget = self;
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			endFrame
+/// scope:			public instance method
+/// overrides:
+/// description:	finishes timing a frame and adjusts the degraded renderers accordingly
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			if the frame went over budget, the class of rasterizer that took the most time in it is degraded, provided
+///					that time is a meaningful share of the overrun. Each frame restarts the idle period after which refinement begins.
+///
+///********************************************************************************************************************
+
+- (void)				endFrame
+{
+	if( mFrameDepth == 0 || --mFrameDepth > 0 )
+		return;
+
+	if( sActiveBudget == self )
+		sActiveBudget = nil;
+
+	NSTimeInterval		elapsed = [NSDate timeIntervalSinceReferenceDate] - mFrameStart;
+	NSEnumerator*		iter;
+	DKRendererTiming*	timing;
+	DKRendererTiming*	worst = nil;
+
+	[mLock lock];
+
+	iter = [mTimings objectEnumerator];
+
+	while(( timing = [iter nextObject]))
+	{
+		if( timing->mFrameCalls > 0 )
+		{
+			NSTimeInterval cost = timing->mFrameCost / timing->mFrameCalls;
+
+			if( timing->mAverageCost <= 0 )
+				timing->mAverageCost = cost;
+			else
+				timing->mAverageCost = timing->mAverageCost * 0.75 + cost * 0.25;
+		}
+
+		if( !timing->mDegraded && timing->mFrameCost > 0 && ( worst == nil || timing->mFrameCost > worst->mFrameCost ))
+			worst = timing;
+	}
+
+	// degrading a class only helps if it accounts for a real part of the overrun - if the time went on rendering that has no
+	// low quality mode, leave things as they are
+
+	if( !mRefining && worst != nil && elapsed > mTargetFrameTime && worst->mFrameCost >= ( elapsed - mTargetFrameTime ) * kDKFrameBudgetMinimumShareOfOverrun )
+	{
+		worst->mDegraded = YES;
+		worst->mDegradedArea = NSZeroRect;
+		++mDegradedCount;
+	}
+
+	iter = [mTimings objectEnumerator];
+
+	while(( timing = [iter nextObject]))
+	{
+		timing->mFrameCost = 0;
+		timing->mFrameCalls = 0;
+	}
+
+	[mLock unlock];
+
+	mRefining = NO;
+
+	if( mDegradedCount > 0 )
+		[self scheduleRefinement];
+}
+
+
+#pragma mark -
+
+///*********************************************************************************************************************
+///
+/// method:			shouldDegradeRenderer:
+/// scope:			public instance method
+/// overrides:
+/// description:	is the rasterizer's class currently degraded?
+///
+/// parameters:		<renderer> the rasterizer about to render
+/// result:			YES if it should use its low quality mode
+///
+/// notes:
+///
+///********************************************************************************************************************
+
+- (BOOL)				shouldDegradeRenderer:(id<DKRasterizer>) renderer
+{
+	if( mDegradedCount == 0 )
+		return NO;
+
+	[mLock lock];
+	DKRendererTiming* timing = [mTimings objectForKey:[renderer class]];
+	BOOL degraded = ( timing != nil && timing->mDegraded );
+	[mLock unlock];
+
+	return degraded;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			renderer:didRenderObject:inTime:
+/// scope:			public instance method
+/// overrides:
+/// description:	records the time a rasterizer took to render an object
+///
+/// parameters:		<renderer> the rasterizer
+///					<obj> the object it rendered
+///					<t> the time taken, in seconds
+/// result:			none
+///
+/// notes:			if the rasterizer's class is degraded, the object's bounds are added to the area that class will refine
+///
+///********************************************************************************************************************
+
+- (void)				renderer:(id<DKRasterizer>) renderer didRenderObject:(id<DKRenderable>) obj inTime:(NSTimeInterval) t
+{
+	Class	rc = [renderer class];
+	NSRect	br = [obj bounds];
+
+	[mLock lock];
+
+	DKRendererTiming* timing = [mTimings objectForKey:rc];
+
+	if( timing == nil )
+	{
+		timing = [[DKRendererTiming alloc] init];
+		[mTimings setObject:timing forKey:rc];
+		[timing release];
+	}
+
+	timing->mFrameCost += t;
+	timing->mFrameCalls++;
+
+	if( timing->mDegraded )
+		timing->mDegradedArea = NSUnionRect( timing->mDegradedArea, br );
+
+	[mLock unlock];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isDegrading
+/// scope:			public instance method
+/// overrides:
+/// description:	are any renderers currently degraded?
+///
+/// parameters:		none
+/// result:			YES if some content may be drawn at low quality
+///
+/// notes:			see -hasDegradedContentInRect: to find out whether a particular area was affected
+///
+///********************************************************************************************************************
+
+- (BOOL)				isDegrading
+{
+	return mDegradedCount > 0;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			hasDegradedContentInRect:
+/// scope:			public instance method
+/// overrides:
+/// description:	was anything in an area drawn at low quality?
+///
+/// parameters:		<rect> an area of the drawing
+/// result:			YES if an object drawn at low quality intersects <rect>
+///
+/// notes:			content in an area for which this returns YES should not be cached, as it will be refined later. Areas
+///					are kept as the union of the degraded objects' bounds, so this may err on the side of YES.
+///
+///********************************************************************************************************************
+
+- (BOOL)				hasDegradedContentInRect:(NSRect) rect
+{
+	if( mDegradedCount == 0 )
+		return NO;
+
+	NSEnumerator*		iter;
+	DKRendererTiming*	timing;
+	BOOL				degraded = NO;
+
+	[mLock lock];
+
+	iter = [mTimings objectEnumerator];
+
+	while(( timing = [iter nextObject]))
+	{
+		if( timing->mDegraded && NSIntersectsRect( timing->mDegradedArea, rect ))
+		{
+			degraded = YES;
+			break;
+		}
+	}
+
+	[mLock unlock];
+
+	return degraded;
+}
+
+
+#pragma mark -
+
+///*********************************************************************************************************************
+///
+/// method:			refineNextRenderer
+/// scope:			public instance method
+/// overrides:
+/// description:	restores full quality to the cheapest degraded class of rasterizer and redraws what it degraded
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			called when drawing has been idle for the refinement delay. Main thread only.
+///
+///********************************************************************************************************************
+
+- (void)				refineNextRenderer
+{
+	NSEnumerator*		iter;
+	DKRendererTiming*	timing;
+	DKRendererTiming*	cheapest = nil;
+	NSRect				area = NSZeroRect;
+
+	[mLock lock];
+
+	iter = [mTimings objectEnumerator];
+
+	while(( timing = [iter nextObject]))
+	{
+		if( timing->mDegraded && ( cheapest == nil || timing->mAverageCost < cheapest->mAverageCost ))
+			cheapest = timing;
+	}
+
+	if( cheapest )
+	{
+		area = cheapest->mDegradedArea;
+		cheapest->mDegraded = NO;
+		cheapest->mDegradedArea = NSZeroRect;
+		--mDegradedCount;
+	}
+
+	[mLock unlock];
+
+	if(!NSIsEmptyRect( area ))
+	{
+		mRefining = YES;
+		[mOwnerRef setNeedsDisplayInRect:area];
+	}
+
+	if( mDegradedCount > 0 )
+		[self scheduleRefinement];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			refineAll
+/// scope:			public instance method
+/// overrides:
+/// description:	restores full quality to all degraded rasterizers at once and redraws what they degraded
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:
+///
+///********************************************************************************************************************
+
+- (void)				refineAll
+{
+	NSEnumerator*		iter;
+	DKRendererTiming*	timing;
+	NSRect				area = NSZeroRect;
+
+	[mRefinementTimer invalidate];
+	[mRefinementTimer release];
+	mRefinementTimer = nil;
+
+	[mLock lock];
+
+	iter = [mTimings objectEnumerator];
+
+	while(( timing = [iter nextObject]))
+	{
+		if( timing->mDegraded )
+		{
+			area = NSUnionRect( area, timing->mDegradedArea );
+			timing->mDegraded = NO;
+			timing->mDegradedArea = NSZeroRect;
+		}
+	}
+
+	mDegradedCount = 0;
+	[mLock unlock];
+
+	if(!NSIsEmptyRect( area ))
+	{
+		mRefining = YES;
+		[mOwnerRef setNeedsDisplayInRect:area];
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			invalidate
+/// scope:			public instance method
+/// overrides:
+/// description:	stops any pending refinement
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			the refinement timer retains the budget, so the owner must call this before releasing it
+///
+///********************************************************************************************************************
+
+- (void)				invalidate
+{
+	[mRefinementTimer invalidate];
+	[mRefinementTimer release];
+	mRefinementTimer = nil;
+	mOwnerRef = nil;
+
+	if( sActiveBudget == self )
+		sActiveBudget = nil;
+}
+
+
+#pragma mark -
+
+- (void)				scheduleRefinement
+{
+	// starts the idle timer, or restarts it if it's already running - thus refinement only happens when frames stop coming
+
+	if( mOwnerRef == nil )
+		return;
+
+	if( mRefinementTimer == nil )
+	{
+		mRefinementTimer = [[NSTimer timerWithTimeInterval:mRefinementDelay target:self selector:@selector(refinementTimerCallback:) userInfo:nil repeats:NO] retain];
+		[[NSRunLoop currentRunLoop] addTimer:mRefinementTimer forMode:NSDefaultRunLoopMode];
+		[[NSRunLoop currentRunLoop] addTimer:mRefinementTimer forMode:NSEventTrackingRunLoopMode];
+	}
+	else
+		[mRefinementTimer setFireDate:[NSDate dateWithTimeIntervalSinceNow:mRefinementDelay]];
+}
+
+
+- (void)				refinementTimerCallback:(NSTimer*) timer
+{
+	#pragma unused(timer)
+
+	[mRefinementTimer release];
+	mRefinementTimer = nil;
+	[self refineNextRenderer];
+}
+
+
+#pragma mark -
+#pragma mark As an NSObject
+
+- (void)				dealloc
+{
+	[self invalidate];
+	[mTimings release];
+	[mLock release];
+	[super dealloc];
+}
+
+
+@end
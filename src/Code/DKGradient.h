@@ -9,6 +9,7 @@
 ///**********************************************************************************************************************************
 
 #import "GCObservableObject.h"
+#import "DKContentHash.h"
 
 
 @class DKColorStop;
@@ -42,7 +43,7 @@ typedef NS_ENUM(NSInteger, DKGradientInterpolation)
 
 // A DKGradient encapsulates gradient/shading drawing.
 
-@interface DKGradient : GCObservableObject <NSCoding, NSCopying>
+@interface DKGradient : GCObservableObject <NSCoding, NSCopying, DKContentHashing>
 {
 	NSMutableArray*			m_colorStops;		// color stops
 	id						m_extensionData;	// additional supplementary data 
@@ -51,6 +52,8 @@ typedef NS_ENUM(NSInteger, DKGradientInterpolation)
 	DKGradientBlending		m_blending;			// method to blend colours
 	DKGradientInterpolation	m_interp;			// interpolation function
 	CGFunctionRef			m_cbfunc;			// callback function
+	float*					mLookupTable;		// precomputed rgba ramp sampled by the shader callback
+	BOOL					mLookupTableValid;	// NO if the ramp needs to be recomputed before use
 }
 
 // simple gradient convenience methods
@@ -97,6 +100,11 @@ typedef NS_ENUM(NSInteger, DKGradientInterpolation)
 
 - (NSColor*)			colorAtValue:(CGFloat) val;
 
+// precomputed colour ramp used for shading
+
+- (const float*)		lookupTable;
+- (void)				invalidateLookupTable;
+
 // setting the angle
 
 - (void)				setAngle:(CGFloat) ang;
@@ -124,6 +132,7 @@ typedef NS_ENUM(NSInteger, DKGradientInterpolation)
 @end
 
 #define DKGradientSwatchSize (NSMakeSize (20, 20))
+#define kDKGradientLookupTableSize		1024
 
 #pragma mark -
 /// DKColorStop class - small object that links a Color with its relative position
@@ -162,3 +171,8 @@ extern NSString*	kDKNotificationGradientDidChange;
 // application without there being a clash between different frameworks.
 
 // DKGradient drops the UI convenience methods and support for wavelength-based gradients
+
+// Shadings don't compute colours from the stops directly. Instead the gradient precomputes a ramp of kDKGradientLookupTableSize
+// rgba entries whenever it is first drawn after a change to its stops, blending or interpolation, and the shading callback
+// interpolates linearly between adjacent entries. This keeps the per-sample cost constant regardless of the number of stops
+// or the blending mode, and results match the directly computed colours to within 1/255.
@@ -306,6 +306,7 @@ static inline void			resolveHSV(CGFloat *color1, CGFloat *color2);
 {
 	[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientWillRemoveColorStop object:self];
 	[m_colorStops removeAllObjects];
+	[self invalidateLookupTable];
 	[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientDidRemoveColorStop object:self];
 }
 
@@ -335,6 +336,7 @@ static inline void			resolveHSV(CGFloat *color1, CGFloat *color2);
 	// set the owner ref - no longer needed for unarchiving gradients - compat with older files
 	
 	[m_colorStops makeObjectsPerformSelector:@selector(setOwner:) withObject:self];
+	[self invalidateLookupTable];
 
 	[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientDidAddColorStop object:self];
 }
@@ -394,6 +396,7 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 - (void)				sortColorStops
 {	
 	[m_colorStops sortUsingFunction:cmpColorStops context:NULL];
+	[self invalidateLookupTable];
 }
 
 
@@ -472,12 +475,15 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 		[m_colorStops addObject:stop];
 	else
 		[m_colorStops insertObject:stop atIndex:ix];
+		
+	[self invalidateLookupTable];
 }
 
 
 - (void)				removeObjectFromColorStopsAtIndex:(NSUInteger) ix
 {
 	[m_colorStops removeObjectAtIndex:ix];
+	[self invalidateLookupTable];
 }
 
 
@@ -957,6 +963,92 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 }
 
 
+#pragma mark -
+///*********************************************************************************************************************
+///
+/// method:			lookupTable
+/// scope:			public method
+/// overrides:		
+/// description:	returns the precomputed colour ramp used by the shading callback
+/// 
+/// parameters:		none
+/// result:			a pointer to kDKGradientLookupTableSize rgba entries (4 floats each)
+///
+/// notes:			the table is rebuilt here if the stops, blending or interpolation changed since it was last computed.
+///					It is owned by the gradient and remains valid for its lifetime, though its contents change when the
+///					gradient does. Entry i corresponds to a ramp value of i / (kDKGradientLookupTableSize - 1).
+///
+///********************************************************************************************************************
+
+- (const float*)		lookupTable
+{
+	if( !mLookupTableValid )
+	{
+		// the colour calculation shares static state across all gradients, so table building is serialised on the class.
+		// A render thread reading a table while the main thread rebuilds it sees a mix of old and new colours, never
+		// freed memory, since the storage is only released on dealloc.
+		
+		@synchronized([DKGradient class])
+		{
+			if( !mLookupTableValid )
+			{
+				if( mLookupTable == NULL )
+					mLookupTable = malloc( sizeof(float) * 4 * kDKGradientLookupTableSize );
+				
+				NSInteger	i, j, keys = [self countOfColorStops];
+				CGFloat		components[4] = { 0.0, 0.0, 0.0, 0.0 };
+				float*		entry = mLookupTable;
+				
+				if( keys == 1 )
+				{
+					DKColorStop* stop = [self objectInColorStopsAtIndex:0];
+					
+					for( j = 0; j < 4; ++j )
+						components[j] = stop->components[j];
+				}
+				
+				for( i = 0; i < kDKGradientLookupTableSize; ++i )
+				{
+					// in alpha blending mode only the alpha is computed between stops, so the colour is carried over from the
+					// previous entry exactly as it was by the sequential callback
+					
+					if( keys >= 2 )
+						[self private_colorAtValue:(CGFloat) i / (kDKGradientLookupTableSize - 1) components:components randomAccess:YES];
+					
+					for( j = 0; j < 4; ++j )
+						*entry++ = LIMIT( components[j], 0.0, 1.0 );
+				}
+				
+				mLookupTableValid = YES;
+			}
+		}
+	}
+	
+	return mLookupTable;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			invalidateLookupTable
+/// scope:			public method
+/// overrides:		
+/// description:	marks the precomputed colour ramp as stale
+/// 
+/// parameters:		none
+/// result:			none
+///
+/// notes:			called internally whenever the stops, blending or interpolation change. Subclasses that add
+///					properties affecting the colour at a given value should call this when those properties change.
+///
+///********************************************************************************************************************
+
+- (void)				invalidateLookupTable
+{
+	mLookupTableValid = NO;
+}
+
+
 #pragma mark -
 ///*********************************************************************************************************************
 ///
@@ -1123,6 +1215,7 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 	{
 		[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientWillChange object:self];
 		m_blending = bt;
+		[self invalidateLookupTable];
 		[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientDidChange object:self];
 	}
 }
@@ -1169,6 +1262,7 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 	{
 		[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientWillChange object:self];
 		m_interp = intrp;
+		[self invalidateLookupTable];
 		[[NSNotificationCenter defaultCenter] postNotificationName:kDKNotificationGradientDidChange object:self];
 	}
 }
@@ -1261,6 +1355,7 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 {
 	#pragma unused(stop)
 	
+	[self invalidateLookupTable];
 //	LogEvent_(kStateEvent, @"stop changed color (%@)", stop);
 }
 
@@ -1275,6 +1370,7 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 {
 	#pragma unused(stop)
 	
+	[self invalidateLookupTable];
 //	LogEvent_(kStateEvent, @"stop changed position (%@)", stop);
 }
 
@@ -1357,6 +1453,32 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 }
 
 
+#pragma mark -
+#pragma mark As part of DKContentHashing Protocol
+
+- (DKContentHash)		contentHash
+{
+	// covers everything that affects how the gradient draws, so equal gradients in different styles hash alike
+	
+	NSEnumerator*	iter = [[self colorStops] objectEnumerator];
+	DKColorStop*	stop;
+	DKContentHash	h = DKHashObject( kDKContentHashSeed, NSStringFromClass([self class]));
+	
+	h = DKHashCombine( h, [self gradientType]);
+	h = DKHashCombine( h, [self gradientBlending]);
+	h = DKHashCombine( h, [self gradientInterpolation]);
+	h = DKHashFloat( h, [self angle]);
+	
+	while(( stop = [iter nextObject]))
+	{
+		h = DKHashObject( h, [stop color]);
+		h = DKHashFloat( h, [stop position]);
+	}
+	
+	return DKHashObject( h, m_extensionData );
+}
+
+
 #pragma mark -
 #pragma mark As an NSObject
 
@@ -1365,6 +1487,10 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 	[self removeAllColors];
 	[m_colorStops release];
 	CGFunctionRelease( m_cbfunc );
+	
+	if( mLookupTable )
+		free( mLookupTable );
+	
 	[m_extensionData release];
 	[super dealloc];
 }
@@ -1748,6 +1874,7 @@ static NSInteger cmpColorStops (DKColorStop* lh, DKColorStop* rh, void *context)
 
 #pragma mark -
 
+#define		qUseLookupTable			1		// sample the precomputed ramp rather than calculating from the stops
 #define		qUseDirectComponents	1		// this makes a big difference - almost 5x faster
 #define		qUseImpCaching			1		// this makes a tiny difference - just 4% faster
 
@@ -1758,7 +1885,37 @@ static void  shaderCallback (void *info, const CGFloat *in, CGFloat *out)
 	if ( out == NULL || in == NULL )
 		return;
 	
-#if qUseDirectComponents
+#if qUseLookupTable
+
+	// interpolate linearly between the two nearest entries of the gradient's precomputed ramp. The table is fetched
+	// through a cached IMP as it is an ivar of the object and this function lies outside its implementation.
+
+	static const float*(*tfunc)( id, SEL ) = nil;
+	static SEL tsel = nil;
+	
+	if ( tfunc == nil )
+	{
+		tsel = @selector( lookupTable );
+		tfunc = (const float*(*)( id, SEL ))[DKGradient instanceMethodForSelector:tsel];
+	}
+	
+	const float*	table = tfunc( info, tsel );
+	CGFloat			v = LIMIT( *in, 0.0, 1.0 ) * ( kDKGradientLookupTableSize - 1 );
+	NSInteger		indx = (NSInteger) v;
+	
+	if ( indx >= kDKGradientLookupTableSize - 1 )
+		indx = kDKGradientLookupTableSize - 2;
+	
+	CGFloat			p = v - indx;
+	const float*	ca = table + ( indx * 4 );
+	const float*	cb = ca + 4;
+	
+	out[0] = ( cb[0] - ca[0] ) * p + ca[0];
+	out[1] = ( cb[1] - ca[1] ) * p + ca[1];
+	out[2] = ( cb[2] - ca[2] ) * p + ca[2];
+	out[3] = ( cb[3] - ca[3] ) * p + ca[3];
+
+#elif qUseDirectComponents
 
 	// here we use a number of optimisation tricks to extract maximum performance - caching the function pointer
 	// and using raw rgb components and not NSColors
@@ -19,6 +19,11 @@
 	DKQuartzCache*		mCache;
 	NSSize				mSize;
 	NSColor*			mColour;
+	CGImageRef			mSprite;			// this handle's sub-image of the shared sprite atlas
+	NSUInteger			mAtlasPage;			// index of the atlas page holding the sprite
+	CGRect				mAtlasSlot;			// location of the sprite within the page, in bitmap coordinates
+	NSUInteger			mAtlasGeneration;	// page generation that mSprite was taken from
+	BOOL				mHasAtlasSlot;		// YES once the sprite has been rendered into the atlas
 }
 
 + (DKKnobType)			type;
@@ -40,12 +45,16 @@
 
 - (void)				drawAtPoint:(NSPoint) point;
 - (void)				drawAtPoint:(NSPoint) point angle:(CGFloat) radians;
+- (CGImageRef)			spriteImage;
+- (void)				drawHandleContent;
 - (BOOL)				hitTestPoint:(NSPoint) point inHandleAtPoint:(NSPoint) hp;
 
 
 @end
 
 
+#define kDKHandleAtlasPageSize			256		// width and height in pixels of each page of the shared handle sprite atlas
+
 
 /*
 
@@ -53,6 +62,12 @@ DKHandle is a base class for all handles, which are the knobs attached to shapes
  which is still used as a central helper class for dispatching drawing to handles as needed.
  
  DKHandle is subclassed for each handle type, making it easier to customise and also add caching.
+ 
+ For batched drawing, every handle instance is also rendered once into a shared sprite atlas - a set of bitmap pages shelf-packed with
+ one sprite per handle type, colour and size. -spriteImage returns the handle's region of the atlas, which DKKnob uses to composite a
+ whole frame's worth of knobs from the same image in one pass. Sprites are rendered at one pixel per unit, since handle sizes are already
+ expressed in screen pixels. Subclasses that draw themselves differently should override -drawHandleContent, which is used both for
+ the atlas and for the unbatched cache.
 
 
 */
@@ -18,9 +18,25 @@
 @interface DKHandle (Private)
 
 + (NSString*)			keyForKnobType:(DKKnobType) type;
++ (BOOL)				allocateAtlasSlot:(CGRect*) slot page:(NSUInteger*) page forSize:(NSSize) size;
 
 @end
 
+
+// each page of the sprite atlas is packed in horizontal shelves, bottom to top. Pages are never freed, since handle instances
+// are themselves kept for the life of the application.
+
+typedef struct
+{
+	CGContextRef	context;		// bitmap holding the page's sprites
+	CGImageRef		image;			// snapshot of the bitmap, or NULL if a sprite has been added since it was taken
+	NSUInteger		generation;		// incremented whenever a sprite is added to the page
+	CGFloat			shelfX;			// next free x position on the current shelf
+	CGFloat			shelfY;			// base of the current shelf
+	CGFloat			shelfHeight;	// height of the tallest sprite on the current shelf
+}
+DKHandleAtlasPage;
+
 #pragma mark -
 
 
@@ -28,6 +44,8 @@
 
 static NSMutableDictionary*		s_handleClassTable = nil;
 static NSMutableDictionary*		s_handleInstancesTable = nil;
+static DKHandleAtlasPage*		s_atlasPages = NULL;
+static NSUInteger				s_atlasPageCount = 0;
 
 
 + (void)				initialize
@@ -207,27 +225,7 @@ static NSMutableDictionary*		s_handleInstancesTable = nil;
 		mCache = [[DKQuartzCache cacheForCurrentContextWithSize:[self size]] retain];
 		
 		[mCache lockFocus];
-		
-		NSBezierPath* path = [[self class] pathWithSize:[self size]];
-		NSColor* c = [self colour];
-		
-		if( c == nil )
-			c = [[self class] fillColour];
-		
-		if( c )
-		{
-			[c set];
-			[path fill];
-		}
-		
-		c = [[self class] strokeColour];
-		
-		if( c )
-		{
-			[path setLineWidth:[[self class] strokeWidth]];
-			[c set];
-			[path stroke];
-		}
+		[self drawHandleContent];
 		[mCache unlockFocus];
 	}
 
@@ -260,6 +258,87 @@ static NSMutableDictionary*		s_handleInstancesTable = nil;
 
 
 
+- (CGImageRef)			spriteImage
+{
+	// returns this handle's sprite within the shared atlas, rendering it there the first time. The image is owned by the handle and
+	// shares its pixels with the atlas page, so all the sprites on a page can be composited from the same backing store. Returns NULL
+	// if the handle is too big to fit on an atlas page, in which case the caller should fall back to -drawAtPoint:angle:
+
+	@synchronized([DKHandle class])
+	{
+		if( !mHasAtlasSlot )
+		{
+			if(![DKHandle allocateAtlasSlot:&mAtlasSlot page:&mAtlasPage forSize:[self size]])
+				return NULL;
+			
+			CGContextRef bm = s_atlasPages[mAtlasPage].context;
+
+			[NSGraphicsContext saveGraphicsState];
+			[NSGraphicsContext setCurrentContext:[NSGraphicsContext graphicsContextWithGraphicsPort:bm flipped:NO]];
+			CGContextSaveGState( bm );
+			CGContextTranslateCTM( bm, mAtlasSlot.origin.x, mAtlasSlot.origin.y );
+			CGContextClipToRect( bm, CGRectMake( 0, 0, mAtlasSlot.size.width, mAtlasSlot.size.height ));
+			[self drawHandleContent];
+			CGContextRestoreGState( bm );
+			[NSGraphicsContext restoreGraphicsState];
+			
+			CGImageRelease( s_atlasPages[mAtlasPage].image );
+			s_atlasPages[mAtlasPage].image = NULL;
+			s_atlasPages[mAtlasPage].generation++;
+			mHasAtlasSlot = YES;
+		}
+		
+		DKHandleAtlasPage* page = &s_atlasPages[mAtlasPage];
+		
+		if( mSprite == NULL || mAtlasGeneration != page->generation )
+		{
+			if( page->image == NULL )
+				page->image = CGBitmapContextCreateImage( page->context );
+			
+			// image coordinates run top-down whereas the slot is in bitmap context coordinates
+			
+			CGRect ir = mAtlasSlot;
+			ir.origin.y = kDKHandleAtlasPageSize - CGRectGetMaxY( mAtlasSlot );
+
+			CGImageRelease( mSprite );
+			mSprite = CGImageCreateWithImageInRect( page->image, ir );
+			mAtlasGeneration = page->generation;
+		}
+	}
+	
+	return mSprite;
+}
+
+
+- (void)				drawHandleContent
+{
+	// draws the handle into the current context with its bottom, left corner at the origin, at one unit per pixel. Used to render both
+	// the handle's own cache and its sprite in the shared atlas.
+	
+	NSBezierPath* path = [[self class] pathWithSize:[self size]];
+	NSColor* c = [self colour];
+	
+	if( c == nil )
+		c = [[self class] fillColour];
+	
+	if( c )
+	{
+		[c set];
+		[path fill];
+	}
+	
+	c = [[self class] strokeColour];
+	
+	if( c )
+	{
+		[path setLineWidth:[[self class] strokeWidth]];
+		[c set];
+		[path stroke];
+	}
+}
+
+
+
 - (BOOL)				hitTestPoint:(NSPoint) point inHandleAtPoint:(NSPoint) hp
 {
 	NSPoint relPoint;
@@ -280,6 +359,55 @@ static NSMutableDictionary*		s_handleInstancesTable = nil;
 }
 
 
++ (BOOL)				allocateAtlasSlot:(CGRect*) slot page:(NSUInteger*) page forSize:(NSSize) size
+{
+	// finds room for a sprite of <size> in the atlas, adding a page if the current one is full. Sprites are separated by a one pixel
+	// gutter so that filtering at their edges never picks up a neighbour. Must be called with the atlas locked.
+	
+	CGFloat sw = ceil( size.width ) + 1;
+	CGFloat sh = ceil( size.height ) + 1;
+	
+	if( sw > kDKHandleAtlasPageSize || sh > kDKHandleAtlasPageSize || size.width < 1 || size.height < 1 )
+		return NO;
+	
+	DKHandleAtlasPage* pg = ( s_atlasPageCount > 0 )? &s_atlasPages[s_atlasPageCount - 1] : NULL;
+	
+	if( pg && pg->shelfX + sw > kDKHandleAtlasPageSize )
+	{
+		// start a new shelf
+		
+		pg->shelfY += pg->shelfHeight;
+		pg->shelfX = 0;
+		pg->shelfHeight = 0;
+	}
+	
+	if( pg == NULL || pg->shelfY + sh > kDKHandleAtlasPageSize )
+	{
+		CGColorSpaceRef cs = CGColorSpaceCreateDeviceRGB();
+		CGContextRef bm = CGBitmapContextCreate( NULL, kDKHandleAtlasPageSize, kDKHandleAtlasPageSize, 8, 0, cs, kCGImageAlphaPremultipliedFirst );
+		CGColorSpaceRelease( cs );
+		
+		if( bm == NULL )
+			return NO;
+		
+		CGContextClearRect( bm, CGRectMake( 0, 0, kDKHandleAtlasPageSize, kDKHandleAtlasPageSize ));
+		
+		s_atlasPages = realloc( s_atlasPages, sizeof(DKHandleAtlasPage) * ( s_atlasPageCount + 1 ));
+		pg = &s_atlasPages[s_atlasPageCount++];
+		bzero( pg, sizeof(DKHandleAtlasPage));
+		pg->context = bm;
+	}
+	
+	*slot = CGRectMake( pg->shelfX, pg->shelfY, ceil( size.width ), ceil( size.height ));
+	*page = s_atlasPageCount - 1;
+	
+	pg->shelfX += sw;
+	pg->shelfHeight = MAX( pg->shelfHeight, sh );
+	
+	return YES;
+}
+
+
 #pragma mark -
 #pragma mark - as a NSObject
 		 
@@ -287,6 +415,7 @@ static NSMutableDictionary*		s_handleInstancesTable = nil;
  {
 	 [mCache release];
 	 [mColour release];
+	 CGImageRelease( mSprite );
 	 [super dealloc];
  }
 
@@ -11,14 +11,13 @@
 #import "DKRasterizer.h"
 
 
-@class DKStrokeDash;
+@class DKStrokeDash, DKLRUCache;
 
 
 @interface DKHatching : DKRasterizer <NSCoding, NSCopying>
 {
 @private
-	NSBezierPath*	m_cache;
-	NSBezierPath*	mRoughenedCache;
+	DKLRUCache*		mSegmentCache;
 	NSColor*		m_hatchColour;
 	DKStrokeDash*	m_hatchDash;
 	NSLineCapStyle	m_cap;
@@ -40,6 +39,7 @@
 
 - (void)			hatchPath:(NSBezierPath*) path;
 - (void)			hatchPath:(NSBezierPath*) path objectAngle:(CGFloat) oa;
+- (NSBezierPath*)	hatchSegmentsForPath:(NSBezierPath*) path objectAngle:(CGFloat) oa;
 
 - (void)			setAngle:(CGFloat) radians;
 - (CGFloat)			angle;
@@ -73,10 +73,11 @@
 - (CGFloat)			wobblyness;
 
 - (void)			invalidateCache;
-- (void)			calcHatchInRect:(NSRect) rect;
 
 @end
 
+#define		kDKHatchingSegmentCacheByteBudget		(256 * 1024)
+
 
 
 /*
@@ -86,8 +87,11 @@ particular angle. Subclass for more sophisticated hatches.
 
 Can be set as a fill style in a DKStyle object.
 
-The hatch is cached in an NSBezierPath object based on the bounds of the path. If another path is hatched that is smaller
-than the cached size, it is not rebuilt. It is rebuilt if the angle or spacing changes or a bigger path is hatched. Linewidth also
-doesn't change the cache.
+Rather than stroking lines across the whole bounds and clipping them to the path, the hatch works out where each line enters and
+leaves the path from its flattened edges, and strokes only the visible segments - still clipped to the path, so that the ends of wide
+lines don't overshoot slanted edges. These are cached by the path's shape (not its
+position) and the angle, so moving an object or hatching many objects of the same shape reuses them. The cache is emptied if the
+spacing, lead-in or wobblyness changes. The segments are also available from -hatchSegmentsForPath:objectAngle: for hit testing
+or vector export.
 
 */
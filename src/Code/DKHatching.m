@@ -13,13 +13,46 @@
 #import "DKDrawKitMacros.h"
 #import "DKStrokeDash.h"
 #import "NSBezierPath+Geometry.h"
-#import "DKRandom.h"
+#import "NSBezierPath+Editing.h"
+#import "DKContentHash.h"
+#import "DKLRUCache.h"
 
 
-@interface DKHatching (Private)
+// an edge of the flattened path and a hatch line, both in hatch space, where the unwobbled hatch lines are vertical
+
+typedef struct
+{
+	NSPoint		a, b;
+	CGFloat		minX, maxX;
+}
+DKHatchEdge;
+
+typedef struct
+{
+	NSPoint		a, b;
+	CGFloat		minX, maxX;
+}
+DKHatchLine;
+
+typedef struct
+{
+	CGFloat		t;
+	NSInteger	dir;
+}
+DKHatchCrossing;
 
-- (void)	invalidateRoughnessCache;
 
+static int		compareHatchEdges( const void* a, const void* b );
+static int		compareHatchCrossings( const void* a, const void* b );
+static CGFloat	hatchWobble( NSInteger line, NSInteger end );
+
+
+@interface DKHatching (Private)
+
+- (NSBezierPath*)	newHatchSegmentsForPath:(NSBezierPath*) path angle:(CGFloat) angle dashPeriod:(CGFloat) period;
+- (NSBezierPath*)	hatchSegmentsRelativeToCentreOfPath:(NSBezierPath*) path angle:(CGFloat) angle;
+- (CGFloat)			dashPeriod;
+- (void)			hatchPath:(NSBezierPath*) path objectAngle:(CGFloat) oa roughen:(BOOL) roughen;
 
 @end
 
@@ -182,33 +215,27 @@
 
 - (void)			hatchPath:(NSBezierPath*) path objectAngle:(CGFloat) oa
 {
-	// if the bounds size of <path> is larger than the cached hatch, then we'll need to enlarge the cache, so invalidate
-	// it.
-	
-	NSRect	cr, br = [path bounds];
+	[self hatchPath:path objectAngle:oa roughen:mRoughenStrokes];
+}
 
-	if ( m_cache )
-	{
-		cr = [m_cache bounds];
-		
-		if (( br.size.width * 1.5f ) > cr.size.width ||
-			 ( br.size.height * 1.5f ) > cr.size.height )
-			[self invalidateCache];
-	}
+
+- (void)			hatchPath:(NSBezierPath*) path objectAngle:(CGFloat) oa roughen:(BOOL) roughen
+{
+	// as -hatchPath:objectAngle:, but the lines are only roughened if <roughen> is YES, so that low quality drawing can skip it
 	
-	if ( m_cache == nil )
-		[self calcHatchInRect:br];
+	if([path isEmpty])
+		return;
 	
-	NSAssert( m_cache != nil, @"couldn't craete the hatch cache");
+	NSRect			br = [path bounds];
+	NSBezierPath*	hatch = [self hatchSegmentsRelativeToCentreOfPath:path angle:[self angle] + oa];
 	
-	if( m_cache )
+	if( hatch )
 	{
-		cr = [m_cache bounds];
-			
-		// now we have a hatch cached, set the clip to the path and draw the hatch. The hatch cache always has its
-		// path centred at the origin so we also need to transform the cache to the drawn position
+		// the segments end on the path's edge, but the stroke still extends past it - even a butt end is square to the hatch line rather
+		// than to the edge - so the path is always clipped to.
 		
 		SAVE_GRAPHICS_CONTEXT		//[NSGraphicsContext saveGraphicsState];
+		
 		[path addClip];
 		
 		// enforce a minimum line width of 0.1 - sizees of zero do not print.
@@ -221,59 +248,109 @@
 				actualLineWidth = 0.05;		// hairline
 		}
 		
-		[m_cache setLineWidth:actualLineWidth];
-
-		if ([self dash])
-			[[self dash] applyToPath:m_cache];
-		else
-			[m_cache setLineDash:nil	count:0 phase:0.0f];
+		// the segment path is cached and shared, so the stroke attributes are set on the context rather than on the path
+		
+		CGContextRef	context = [[NSGraphicsContext currentContext] graphicsPort];
+		CGFloat			dp[8];
+		NSInteger		i, dashCount = 0;
+		CGFloat			phase = 0.0;
+		
+		if([self dash])
+		{
+			CGFloat scale = [[self dash] scalesToLineWidth]? actualLineWidth : 1.0;
 			
-		[m_cache setLineCapStyle:[self lineCapStyle]];
-		[m_cache setLineJoinStyle:[self lineJoinStyle]];
+			[[self dash] getDashPattern:dp count:&dashCount];
+			
+			for( i = 0; i < dashCount; ++i )
+				dp[i] *= scale;
+			
+			phase = -LIMIT([[self dash] phase], 0, [[self dash] length]) * scale;
+		}
+		
+		CGContextSetLineWidth( context, actualLineWidth );
+		CGContextSetLineDash( context, phase, dashCount > 0? dp : NULL, dashCount );
+		CGContextSetLineCap( context, (CGLineCap)[self lineCapStyle]);
+		CGContextSetLineJoin( context, (CGLineJoin)[self lineJoinStyle]);
 		
 		[[self colour] set];
 		
-		NSAffineTransform* xform;
+		// the segments are cached relative to the centre of the path's bounds, so move them to the drawn position
 		
-		xform = [NSAffineTransform transform];
+		NSAffineTransform* xform = [NSAffineTransform transform];
 		[xform translateXBy:NSMidX( br ) yBy:NSMidY( br )];
 		[xform concat];
 		
-		NSBezierPath* hatch;
-		
-		// compensate for the object's angle by applying that rotation to the hatch path
-		
-		if ( oa != 0.0 )
+		if( roughen )
 		{
-			xform = [NSAffineTransform transform];
-			[xform rotateByRadians:oa];
-			hatch = [xform transformBezierPath:m_cache];
-		}
-		else
-			hatch = m_cache;
-		
-		if( mRoughenStrokes )
-		{
-			NSBezierPath* roughHatch;
+			DKContentHash	h = DKHashFloat( DKHashCombine([path shapeHash], [path windingRule]), [self angle] + oa );
+			
+			h = DKHashFloat( DKHashFloat( DKHashFloat( h, [self dashPeriod]), [self roughness] ), actualLineWidth );
+			h = DKHashCombine( DKHashCombine( h, [self lineCapStyle]), [self lineJoinStyle]);
 			
-			if( mRoughenedCache == nil )
-				mRoughenedCache = [[m_cache bezierPathWithRoughenedStrokeOutline:[self roughness] * [self width]] retain];
+			NSNumber*		key = [NSNumber numberWithUnsignedLongLong:h];
+			NSBezierPath*	roughHatch = [mSegmentCache objectForKey:key];
 			
-			if ( oa != 0.0 )
-				roughHatch = [xform transformBezierPath:mRoughenedCache];
-			else
-				roughHatch = mRoughenedCache;
+			if( roughHatch == nil )
+			{
+				// roughening works from the path's own stroke attributes, so they are applied to a copy
+				
+				NSBezierPath* styled = [[hatch copy] autorelease];
+				
+				[styled setLineWidth:actualLineWidth];
+				[styled setLineDash:dashCount > 0? dp : NULL count:dashCount phase:phase];
+				[styled setLineCapStyle:[self lineCapStyle]];
+				[styled setLineJoinStyle:[self lineJoinStyle]];
+				
+				roughHatch = [styled bezierPathWithRoughenedStrokeOutline:[self roughness] * [self width]];
+				[mSegmentCache setObject:roughHatch forKey:key cost:[roughHatch elementCount] * 32];
+			}
 			
 			[roughHatch fill];
 		}
 		else
-			[hatch stroke];
+		{
+			CGPathRef cp = [hatch newQuartzPath];
+			
+			CGContextAddPath( context, cp );
+			CGContextStrokePath( context );
+			CGPathRelease( cp );
+		}
 		
 		RESTORE_GRAPHICS_CONTEXT		//[NSGraphicsContext restoreGraphicsState];
 	}
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			hatchSegmentsForPath:objectAngle:
+/// scope:			public instance method
+/// overrides:
+/// description:	returns the visible parts of the hatch lines for a path
+/// 
+/// parameters:		<path> the path to hatch
+///					<oa> the additional angle to apply, in radians
+/// result:			a path consisting of one open subpath per visible hatch line segment
+///
+/// notes:			these are the lines the hatch strokes, already trimmed to the path, so they can be used to hit test
+///					the hatch or to export it as vectors without relying on clipping. The line width, dash and caps are
+///					not applied. When dashed, each segment begins on a dash boundary which may lie outside <path>.
+///
+///********************************************************************************************************************
+
+- (NSBezierPath*)	hatchSegmentsForPath:(NSBezierPath*) path objectAngle:(CGFloat) oa
+{
+	if([path isEmpty])
+		return [NSBezierPath bezierPath];
+	
+	NSRect				br = [path bounds];
+	NSAffineTransform*	xform = [NSAffineTransform transform];
+	
+	[xform translateXBy:NSMidX( br ) yBy:NSMidY( br )];
+	return [xform transformBezierPath:[self hatchSegmentsRelativeToCentreOfPath:path angle:[self angle] + oa]];
+}
+
+
 #pragma mark -
 ///*********************************************************************************************************************
 ///
@@ -293,15 +370,7 @@
 {
 	if ( radians != m_angle )
 	{
-		// cache doesn't need rebuilding, just rotating to the new angle.
-		
-		if ( m_cache )
-		{
-			NSAffineTransform* xform = [NSAffineTransform transform];
-			[xform rotateByRadians:radians - m_angle];
-			[m_cache transformUsingAffineTransform:xform];
-			[mRoughenedCache transformUsingAffineTransform:xform];
-		}
+		// cached segments are keyed by angle, so there's nothing to invalidate
 		
 		m_angle = radians;
 	}
@@ -424,7 +493,6 @@
 - (void)			setWidth:(CGFloat) width
 {
 	m_lineWidth = width;
-	[self invalidateRoughnessCache];
 }
 
 
@@ -437,7 +505,6 @@
 - (void)			setLineCapStyle:(NSLineCapStyle) lcs
 {
 	m_cap = lcs;
-	[self invalidateRoughnessCache];
 }
 
 
@@ -450,7 +517,6 @@
 - (void)			setLineJoinStyle:(NSLineJoinStyle) ljs
 {
 	m_join = ljs;
-	[self invalidateRoughnessCache];
 }
 
 
@@ -481,7 +547,6 @@
 	[dash retain];
 	[m_hatchDash release];
 	m_hatchDash = dash;
-	[self invalidateRoughnessCache];
 }
 
 
@@ -510,7 +575,6 @@
 {
 	mRoughness = LIMIT( amount, 0, 1 );
 	mRoughenStrokes = amount > 0.0;
-	[self invalidateRoughnessCache];
 }
 
 
@@ -536,64 +600,253 @@
 #pragma mark -
 - (void)			invalidateCache
 {
-	[m_cache release];
-	m_cache = nil;
-	[self invalidateRoughnessCache];
+	[mSegmentCache removeAllObjects];
 }
 
 
-- (void)			calcHatchInRect:(NSRect) rect
+- (NSBezierPath*)	hatchSegmentsRelativeToCentreOfPath:(NSBezierPath*) path angle:(CGFloat) angle
 {
-	// this does the actual work of calculating the hatch. Given the rect, we build a series of lines at the origin in a square
-	// based on the largest side of <rect> *~ sqrt(2). Then we transform the cache to the current angle. This is much simpler than
-	// calculating where to start and end each line.
+	// returns the hatch segments for <path> at <angle>, relative to the centre of its bounds, from the cache if possible. The
+	// key is position independent, so an object that is only moved, or many objects of the same shape, use the same segments.
+	
+	CGFloat			period = [self dashPeriod];
+	DKContentHash	h = DKHashFloat( DKHashCombine([path shapeHash], [path windingRule]), angle );
+	
+	h = DKHashFloat( h, period );
+	
+	NSNumber*		key = [NSNumber numberWithUnsignedLongLong:h];
+	NSBezierPath*	segments;
+	
+	if( mSegmentCache == nil )
+		mSegmentCache = [[DKLRUCache alloc] initWithCostLimit:kDKHatchingSegmentCacheByteBudget];
 	
-	if ( m_cache == nil )
+	segments = [mSegmentCache objectForKey:key];
+	
+	if( segments == nil )
 	{
-		m_cache = [[NSBezierPath bezierPath] retain];
+		segments = [self newHatchSegmentsForPath:path angle:angle dashPeriod:period];
+		[mSegmentCache setObject:segments forKey:key cost:[segments elementCount] * 32];
+		[segments autorelease];
+	}
+	
+	return segments;
+}
+
+
+- (NSBezierPath*)	newHatchSegmentsForPath:(NSBezierPath*) path angle:(CGFloat) angle dashPeriod:(CGFloat) period
+{
+	// this does the actual work of calculating the hatch. The path is flattened and its edges rotated into "hatch space" about the
+	// centre of its bounds, where the hatch lines are vertical (or nearly so, if wobbly). The edges are sorted by their left-most
+	// point and swept from left to right against the lines, so each line is only tested against the edges that span it. Where
+	// a line crosses an edge, the direction of the crossing updates the winding count, and the spans where the count says the
+	// line is inside the path become segments, rotated back into place. The line positions match those of the original
+	// clipped hatch, which was built in a square 1.5 times the largest side of the path.
+	
+	NSBezierPath*	segments = [[NSBezierPath alloc] init];
+	NSBezierPath*	flat = [path bezierPathByFlatteningPath];
+	NSInteger		i, k, ec = [flat elementCount];
+	NSRect			br = [path bounds];
+	NSPoint			c = NSMakePoint( NSMidX( br ), NSMidY( br ));
+	CGFloat			ca = cos( angle ), sa = sin( angle );
+	DKHatchEdge*	edges = malloc( sizeof(DKHatchEdge) * ( ec + 1 ));
+	NSInteger		edgeCount = 0;
+	NSPoint			p[3], q, first = NSZeroPoint, last = NSZeroPoint;
+	BOOL			inSubpath = NO;
+	CGFloat			minX = HUGE_VAL, maxX = -HUGE_VAL, minY = HUGE_VAL, maxY = -HUGE_VAL;
+	
+	if( edges == NULL )
+		return segments;
+	
+	for( i = 0; i <= ec; ++i )
+	{
+		NSBezierPathElement element = ( i < ec )? [flat elementAtIndex:i associatedPoints:p] : NSMoveToBezierPathElement;
 		
-		NSRect cr;
+		// subpaths are implicitly closed, as they are when filled or clipped
 		
-		cr.size.width = cr.size.height = ( MAX( rect.size.width, rect.size.height ) * 1.5f);
-		cr.origin.x = cr.origin.y = ( cr.size.width * -0.5f );
+		if( element == NSClosePathBezierPathElement || ( element == NSMoveToBezierPathElement && inSubpath ))
+		{
+			if( !NSEqualPoints( last, first ))
+			{
+				edges[edgeCount].a = last;
+				edges[edgeCount++].b = first;
+			}
+			
+			last = first;
+			inSubpath = NO;
+		}
 		
-		//LogEvent_(kReactiveEvent,  @"hatch origin rect = {%f, %f},{%f, %f}", cr.origin.x, cr.origin.y, cr.size.width, cr.size.height );
+		if( i == ec || element == NSClosePathBezierPathElement )
+			continue;
 		
-		NSInteger i, m;
+		q.x = ( p[0].x - c.x ) * ca + ( p[0].y - c.y ) * sa;
+		q.y = ( p[0].y - c.y ) * ca - ( p[0].x - c.x ) * sa;
 		
-		m = lround(cr.size.width / [self spacing]) + 1;
-		NSPoint		a, b;
+		minX = MIN( minX, q.x );
+		maxX = MAX( maxX, q.x );
+		minY = MIN( minY, q.y );
+		maxY = MAX( maxY, q.y );
 		
-		a.y = NSMinY( cr );
-		b.y = NSMaxY( cr );
+		if( element == NSMoveToBezierPathElement )
+			first = last = q;
+		else
+		{
+			if( !NSEqualPoints( last, q ))
+			{
+				edges[edgeCount].a = last;
+				edges[edgeCount++].b = q;
+			}
+			
+			last = q;
+			inSubpath = YES;
+		}
+	}
+	
+	for( k = 0; k < edgeCount; ++k )
+	{
+		edges[k].minX = MIN( edges[k].a.x, edges[k].b.x );
+		edges[k].maxX = MAX( edges[k].a.x, edges[k].b.x );
+	}
+	
+	qsort( edges, edgeCount, sizeof(DKHatchEdge), compareHatchEdges );
+	
+	// lay out the lines that can reach the path. Wobblyness is a randomising factor which displaces the end points of each line
+	// by an amount relative to the spacing, to give a more naturalistic type of hatch (esp. in conjunction with roughness). The
+	// displacement is a fixed function of the line number so that the hatch doesn't change each time it is recalculated.
+	
+	CGFloat		spacing = [self spacing];
+	CGFloat		maxWobble = mWobblyness * spacing;
+	CGFloat		x0 = MAX( br.size.width, br.size.height ) * -0.75 + m_leadIn;
+	NSInteger	firstLine = (NSInteger) floor(( minX - maxWobble - x0 ) / spacing );
+	NSInteger	lineCount = (NSInteger) ceil(( maxX + maxWobble - x0 ) / spacing ) - firstLine + 1;
+	DKHatchLine* lines = ( edgeCount > 0 && lineCount > 0 )? malloc( sizeof(DKHatchLine) * lineCount ) : NULL;
+	NSInteger*	active = malloc( sizeof(NSInteger) * ( edgeCount + 1 ));
+	DKHatchCrossing* crossings = malloc( sizeof(DKHatchCrossing) * ( edgeCount + 1 ));
+	BOOL		evenOdd = [path windingRule] == NSEvenOddWindingRule;
+	
+	if( lines && active && crossings )
+	{
+		for( i = 0; i < lineCount; ++i )
+		{
+			CGFloat x = x0 + ( firstLine + i ) * spacing;
+			
+			lines[i].a = NSMakePoint( x + hatchWobble( firstLine + i, 0 ) * maxWobble, minY - 1.0 );
+			lines[i].b = NSMakePoint( x + hatchWobble( firstLine + i, 1 ) * maxWobble, maxY + 1.0 );
+			lines[i].minX = MIN( lines[i].a.x, lines[i].b.x );
+			lines[i].maxX = MAX( lines[i].a.x, lines[i].b.x );
+		}
+		
+		// the sweep relies on the lines being in order of their left-most point, which only wobble can upset
 		
-		// wobblyness is a randomising factor 0..1 which displaces the end points of the hatch by a random amount
-		// relative to the spacing. It is used to give a more naturalistic type of hatch (esp. in conjunction with roughness).
+		if( maxWobble > 0 )
+			qsort( lines, lineCount, sizeof(DKHatchLine), compareHatchEdges );
 		
-		CGFloat maxWobble = mWobblyness * [self spacing];
+		NSInteger	nextEdge = 0, activeCount = 0, n, winding, j;
 		
-		for( i = 0; i < m; i++ )
+		for( i = 0; i < lineCount; ++i )
 		{
-			a.x = cr.origin.x + m_leadIn + ( i * [self spacing]) + ([DKRandom randomPositiveOrNegativeNumber] * maxWobble);
-			b.x = cr.origin.x + m_leadIn + ( i * [self spacing]) + ([DKRandom randomPositiveOrNegativeNumber] * maxWobble);
+			DKHatchLine*	line = &lines[i];
+			NSPoint			d = NSMakePoint( line->b.x - line->a.x, line->b.y - line->a.y );
+			CGFloat			len = hypot( d.x, d.y );
+			
+			// add edges that start before the line's right end, and drop those that end before its left end - since the lines
+			// are in order of their left ends, no later line can reach a dropped edge either
+			
+			while( nextEdge < edgeCount && edges[nextEdge].minX <= line->maxX )
+				active[activeCount++] = nextEdge++;
+			
+			for( j = k = 0; j < activeCount; ++j )
+			{
+				if( edges[active[j]].maxX >= line->minX )
+					active[k++] = active[j];
+			}
+			activeCount = k;
+			
+			// find where the line crosses the active edges. Each edge includes its first point but not its last, so a line
+			// through a vertex counts exactly one crossing.
+			
+			for( j = n = 0; j < activeCount; ++j )
+			{
+				DKHatchEdge*	e = &edges[active[j]];
+				CGFloat			d0, d1, s;
+				NSPoint			x;
+				
+				if( e->minX > line->maxX )
+					continue;
+				
+				d0 = d.x * ( e->a.y - line->a.y ) - d.y * ( e->a.x - line->a.x );
+				d1 = d.x * ( e->b.y - line->a.y ) - d.y * ( e->b.x - line->a.x );
+				
+				if(( d0 > 0 ) == ( d1 > 0 ))
+					continue;
+				
+				s = d0 / ( d0 - d1 );
+				x.x = e->a.x + s * ( e->b.x - e->a.x );
+				x.y = e->a.y + s * ( e->b.y - e->a.y );
+				
+				crossings[n].t = (( x.x - line->a.x ) * d.x + ( x.y - line->a.y ) * d.y ) / ( len * len );
+				crossings[n++].dir = ( d0 > 0 )? 1 : -1;
+			}
+			
+			if( n < 2 )
+				continue;
 			
-			[m_cache moveToPoint:a];
-			[m_cache lineToPoint:b];
+			qsort( crossings, n, sizeof(DKHatchCrossing), compareHatchCrossings );
+			
+			// walk along the line, emitting the spans that are inside the path
+			
+			CGFloat	start = 0;
+			BOOL	inside = NO, wasInside;
+			
+			for( j = 0, winding = 0; j < n; ++j )
+			{
+				wasInside = inside;
+				winding += crossings[j].dir;
+				inside = evenOdd? ( winding & 1 ) != 0 : winding != 0;
+				
+				if( inside && !wasInside )
+					start = crossings[j].t;
+				else if( wasInside && !inside && crossings[j].t > start )
+				{
+					// a dashed segment is extended back to a dash boundary, so that the dash keeps the phase it would
+					// have had on the whole line - the clip trims the extension
+					
+					if( period > 0.0 )
+						start = floor( start * len / period ) * period / len;
+					
+					NSPoint a = NSMakePoint( line->a.x + d.x * start, line->a.y + d.y * start );
+					NSPoint b = NSMakePoint( line->a.x + d.x * crossings[j].t, line->a.y + d.y * crossings[j].t );
+					
+					// rotate back out of hatch space
+					
+					[segments moveToPoint:NSMakePoint( a.x * ca - a.y * sa, a.x * sa + a.y * ca )];
+					[segments lineToPoint:NSMakePoint( b.x * ca - b.y * sa, b.x * sa + b.y * ca )];
+				}
+			}
 		}
-		
-		// now rotate the cache to the current angle
-		
-		NSAffineTransform* rot = [NSAffineTransform transform];
-		[rot rotateByRadians:[self angle]];
-		[m_cache transformUsingAffineTransform:rot];
 	}
+	
+	free( lines );
+	free( active );
+	free( crossings );
+	free( edges );
+	
+	return segments;
 }
 
 
-- (void)	invalidateRoughnessCache
+- (CGFloat)			dashPeriod
 {
-	[mRoughenedCache release];
-	mRoughenedCache = nil;
+	// the length of one repeat of the dash pattern as it will be applied to the hatch, or 0 if undashed
+	
+	DKStrokeDash* dash = [self dash];
+	
+	if( dash == nil )
+		return 0.0;
+	
+	if([dash scalesToLineWidth])
+		return [dash length] * [self width];
+	else
+		return [dash length];
 }
 
 
@@ -605,6 +858,30 @@
 }
 
 
+- (BOOL)			isSafeForConcurrentRendering
+{
+	// the hatch cache is built and restyled in place while rendering
+	
+	return NO;
+}
+
+
+- (BOOL)			isExpensiveToRender
+{
+	// hatch segments are cached, but building them walks every edge of the path
+	
+	return YES;
+}
+
+
+- (BOOL)			supportsLowQualityDrawing
+{
+	// at low quality roughened lines are stroked plainly
+	
+	return mRoughenStrokes;
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 + (NSArray*)		observableKeyPaths
@@ -638,7 +915,7 @@
 {
 	[m_hatchDash release];
 	[m_hatchColour release];
-	[self invalidateCache];
+	[mSegmentCache release];
 	
 	[super dealloc];
 }
@@ -670,12 +947,13 @@
 	if( ![obj conformsToProtocol:@protocol(DKRenderable)] || ![self enabled])
 		return;
 
-	NSBezierPath* path = [obj renderingPath];
+	NSBezierPath*	path = [obj renderingPath];
+	BOOL			roughen = mRoughenStrokes && ![self useLowQualityDrawingForObject:obj];
 	
 	if ( m_angleRelativeToObject )
-		[self hatchPath:path objectAngle:[obj angle]];
+		[self hatchPath:path objectAngle:[obj angle] roughen:roughen];
 	else
-		[self hatchPath:path objectAngle:0.0f];
+		[self hatchPath:path objectAngle:0.0f roughen:roughen];
 }
 
 
@@ -742,7 +1020,6 @@
 	self = [super initWithCoder:coder];
 	if (self != nil)
 	{
-		NSAssert(m_cache == nil, @"Expected init to zero");
 		[self setColour:[coder decodeObjectForKey:@"colour"]];
 		[self setDash:[coder decodeObjectForKey:@"dash"]];
 		
@@ -788,3 +1065,34 @@
 
 
 @end
+
+
+#pragma mark -
+static int		compareHatchEdges( const void* a, const void* b )
+{
+	// sorts edges or lines by their left-most point - the two structs share the same layout
+	
+	CGFloat ma = ((const DKHatchEdge*) a)->minX;
+	CGFloat mb = ((const DKHatchEdge*) b)->minX;
+	
+	return ( ma < mb )? -1 : ( ma > mb )? 1 : 0;
+}
+
+
+static int		compareHatchCrossings( const void* a, const void* b )
+{
+	CGFloat ta = ((const DKHatchCrossing*) a)->t;
+	CGFloat tb = ((const DKHatchCrossing*) b)->t;
+	
+	return ( ta < tb )? -1 : ( ta > tb )? 1 : 0;
+}
+
+
+static CGFloat	hatchWobble( NSInteger line, NSInteger end )
+{
+	// a repeatable pseudo-random value in the range -0.5..0.5 for one end of the given hatch line
+	
+	DKContentHash h = DKHashCombine( DKHashCombine( kDKContentHashSeed, (uint64_t) line ), (uint64_t) end );
+	
+	return (CGFloat)( h & 0xFFFF ) / 65535.0 - 0.5;
+}
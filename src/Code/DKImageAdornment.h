@@ -82,4 +82,6 @@ typedef NS_ENUM(NSInteger, DKImageFittingOption)
 
 This class allows any image to be part of the rendering tree. 
 
+An image set using a key from the drawing's image manager is drawn from the manager's DKImagePyramid for that key.
+
 */
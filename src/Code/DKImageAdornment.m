@@ -16,6 +16,7 @@
 
 #import "DKDrawing.h"
 #import "DKImageDataManager.h"
+#import "DKImagePyramid.h"
 
 @implementation DKImageAdornment
 #pragma mark As a DKImageAdornment
@@ -43,6 +44,11 @@
 	[m_image release];
 	m_image = image;
 	
+	// any key refers to the old image - -setImageWithKey:forDrawing: sets it again afterwards
+	
+	[mImageKey release];
+	mImageKey = nil;
+	
 	//[_image setFlipped:YES];
 	[m_image setCacheMode:NSImageCacheNever];
 }
@@ -250,6 +256,14 @@
 }
 
 
+- (BOOL)				isSafeForConcurrentRendering
+{
+	// NSImage caches its representations lazily, so images are only drawn on the main thread
+	
+	return NO;
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 
@@ -310,7 +324,13 @@
 
 	if([self enabled])
 	{
-		NSImage*	image = [self image];
+		NSImage*			image = [self image];
+		DKImagePyramid*		pyramid = nil;
+		
+		// an image from the drawing's image manager is drawn from the pyramid it shares with every other user of the same key
+		
+		if( image != nil && [self imageKey] != nil && [object respondsToSelector:@selector(drawing)])
+			pyramid = [[[(DKDrawableObject*)object drawing] imageManager] imagePyramidForKey:[self imageKey]];
 		
 		if ( image == nil )
 		{
@@ -352,9 +372,15 @@
 		
 		// draw the image
 		[[NSGraphicsContext currentContext] setImageInterpolation:NSImageInterpolationHigh];
-		[image setFlipped:YES];
-		[image drawInRect:destRect fromRect:NSZeroRect operation:[self operation] fraction:[self opacity]];
-		[image setFlipped:NO];
+		
+		if( pyramid )
+			[pyramid drawInRect:destRect operation:[self operation] fraction:[self opacity]];
+		else
+		{
+			[image setFlipped:YES];
+			[image drawInRect:destRect fromRect:NSZeroRect operation:[self operation] fraction:[self opacity]];
+			[image setFlipped:NO];
+		}
 			
 		// clean up
 		
@@ -397,6 +423,7 @@
 	if (self != nil)
 	{
 		[self setImage:[coder decodeObjectForKey:@"image"]];
+		[self setImageKey:[coder decodeObjectForKey:@"DKImageAdornment_imageKey"]];
 		[self setScale:[coder decodeDoubleForKey:@"scale"]];
 		[self setOpacity:[coder decodeDoubleForKey:@"opacity"]];
 		[self setAngle:[coder decodeDoubleForKey:@"angle"]];
@@ -415,6 +442,7 @@
 	DKImageAdornment* copy = [super copyWithZone:zone];
 	
 	[copy setImage:[self image]];
+	[copy setImageKey:[self imageKey]];
 	[copy setImageIdentifier:[self imageIdentifier]];
 	[copy setScale:[self scale]];
 	[copy setOpacity:[self opacity]];
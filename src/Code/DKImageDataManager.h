@@ -9,12 +9,16 @@
 #import <Cocoa/Cocoa.h>
 
 
+@class DKImagePyramid;
+
+
 @interface DKImageDataManager : NSObject <NSCoding>
 {
 @private
 	NSMutableDictionary*	mRepository;
 	NSMutableDictionary*	mHashList;
 	NSMutableDictionary*	mKeyUsage;
+	NSMutableDictionary*	mPyramids;				// image pyramids keyed by image key, or NSNull where the data can't have one
 }
 
 - (NSData*)			imageDataForKey:(NSString*) key;
@@ -34,6 +38,9 @@
 - (BOOL)			keyIsInUse:(NSString*) key;
 - (void)			removeUnusedData;
 
+- (DKImagePyramid*)	imagePyramidForKey:(NSString*) key;
+- (void)			purgeImagePyramids;
+
 @end
 
 
@@ -58,6 +65,10 @@ extern NSString*	kDKImageDataManagerPasteboardType;
  This only comes into play when archiving, dearchiving or creating images - each object still maintains an NSImage derived from the data stored here.
  
  When images are cut/pasted within the framework, the image key can be used to effect that operation without having to move the actual image data.
+ 
+ The manager also keeps a DKImagePyramid for each key on demand, so that all the objects displaying the same image draw from the same set of reduced
+ resolution levels. Pyramids aren't archived - they are remade from the data when first drawn. The decoded levels of all pyramids share one
+LRU cache with a bounded size in bytes.
 
 */
 
@@ -9,6 +9,7 @@
 #import "DKImageDataManager.h"
 #import "DKUniqueID.h"
 #import "DKKeyedUnarchiver.h"
+#import "DKImagePyramid.h"
 
 
 NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrtype";
@@ -40,6 +41,7 @@ NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrty
 	
 	[mRepository setObject:imageData forKey:key];
 	[mHashList setObject:key forKey:[imageData checksumString]];
+	[mPyramids removeObjectForKey:key];
 }
 
 
@@ -86,6 +88,7 @@ NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrty
 	}
 	
 	[mRepository removeObjectForKey:key];
+	[mPyramids removeObjectForKey:key];
 }
 
 
@@ -232,6 +235,73 @@ NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrty
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			imagePyramidForKey:
+/// scope:			public instance method
+/// overrides:
+/// description:	returns the image pyramid for the image data stored under the key
+///
+/// parameters:		<key> the image key
+/// result:			the pyramid, or nil if there is no data for the key or it can't be drawn from a pyramid
+///
+/// notes:			the pyramid is made the first time it's asked for and shared by every caller using the same key
+///
+///********************************************************************************************************************
+
+- (DKImagePyramid*)	imagePyramidForKey:(NSString*) key
+{
+	if( key == nil )
+		return nil;
+	
+	id pyramid = [mPyramids objectForKey:key];
+	
+	if( pyramid == nil )
+	{
+		NSData* data = [self imageDataForKey:key];
+		
+		if( data == nil )
+			return nil;
+		
+		pyramid = [[[DKImagePyramid alloc] initWithData:data] autorelease];
+		
+		// remember failures too, so undecodable data isn't examined on every draw
+		
+		[mPyramids setObject:pyramid? pyramid : [NSNull null] forKey:key];
+	}
+	
+	return pyramid == [NSNull null]? nil : pyramid;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			purgeImagePyramids
+/// scope:			public instance method
+/// overrides:
+/// description:	discards the decoded levels of all image pyramids to free memory
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			levels are decoded again as they are drawn. The levels are held in a cache bounded by
+///					+[DKImagePyramid setLevelCacheByteBudget:], so this is only needed to free their memory at once.
+///
+///********************************************************************************************************************
+
+- (void)			purgeImagePyramids
+{
+	NSEnumerator*	iter = [mPyramids objectEnumerator];
+	id				pyramid;
+	
+	while(( pyramid = [iter nextObject]))
+	{
+		if( pyramid != [NSNull null])
+			[pyramid purgeLevels];
+	}
+}
+
+
 - (void)			buildHashList
 {
 	// hash list maps hash (or checksum) -> key, so is inverse to repository. As it can be built from the repo, it is safer to do this following dearchiving
@@ -261,6 +331,7 @@ NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrty
 		mRepository = [[NSMutableDictionary alloc] init];
 		mHashList = [[NSMutableDictionary alloc] init];
 		mKeyUsage = [[NSMutableDictionary alloc] init];
+		mPyramids = [[NSMutableDictionary alloc] init];
 	}
 	
 	return self;
@@ -273,6 +344,7 @@ NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrty
 	[mRepository release];
 	[mHashList release];
 	[mKeyUsage release];
+	[mPyramids release];
 	[super dealloc];
 }
 
@@ -296,6 +368,7 @@ NSString*	kDKImageDataManagerPasteboardType = @"net.apptree.drawkit.imgdatamgrty
 	// key usage isn't archived, will manage itself as clients make use of the object
 	
 	mKeyUsage = [[NSMutableDictionary alloc] init];
+	mPyramids = [[NSMutableDictionary alloc] init];
 	
 	// if the coder can keep a note of the image manager, set it to self (on the basis that only one image manager should
 	// exist per archive, therefore this must be it)
@@ -10,6 +10,9 @@
 #import "DKLayer.h"
 
 
+@class DKTiledImagePyramid;
+
+
 //! coverage method flags - can be combined to give different effects
 typedef NS_OPTIONS(NSUInteger, DKImageCoverageFlags)
 {
@@ -29,19 +32,33 @@ typedef NS_OPTIONS(NSUInteger, DKImageCoverageFlags)
  This layer type implements a single image overlay, for example for tracing a photograph in another layer. The coverage method
  sets whether the image is scaled, tiled or drawn only once in a particular position.
  
+ Very large images can be shown from a DKTiledImagePyramid instead of an NSImage, so that only the tiles within the area being updated
+ are drawn, at the resolution needed. -initWithContentsOfFile: does this automatically for files that +[DKTiledImagePyramid imageAtPathNeedsTiling:].
+ A tiled image is archived as the path of its file, and its tiles are found again in the cache directory when the layer is dearchived.
+ If the file can't be found when the layer is dearchived, the layer is kept with no image and -missingTiledImagePath returns the archived
+ path, so that the image can be relinked - the path is archived again until an image is set. A layer has either an image or a tiled image:
+ setting one discards the other.
+ 
  */
 @interface DKImageOverlayLayer : DKLayer <NSCoding>
 {
 	NSImage*				m_image;
+	DKTiledImagePyramid*	mTiledImage;
+	NSString*				mMissingTiledImagePath;
 	CGFloat					m_opacity;
 	DKImageCoverageFlags	m_coverageMethod;
 }
 
 - (instancetype)			initWithImage:(NSImage*) image;
 - (instancetype)			initWithContentsOfFile:(NSString*) imagefile;
+- (instancetype)			initWithTiledImage:(DKTiledImagePyramid*) tiledImage;
 
 @property (nonatomic, retain) NSImage *image;
 
+@property (nonatomic, retain) DKTiledImagePyramid *tiledImage;
+
+@property (readonly, copy) NSString *missingTiledImagePath;
+
 @property (nonatomic) CGFloat opacity;
 
 @property (nonatomic) DKImageCoverageFlags coverageMethod;
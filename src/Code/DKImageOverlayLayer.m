@@ -10,6 +10,16 @@
 #import "DKImageOverlayLayer.h"
 
 #import "DKDrawing.h"
+#import "DKTiledImagePyramid.h"
+
+
+@interface DKImageOverlayLayer (Private)
+
+- (NSSize)		imageSize;
+- (void)		drawImageInRect:(NSRect) rect updateRect:(NSRect) update;
+- (void)		tiledImageDidUpdate:(NSNotification*) note;
+
+@end
 
 
 
@@ -17,6 +27,7 @@
 #pragma mark As a DKImageOverlayLayer
 @synthesize opacity=m_opacity;
 @synthesize image=m_image;
+@synthesize tiledImage=mTiledImage;
 @synthesize coverageMethod=m_coverageMethod;
 
 - (id)			initWithImage:(NSImage*) image
@@ -41,21 +52,99 @@
 
 - (id)			initWithContentsOfFile:(NSString*) imagefile
 {
+	// images too big to hold in memory are displayed from a tiled pyramid, built in the background the first time the file is used
+	
+	if([DKTiledImagePyramid imageAtPathNeedsTiling:imagefile])
+	{
+		DKTiledImagePyramid* tiled = [[[DKTiledImagePyramid alloc] initWithContentsOfFile:imagefile cacheDirectory:nil] autorelease];
+		return [self initWithTiledImage:tiled];
+	}
+	
 	NSImage* img = [[[NSImage alloc] initWithContentsOfFile:imagefile] autorelease];
 	return [self initWithImage:img];
 }
 
 
+- (id)			initWithTiledImage:(DKTiledImagePyramid*) tiledImage
+{
+	self = [self init];
+	if (self != nil)
+	{
+		[self setTiledImage:tiledImage];
+		[self setOpacity:1.0];
+		[self setCoverageMethod:kDKDrawingImageCoverageNormal];
+		
+		if (mTiledImage == nil)
+		{
+			[self autorelease];
+			return nil;
+		}
+	}
+	
+	return self;
+}
+
+
 #pragma mark -
 - (void)		setImage:(NSImage*) image
 {
+	// a layer shows either an image or a tiled image, never both. The image is retained first, as clearing the tiled image releases it.
+	
 	[image retain];
+	[self setTiledImage:nil];
 	[m_image release];
 	m_image = image;
 	[m_image setFlipped:YES];
 }
 
 
+- (void)		setTiledImage:(DKTiledImagePyramid*) tiledImage
+{
+	// setting either kind of image replaces any missing tiled image, and a layer never has both kinds
+	
+	[mMissingTiledImagePath release];
+	mMissingTiledImagePath = nil;
+	
+	[m_image release];
+	m_image = nil;
+	
+	if ( tiledImage != mTiledImage )
+	{
+		// the pyramid may be shared with other layers showing the same file, so its build is left to finish - the tiles are kept for next time
+		
+		if ( mTiledImage )
+			[[NSNotificationCenter defaultCenter] removeObserver:self name:kDKTiledImagePyramidDidUpdate object:mTiledImage];
+		
+		[tiledImage retain];
+		[mTiledImage release];
+		mTiledImage = tiledImage;
+		
+		// redraw as the tiles become available
+		
+		if ( mTiledImage )
+			[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(tiledImageDidUpdate:) name:kDKTiledImagePyramidDidUpdate object:mTiledImage];
+		
+		[self setNeedsDisplay:YES];
+	}
+}
+
+
+- (NSString*)	missingTiledImagePath
+{
+	// the path of a tiled image whose file couldn't be found when the layer was dearchived, or nil
+	
+	return mMissingTiledImagePath;
+}
+
+
+- (void)		tiledImageDidUpdate:(NSNotification*) note
+{
+	#pragma unused(note)
+	
+	[self setNeedsDisplayInRect:[self imageDestinationRect]];
+}
+
+
 #pragma mark -
 - (void)		setOpacity:(CGFloat) op
 {
@@ -86,7 +175,7 @@
 	// rect alone doesn't tell you.
 	
 	NSSize	ds = [[self drawing] drawingSize];
-	NSSize	is = [[self image] size];
+	NSSize	is = [self imageSize];
 	NSRect	r = NSZeroRect;
 	
 	r.size = is;
@@ -106,6 +195,31 @@
 }
 
 
+- (NSSize)		imageSize
+{
+	if ( mTiledImage )
+		return [mTiledImage size];
+	else
+		return [[self image] size];
+}
+
+
+- (void)		drawImageInRect:(NSRect) rect updateRect:(NSRect) update
+{
+	// a tiled image draws only the tiles within the current clip, so clipping to the update rect limits it to the tiles needed there
+	
+	if ( mTiledImage )
+	{
+		[NSGraphicsContext saveGraphicsState];
+		NSRectClip( update );
+		[mTiledImage drawInRect:rect operation:NSCompositeSourceAtop fraction:[self opacity]];
+		[NSGraphicsContext restoreGraphicsState];
+	}
+	else
+		[[self image] drawInRect:rect fromRect:NSZeroRect operation:NSCompositeSourceAtop fraction:[self opacity]];
+}
+
+
 #pragma mark -
 #pragma mark As a DKLayer
 - (void)		drawRect:(NSRect) rect inView:(DKDrawingView*) aView
@@ -128,12 +242,12 @@
 			if ( cm & kDKDrawingImageCoverageVerticallyStretched )
 				ri.size.height = ds.height;
 			else
-				ri.size.height = [[self image] size].height;
+				ri.size.height = [self imageSize].height;
 				
 			if ( cm & kDKDrawingImageCoverageHorizontallyStretched )
 				ri.size.width = ds.width;
 			else
-				ri.size.width = [[self image] size].width;
+				ri.size.width = [self imageSize].width;
 			
 			NSInteger h, v, x, y;
 			
@@ -151,7 +265,9 @@
 			{
 				for( x = 0; x < h; ++x )
 				{
-					[[self image] drawInRect:ri fromRect:NSZeroRect operation:NSCompositeSourceAtop fraction:[self opacity]];
+					if ( NSIntersectsRect( rect, ri ))
+						[self drawImageInRect:ri updateRect:rect];
+
 					ri.origin.x += ri.size.width;
 				}
 				ri.origin.x = dr.origin.x;
@@ -162,7 +278,7 @@
 		{
 			// straightforward composition of the image
 			
-			[[self image] drawInRect:dr fromRect:NSZeroRect operation:NSCompositeSourceAtop fraction:[self opacity]];
+			[self drawImageInRect:dr updateRect:rect];
 		}
 	}
 }
@@ -172,6 +288,9 @@
 #pragma mark As an NSObject
 - (void)		dealloc
 {
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[mTiledImage release];
+	[mMissingTiledImagePath release];
 	[m_image release];
 	
 	[super dealloc];
@@ -185,7 +304,14 @@
 	NSAssert(coder != nil, @"Expected valid coder");
 	[super encodeWithCoder:coder];
 	
-	[coder encodeObject:[self image] forKey:@"image"];
+	// a tiled image is much too big to archive, so just its file is recorded - including a file that was missing when dearchived
+	
+	if ( mTiledImage )
+		[coder encodeObject:[mTiledImage sourcePath] forKey:@"DKImageOverlayLayer_tiledImagePath"];
+	else if ( mMissingTiledImagePath )
+		[coder encodeObject:mMissingTiledImagePath forKey:@"DKImageOverlayLayer_tiledImagePath"];
+	else
+		[coder encodeObject:[self image] forKey:@"image"];
 	[coder encodeDouble:[self opacity] forKey:@"opacity"];
 	[coder encodeInteger:[self coverageMethod] forKey:@"coveragemethod"];
 }
@@ -197,11 +323,24 @@
 	self = [super initWithCoder:coder];
 	if (self != nil)
 	{
-		[self setImage:[coder decodeObjectForKey:@"image"]];
+		NSString* tiledPath = [coder decodeObjectForKey:@"DKImageOverlayLayer_tiledImagePath"];
+		
+		if ( tiledPath )
+		{
+			[self setTiledImage:[[[DKTiledImagePyramid alloc] initWithContentsOfFile:tiledPath cacheDirectory:nil] autorelease]];
+			
+			// if the file has moved, keep the layer with no image so that it can be relinked, rather than dropping it from the drawing
+			
+			if ( mTiledImage == nil )
+				mMissingTiledImagePath = [tiledPath copy];
+		}
+		else
+			[self setImage:[coder decodeObjectForKey:@"image"]];
+		
 		[self setOpacity:[coder decodeDoubleForKey:@"opacity"]];
 		[self setCoverageMethod:[coder decodeIntegerForKey:@"coveragemethod"]];
 		
-		if (m_image == nil)
+		if (m_image == nil && mTiledImage == nil && mMissingTiledImagePath == nil)
 		{
 			[self autorelease];
 			return nil;
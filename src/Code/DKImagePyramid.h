@@ -0,0 +1,69 @@
+//
+//  DKImagePyramid.h
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file.
+//
+
+#import <Cocoa/Cocoa.h>
+
+
+@class DKLRUCache;
+
+
+@interface DKImagePyramid : NSObject
+{
+@private
+	CGImageSourceRef		mSource;				// the image source the levels are decoded from
+	NSSize					mPixelSize;				// pixel size of the full resolution image
+	NSUInteger				mLevelCount;			// number of levels, including the full resolution one
+	NSUInteger				mIdentifier;			// unique number identifying this pyramid's levels in the shared level cache
+	NSLock*					mLock;
+}
+
++ (DKLRUCache*)			sharedLevelCache;
++ (void)				setLevelCacheByteBudget:(NSUInteger) bytes;
+
+- (id)					initWithData:(NSData*) imageData;
+
+- (NSSize)				pixelSize;
+- (NSUInteger)			levelCount;
+- (NSSize)				pixelSizeOfLevel:(NSUInteger) level;
+- (NSBitmapImageRep*)	imageRepForLevel:(NSUInteger) level;
+- (NSUInteger)			levelForDeviceSize:(NSSize) deviceSize;
+
+- (void)				drawInRect:(NSRect) destRect operation:(NSCompositingOperation) op fraction:(CGFloat) opacity;
+
+- (void)				purgeLevels;
+
+@end
+
+
+#define kDKImagePyramidMinimumLevelSize				64						// no level is made smaller than this many pixels across its longest side
+#define kDKImagePyramidDefaultLevelCacheByteBudget	( 128 * 1024 * 1024 )	// memory allowed for decoded levels of all pyramids
+
+
+/*
+
+An image pyramid holds an image at its full resolution and at a series of reduced resolutions, each half the size of the one before, so
+that an image shown much smaller than its natural size can be drawn from a level close to the size it appears on screen rather than being
+resampled from full size on every redraw.
+
+Levels are decoded from the original image data only when first needed - the reduced levels are decoded at their reduced size, so a large
+image displayed as a thumbnail never needs to be decoded at full size at all. All levels have the image's EXIF orientation applied, so a
+rotated camera image is drawn upright as NSImage draws it, and -pixelSize is the size of the upright image. -drawInRect:operation:fraction:
+picks the smallest level that still has at least one pixel per device pixel under the current transformation, and draws only the part of it
+that lies within the current clip, so an image cropped by its shape is not drawn beyond the crop. When not drawing to the screen, the full
+resolution level is used.
+
+Decoded levels are kept in an LRU cache shared by all pyramids, whose size in bytes is bounded by the level cache budget, so the least recently
+drawn levels are discarded and decoded again if needed, and memory use doesn't grow with the number of images in the document. A level larger
+than the whole budget is decoded each time it's drawn.
+
+Pyramids are made by DKImageDataManager, which keeps one per image key, so all the objects showing the same image share the same levels.
+Images that ImageIO can't decode as a bitmap (PDF data, for example) have no pyramid, and their NSImage is drawn as before.
+
+*/
+
@@ -0,0 +1,357 @@
+//
+//  DKImagePyramid.m
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file.
+//
+
+#import "DKImagePyramid.h"
+#import "DKLRUCache.h"
+
+
+static DKLRUCache*	sLevelCache = nil;
+static NSUInteger	sNextIdentifier = 0;
+
+
+@interface DKImagePyramid (Private)
+
+- (NSString*)			cacheKeyForLevel:(NSUInteger) level;
+
+@end
+
+
+@implementation DKImagePyramid
+
++ (DKLRUCache*)			sharedLevelCache
+{
+	// the cache of decoded levels shared by all pyramids. Levels may be drawn on several threads at once, so the cache is created under a lock.
+	
+	@synchronized([DKImagePyramid class])
+	{
+		if( sLevelCache == nil )
+			sLevelCache = [[DKLRUCache alloc] initWithCostLimit:kDKImagePyramidDefaultLevelCacheByteBudget];
+	}
+	
+	return sLevelCache;
+}
+
+
++ (void)				setLevelCacheByteBudget:(NSUInteger) bytes
+{
+	// sets the approximate memory that decoded levels may use. Reducing it discards levels as necessary.
+	
+	[[self sharedLevelCache] setCostLimit:bytes];
+}
+
+
+
+///*********************************************************************************************************************
+///
+/// method:			initWithData:
+/// scope:			public instance method
+/// overrides:
+/// description:	initialises a pyramid for the image in the data
+///
+/// parameters:		<imageData> the original image data, as kept by the image manager
+/// result:			the pyramid, or nil if the data isn't a bitmap image that ImageIO can decode
+///
+/// notes:			no pixels are decoded until a level is first needed
+///
+///********************************************************************************************************************
+
+- (id)					initWithData:(NSData*) imageData
+{
+	self = [super init];
+	if( self )
+	{
+		if( imageData != nil )
+			mSource = CGImageSourceCreateWithData((CFDataRef) imageData, NULL );
+
+		NSDictionary*	props = nil;
+
+		if( mSource != NULL && CGImageSourceGetCount( mSource ) > 0 )
+			props = [(NSDictionary*) CGImageSourceCopyPropertiesAtIndex( mSource, 0, NULL ) autorelease];
+
+		mPixelSize.width = [[props objectForKey:(NSString*) kCGImagePropertyPixelWidth] doubleValue];
+		mPixelSize.height = [[props objectForKey:(NSString*) kCGImagePropertyPixelHeight] doubleValue];
+
+		// the levels are decoded upright, so for EXIF orientations 5 to 8, which rotate the image by 90 degrees, the size is swapped
+
+		if([[props objectForKey:(NSString*) kCGImagePropertyOrientation] integerValue] >= 5 )
+			mPixelSize = NSMakeSize( mPixelSize.height, mPixelSize.width );
+
+		if( mPixelSize.width < 1 || mPixelSize.height < 1 )
+		{
+			[self autorelease];
+			return nil;
+		}
+
+		// each level halves the size of the one before, down to the minimum size
+
+		NSUInteger	longest = (NSUInteger) MAX( mPixelSize.width, mPixelSize.height );
+
+		mLevelCount = 1;
+
+		while(( longest >> mLevelCount ) >= kDKImagePyramidMinimumLevelSize )
+			++mLevelCount;
+
+		@synchronized([DKImagePyramid class])
+		{
+			mIdentifier = ++sNextIdentifier;
+		}
+
+		mLock = [[NSLock alloc] init];
+	}
+
+	return self;
+}
+
+
+- (NSSize)				pixelSize
+{
+	return mPixelSize;
+}
+
+
+- (NSUInteger)			levelCount
+{
+	return mLevelCount;
+}
+
+
+- (NSSize)				pixelSizeOfLevel:(NSUInteger) level
+{
+	// the size the level has, or will have once generated
+
+	CGFloat scale = ldexp( 1.0, -(int) MIN( level, mLevelCount - 1 ));
+
+	return NSMakeSize( MAX( 1, floor( mPixelSize.width * scale )), MAX( 1, floor( mPixelSize.height * scale )));
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			imageRepForLevel:
+/// scope:			public instance method
+/// overrides:
+/// description:	returns the bitmap for a level, decoding it if necessary
+///
+/// parameters:		<level> the level, 0 being the full resolution image
+/// result:			a bitmap whose size is set to its pixel size, or nil if it couldn't be decoded
+///
+/// notes:			thread safe. The level is kept in the shared level cache, from which it may be discarded. Levels are upright,
+///					with the image's EXIF orientation applied. Reduced levels are decoded directly at their reduced size, which for JPEG data and the like is much
+///					faster than decoding the full image and scaling it down.
+///
+///********************************************************************************************************************
+
+- (NSBitmapImageRep*)	imageRepForLevel:(NSUInteger) level
+{
+	if( level >= mLevelCount )
+		level = mLevelCount - 1;
+
+	// the lock prevents two threads decoding the same level at once
+
+	[mLock lock];
+
+	NSString*			key = [self cacheKeyForLevel:level];
+	NSBitmapImageRep*	rep = [[DKImagePyramid sharedLevelCache] objectForKey:key];
+
+	if( rep == nil )
+	{
+		// every level, including the full size one, is made as a thumbnail so that the image's orientation is applied as NSImage would
+
+		NSUInteger		longest = (NSUInteger) MAX( mPixelSize.width, mPixelSize.height );
+		NSDictionary*	options = [NSDictionary dictionaryWithObjectsAndKeys:
+									[NSNumber numberWithBool:YES], (NSString*) kCGImageSourceCreateThumbnailFromImageAlways,
+									[NSNumber numberWithBool:YES], (NSString*) kCGImageSourceCreateThumbnailWithTransform,
+									[NSNumber numberWithBool:YES], (NSString*) kCGImageSourceShouldCacheImmediately,
+									[NSNumber numberWithUnsignedInteger:longest >> level], (NSString*) kCGImageSourceThumbnailMaxPixelSize,
+									nil];
+		CGImageRef		image = CGImageSourceCreateThumbnailAtIndex( mSource, 0, (CFDictionaryRef) options );
+
+		rep = nil;
+
+		if( image != NULL )
+		{
+			rep = [[NSBitmapImageRep alloc] initWithCGImage:image];
+			[rep setSize:NSMakeSize([rep pixelsWide], [rep pixelsHigh])];
+			[[DKImagePyramid sharedLevelCache] setObject:rep forKey:key cost:[rep bytesPerRow] * [rep pixelsHigh]];
+			[rep autorelease];
+			CGImageRelease( image );
+		}
+	}
+
+	[[rep retain] autorelease];
+	[mLock unlock];
+
+	return rep;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			levelForDeviceSize:
+/// scope:			public instance method
+/// overrides:
+/// description:	returns the smallest level that covers the given size in device pixels
+///
+/// parameters:		<deviceSize> the size the whole image will occupy on the device
+/// result:			the level index
+///
+/// notes:			if even the full resolution image is smaller than the device size, level 0 is returned
+///
+///********************************************************************************************************************
+
+- (NSUInteger)			levelForDeviceSize:(NSSize) deviceSize
+{
+	NSUInteger	level = mLevelCount;
+	NSSize		ls;
+
+	while( level-- > 0 )
+	{
+		ls = [self pixelSizeOfLevel:level];
+
+		if( ls.width >= deviceSize.width && ls.height >= deviceSize.height )
+			return level;
+	}
+
+	return 0;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawInRect:operation:fraction:
+/// scope:			public instance method
+/// overrides:
+/// description:	draws the image into a rect in the current context from the most appropriate level
+///
+/// parameters:		<destRect> the rect the whole image occupies
+///					<op> the compositing operation
+///					<opacity> the opacity to draw at
+/// result:			none
+///
+/// notes:			only the part of the level inside the current clip is drawn. The image is drawn upright whether or not the
+///					context is flipped.
+///
+///********************************************************************************************************************
+
+- (void)				drawInRect:(NSRect) destRect operation:(NSCompositingOperation) op fraction:(CGFloat) opacity
+{
+	if( NSWidth( destRect ) <= 0 || NSHeight( destRect ) <= 0 )
+		return;
+
+	NSGraphicsContext*	gc = [NSGraphicsContext currentContext];
+	CGContextRef		ctx = [gc graphicsPort];
+	NSUInteger			level = 0;
+
+	// pick the level by the size the image occupies on the device. Printing and PDF output always get the full resolution.
+
+	if([NSGraphicsContext currentContextDrawingToScreen])
+	{
+		CGAffineTransform	ctm = CGContextGetCTM( ctx );
+		NSSize				ds;
+
+		ds.width = NSWidth( destRect ) * hypot( ctm.a, ctm.b );
+		ds.height = NSHeight( destRect ) * hypot( ctm.c, ctm.d );
+		level = [self levelForDeviceSize:ds];
+	}
+
+	NSBitmapImageRep* rep = [self imageRepForLevel:level];
+
+	if( rep == nil )
+		return;
+
+	// work out which pixels of the level fall within the clip, and where they go
+
+	NSRect vis = NSIntersectionRect( destRect, NSRectFromCGRect( CGContextGetClipBoundingBox( ctx )));
+
+	if( NSIsEmptyRect( vis ))
+		return;
+
+	CGFloat	pw = [rep pixelsWide];
+	CGFloat	ph = [rep pixelsHigh];
+	CGFloat	sx = pw / NSWidth( destRect );
+	CGFloat	sy = ph / NSHeight( destRect );
+	BOOL	flipped = [gc isFlipped];
+	NSRect	src, dr;
+
+	src.origin.x = ( NSMinX( vis ) - NSMinX( destRect )) * sx;
+	src.origin.y = flipped? ( NSMaxY( destRect ) - NSMaxY( vis )) * sy : ( NSMinY( vis ) - NSMinY( destRect )) * sy;
+	src.size.width = NSWidth( vis ) * sx;
+	src.size.height = NSHeight( vis ) * sy;
+
+	// whole pixels only, so that adjacent redraws don't leave seams
+
+	src = NSIntersectionRect( NSIntegralRect( src ), NSMakeRect( 0, 0, pw, ph ));
+
+	if( NSIsEmptyRect( src ))
+		return;
+
+	dr.origin.x = NSMinX( destRect ) + NSMinX( src ) / sx;
+	dr.origin.y = flipped? NSMaxY( destRect ) - NSMaxY( src ) / sy : NSMinY( destRect ) + NSMinY( src ) / sy;
+	dr.size.width = NSWidth( src ) / sx;
+	dr.size.height = NSHeight( src ) / sy;
+
+	[rep drawInRect:dr fromRect:src operation:op fraction:opacity respectFlipped:YES hints:nil];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			purgeLevels
+/// scope:			public instance method
+/// overrides:
+/// description:	discards all decoded levels
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			the levels are decoded again from the data when next needed. Levels are also discarded from the shared level
+///					cache when it exceeds its budget, so this only needs to be called to free memory at once.
+///
+///********************************************************************************************************************
+
+- (void)				purgeLevels
+{
+	DKLRUCache*	cache = [DKImagePyramid sharedLevelCache];
+	NSUInteger	i;
+
+	[mLock lock];
+
+	for( i = 0; i < mLevelCount; ++i )
+		[cache removeObjectForKey:[self cacheKeyForLevel:i]];
+
+	[mLock unlock];
+}
+
+
+#pragma mark -
+#pragma mark As a DKImagePyramid (Private)
+
+- (NSString*)			cacheKeyForLevel:(NSUInteger) level
+{
+	// levels are keyed by the pyramid's unique identifier rather than its address, which may be reused once it is freed
+	
+	return [NSString stringWithFormat:@"%lu/%lu", (unsigned long) mIdentifier, (unsigned long) level];
+}
+
+
+#pragma mark -
+#pragma mark As an NSObject
+
+- (void)				dealloc
+{
+	if( mSource != NULL )
+		CFRelease( mSource );
+
+	[self purgeLevels];
+	[mLock release];
+	[super dealloc];
+}
+
+
+@end
@@ -38,6 +38,9 @@ typedef NS_ENUM(NSInteger, DKImageCroppingOptions)
  facilitated by a central DKImageDataManager object, which is managed by the drawing. Note that using certian operations, such as creating
  the shape with an NSImage will bypass this benefit.
  
+ Images that come from the image manager are drawn from a DKImagePyramid shared by all shapes with the same image key, so a large image shown
+ small is drawn from a reduced copy rather than resampled from full size on every redraw.
+ 
  */
 @interface DKImageShape : DKDrawableShape <NSCoding, NSCopying, DKHotspotDelegate>
 {
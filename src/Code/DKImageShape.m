@@ -20,6 +20,7 @@
 #import "DKDrawing.h"
 #import "DKImageDataManager.h"
 #import "DKKeyedUnarchiver.h"
+#import "DKImagePyramid.h"
 
 #pragma mark Constants
 
@@ -32,7 +33,7 @@ NSString*	kDKOriginalNameMetadataKey				= @"dk_original_name";
 - (NSAffineTransform*)		imageTransformWithoutLocation;
 - (NSAffineTransform*)		imageTransform;
 - (void)					drawImage;
-
+- (DKImagePyramid*)			imagePyramid;
 
 @end
 
@@ -1017,20 +1018,52 @@ NSString*	kDKOriginalNameMetadataKey				= @"dk_original_name";
 		ir.origin.y = m_imageOffset.y;
 	}
 	
-	// render at high quality
+	// render at high quality. If the image came from the image manager, draw it from the shared pyramid at the level nearest the size
+	// it appears, otherwise from the full size image.
 	
 	[[NSGraphicsContext currentContext] setImageInterpolation:NSImageInterpolationHigh];
-	[[self image] setFlipped:[[NSGraphicsContext currentContext] isFlipped]];
 	
-	[[self image]	drawInRect:ir
-					fromRect:NSZeroRect
-					operation:[self compositingOperation]
-					fraction:[self imageOpacity]];
+	DKImagePyramid* pyramid = [self imagePyramid];
+	
+	if( pyramid )
+		[pyramid drawInRect:ir operation:[self compositingOperation] fraction:[self imageOpacity]];
+	else
+	{
+		[[self image] setFlipped:[[NSGraphicsContext currentContext] isFlipped]];
+		
+		[[self image]	drawInRect:ir
+						fromRect:NSZeroRect
+						operation:[self compositingOperation]
+						fraction:[self imageOpacity]];
+	}
 	
 	RESTORE_GRAPHICS_CONTEXT	//[NSGraphicsContext restoreGraphicsState];
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			imagePyramid
+/// scope:			private instance method
+/// overrides:		
+/// description:	return the image pyramid shared by all shapes using this shape's image key
+/// 
+/// parameters:		none
+/// result:			the pyramid, or nil if the image isn't held by the image manager or can't be drawn from a pyramid
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (DKImagePyramid*)			imagePyramid
+{
+	if([self imageKey] == nil )
+		return nil;
+	
+	return [[[self container] imageManager] imagePyramidForKey:[self imageKey]];
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			imageTransform
@@ -1304,6 +1337,14 @@ NSString*	kDKOriginalNameMetadataKey				= @"dk_original_name";
 }
 
 
+- (BOOL)				isSafeForConcurrentRendering
+{
+	// NSImage caches its representations lazily, so images are only drawn on the main thread
+	
+	return NO;
+}
+
+
 
 ///*********************************************************************************************************************
 ///
@@ -37,6 +37,11 @@ typedef NS_OPTIONS(NSUInteger, DKKnobDrawingFlags)
  Subclasses may want to customise many aspects of a knob's appearance, and can override any suitable factored methods according to their needs. Customisations
  might include the shape of a knob, its colours, whether stroked or filled or both, etc.
  
+ Between -beginKnobBatch and -endKnobBatch, knobs are not drawn immediately but queued, skipping any that fall outside the area being
+ updated. -endKnobBatch then composites the whole queue from the handles' shared sprite atlas in a single pass. Knobs drawn in a batch
+ therefore end up above anything else drawn during it, so a batch should only bracket drawing where that is acceptable, such as a
+ layer's selection highlights drawn on top of its content. Batches may be nested; only the outermost -endKnobBatch draws.
+ 
  */
 @interface DKKnob : NSObject <NSCoding, NSCopying>
 {
@@ -51,6 +56,8 @@ typedef NS_OPTIONS(NSUInteger, DKKnobDrawingFlags)
 	NSColor*		mControlBarColour;			// colour of control bars
 	NSSize			mControlKnobSize;			// control knob size
 	CGFloat			mControlBarWidth;			// control bar width
+	NSMutableData*	mKnobBatch;					// knobs queued for drawing while batching
+	NSUInteger		mKnobBatchDepth;			// nesting count of -beginKnobBatch calls
 }
 
 + (DKKnob*)			standardKnobs;
@@ -72,6 +79,12 @@ typedef NS_OPTIONS(NSUInteger, DKKnobDrawingFlags)
 
 - (BOOL)			hitTestPoint:(NSPoint) p inKnobAtPoint:(NSPoint) kp ofType:(DKKnobType) knobType userInfo:(id) userInfo;
 
+// batching knob drawing for a whole frame
+
+- (void)			beginKnobBatch;
+- (void)			endKnobBatch;
+- (BOOL)			isBatchingKnobs;
+
 //! colour of control bars
 @property (retain) NSColor *controlBarColour;
 //! control bar width
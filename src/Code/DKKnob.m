@@ -28,6 +28,24 @@ static CGFloat			sBarWidth = 0.0;
 static NSSize			sKnobSize = { 6.0, 6.0 };
 
 
+// a knob queued while batching - the transform maps the handle's sprite directly to device space
+
+typedef struct
+{
+	DKHandle*			handle;
+	CGAffineTransform	transform;
+}
+DKKnobBatchEntry;
+
+
+@interface DKKnob (Private)
+
+- (void)			drawHandle:(DKHandle*) handle atPoint:(NSPoint) p angle:(CGFloat) radians;
+- (void)			flushKnobBatch;
+
+@end
+
+
 @implementation DKKnob
 #pragma mark As a DKKnob
 
@@ -92,7 +110,7 @@ static NSSize			sKnobSize = { 6.0, 6.0 };
 	if( ahs.width >= 1.0 || ahs.height >= 1.0 )
 	{
 		DKHandle* handle = [self handleForType:knobType colour:aColour];
-		[handle drawAtPoint:p angle:radians];
+		[self drawHandle:handle atPoint:p angle:radians];
 	}
 	return;
 #else
@@ -196,7 +214,7 @@ static NSSize			sKnobSize = { 6.0, 6.0 };
 	if( ahs.width >= 1.0 || ahs.height >= 1.0 )
 	{
 		DKHandle* handle = [self handleForType:knobType];
-		[handle drawAtPoint:p angle:radians];
+		[self drawHandle:handle atPoint:p angle:radians];
 	}
 	return;
 #else
@@ -440,6 +458,135 @@ static NSSize			sKnobSize = { 6.0, 6.0 };
 }
 
 
+#pragma mark -
+
+- (void)			beginKnobBatch
+{
+	// starts queuing knobs rather than drawing them immediately. Calls may be nested.
+	
+	if( mKnobBatchDepth++ == 0 )
+	{
+		if( mKnobBatch == nil )
+			mKnobBatch = [[NSMutableData alloc] init];
+		else
+			[mKnobBatch setLength:0];
+	}
+}
+
+
+- (void)			endKnobBatch
+{
+	// draws all the knobs queued since the matching -beginKnobBatch. Must be called in the same context the knobs were drawn in.
+	
+	NSAssert( mKnobBatchDepth > 0, @"endKnobBatch called without a matching beginKnobBatch");
+	
+	if( mKnobBatchDepth > 0 && --mKnobBatchDepth == 0 )
+	{
+		[self flushKnobBatch];
+		[mKnobBatch setLength:0];
+	}
+}
+
+
+- (BOOL)			isBatchingKnobs
+{
+	return mKnobBatchDepth > 0;
+}
+
+
+#pragma mark -
+
+- (void)			drawHandle:(DKHandle*) handle atPoint:(NSPoint) p angle:(CGFloat) radians
+{
+	// draws or queues the handle. Knobs entirely outside the area being updated are skipped. The handle is drawn at its
+	// cached screen size regardless of the view scale, exactly as -[DKHandle drawAtPoint:angle:] does it.
+	
+	if( handle == nil )
+		return;
+	
+	CGContextRef		context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGAffineTransform	ctm = CGContextGetCTM( context );
+	NSSize				hs = [handle size];
+	CGFloat				compScale = 1.0 / ctm.a;
+	DKDrawingView*		view = [DKDrawingView currentlyDrawingView];
+	
+	if( view )
+	{
+		// allow for any rotation by using the handle's diagonal as its extent
+		
+		CGFloat	radius = hypot( hs.width, hs.height ) * 0.5 * fabs( compScale );
+		NSRect	kr = NSMakeRect( p.x - radius, p.y - radius, radius * 2.0, radius * 2.0 );
+		
+		if(![view needsToDrawRect:kr])
+			return;
+	}
+	
+	// a subclass of DKHandle that draws itself its own way must be allowed to do so
+	
+	static IMP sBaseDrawIMP = NULL;
+	
+	if( sBaseDrawIMP == NULL )
+		sBaseDrawIMP = [DKHandle instanceMethodForSelector:@selector(drawAtPoint:angle:)];
+	
+	if( mKnobBatchDepth == 0 || [handle methodForSelector:@selector(drawAtPoint:angle:)] != sBaseDrawIMP )
+	{
+		[handle drawAtPoint:p angle:radians];
+		return;
+	}
+	
+	DKKnobBatchEntry entry;
+	
+	entry.handle = handle;
+	entry.transform = CGAffineTransformMakeTranslation( p.x, p.y );
+	
+	if( radians != 0 )
+		entry.transform = CGAffineTransformRotate( entry.transform, radians );
+	
+	entry.transform = CGAffineTransformScale( entry.transform, compScale, compScale );
+	entry.transform = CGAffineTransformTranslate( entry.transform, -hs.width * 0.5, -hs.height * 0.5 );
+	entry.transform = CGAffineTransformConcat( entry.transform, ctm );
+	
+	[mKnobBatch appendBytes:&entry length:sizeof(DKKnobBatchEntry)];
+}
+
+
+- (void)			flushKnobBatch
+{
+	// composites the queued knobs. Each entry's transform already includes the CTM that was current when it was queued, so the
+	// drawing is done from device space, which also makes it immune to any transforms objects left behind.
+	
+	NSUInteger count = [mKnobBatch length] / sizeof(DKKnobBatchEntry);
+	
+	if( count == 0 )
+		return;
+	
+	const DKKnobBatchEntry* entries = [mKnobBatch bytes];
+	CGContextRef			context = [[NSGraphicsContext currentContext] graphicsPort];
+	NSUInteger				i;
+	
+	CGContextSaveGState( context );
+	CGContextConcatCTM( context, CGAffineTransformInvert( CGContextGetCTM( context )));
+	
+	for( i = 0; i < count; ++i )
+	{
+		DKHandle*	handle = entries[i].handle;
+		CGImageRef	sprite = [handle spriteImage];
+		NSSize		hs = [handle size];
+		
+		CGContextConcatCTM( context, entries[i].transform );
+		
+		if( sprite )
+			CGContextDrawImage( context, CGRectMake( 0, 0, hs.width, hs.height ), sprite );
+		else
+			[handle drawHandleContent];	// too big for the atlas, so draw it directly at the equivalent position
+		
+		CGContextConcatCTM( context, CGAffineTransformInvert( entries[i].transform ));
+	}
+	
+	CGContextRestoreGState( context );
+}
+
+
 #pragma mark -
 #pragma mark As an NSObject
 - (id)				init
@@ -472,6 +619,7 @@ static NSSize			sKnobSize = { 6.0, 6.0 };
 	[mControlOnPathPointColour release];
 	[mControlOffPathPointColour release];
 	[mControlBarColour release];
+	[mKnobBatch release];
 	[super dealloc];
 }
 
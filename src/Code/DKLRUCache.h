@@ -0,0 +1,64 @@
+//
+//  DKLRUCache.h
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file. 
+//
+
+#import <Cocoa/Cocoa.h>
+
+
+@class DKLRUCacheEntry;
+
+
+@interface DKLRUCache : NSObject
+{
+@private
+	NSMutableDictionary*	mEntries;
+	DKLRUCacheEntry*		mMostRecent;
+	DKLRUCacheEntry*		mLeastRecent;
+	NSUInteger				mTotalCost;
+	NSUInteger				mCostLimit;
+	NSUInteger				mHits;
+	NSUInteger				mMisses;
+	NSUInteger				mEvictions;
+	NSLock*					mLock;
+}
+
+- (id)					initWithCostLimit:(NSUInteger) limit;
+
+- (id)					objectForKey:(id) key;
+- (id)					peekObjectForKey:(id) key;
+- (void)				setObject:(id) obj forKey:(id) key cost:(NSUInteger) cost;
+- (void)				removeObjectForKey:(id) key;
+- (void)				removeAllObjects;
+- (NSArray*)			allKeys;
+
+- (void)				setCostLimit:(NSUInteger) limit;
+- (NSUInteger)			costLimit;
+- (NSUInteger)			totalCost;
+- (NSUInteger)			count;
+
+// statistics, for tuning
+
+- (NSUInteger)			hits;
+- (NSUInteger)			misses;
+- (NSUInteger)			evictions;
+- (CGFloat)				hitRate;
+- (void)				resetStatistics;
+
+@end
+
+
+/*
+
+A simple cache that holds objects up to a total "cost" (normally an estimate of the memory they use, in bytes), discarding the least recently
+used objects when the limit is exceeded. Objects that are retrieved are marked as most recently used. Unlike NSCache, eviction order is
+strictly LRU and hit/miss counts are kept so that the budget can be tuned. Objects larger than the whole budget are not cached at all.
+
+The cache is thread-safe, so it can be shared between objects and used when drawing on secondary threads.
+
+*/
+
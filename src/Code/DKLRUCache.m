@@ -0,0 +1,360 @@
+//
+//  DKLRUCache.m
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file. 
+//
+
+#import "DKLRUCache.h"
+
+
+// cache entries form a doubly linked list in order of use. The links are not retained - the dictionary owns the entries.
+
+@interface DKLRUCacheEntry : NSObject
+{
+@public
+	id					mKey;
+	id					mObject;
+	NSUInteger			mCost;
+	DKLRUCacheEntry*	mPrevious;		// more recently used
+	DKLRUCacheEntry*	mNext;			// less recently used
+}
+
+@end
+
+
+@implementation DKLRUCacheEntry
+
+- (void)				dealloc
+{
+	[mKey release];
+	[mObject release];
+	[super dealloc];
+}
+
+@end
+
+
+#pragma mark -
+
+@interface DKLRUCache (Private)
+
+- (void)				unlinkEntry:(DKLRUCacheEntry*) entry;
+- (void)				linkEntryAsMostRecent:(DKLRUCacheEntry*) entry;
+- (void)				removeEntry:(DKLRUCacheEntry*) entry;
+- (void)				evictToCostLimit:(NSUInteger) limit;
+
+@end
+
+
+#pragma mark -
+
+@implementation DKLRUCache
+
+
+- (id)					initWithCostLimit:(NSUInteger) limit
+{
+	self = [super init];
+	if( self )
+	{
+		mEntries = [[NSMutableDictionary alloc] init];
+		mLock = [[NSLock alloc] init];
+		mCostLimit = limit;
+	}
+	
+	return self;
+}
+
+
+- (id)					objectForKey:(id) key
+{
+	id obj = nil;
+	
+	[mLock lock];
+	
+	DKLRUCacheEntry* entry = [mEntries objectForKey:key];
+	
+	if( entry )
+	{
+		++mHits;
+		
+		if( entry != mMostRecent )
+		{
+			[self unlinkEntry:entry];
+			[self linkEntryAsMostRecent:entry];
+		}
+		
+		obj = [[entry->mObject retain] autorelease];
+	}
+	else
+		++mMisses;
+	
+	[mLock unlock];
+	
+	return obj;
+}
+
+
+- (id)					peekObjectForKey:(id) key
+{
+	// returns the object without marking it as recently used or counting a hit or miss - for clients that need to scan the cache's contents
+	
+	id obj = nil;
+	
+	[mLock lock];
+	
+	DKLRUCacheEntry* entry = [mEntries objectForKey:key];
+	
+	if( entry )
+		obj = [[entry->mObject retain] autorelease];
+	
+	[mLock unlock];
+	
+	return obj;
+}
+
+
+- (void)				setObject:(id) obj forKey:(id) key cost:(NSUInteger) cost
+{
+	NSAssert( key != nil, @"cannot cache with a nil key");
+	
+	[mLock lock];
+	
+	DKLRUCacheEntry* entry = [mEntries objectForKey:key];
+	
+	if( entry )
+		[self removeEntry:entry];
+	
+	if( obj != nil && cost <= mCostLimit )
+	{
+		// make room first so that the new entry isn't itself a candidate
+		
+		[self evictToCostLimit:mCostLimit - cost];
+		
+		entry = [[DKLRUCacheEntry alloc] init];
+		entry->mKey = [key copy];
+		entry->mObject = [obj retain];
+		entry->mCost = cost;
+		
+		[mEntries setObject:entry forKey:entry->mKey];
+		[self linkEntryAsMostRecent:entry];
+		[entry release];
+		
+		mTotalCost += cost;
+	}
+	
+	[mLock unlock];
+}
+
+
+- (void)				removeObjectForKey:(id) key
+{
+	[mLock lock];
+	
+	DKLRUCacheEntry* entry = [mEntries objectForKey:key];
+	
+	if( entry )
+		[self removeEntry:entry];
+	
+	[mLock unlock];
+}
+
+
+- (void)				removeAllObjects
+{
+	[mLock lock];
+	
+	[mEntries removeAllObjects];
+	mMostRecent = mLeastRecent = nil;
+	mTotalCost = 0;
+	
+	[mLock unlock];
+}
+
+
+- (NSArray*)			allKeys
+{
+	[mLock lock];
+	NSArray* keys = [mEntries allKeys];
+	[mLock unlock];
+	
+	return keys;
+}
+
+
+#pragma mark -
+
+- (void)				setCostLimit:(NSUInteger) limit
+{
+	[mLock lock];
+	
+	mCostLimit = limit;
+	[self evictToCostLimit:limit];
+	
+	[mLock unlock];
+}
+
+
+- (NSUInteger)			costLimit
+{
+	[mLock lock];
+	NSUInteger limit = mCostLimit;
+	[mLock unlock];
+	
+	return limit;
+}
+
+
+- (NSUInteger)			totalCost
+{
+	[mLock lock];
+	NSUInteger cost = mTotalCost;
+	[mLock unlock];
+	
+	return cost;
+}
+
+
+- (NSUInteger)			count
+{
+	[mLock lock];
+	NSUInteger count = [mEntries count];
+	[mLock unlock];
+	
+	return count;
+}
+
+
+#pragma mark -
+
+- (NSUInteger)			hits
+{
+	[mLock lock];
+	NSUInteger hits = mHits;
+	[mLock unlock];
+	
+	return hits;
+}
+
+
+- (NSUInteger)			misses
+{
+	[mLock lock];
+	NSUInteger misses = mMisses;
+	[mLock unlock];
+	
+	return misses;
+}
+
+
+- (NSUInteger)			evictions
+{
+	[mLock lock];
+	NSUInteger evictions = mEvictions;
+	[mLock unlock];
+	
+	return evictions;
+}
+
+
+- (CGFloat)				hitRate
+{
+	[mLock lock];
+	NSUInteger hits = mHits;
+	NSUInteger lookups = mHits + mMisses;
+	[mLock unlock];
+	
+	if( lookups == 0 )
+		return 0.0;
+	
+	return (CGFloat) hits / (CGFloat) lookups;
+}
+
+
+- (void)				resetStatistics
+{
+	[mLock lock];
+	mHits = mMisses = mEvictions = 0;
+	[mLock unlock];
+}
+
+
+#pragma mark -
+#pragma mark As an NSObject
+
+- (void)				dealloc
+{
+	[mEntries release];
+	[mLock release];
+	[super dealloc];
+}
+
+
+- (NSString*)			description
+{
+	return [NSString stringWithFormat:@"%@ %lu objects, cost %lu of %lu, hits %lu, misses %lu, evictions %lu", [super description],
+			(unsigned long)[self count], (unsigned long)mTotalCost, (unsigned long)mCostLimit, (unsigned long)mHits, (unsigned long)mMisses, (unsigned long)mEvictions];
+}
+
+
+@end
+
+
+#pragma mark -
+
+@implementation DKLRUCache (Private)
+
+// all of these must be called with the lock held
+
+- (void)				unlinkEntry:(DKLRUCacheEntry*) entry
+{
+	if( entry->mPrevious )
+		entry->mPrevious->mNext = entry->mNext;
+	else
+		mMostRecent = entry->mNext;
+	
+	if( entry->mNext )
+		entry->mNext->mPrevious = entry->mPrevious;
+	else
+		mLeastRecent = entry->mPrevious;
+	
+	entry->mPrevious = entry->mNext = nil;
+}
+
+
+- (void)				linkEntryAsMostRecent:(DKLRUCacheEntry*) entry
+{
+	entry->mPrevious = nil;
+	entry->mNext = mMostRecent;
+	
+	if( mMostRecent )
+		mMostRecent->mPrevious = entry;
+	
+	mMostRecent = entry;
+	
+	if( mLeastRecent == nil )
+		mLeastRecent = entry;
+}
+
+
+- (void)				removeEntry:(DKLRUCacheEntry*) entry
+{
+	[self unlinkEntry:entry];
+	mTotalCost -= entry->mCost;
+	[mEntries removeObjectForKey:entry->mKey];		// releases the entry
+}
+
+
+- (void)				evictToCostLimit:(NSUInteger) limit
+{
+	while( mTotalCost > limit && mLeastRecent != nil )
+	{
+		[self removeEntry:mLeastRecent];
+		++mEvictions;
+	}
+}
+
+
+@end
@@ -85,6 +85,7 @@
 
 - (void)			beginDrawing;
 - (void)			endDrawing;
+- (BOOL)			canRenderConcurrentlyInRect:(NSRect) rect inView:(DKDrawingView*) aView;
 
 //! The preferred selection colour for this layer.
 @property (nonatomic, retain) NSColor *selectionColour;
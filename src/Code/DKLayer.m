@@ -522,6 +522,33 @@ static NSArray*	s_selectionColours = nil;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			canRenderConcurrentlyInRect:inView:
+/// scope:			public instance method
+/// description:	can the layer's content in an area be drawn on secondary threads?
+/// 
+/// parameters:		<rect> the area of the drawing to be drawn
+///					<aView> the view that will display it
+/// result:			YES if -drawRect:inView: may be called for this area on several threads at once
+///
+/// notes:			the view's tile renderer draws separate tiles of the drawing in parallel, each on its own thread
+///					and into its own context. It only does so for layers that return YES here; other layers are drawn
+///					into the tiles one at a time on the main thread. Always called on the main thread. The default is
+///					NO, as a layer can't know whether its subclass's drawing is safe - a layer that returns YES must not
+///					change any state while drawing, nor use main-thread-only parts of Cocoa such as text layout.
+///
+///********************************************************************************************************************
+
+- (BOOL)			canRenderConcurrentlyInRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	#pragma unused(rect)
+	#pragma unused(aView)
+	
+	return NO;
+}
+
+
 #pragma mark -
 ///*********************************************************************************************************************
 ///
@@ -69,6 +69,20 @@ NS_ASSUME_NONNULL_BEGIN
 /// <code>isOpaque</code>. If no layers are opaque, returns the index of the bottom layer.
 @property (readonly) NSInteger indexOfHighestOpaqueLayer;
 
+/// @brief Returns the layers that are drawn when the group is drawn, in the order they are drawn (bottom first).
+///
+/// @discussion Omits hidden layers, layers below the highest opaque layer and, when printing, layers that aren't printed.
+- (NSArray<DKLayer*>*)		layersForDrawing;
+
+/// @brief Draws one of the group's layers in the same way as <code>-drawRect:inView:</code> draws each layer.
+///
+/// @param aLayer A layer in the group.
+/// @param rect The area being drawn.
+/// @param aView The view being drawn, if any.
+/// @discussion Together with <code>-layersForDrawing</code> this allows a drawing to be drawn a layer at a time, as the
+/// view's tile renderer does. Does not apply the group's own interior clip.
+- (void)					drawLayer:(DKLayer*) aLayer inRect:(NSRect) rect inView:(nullable DKDrawingView*) aView;
+
 /// @brief returns all of the layers in this group and all groups below it
 ///
 /// @return a list of layers
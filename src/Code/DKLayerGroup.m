@@ -676,45 +676,122 @@ NSString*		kDKLayerGroupDidReorderLayers			= @"kDKLayerGroupDidReorderLayers";
 		if ([self clipsDrawingToInterior])
 			[NSBezierPath clipRect:[[self drawing] interior]];
 
-		NSUInteger	bottom;
-		NSInteger			n;
-		BOOL		printing = ![NSGraphicsContext currentContextDrawingToScreen];
-		DKLayer*	layer;
-		
-		bottom = [self indexOfHighestOpaqueLayer];
+		NSEnumerator*	iter = [[self layersForDrawing] objectEnumerator];
+		DKLayer*		layer;
 		
-		for( n = bottom; n >= 0; --n )
-		{
-			layer = [self objectInLayersAtIndex:n];
-			
-			if ([layer visible] && !( printing && ![layer shouldDrawToPrinter]))
-			{
-				@try
-				{
-					[NSGraphicsContext saveGraphicsState];
-				
-					if ([layer clipsDrawingToInterior])
-						[NSBezierPath clipRect:[[self drawing] interior]];
-					
-					[layer beginDrawing];
-					[layer drawRect:rect inView:aView];
-					[layer endDrawing];
-				}
-				@catch( id exc )
-				{
-					NSLog(@"exception while drawing layer %@ [%ld of %ld in group %@](%@ - ignored)", layer, (long)n, (long)[self countOfLayers], self, exc );
-				}
-				@finally
-				{
-					[NSGraphicsContext restoreGraphicsState];
-				}
-			}
-		}
+		while(( layer = [iter nextObject]))
+			[self drawLayer:layer inRect:rect inView:aView];
+
 		RESTORE_GRAPHICS_CONTEXT	//[NSGraphicsContext restoreGraphicsState];
 	}
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			layersForDrawing
+/// scope:			public method
+/// overrides:
+/// description:	returns the layers that get drawn, bottom first
+/// 
+/// parameters:		none
+/// result:			a list of layers
+///
+/// notes:			layers are not drawn if they lie below the highest opaque layer, or if we are printing and the layer
+///					isn't printable.
+///
+///********************************************************************************************************************
+
+- (NSArray*)			layersForDrawing
+{
+	NSMutableArray*	list = [NSMutableArray array];
+	NSInteger		n;
+	BOOL			printing = ![NSGraphicsContext currentContextDrawingToScreen];
+	DKLayer*		layer;
+	
+	for( n = [self indexOfHighestOpaqueLayer]; n >= 0; --n )
+	{
+		layer = [self objectInLayersAtIndex:n];
+		
+		if ([layer visible] && !( printing && ![layer shouldDrawToPrinter]))
+			[list addObject:layer];
+	}
+	
+	return list;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawLayer:inRect:inView:
+/// scope:			public method
+/// overrides:
+/// description:	draws one layer of the group
+/// 
+/// parameters:		<aLayer> the layer to draw
+///					<rect> the update area passed from the original view
+///					<aView> the view being drawn
+/// result:			none
+///
+/// notes:			an exception raised by the layer is logged and ignored, so that one layer can't prevent the rest
+///					of the drawing being drawn.
+///
+///********************************************************************************************************************
+
+- (void)				drawLayer:(DKLayer*) aLayer inRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	@try
+	{
+		[NSGraphicsContext saveGraphicsState];
+	
+		if ([aLayer clipsDrawingToInterior])
+			[NSBezierPath clipRect:[[self drawing] interior]];
+		
+		[aLayer beginDrawing];
+		[aLayer drawRect:rect inView:aView];
+		[aLayer endDrawing];
+	}
+	@catch( id exc )
+	{
+		NSLog(@"exception while drawing layer %@ [%ld of %ld in group %@](%@ - ignored)", aLayer, (long)[self indexOfLayer:aLayer], (long)[self countOfLayers], self, exc );
+	}
+	@finally
+	{
+		[NSGraphicsContext restoreGraphicsState];
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			canRenderConcurrentlyInRect:inView:
+/// scope:			public method
+/// overrides:		DKLayer
+/// description:	can the group's content in an area be drawn on secondary threads?
+/// 
+/// parameters:		<rect> the area of the drawing to be drawn
+///					<aView> the view that will display it
+/// result:			YES if every layer the group draws can be drawn concurrently
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (BOOL)				canRenderConcurrentlyInRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	NSEnumerator*	iter = [[self layersForDrawing] objectEnumerator];
+	DKLayer*		layer;
+	
+	while(( layer = [iter nextObject]))
+	{
+		if(![layer canRenderConcurrentlyInRect:rect inView:aView])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			layerMayBecomeActive
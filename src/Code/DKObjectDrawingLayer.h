@@ -32,6 +32,12 @@
  the layer's selectionColour). Also, the layer's (or more typically the drawing's) DKKnob class is generally used by objects to display their
  selected state.
  
+ When many objects are selected, stroking each highlight separately gets expensive. Once the selection grows beyond
+ -selectionHighlightAggregationThreshold objects, the highlight paths that objects pass to -drawSelectionPath: are instead gathered into one
+ combined path which the layer strokes once, with the knobs batched behind it. Highlights are then always drawn on top of the objects.
+ Beyond -selectionHighlightBoundsOnlyThreshold, the objects are not asked to draw their selected state at all, and their logical bounds are
+ outlined instead. Set either threshold to NSUIntegerMax to disable that behaviour.
+ 
  */
 @interface DKObjectDrawingLayer : DKObjectOwnerLayer <NSCoding>
 {
@@ -49,6 +55,11 @@
 	NSArray*			m_objectsPendingDrag;		// temporary list of objects being dragged from the layer
 	DKDrawableObject*	mKeyAlignmentObject;		// the master object to which others can be aligned
 	NSRect				mSelBoundsCached;			// cached value of the selection bounds
+	NSUInteger			mHighlightAggregationThreshold;	// selection size above which highlights are stroked as one path
+	NSUInteger			mHighlightBoundsOnlyThreshold;	// selection size above which only the objects' bounds are highlighted
+	NSBezierPath*		mGatheredHighlightPath;		// selection highlights gathered for a single stroke, or nil if not gathering
+	NSBezierPath*		mGatheredLockedHighlightPath;	// as above, for locked objects which are highlighted in a different colour
+	CGAffineTransform	mGatheredHighlightCTM;		// the CTM at the time gathering began
 }
 
 // default settings:
@@ -143,6 +154,12 @@
 @property BOOL multipleSelectionAutoForwarding;
 - (BOOL)				multipleSelectionValidatedMenuItem:(NSMenuItem*) item;
 
+// drawing the highlights of large selections:
+
+@property NSUInteger selectionHighlightAggregationThreshold;
+@property NSUInteger selectionHighlightBoundsOnlyThreshold;
+- (BOOL)				gatherSelectionHighlightPath:(NSBezierPath*) path locked:(BOOL) locked;
+
 // drag + drop:
 
 @property NSRect dragExclusionRect;
@@ -193,6 +210,12 @@
 @end
 
 
+// default thresholds for aggregated selection highlighting:
+
+#define kDKDefaultSelectionHighlightAggregationThreshold		32
+#define kDKDefaultSelectionHighlightBoundsOnlyThreshold			1000
+
+
 // magic numbers:
 
 enum
@@ -23,6 +23,7 @@
 #import "DKImageShape.h"
 #import "DKTextShape.h"
 #import "DKGeometryUtilities.h"
+#import "DKKnob.h"
 #import "LogEvent.h"
 #import "DKPasteboardInfo.h"
 
@@ -54,6 +55,7 @@ enum
 - (void)				endBufferingSelectionChanges;
 - (BOOL)				isBufferingSelectionChanges;
 - (void)				bufferObject:(id) obj forSelectionOp:(NSInteger) op;
+- (void)				drawAggregatedSelectionHighlightsForObjects:(NSArray*) objects;
 
 
 @end
@@ -1744,6 +1746,130 @@ enum
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			setSelectionHighlightAggregationThreshold:
+/// scope:			public instance method
+///	overrides:
+/// description:	sets the number of selected objects above which selection highlights are stroked as a single path
+/// 
+/// parameters:		<count> the threshold selection size, or NSUIntegerMax to never aggregate
+/// result:			none
+///
+/// notes:			when aggregating, highlights are drawn on top regardless of -drawsSelectionHighlightsOnTop.
+///					Default is kDKDefaultSelectionHighlightAggregationThreshold
+///
+///********************************************************************************************************************
+
+- (void)				setSelectionHighlightAggregationThreshold:(NSUInteger) count
+{
+	mHighlightAggregationThreshold = count;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			selectionHighlightAggregationThreshold
+/// scope:			public instance method
+///	overrides:
+/// description:	the number of selected objects above which selection highlights are stroked as a single path
+/// 
+/// parameters:		none
+/// result:			the threshold selection size
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (NSUInteger)			selectionHighlightAggregationThreshold
+{
+	return mHighlightAggregationThreshold;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setSelectionHighlightBoundsOnlyThreshold:
+/// scope:			public instance method
+///	overrides:
+/// description:	sets the number of selected objects above which only the objects' bounds are highlighted
+/// 
+/// parameters:		<count> the threshold selection size, or NSUIntegerMax to always let objects draw their own highlight
+/// result:			none
+///
+/// notes:			in this mode no knobs are drawn, just an outline of each object's logical bounds. This only takes effect
+///					when the highlights are also being aggregated. Default is kDKDefaultSelectionHighlightBoundsOnlyThreshold
+///
+///********************************************************************************************************************
+
+- (void)				setSelectionHighlightBoundsOnlyThreshold:(NSUInteger) count
+{
+	mHighlightBoundsOnlyThreshold = count;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			selectionHighlightBoundsOnlyThreshold
+/// scope:			public instance method
+///	overrides:
+/// description:	the number of selected objects above which only the objects' bounds are highlighted
+/// 
+/// parameters:		none
+/// result:			the threshold selection size
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (NSUInteger)			selectionHighlightBoundsOnlyThreshold
+{
+	return mHighlightBoundsOnlyThreshold;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			gatherSelectionHighlightPath:locked:
+/// scope:			public instance method
+///	overrides:
+/// description:	adds a selection highlight path to those being gathered for a single stroke
+/// 
+/// parameters:		<path> the highlight path, in the current coordinate system
+///					<locked> YES if the path belongs to a locked object
+/// result:			YES if the path was gathered, NO if the layer is not gathering highlights and the caller should stroke
+///					the path itself
+///
+/// notes:			called by -[DKDrawableObject drawSelectionPath:]. If the current transform differs from the one in force
+///					when gathering began (e.g. an object drew its highlight within its own transform), the path is mapped
+///					back into the layer's coordinate system so that the combined stroke lands in the right place.
+///
+///********************************************************************************************************************
+
+- (BOOL)				gatherSelectionHighlightPath:(NSBezierPath*) path locked:(BOOL) locked
+{
+	if( mGatheredHighlightPath == nil || path == nil )
+		return NO;
+	
+	CGAffineTransform ctm = CGContextGetCTM([[NSGraphicsContext currentContext] graphicsPort]);
+	NSBezierPath* target = locked? mGatheredLockedHighlightPath : mGatheredHighlightPath;
+	
+	if( CGAffineTransformEqualToTransform( ctm, mGatheredHighlightCTM ))
+		[target appendBezierPath:path];
+	else
+	{
+		CGAffineTransform		rel = CGAffineTransformConcat( ctm, CGAffineTransformInvert( mGatheredHighlightCTM ));
+		NSAffineTransformStruct	ts = { rel.a, rel.b, rel.c, rel.d, rel.tx, rel.ty };
+		NSAffineTransform*		tfm = [NSAffineTransform transform];
+		
+		[tfm setTransformStruct:ts];
+		[target appendBezierPath:[tfm transformBezierPath:path]];
+	}
+	
+	return YES;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			setAllowsObjectsToBeTargetedByDrags:
@@ -3310,10 +3436,22 @@ enum
 
 #define FAST_DRAWING_ITERATION		1
 
+// the context passed to the drawing functions
+
+typedef struct
+{
+	DKObjectDrawingLayer*	layer;
+	CGFloat					proxyScale;		// as returned by -proxyDrawingScale
+}
+DKObjectDrawingInfo;
+
+
 static void	 drawFunction1( const void* value, void* context )
 {
-#pragma unused(context)
-	[(DKDrawableObject*)value drawContentWithSelectedState:NO];
+	DKObjectDrawingInfo* info = (DKObjectDrawingInfo*) context;
+	
+	if(![info->layer drawProxyForObject:(DKDrawableObject*) value atScale:info->proxyScale])
+		[(DKDrawableObject*)value drawContentWithSelectedState:NO];
 }
 
 
@@ -3326,7 +3464,69 @@ static void	 drawFunction2( const void* value, void* context )
 
 static void	 drawFunction3( const void* value, void* context )
 {
-	[(DKDrawableObject*)value drawContentWithSelectedState:[(DKObjectDrawingLayer*)context isSelectedObject:(DKDrawableObject*)value]];
+	DKObjectDrawingInfo*	info = (DKObjectDrawingInfo*) context;
+	BOOL					selected = [info->layer isSelectedObject:(DKDrawableObject*)value];
+	
+	if( selected || ![info->layer drawProxyForObject:(DKDrawableObject*) value atScale:info->proxyScale])
+		[(DKDrawableObject*)value drawContentWithSelectedState:selected];
+}
+
+
+- (void)				drawAggregatedSelectionHighlightsForObjects:(NSArray*) objects
+{
+	// draws the highlights of the selected objects in <objects>, gathering their highlight paths so that all of them are stroked with
+	// a single call. For very large selections, the objects aren't asked to draw themselves at all - their logical bounds are
+	// outlined instead.
+	
+	BOOL				boundsOnly = [m_selection count] > [self selectionHighlightBoundsOnlyThreshold];
+	NSEnumerator*		iter = [objects objectEnumerator];
+	DKDrawableObject*	obj;
+	
+	mGatheredHighlightPath = [[NSBezierPath alloc] init];
+	mGatheredLockedHighlightPath = [[NSBezierPath alloc] init];
+	mGatheredHighlightCTM = CGContextGetCTM([[NSGraphicsContext currentContext] graphicsPort]);
+	
+	NSBezierPath*	path;
+	NSBezierPath*	lockedPath;
+	
+	@try
+	{
+		while(( obj = [iter nextObject]))
+		{
+			if(![m_selection containsObject:obj])
+				continue;
+			
+			if( boundsOnly )
+				[([obj locked]? mGatheredLockedHighlightPath : mGatheredHighlightPath) appendBezierPathWithRect:[obj logicalBounds]];
+			else
+				[obj drawSelectedState];
+		}
+	}
+	@finally
+	{
+		// n.b. set gathering off before stroking, so nothing drawn from here on is caught by it. This is done even if an object throws,
+		// otherwise every later highlight in this layer would be gathered and never drawn.
+		
+		path = [mGatheredHighlightPath autorelease];
+		lockedPath = [mGatheredLockedHighlightPath autorelease];
+		
+		mGatheredHighlightPath = nil;
+		mGatheredLockedHighlightPath = nil;
+	}
+	
+	if(![path isEmpty])
+	{
+		[[self selectionColour] set];
+		[path setLineWidth:0.0];
+		[path stroke];
+	}
+	
+	if(![lockedPath isEmpty])
+	{
+		[[NSColor lightGrayColor] set];
+		[lockedPath setLineWidth:0.0];
+		[lockedPath stroke];
+	}
 }
 
 
@@ -3348,48 +3548,80 @@ static void	 drawFunction3( const void* value, void* context )
 #endif
 			BOOL				screen = [NSGraphicsContext currentContextDrawingToScreen];
 			BOOL				drawSelected = [self selectionVisible] && screen && ([self isActive] || [[self class] selectionIsShownWhenInactive]) && ![self locked];
+			BOOL				aggregate = drawSelected && [m_selection count] > [self selectionHighlightAggregationThreshold];
+			BOOL				selectionOnTop = [self drawsSelectionHighlightsOnTop] || aggregate;
 			NSArray*			objectsToDraw = [self objectsForUpdateRect:rect inView:aView];
+			DKObjectDrawingInfo	info;
+			
+			info.layer = self;
+			info.proxyScale = [self proxyDrawingScale];
 			
 			// draw the objects
 			
-			if( !drawSelected || [self drawsSelectionHighlightsOnTop])
+			if( !drawSelected || selectionOnTop )
 			{
 #if FAST_DRAWING_ITERATION
-				CFArrayApplyFunction((CFArrayRef) objectsToDraw, CFRangeMake( 0, [objectsToDraw count]), drawFunction1, aView );
+				CFArrayApplyFunction((CFArrayRef) objectsToDraw, CFRangeMake( 0, [objectsToDraw count]), drawFunction1, &info );
 #else
 				iter = [objectsToDraw objectEnumerator];
 				
 				while(( obj = [iter nextObject]))
-					[obj drawContentWithSelectedState:NO];
+				{
+					if(![self drawProxyForObject:obj atScale:info.proxyScale])
+						[obj drawContentWithSelectedState:NO];
+				}
 #endif
 			}
 			else
 			{
 #if FAST_DRAWING_ITERATION
-				CFArrayApplyFunction((CFArrayRef) objectsToDraw, CFRangeMake( 0, [objectsToDraw count]), drawFunction3, self );
+				CFArrayApplyFunction((CFArrayRef) objectsToDraw, CFRangeMake( 0, [objectsToDraw count]), drawFunction3, &info );
 #else
 				iter = [objectsToDraw objectEnumerator];
 
 				while(( obj = [iter nextObject]))
-					[obj drawContentWithSelectedState:[self isSelectedObject:obj]];
+				{
+					BOOL selected = [self isSelectedObject:obj];
+					
+					if( selected || ![self drawProxyForObject:obj atScale:info.proxyScale])
+						[obj drawContentWithSelectedState:selected];
+				}
 #endif
 			}
 			
 			// draw the selection on top if set to do so
 			
-			if ([self drawsSelectionHighlightsOnTop] && drawSelected )
+			if ( selectionOnTop && drawSelected )
 			{
+				// since nothing else is drawn after the highlights, their knobs can be composited together in one pass. The knobs are
+				// shared by the whole drawing, so the batch must be ended even if an object throws while drawing its highlight.
+				
+				DKKnob* knobs = [self knobs];
+				[knobs beginKnobBatch];
+				
+				@try
+				{
+					if( aggregate )
+						[self drawAggregatedSelectionHighlightsForObjects:objectsToDraw];
+					else
+					{
 #if FAST_DRAWING_ITERATION
-				CFArrayApplyFunction((CFArrayRef) objectsToDraw, CFRangeMake( 0, [objectsToDraw count]), drawFunction2, self );
+						CFArrayApplyFunction((CFArrayRef) objectsToDraw, CFRangeMake( 0, [objectsToDraw count]), drawFunction2, self );
 #else
-				iter = [objectsToDraw objectEnumerator];
-				
-				while(( obj = [iter nextObject]))
+						iter = [objectsToDraw objectEnumerator];
+						
+						while(( obj = [iter nextObject]))
+						{
+							if([self isSelectedObject:obj])
+								[obj drawSelectedState];
+						}
+#endif
+					}
+				}
+				@finally
 				{
-					if([self isSelectedObject:obj])
-						[obj drawSelectedState];
+					[knobs endKnobBatch];
 				}
-#endif
 			}
 			
 			[pool drain];
@@ -3418,6 +3650,45 @@ static void	 drawFunction3( const void* value, void* context )
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			canRenderConcurrentlyInRect:inView:
+/// scope:			public instance method
+///	overrides:		DKObjectOwnerLayer
+/// description:	can the layer's content in an area be drawn on secondary threads?
+/// 
+/// parameters:		<rect> the area of the drawing to be drawn
+///					<aView> the view that will display it
+/// result:			YES if the layer can be drawn concurrently in <rect>
+///
+/// notes:			selection highlights (knobs, etc) are drawn on the main thread, so an area containing a visible
+///					selection can't be drawn concurrently.
+///
+///********************************************************************************************************************
+
+- (BOOL)				canRenderConcurrentlyInRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	if(![super canRenderConcurrentlyInRect:rect inView:aView])
+		return NO;
+	
+	BOOL drawSelected = [self selectionVisible] && ([self isActive] || [[self class] selectionIsShownWhenInactive]) && ![self locked];
+	
+	if( drawSelected )
+	{
+		NSEnumerator*		iter = [self objectEnumeratorForUpdateRect:rect inView:nil];
+		DKDrawableObject*	obj;
+		
+		while(( obj = [iter nextObject]))
+		{
+			if([self isSelectedObject:obj])
+				return NO;
+		}
+	}
+	
+	return YES;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			layerDidBecomeActiveLayer
@@ -3825,6 +4096,8 @@ static void	 drawFunction3( const void* value, void* context )
 		m_drawSelectionOnTop = YES;
 		m_selectionVisible = YES;
 		m_allowDragTargeting = YES;
+		mHighlightAggregationThreshold = kDKDefaultSelectionHighlightAggregationThreshold;
+		mHighlightBoundsOnlyThreshold = kDKDefaultSelectionHighlightBoundsOnlyThreshold;
 		
 		if (m_selection == nil)
 		{
@@ -3921,6 +4194,8 @@ static void	 drawFunction3( const void* value, void* context )
 
 		m_drawSelectionOnTop = [coder decodeBoolForKey:@"selOnTop"];
 		m_selectionVisible = YES;
+		mHighlightAggregationThreshold = kDKDefaultSelectionHighlightAggregationThreshold;
+		mHighlightBoundsOnlyThreshold = kDKDefaultSelectionHighlightBoundsOnlyThreshold;
 		
 		if ([coder containsValueForKey:@"DKObjectDrawingLayer_allowDragTargets"])
 			[self setAllowsObjectsToBeTargetedByDrags:[coder decodeBoolForKey:@"DKObjectDrawingLayer_allowDragTargets"]];
@@ -12,9 +12,18 @@
 #import "DKObjectStorageProtocol.h"
 #import "DKDrawableContainerProtocol.h"
 
-@class DKDrawableObject, DKStyle;
+@class DKDrawableObject, DKStyle, DKQuartzCache;
 
 //! caching options
+// the largest CGLayer cache that will be built, in pixels in either direction. Beyond this the layer is drawn directly, or from the PDF cache if there is one
+
+#define		kDKLayerCacheMaximumPixelDimension		4096
+
+// default on-screen sizes, in device pixels, below which objects are drawn as a proxy or skipped
+
+#define		kDKDefaultProxyDrawingThreshold			2.0
+#define		kDKDefaultCullingThreshold				0.25
+
 typedef NS_OPTIONS(NSUInteger, DKLayerCacheOption)
 {
 	kDKLayerCacheNone			= 0,				//!< no caching
@@ -45,7 +54,17 @@ typedef NS_OPTIONS(NSUInteger, DKLayerCacheOption)
  fastest rendering but will show pixellation at higher zooms. If both pdf and CGLayer are set, both caches will be created and
  the CGLayer one used when DKDrawing has its "low quality" hint set, and the PDF rep otherwise.
  
- The cache is only used for screen drawing.
+ The cache is only used for screen drawing. It is built the first time the inactive layer is drawn and reused until a contained object
+ reports a change, the layer becomes active, or (for the CGLayer cache) the view scale changes - the CGLayer is rendered at the view's scale
+ so it stays sharp, up to kDKLayerCacheMaximumPixelDimension. If "outlines" is set, the inactive layer draws each object as a plain outline
+ stroke; combined with the CGLayer option the outlines themselves are cached.
+ 
+ Tiny objects:
+ 
+ When zoomed well out, many objects may cover no more than a pixel or two on screen, yet rendering each one in full costs just as much as
+ at 100%. Objects whose larger projected dimension is less than -proxyDrawingThreshold device pixels are instead drawn as a rect filled with
+ the object's -proxyColour, the cached average colour of its style. Below -cullingThreshold they are not drawn at all. Objects drawn along
+ with their selection highlight are always drawn in full, as is anything drawn for printing or export. Set both thresholds to 0 to disable this.
  
  NOTE: PDF caching has been shown to be actually slower when there are many objects, espcially with advanced storage in use. This is
  because it's an all-or-nothing rendering proposition which direct drawing of a layer's objects is not.
@@ -61,11 +80,16 @@ typedef NS_OPTIONS(NSUInteger, DKLayerCacheOption)
 	DKDrawableObject*		mNewObjectPending;		//!< temporary object being created - is drawn and handled as a normal object but can be deleted without undo
 	DKLayerCacheOption		mLayerCachingOption;	//!< see constants defined above
 	NSRect					mCacheBounds;			//!< the bounds rect of the cached layer or PDF rep - used to accurately position the cache when drawn
+	DKQuartzCache*			mLayerContentCache;		//!< CGLayer cache of the layer's content, if kDKLayerCacheUsingCGLayer is set
+	NSPDFImageRep*			mPDFContentCache;		//!< PDF cache of the layer's content, if kDKLayerCacheUsingPDF is set
+	CGFloat					mCacheScale;			//!< the view scale the CGLayer cache was rendered at
 	BOOL					m_inDragOp;				//!< YES if a drag is happening over the layer
 	NSSize					m_pasteOffset;			//!< distance to offset a pasted object
 	BOOL					m_recordPasteOffset;	//!< set to YES following a paste, and NO following a drag. When YES, paste offset is recorded.
 	NSInteger				mPasteboardLastChange;	//!< last change count recorded during a paste
 	NSInteger				mPasteCount;			//!< number of repeated paste operations since last new paste
+	CGFloat					mProxyThreshold;		//!< objects smaller than this on screen, in pixels, are drawn as a flat colour
+	CGFloat					mCullThreshold;			//!< objects smaller than this on screen, in pixels, are not drawn at all
 @protected
 	BOOL					mShowStorageDebugging;	//!< if YES, draws the debugging path for the storage on top (debugging feature only)
 }
@@ -139,6 +163,8 @@ typedef NS_OPTIONS(NSUInteger, DKLayerCacheOption)
 
 - (void)				drawable:(DKDrawableObject*) obj needsDisplayInRect:(NSRect) rect;
 - (void)				drawVisibleObjects;
+- (CGFloat)				proxyDrawingScale;
+- (BOOL)				drawProxyForObject:(DKDrawableObject*) obj atScale:(CGFloat) scale;
 - (NSImage*)			imageOfObjects;
 - (NSData*)				pdfDataOfObjects;
 
@@ -201,6 +227,9 @@ typedef NS_OPTIONS(NSUInteger, DKLayerCacheOption)
 
 @property DKLayerCacheOption layerCacheOption;
 
+@property CGFloat proxyDrawingThreshold;
+@property CGFloat cullingThreshold;
+
 @property (getter=isHighlightedForDrag) BOOL highlightedForDrag;
 - (void)				drawHighlightingForDrag;
 
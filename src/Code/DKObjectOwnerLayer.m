@@ -24,6 +24,7 @@
 #import "DKImageDataManager.h"
 #import "DKBSPObjectStorage.h"
 #import "DKPasteboardInfo.h"
+#import "DKQuartzCache.h"
 
 // constants
 
@@ -36,6 +37,9 @@ NSString* const kDKLayerDidRemoveObject		= @"kDKLayerDidRemoveObject";
 @interface DKObjectOwnerLayer (Private)
 - (void)	updateCache;
 - (void)	invalidateCache;
+- (BOOL)	drawCachedContent;
+- (BOOL)	shouldDrawObjectOutlines;
+- (DKStyle*) outlineStyle;
 @end
 
 static Class sStorageClass = nil;
@@ -1168,13 +1172,19 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 ///													update region or not
 /// result:			an array, the objects needig update, in drawing order
 ///
-/// notes:			If the view is nil <rect> is used to determine inclusion.
+/// notes:			If the view is nil <rect> is used to determine inclusion. Storage searches use scratch state within
+///					the storage, so they are serialized - tiles of the layer may be drawing on several threads at once.
 ///
 ///********************************************************************************************************************
 
 - (NSArray*)			objectsForUpdateRect:(NSRect) rect inView:(NSView*) aView options:(DKObjectStorageOptions) options
 {
-	return [[self storage] objectsIntersectingRect:rect inView:aView options:options];
+	id<DKObjectStorage> storage = [self storage];
+	
+	@synchronized( storage )
+	{
+		return [storage objectsIntersectingRect:rect inView:aView options:options];
+	}
 }
 
 
@@ -1232,7 +1242,7 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 	outlines = (([self layerCacheOption] & kDKLayerCacheObjectOutlines ) != 0 );
 	
 	if( outlines )
-		tempStyle = [DKStyle styleWithFillColour:nil strokeColour:[NSColor blackColor] strokeWidth:1.0];
+		tempStyle = [self outlineStyle];
 	
 	while(( od = [iter nextObject]))
 	{
@@ -1244,6 +1254,77 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			proxyDrawingScale
+/// scope:			public instance method
+/// description:	the scale from drawing units to device pixels to use when deciding whether objects are too small to draw
+/// 
+/// parameters:		none
+/// result:			the scale, or 0 if objects must all be drawn in full
+///
+/// notes:			taken from the current context's transform, so the view scale and the screen's backing scale are both
+///					included. Returns 0 when not drawing to the screen, so that printing and export are unaffected, or
+///					when both thresholds are 0. Call once per update and pass the result to -drawProxyForObject:atScale:
+///
+///********************************************************************************************************************
+
+- (CGFloat)				proxyDrawingScale
+{
+	if(( mProxyThreshold <= 0 && mCullThreshold <= 0 ) || ![NSGraphicsContext currentContextDrawingToScreen])
+		return 0;
+	
+	CGAffineTransform ctm = CGContextGetCTM([[NSGraphicsContext currentContext] graphicsPort]);
+	
+	return sqrt( fabs( ctm.a * ctm.d - ctm.b * ctm.c ));
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawProxyForObject:atScale:
+/// scope:			public instance method
+/// description:	draws a simplified stand-in for an object that is too small on screen to be worth drawing in full
+/// 
+/// parameters:		<obj> the object to be drawn
+///					<scale> the scale returned by -proxyDrawingScale
+/// result:			YES if the object was dealt with - drawn as a proxy or skipped altogether - NO if the caller should
+///					draw it normally
+///
+/// notes:			the object's bounds are filled with its -proxyColour. Uses the object's bounds rather than its path so
+///					that the test is as cheap as possible.
+///
+///********************************************************************************************************************
+
+- (BOOL)				drawProxyForObject:(DKDrawableObject*) obj atScale:(CGFloat) scale
+{
+	if( scale <= 0 )
+		return NO;
+	
+	NSRect	br = [obj bounds];
+	CGFloat	pixels = MAX( NSWidth( br ), NSHeight( br )) * scale;
+	
+	if( pixels < mCullThreshold )
+		return YES;
+	
+	if( pixels >= mProxyThreshold )
+		return NO;
+	
+	NSColor* colour = [obj proxyColour];
+	
+	if( colour == nil )
+		return NO;
+	
+	if([colour alphaComponent] > 0 )
+	{
+		[colour set];
+		NSRectFillUsingOperation( br, NSCompositeSourceOver );
+	}
+	
+	return YES;
+}
+
+
 
 ///*********************************************************************************************************************
 ///
@@ -2433,7 +2514,18 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 ///
 ///********************************************************************************************************************
 
-@synthesize layerCacheOption = mLayerCachingOption;
+- (void)				setLayerCacheOption:(DKLayerCacheOption) option
+{
+	if( option != mLayerCachingOption )
+	{
+		mLayerCachingOption = option;
+		[self invalidateCache];
+		
+		if(![self isActive])
+			[self setNeedsDisplay:YES];
+	}
+}
+
 
 ///*********************************************************************************************************************
 ///
@@ -2451,6 +2543,99 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 ///
 ///********************************************************************************************************************
 
+- (DKLayerCacheOption)	layerCacheOption
+{
+	return mLayerCachingOption;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setProxyDrawingThreshold:
+/// scope:			public instance method
+///	overrides:
+/// description:	sets the on-screen size below which objects are drawn as a flat colour
+/// 
+/// parameters:		<pixels> the size in device pixels of the larger dimension of an object's bounds
+/// result:			none
+///
+/// notes:			default is kDKDefaultProxyDrawingThreshold. Set to 0 to always draw objects in full.
+///
+///********************************************************************************************************************
+
+- (void)				setProxyDrawingThreshold:(CGFloat) pixels
+{
+	if( pixels != mProxyThreshold )
+	{
+		mProxyThreshold = MAX( 0, pixels );
+		[self setNeedsDisplay:YES];
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			proxyDrawingThreshold
+/// scope:			public instance method
+///	overrides:
+/// description:	the on-screen size below which objects are drawn as a flat colour
+/// 
+/// parameters:		none
+/// result:			the size in device pixels
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (CGFloat)				proxyDrawingThreshold
+{
+	return mProxyThreshold;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setCullingThreshold:
+/// scope:			public instance method
+///	overrides:
+/// description:	sets the on-screen size below which objects are not drawn at all
+/// 
+/// parameters:		<pixels> the size in device pixels of the larger dimension of an object's bounds
+/// result:			none
+///
+/// notes:			default is kDKDefaultCullingThreshold. Set to 0 to never skip objects on account of their size.
+///
+///********************************************************************************************************************
+
+- (void)				setCullingThreshold:(CGFloat) pixels
+{
+	if( pixels != mCullThreshold )
+	{
+		mCullThreshold = MAX( 0, pixels );
+		[self setNeedsDisplay:YES];
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			cullingThreshold
+/// scope:			public instance method
+///	overrides:
+/// description:	the on-screen size below which objects are not drawn at all
+/// 
+/// parameters:		none
+/// result:			the size in device pixels
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (CGFloat)				cullingThreshold
+{
+	return mCullThreshold;
+}
+
 
 
 ///*********************************************************************************************************************
@@ -2586,7 +2771,58 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 
 - (void)				updateCache
 {
-	// not implemented
+	// builds whichever caches the option calls for that don't exist yet. The CGLayer is rendered at the current view scale (and rebuilt
+	// if that changes) so that it's pixel-accurate; if that would make it unreasonably large, it isn't built and the layer draws from the
+	// PDF cache if there is one, or directly.
+	
+	DKLayerCacheOption	option = [self layerCacheOption];
+	NSRect				br = [self unionOfAllObjectBounds];
+	CGFloat				scale = [(DKDrawingView*)[self currentView] scale];
+	
+	if( NSIsEmptyRect( br ))
+	{
+		[self invalidateCache];
+		return;
+	}
+	
+	if( scale <= 0.0 )
+		scale = 1.0;
+	
+	if( !NSEqualRects( br, mCacheBounds ))
+		[self invalidateCache];
+	
+	mCacheBounds = br;
+	
+	if(( option & kDKLayerCacheUsingCGLayer ) != 0 && ( mLayerContentCache == nil || scale != mCacheScale ))
+	{
+		NSSize pixels = NSMakeSize( ceil( NSWidth( br ) * scale ), ceil( NSHeight( br ) * scale ));
+		
+		[mLayerContentCache release];
+		mLayerContentCache = nil;
+		
+		if( pixels.width <= kDKLayerCacheMaximumPixelDimension && pixels.height <= kDKLayerCacheMaximumPixelDimension )
+		{
+			mLayerContentCache = [[DKQuartzCache alloc] initWithContext:[NSGraphicsContext currentContext] forRect:NSMakeRect( 0, 0, pixels.width, pixels.height )];
+			mCacheScale = scale;
+			
+			NSAffineTransform* tfm = [NSAffineTransform transform];
+			[tfm scaleBy:scale];
+			[tfm translateXBy:-br.origin.x yBy:-br.origin.y];
+			
+			[mLayerContentCache lockFocus];
+			[tfm concat];
+			[self drawVisibleObjects];
+			[mLayerContentCache unlockFocus];
+		}
+	}
+	
+	if(( option & kDKLayerCacheUsingPDF ) != 0 && mPDFContentCache == nil )
+	{
+		NSData* pdf = [self pdfDataOfObjects];
+		
+		if( pdf )
+			mPDFContentCache = [[NSPDFImageRep alloc] initWithData:pdf];
+	}
 }
 
 
@@ -2606,7 +2842,79 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 
 - (void)			invalidateCache
 {
-	// not implemented
+	[mLayerContentCache release];
+	mLayerContentCache = nil;
+	[mPDFContentCache release];
+	mPDFContentCache = nil;
+	mCacheBounds = NSZeroRect;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawCachedContent
+/// scope:			private method
+///	overrides:		
+/// description:	draws the layer's objects from the offscreen cache, if the layer should be drawn that way
+/// 
+/// parameters:		none
+/// result:			YES if the content was drawn from a cache, NO if the caller should draw the objects itself
+///
+/// notes:			caches are only used for screen drawing of an inactive layer. Where both caches exist the CGLayer
+///					is used when the drawing is set to low quality, the PDF otherwise.
+///
+///********************************************************************************************************************
+
+- (BOOL)			drawCachedContent
+{
+	DKLayerCacheOption option = [self layerCacheOption];
+	
+	if(( option & ( kDKLayerCacheUsingCGLayer | kDKLayerCacheUsingPDF )) == 0 )
+		return NO;
+	
+	if([self isActive] || ![NSGraphicsContext currentContextDrawingToScreen])
+		return NO;
+	
+	[self updateCache];
+	
+	BOOL preferCGLayer = ( mPDFContentCache == nil || [[self drawing] lowRenderingQuality]);
+	
+	if( mLayerContentCache && preferCGLayer )
+	{
+		[mLayerContentCache drawInRect:mCacheBounds];
+		return YES;
+	}
+	else if( mPDFContentCache )
+	{
+		[mPDFContentCache drawInRect:mCacheBounds];
+		return YES;
+	}
+	
+	return NO;
+}
+
+
+- (BOOL)			shouldDrawObjectOutlines
+{
+	// outlines are only drawn for an inactive layer on screen
+	
+	return (([self layerCacheOption] & kDKLayerCacheObjectOutlines ) != 0 && ![self isActive] && [NSGraphicsContext currentContextDrawingToScreen]);
+}
+
+
+- (DKStyle*)		outlineStyle
+{
+	// made once and shared by all layers - it's used for every object drawn in outline, so making a new one each time is wasteful
+	
+	static DKStyle* sOutlineStyle = nil;
+	
+	@synchronized([DKObjectOwnerLayer class])
+	{
+		if( sOutlineStyle == nil )
+			sOutlineStyle = [[DKStyle styleWithFillColour:nil strokeColour:[NSColor blackColor] strokeWidth:1.0] retain];
+	}
+	
+	return sOutlineStyle;
 }
 
 
@@ -2704,15 +3012,22 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 {
 	#pragma unused(rect)
 	
-	if([self countOfObjects] > 0)
+	if([self countOfObjects] > 0 && ![self drawCachedContent])
 	{
 		NSEnumerator*		iter = [self objectEnumeratorForUpdateRect:rect inView:aView];
 		DKDrawableObject*	obj;
+		DKStyle*			outlineStyle = [self shouldDrawObjectOutlines]? [self outlineStyle] : nil;
+		CGFloat				proxyScale = [self proxyDrawingScale];
 		
 		// draw the objects - this enumerator has already excluded any not needing to be drawn
 		
 		while(( obj = [iter nextObject]))
-			[obj drawContentWithSelectedState:NO];
+		{
+			if( outlineStyle )
+				[obj drawContentWithStyle:outlineStyle];
+			else if(![self drawProxyForObject:obj atScale:proxyScale])
+				[obj drawContentWithSelectedState:NO];
+		}
 	}
 	
 	// draw any pending object on top of the others
@@ -2733,6 +3048,46 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			canRenderConcurrentlyInRect:inView:
+/// scope:			public instance method
+///	overrides:		DKLayer
+/// description:	can the layer's content in an area be drawn on secondary threads?
+/// 
+/// parameters:		<rect> the area of the drawing to be drawn
+///					<aView> the view that will display it
+/// result:			YES if the layer can be drawn concurrently in <rect>
+///
+/// notes:			not if the layer is inactive and uses any of its cache options - drawing would build the cache or
+///					an outline style - or has transient content such as a pending object, or if any object in the area
+///					isn't safe to draw on another thread.
+///
+///********************************************************************************************************************
+
+- (BOOL)				canRenderConcurrentlyInRect:(NSRect) rect inView:(DKDrawingView*) aView
+{
+	#pragma unused(aView)
+	
+	if([self layerCacheOption] != kDKLayerCacheNone && ![self isActive])
+		return NO;
+	
+	if( mNewObjectPending != nil || [self isHighlightedForDrag] || mShowStorageDebugging )
+		return NO;
+	
+	NSEnumerator*		iter = [self objectEnumeratorForUpdateRect:rect inView:nil];
+	DKDrawableObject*	obj;
+	
+	while(( obj = [iter nextObject]))
+	{
+		if(![obj isSafeForConcurrentRendering])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			hitLayer:
@@ -2939,6 +3294,10 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 
 - (void)				layerDidResignActiveLayer
 {
+	// the caches are built on the next draw, which also reflects any changes made while the layer was active
+	
+	[self invalidateCache];
+	
 	if(([self layerCacheOption] & kDKLayerCacheObjectOutlines) != 0 )
 		[self setNeedsDisplay:YES];
 }
@@ -2953,6 +3312,8 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 	
 	[[self objects] makeObjectsPerformSelector:@selector(setContainer:) withObject:nil];
 	
+	[mLayerContentCache release];
+	[mPDFContentCache release];
 	[mStorage release];
 	[super dealloc];
 }
@@ -2971,6 +3332,8 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 		[self setAllowsSnapToObjects:YES];
 		[self setAllowsEditing:YES];
 		[self setLayerCacheOption:[[self class] defaultLayerCacheOption]];
+		mProxyThreshold = kDKDefaultProxyDrawingThreshold;
+		mCullThreshold = kDKDefaultCullingThreshold;
 		[self setLayerName:NSLocalizedString(@"Drawing Layer", @"default name for new drawing layers")];
 	}
 	return self;
@@ -3073,6 +3436,8 @@ static DKLayerCacheOption sDefaultCacheOption = kDKLayerCacheNone;
 		[self setAllowsEditing:[coder decodeBoolForKey:@"editable"]];
 		[self setAllowsSnapToObjects:[coder decodeBoolForKey:@"snappable"]];
 		[self setLayerCacheOption:[[self class] defaultLayerCacheOption]];
+		mProxyThreshold = kDKDefaultProxyDrawingThreshold;
+		mCullThreshold = kDKDefaultCullingThreshold;
 	}
 	return self;
 }
@@ -9,9 +9,21 @@
 ///**********************************************************************************************************************************
 
 #import "DKRasterizer.h"
+#import "DKContentHash.h"
 
 
 @class DKQuartzCache;
+@class DKLRUCache;
+
+
+// a motif placed by the placement engine: the transform from image space to the drawing and the bounds it covers
+
+typedef struct
+{
+	CGAffineTransform	transform;
+	NSRect				bounds;
+}
+DKDecoratorPlacement;
 
 
 
@@ -34,6 +46,7 @@
 	BOOL				m_useChainMethod;
 	DKQuartzCache*		mDKCache;
 	BOOL				m_lowQuality;
+	DKLRUCache*			mPlacementCache;
 @protected
 	NSUInteger			mPlacementCount;
 	NSMutableArray*		mWobbleCache;
@@ -84,6 +97,9 @@
 - (void)				setUsesChainMethod:(BOOL) chain;
 - (BOOL)				usesChainMethod;
 
+- (NSData*)				placementsForPath:(NSBezierPath*) path;
+- (void)				drawPlacements:(NSData*) placements;
+
 @end
 
 // clipping values:
@@ -96,6 +112,8 @@ enum
 	kDKPathDecoratorClipInsidePath	= 2
 };
 
+#define		kDKPathDecoratorPlacementCacheByteBudget		(512 * 1024)
+
 /*
 
 This renderer draws the image along the path of another object spaced at <interval> distance. Each image is scaled by <scale> and is
@@ -103,4 +121,9 @@ rotated to be normal to the path unless _normalToPath is NO.
 
 This prefers PDF image representations where the image contains one, preserving resolution as the drawing is scaled.
 
+Unless a subclass overrides -placeObjectAtPoint:onPath:position:slope:userInfo:, motifs are placed by walking the flattened path once,
+working out an affine transform for each motif (with lead in/out, lateral offsets, wobble and scale randomness applied), and drawing
+the image through all of them in one batch. The placements are cached in an LRU cache keyed by the path and the decorator's settings, so
+redrawing any of the objects sharing the decorator doesn't need to place anything.
+
 */
@@ -20,6 +20,16 @@
 #import "DKDrawKitMacros.h"
 #import "DKRandom.h"
 #import "DKQuartzCache.h"
+#import "NSBezierPath+Editing.h"
+#import "DKLRUCache.h"
+
+
+@interface DKPathDecorator (Private)
+
+- (BOOL)				usesPlacementEngine;
+- (DKContentHash)		placementHashForPath:(NSBezierPath*) path;
+
+@end
 
 
 @implementation DKPathDecorator
@@ -360,6 +370,299 @@
 }	
 
 
+#pragma mark -
+///*********************************************************************************************************************
+///
+/// method:			placementsForPath:
+/// scope:			public instance method
+/// overrides:		
+/// description:	works out where each motif is drawn along a path
+/// 
+/// parameters:		<path> the path to decorate
+/// result:			data containing a DKDecoratorPlacement struct for each motif, in order along the path
+///
+/// notes:			this is equivalent to placing objects along the path at the interval and drawing each with
+///					-placeObjectAtPoint:onPath:position:slope:userInfo:, but walks the path only once rather than measuring
+///					it again for each motif. The result is cached by the path and settings, so styles sharing the decorator across
+///					many objects reuse the placements of each.
+///					Random wobble and scale values are taken from the same caches that individual placement uses.
+///
+///********************************************************************************************************************
+
+- (NSData*)				placementsForPath:(NSBezierPath*) path
+{
+	NSNumber*	key = [NSNumber numberWithUnsignedLongLong:[self placementHashForPath:path]];
+	NSData*		cached = [mPlacementCache objectForKey:key];
+	
+	if( cached != nil )
+		return cached;
+	
+	NSMutableData*	data = [NSMutableData data];
+	NSImage*		img = [self image];
+	NSSize			iSize = [img size];
+	CGFloat			interval = [self interval];
+	
+	if( img == nil || interval <= 0.0 || [path elementCount] < 2 )
+		return data;
+	
+	// flatten the path finely enough that the chords are a good match for its true length, then measure it
+	
+	NSBezierPath*	flat = [[path copy] autorelease];
+	NSInteger		i, ec;
+	NSPoint			ap[3], cur = NSZeroPoint, start = NSZeroPoint, next;
+	CGFloat			length = 0.0, segLength;
+	NSBezierPathElement	element;
+	
+	[flat setFlatness:0.1];
+	flat = [flat bezierPathByFlatteningPath];
+	ec = [flat elementCount];
+	
+	for( i = 0; i < ec; ++i )
+	{
+		element = [flat elementAtIndex:i associatedPoints:ap];
+		
+		if( element == NSMoveToBezierPathElement )
+			start = cur = ap[0];
+		else
+		{
+			next = ( element == NSClosePathBezierPathElement )? start : ap[0];
+			length += hypot( next.x - cur.x, next.y - cur.y );
+			cur = next;
+		}
+	}
+	
+	// now walk the segments, dropping a motif every <interval>. The count of motifs is only advanced for those actually
+	// placed, as it is by -placeObjectAtPoint:..., so that alternating offsets and cached random values line up the same way.
+	
+	CGFloat		distance = 0.0, segStart = 0.0, slope = 0.0, t;
+	NSPoint		p;
+	NSUInteger	count = 0;
+	
+	for( i = 0; i < ec && distance <= length; ++i )
+	{
+		element = [flat elementAtIndex:i associatedPoints:ap];
+		
+		if( element == NSMoveToBezierPathElement )
+		{
+			start = cur = ap[0];
+			continue;
+		}
+		
+		next = ( element == NSClosePathBezierPathElement )? start : ap[0];
+		segLength = hypot( next.x - cur.x, next.y - cur.y );
+		
+		if( segLength > 0.0 )
+		{
+			slope = Slope( cur, next );
+			
+			// the last segment takes any placement that falls at the very end, allowing for rounding
+			
+			while( distance <= segStart + segLength || ( i == ec - 1 && distance <= length + 1e-6 ))
+			{
+				t = MIN(( distance - segStart ) / segLength, 1.0 );
+				p.x = cur.x + ( next.x - cur.x ) * t;
+				p.y = cur.y + ( next.y - cur.y ) * t;
+				
+				// lead in/out scaling; if size has reduced to zero, nothing to place
+				
+				CGFloat leadScale = 1.0;
+				CGFloat loLen = length - m_leadOutLength;
+				
+				if ( m_leadInLength != 0 && distance <= m_leadInLength )
+					leadScale = [self rampFunction:distance / m_leadInLength];
+				else if ( m_leadOutLength != 0 && distance >= loLen )
+					leadScale = [self rampFunction:1.0 - ((distance - loLen) / m_leadOutLength)];
+				
+				if( leadScale > 0.0 )
+				{
+					CGFloat			s = slope;
+					NSPoint			wobblePoint = NSZeroPoint;
+					CGFloat			randScale = 1.0;
+					
+					if(( count & 1 ) && mAlternateLateralOffsets )
+						s += M_PI;
+					
+					if([self wobblyness] > 0.0 )
+					{
+						if( count < [mWobbleCache count])
+							wobblePoint = [[mWobbleCache objectAtIndex:count] pointValue];
+						else
+						{
+							wobblePoint.x = [DKRandom randomPositiveOrNegativeNumber] * interval * [self wobblyness];
+							wobblePoint.y = [DKRandom randomPositiveOrNegativeNumber] * interval * [self wobblyness];
+							[mWobbleCache addObject:[NSValue valueWithPoint:wobblePoint]];
+						}
+					}
+					
+					if([self scaleRandomness] > 0.0 )
+					{
+						if( count < [mScaleRandCache count])
+							randScale = [[mScaleRandCache objectAtIndex:count] floatValue];
+						else
+						{
+							randScale = 1.0 + ([DKRandom randomPositiveOrNegativeNumber] * [self scaleRandomness]);
+							[mScaleRandCache addObject:[NSNumber numberWithFloat:randScale]];
+						}
+					}
+					
+					CGFloat				sc = [self scale] * leadScale * randScale;
+					CGAffineTransform	tfm = CGAffineTransformMakeTranslation( p.x + mLateralOffset * cos( s + HALF_PI ) + wobblePoint.x,
+																			  p.y + mLateralOffset * sin( s + HALF_PI ) + wobblePoint.y );
+					tfm = CGAffineTransformScale( tfm, sc, -sc );
+					
+					if([self normalToPath])
+						tfm = CGAffineTransformRotate( tfm, -s );
+					
+					tfm = CGAffineTransformTranslate( tfm, -( iSize.width / 2 ), -( iSize.height / 2 ));
+					
+					DKDecoratorPlacement placement;
+					
+					placement.transform = tfm;
+					placement.bounds = NSRectFromCGRect( CGRectApplyAffineTransform( CGRectMake( 0, 0, iSize.width, iSize.height ), tfm ));
+					[data appendBytes:&placement length:sizeof(DKDecoratorPlacement)];
+					++count;
+				}
+				
+				distance += interval;
+			}
+			
+			segStart += segLength;
+		}
+		
+		cur = next;
+	}
+	
+	if( mPlacementCache == nil )
+		mPlacementCache = [[DKLRUCache alloc] initWithCostLimit:kDKPathDecoratorPlacementCacheByteBudget];
+	
+	[mPlacementCache setObject:data forKey:key cost:[data length]];
+	
+	return data;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			drawPlacements:
+/// scope:			public instance method
+/// overrides:		
+/// description:	draws the motif image at each of a list of placements
+/// 
+/// parameters:		<placements> data containing DKDecoratorPlacement structs, as returned by -placementsForPath:
+/// result:			none
+///
+/// notes:			placements outside the area being updated in the current view are skipped. How the image is drawn is
+///					decided once for the whole batch, rather than for each motif.
+///
+///********************************************************************************************************************
+
+- (void)				drawPlacements:(NSData*) placements
+{
+	NSImage*	img = [self image];
+	NSUInteger	i, count = [placements length] / sizeof(DKDecoratorPlacement);
+	
+	if( img == nil || count == 0 )
+		return;
+	
+	const DKDecoratorPlacement*	placement = [placements bytes];
+	DKDrawingView*				cv = [DKDrawingView currentlyDrawingView];	// n.b. can be nil if drawing into image, etc
+	CGContextRef				context = [[NSGraphicsContext currentContext] graphicsPort];
+	NSRect						ir = NSMakeRect( 0, 0, [img size].width, [img size].height );
+	CGImageRef					bitmap = NULL;
+	BOOL						useCache = ( mDKCache != nil && m_lowQuality );
+	
+	// plain bitmap images are drawn directly by Quartz, which avoids the overhead of NSImage for every motif
+	
+	if( !useCache && m_pdf == nil )
+		bitmap = [img CGImageForProposedRect:&ir context:[NSGraphicsContext currentContext] hints:nil];
+	
+	for( i = 0; i < count; ++i, ++placement )
+	{
+		if( cv != nil && ![cv needsToDrawRect:placement->bounds])
+			continue;
+		
+		CGContextSaveGState( context );
+		CGContextConcatCTM( context, placement->transform );
+		
+		if( useCache )
+			[mDKCache drawAtPoint:NSZeroPoint];
+		else if( bitmap )
+		{
+			CGContextSetBlendMode( context, kCGBlendModeSourceAtop );
+			CGContextDrawImage( context, CGRectMake( 0, 0, ir.size.width, ir.size.height ), bitmap );
+		}
+		else
+		{
+			SAVE_GRAPHICS_CONTEXT
+			if ( m_pdf != nil )
+				[m_pdf draw];
+			else
+				[img drawAtPoint:NSZeroPoint fromRect:NSZeroRect operation:NSCompositeSourceAtop fraction:1.0];
+			RESTORE_GRAPHICS_CONTEXT
+		}
+		
+		CGContextRestoreGState( context );
+	}
+	
+	mPlacementCount = count;
+}
+
+
+- (BOOL)				usesPlacementEngine
+{
+	// subclasses that draw something else at each placement need every motif to go through their override
+	
+	static IMP sPlaceIMP = NULL;
+	
+	if( sPlaceIMP == NULL )
+		sPlaceIMP = [DKPathDecorator instanceMethodForSelector:@selector(placeObjectAtPoint:onPath:position:slope:userInfo:)];
+	
+	return [self image] != nil && [self methodForSelector:@selector(placeObjectAtPoint:onPath:position:slope:userInfo:)] == sPlaceIMP;
+}
+
+
+- (DKContentHash)		placementHashForPath:(NSBezierPath*) path
+{
+	// everything that affects where the motifs go. The image is only relevant for its size, since its content is drawn anew.
+	
+	DKContentHash h = DKHashObject([path contentHash], m_image );
+	
+	h = DKHashFloat( DKHashFloat( h, [m_image size].width ), [m_image size].height );
+	h = DKHashFloat( DKHashFloat( DKHashFloat( h, m_interval ), m_scale ), mLateralOffset );
+	h = DKHashFloat( DKHashFloat( DKHashFloat( h, m_leadInLength ), m_leadOutLength ), mWobblyness );
+	h = DKHashFloat( h, mScaleRandomness );
+	h = DKHashCombine( DKHashCombine( h, mAlternateLateralOffsets ), m_normalToPath );
+	
+	return h;
+}
+
+
+#pragma mark -
+#pragma mark As a DKRasterizer
+- (BOOL)				isSafeForConcurrentRendering
+{
+	// the image and its offscreen caches are built lazily while rendering
+	
+	return NO;
+}
+
+
+- (BOOL)				isExpensiveToRender
+{
+	// the motif is drawn once for every placement along the path
+	
+	return YES;
+}
+
+
+- (BOOL)				supportsLowQualityDrawing
+{
+	// at low quality the motif is drawn from its offscreen cache
+	
+	return YES;
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 + (NSArray*)			observableKeyPaths
@@ -401,6 +704,7 @@
 	[m_pdf release];
 	[m_image release];
 	[mDKCache release];
+	[mPlacementCache release];
 	[mWobbleCache release];
 	[mScaleRandCache release];
 	[super dealloc];
@@ -596,7 +900,7 @@
 		if ( mDKCache == nil && [self image] != nil )
 			[self setUpCache];
 			
-		m_lowQuality = [obj useLowQualityDrawing];
+		m_lowQuality = [self useLowQualityDrawingForObject:obj];
 
 		NSBezierPath* path = [self renderingPathForObject:obj];
 		
@@ -650,6 +954,8 @@
 		++pass;
 		[path placeLinksOnPathWithLinkLength:[self interval] factoryObject:self userInfo:&pass];
 	}
+	else if([self usesPlacementEngine])
+		[self drawPlacements:[self placementsForPath:path]];
 	else
 		[path placeObjectsOnPathAtInterval:[self interval] factoryObject:self userInfo:NULL];
 }
@@ -35,6 +35,32 @@ static CGImageRef	CreateMaskFromImage( NSImage* image );
 }
 
 
+#pragma mark -
+#pragma mark As a DKRasterizer
+- (BOOL)			isSafeForConcurrentRendering
+{
+	return m_maskImage == nil && [super isSafeForConcurrentRendering];
+}
+
+
+- (BOOL)			canBeRasterCached
+{
+	// blend modes other than normal combine with what's already been drawn, which isn't in the cache
+	
+	return [self blendMode] == kCGBlendModeNormal && [super canBeRasterCached];
+}
+
+
+- (DKContentHash)	contentHash
+{
+	DKContentHash h = [super contentHash];
+	
+	h = DKHashCombine( h, [self blendMode]);
+	h = DKHashFloat( h, [self alpha]);
+	return DKHashObject( h, [self maskImage]);
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 + (NSArray*)		observableKeyPaths
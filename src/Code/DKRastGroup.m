@@ -624,6 +624,124 @@
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			contentHash
+/// scope:			public method
+/// overrides:		DKRasterizer
+/// description:	returns a structural hash of the group and everything it contains
+/// 
+/// parameters:		none
+/// result:			a hash value
+///
+/// notes:			combines the hashes of the contained renderers in order, so reordering them changes the result
+///
+///********************************************************************************************************************
+
+- (DKContentHash)	contentHash
+{
+	NSEnumerator*	iter = [[self renderList] objectEnumerator];
+	DKRasterizer*	rend;
+	DKContentHash	h = DKHashObject( kDKContentHashSeed, NSStringFromClass([self class]));
+	
+	h = DKHashCombine( h, [self enabled]);
+	h = DKHashCombine( h, [self clipping]);
+	h = DKHashCombine( h, [self countOfRenderList]);
+	
+	while(( rend = [iter nextObject]))
+		h = DKHashCombine( h, [rend contentHash]);
+	
+	return h;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isSafeForConcurrentRendering
+/// scope:			public method
+/// overrides:		DKRasterizer
+/// description:	can the group render on a secondary thread?
+/// 
+/// parameters:		none
+/// result:			YES if every enabled renderer in the group can
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (BOOL)			isSafeForConcurrentRendering
+{
+	NSEnumerator*	iter = [[self renderList] objectEnumerator];
+	DKRasterizer*	rend;
+	
+	while(( rend = [iter nextObject]))
+	{
+		if([rend enabled] && ![rend isSafeForConcurrentRendering])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isExpensiveToRender
+/// scope:			public method
+/// overrides:		DKRasterizer
+/// description:	is the group costly to draw?
+/// 
+/// parameters:		none
+/// result:			YES if any enabled renderer in the group is
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (BOOL)			isExpensiveToRender
+{
+	NSEnumerator*	iter = [[self renderList] objectEnumerator];
+	DKRasterizer*	rend;
+	
+	while(( rend = [iter nextObject]))
+	{
+		if([rend enabled] && [rend isExpensiveToRender])
+			return YES;
+	}
+	
+	return NO;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			canBeRasterCached
+/// scope:			public method
+/// overrides:		DKRasterizer
+/// description:	can the group's output be cached as a bitmap?
+/// 
+/// parameters:		none
+/// result:			YES if every enabled renderer in the group can
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (BOOL)			canBeRasterCached
+{
+	NSEnumerator*	iter = [[self renderList] objectEnumerator];
+	DKRasterizer*	rend;
+	
+	while(( rend = [iter nextObject]))
+	{
+		if([rend enabled] && ![rend canBeRasterCached])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
 #pragma mark -
 #pragma mark As a GCObservableObject
 
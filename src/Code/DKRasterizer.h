@@ -10,11 +10,19 @@
 
 #import "DKRasterizerProtocol.h"
 #import "GCObservableObject.h"
+#import "DKContentHash.h"
 
 
 @class DKRastGroup;
 
 
+// level of detail path simplification:
+
+#define		kDKDefaultPathLODPixelTolerance		0.25	// maximum deviation of a simplified path, in device pixels
+#define		kDKPathLODMinimumElementCount		64		// paths with fewer elements than this are never simplified
+#define		kDKPathLODMinimumTolerance			0.5		// simplification tolerances below this (in path units) are not worth applying
+#define		kDKPathLODMaximumCachedLevels		4		// number of zoom levels of simplified paths cached per object
+
 // clipping values:
 
 
@@ -41,7 +49,7 @@ typedef NS_ENUM(NSInteger, DKClippingOption)
  of a shape when a set of rendering operations is applied to it.
  
  */
-@interface DKRasterizer : GCObservableObject <DKRasterizer, NSCoding, NSCopying>
+@interface DKRasterizer : GCObservableObject <DKRasterizer, NSCoding, NSCopying, DKContentHashing>
 {
 @private
 	DKRastGroup*		mContainerRef;		//!< group that contains this
@@ -52,6 +60,11 @@ typedef NS_ENUM(NSInteger, DKClippingOption)
 
 + (DKRasterizer*)	rasterizerFromPasteboard:(NSPasteboard*) pb;
 
++ (void)			setPathLevelOfDetailEnabled:(BOOL) enable;
++ (BOOL)			pathLevelOfDetailEnabled;
++ (void)			setPathLevelOfDetailPixelTolerance:(CGFloat) tolerance;
++ (CGFloat)			pathLevelOfDetailPixelTolerance;
+
 - (DKRastGroup*)	container;
 - (void)			setContainer:(DKRastGroup*) container;
 
@@ -67,6 +80,14 @@ typedef NS_ENUM(NSInteger, DKClippingOption)
 - (void)			setClippingWithoutNotifying:(DKClippingOption) clipping;
 
 - (NSBezierPath*)	renderingPathForObject:(id<DKRenderable>) object;
+- (NSBezierPath*)	levelOfDetailPath:(NSBezierPath*) path forObject:(id<DKRenderable>) object;
+
+- (DKContentHash)	contentHash;
+- (BOOL)			isSafeForConcurrentRendering;
+- (BOOL)			isExpensiveToRender;
+- (BOOL)			canBeRasterCached;
+- (BOOL)			supportsLowQualityDrawing;
+- (BOOL)			useLowQualityDrawingForObject:(id<DKRenderable>) object;
 
 - (BOOL)			copyToPasteboard:(NSPasteboard*) pb;
 
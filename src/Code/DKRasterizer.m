@@ -10,17 +10,54 @@
 
 #import "DKRasterizer.h"
 #import "DKStyle.h"
+#import "DKFrameBudget.h"
 #import "LogEvent.h"
 #import "NSBezierPath+Geometry.h"
+#import "NSBezierPath+Editing.h"
 
 NSString*	kDKRasterizerPasteboardType		= @"kDKRendererPasteboardType";
 NSString*	kDKRasterizerPropertyWillChange	= @"kDKRasterizerPropertyWillChange";
 NSString*	kDKRasterizerPropertyDidChange	= @"kDKRasterizerPropertyDidChange";
 NSString*	kDKRasterizerChangedPropertyKey = @"kDKRasterizerChangedPropertyKey";
 
+static NSString*	kDKRasterizerLODCacheKey		= @"DKRasterizer_LOD";
+
+static BOOL			sPathLODEnabled = YES;
+static CGFloat		sPathLODPixelTolerance = kDKDefaultPathLODPixelTolerance;
+
 @implementation DKRasterizer
 #pragma mark As a DKRasterizer
 
++ (void)				setPathLevelOfDetailEnabled:(BOOL) enable
+{
+	// when enabled (the default) dense paths are simplified according to the view scale when drawn to the screen. Disable to always
+	// draw the full path
+	
+	sPathLODEnabled = enable;
+}
+
+
++ (BOOL)				pathLevelOfDetailEnabled
+{
+	return sPathLODEnabled;
+}
+
+
++ (void)				setPathLevelOfDetailPixelTolerance:(CGFloat) tolerance
+{
+	// the maximum deviation of a simplified path from the original, in device pixels. Default is 0.25
+	
+	sPathLODPixelTolerance = MAX( 0.01, tolerance );
+}
+
+
++ (CGFloat)				pathLevelOfDetailPixelTolerance
+{
+	return sPathLODPixelTolerance;
+}
+
+
+
 + (DKRasterizer*)		rasterizerFromPasteboard:(NSPasteboard*) pb
 {
 	// creates a renderer from the pasteboard if possible. Returns the renderer, or nil.
@@ -303,7 +340,259 @@ NSString*	kDKRasterizerChangedPropertyKey = @"kDKRasterizerChangedPropertyKey";
 
 - (NSBezierPath*)	renderingPathForObject:(id<DKRenderable>) object
 {
-	return [object renderingPath];
+	NSBezierPath* path = [object renderingPath];
+	
+	if( sPathLODEnabled )
+		path = [self levelOfDetailPath:path forObject:object];
+	
+	return path;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			levelOfDetailPath:forObject:
+/// scope:			protected method
+/// overrides:
+/// description:	returns a simplified version of the path suited to the current drawing scale
+/// 
+/// parameters:		<path> the object's full rendering path
+///					<object> the object being rendered
+/// result:			a path with no more detail than can be seen at the current scale, or <path> itself
+///
+/// notes:			when a dense path is drawn to the screen at a small scale, most of its vertices fall within the
+///					same device pixel. This replaces the path with a Douglas-Peucker simplification whose error is
+///					a fraction of a device pixel, so the result is visually identical. The tolerance is quantized to
+///					powers of two so that the simplified paths can be cached in the object's rendering cache for a
+///					handful of zoom levels; the cache is checked against the path's content hash so edits that don't
+///					change the bounds are still picked up. Printing, PDF export and hit-testing always get the full path.
+///					Secondary threads rendering tiles use cached levels (as a copy), and simplify without caching otherwise.
+///
+///********************************************************************************************************************
+
+- (NSBezierPath*)	levelOfDetailPath:(NSBezierPath*) path forObject:(id<DKRenderable>) object
+{
+	if( path == nil || [path elementCount] < kDKPathLODMinimumElementCount )
+		return path;
+	
+	if( ![NSGraphicsContext currentContextDrawingToScreen])
+		return path;
+	
+	if([object respondsToSelector:@selector(isBeingHitTested)] && [(id)object isBeingHitTested])
+		return path;
+	
+	// work out the size of a device pixel in path units from the current CTM, which includes the view scale and any container transforms
+	
+	CGContextRef		context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGAffineTransform	ctm = CGContextGetCTM( context );
+	CGFloat				det = fabs( ctm.a * ctm.d - ctm.b * ctm.c );
+	
+	if( det <= 0.0 )
+		return path;
+	
+	CGFloat tolerance = sPathLODPixelTolerance / sqrt( det );
+	
+	// quantize to a power of two (rounding down, so the error never exceeds the requested tolerance), and don't bother when the
+	// tolerance is so small that hardly anything would be removed
+	
+	NSInteger	level = (NSInteger) floor( log2( tolerance ));
+	
+	tolerance = ldexp( 1.0, (int) level );
+	
+	if( tolerance < kDKPathLODMinimumTolerance )
+		return path;
+	
+	NSMutableDictionary*	cache = nil;
+	NSMutableDictionary*	levels = nil;
+	NSNumber*				checksum = @([path contentHash]);
+	NSNumber*				levelKey = @(level);
+	NSBezierPath*			simplified;
+	
+	if([object respondsToSelector:@selector(renderingCache)])
+	{
+		cache = [object renderingCache];
+		levels = [cache objectForKey:kDKRasterizerLODCacheKey];
+		
+		if( levels && ![[levels objectForKey:@"checksum"] isEqualToNumber:checksum])
+			levels = nil;
+		
+		simplified = [levels objectForKey:levelKey];
+		
+		// renderers set attributes such as the line width on the path they're given, so a secondary thread gets its own copy
+		
+		if( simplified )
+			return [NSThread isMainThread]? simplified : [[simplified copy] autorelease];
+	}
+	
+	simplified = [path bezierPathBySimplifyingWithTolerance:tolerance];
+	
+	// if it didn't achieve much, keep drawing the original so that curves remain as curves
+	
+	if([simplified elementCount] * 4 > [path elementCount] * 3 )
+		simplified = path;
+	
+	// the rendering cache is only changed on the main thread - secondary threads use the simplified path without keeping it
+	
+	if( cache && [NSThread isMainThread])
+	{
+		if( levels == nil || [levels count] > kDKPathLODMaximumCachedLevels )
+		{
+			levels = [NSMutableDictionary dictionary];
+			[levels setObject:checksum forKey:@"checksum"];
+			[cache setObject:levels forKey:kDKRasterizerLODCacheKey];
+		}
+		
+		[levels setObject:simplified forKey:levelKey];
+	}
+	
+	return simplified;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			contentHash
+/// scope:			public method
+/// overrides:
+/// description:	returns a 64-bit hash of the rasterizer's class and all of its properties
+/// 
+/// parameters:		none
+/// result:			a hash value
+///
+/// notes:			two rasterizers with the same hash will render identically, so the value can be used as part of
+///					a cache key. The default implementation hashes the values of the class's +observableKeyPaths, which
+///					are the properties whose changes a style is notified of - a subclass with other properties that affect
+///					rendering must override this and add them. Clients should cache the result (as DKStyle does). Do not
+///					persist the value.
+///
+///********************************************************************************************************************
+
+- (DKContentHash)	contentHash
+{
+	// hashes the value of every observable property except the name, which doesn't affect rendering
+	
+	NSEnumerator*	iter = [[[self class] observableKeyPaths] objectEnumerator];
+	NSString*		keyPath;
+	DKContentHash	h = DKHashObject( kDKContentHashSeed, NSStringFromClass([self class]));
+	
+	while(( keyPath = [iter nextObject]))
+	{
+		if(![keyPath isEqualToString:@"name"])
+			h = DKHashObject( h, [self valueForKeyPath:keyPath]);
+	}
+	
+	return h;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isSafeForConcurrentRendering
+/// scope:			public method
+/// overrides:
+/// description:	can the rasterizer render on a secondary thread at the same time as other threads render it?
+/// 
+/// parameters:		none
+/// result:			YES if the rasterizer may be rendered concurrently
+///
+/// notes:			a rasterizer that only draws a path to the current context is safe. One that builds lazy caches
+///					in its own ivars, or uses text or image drawing, is not and should override this to return NO - objects
+///					using it will then be drawn on the main thread only.
+///
+///********************************************************************************************************************
+
+- (BOOL)			isSafeForConcurrentRendering
+{
+	return YES;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isExpensiveToRender
+/// scope:			public method
+/// overrides:
+/// description:	is the rasterizer costly enough to draw that objects using it should cache their rendered image?
+/// 
+/// parameters:		none
+/// result:			YES if objects using the rasterizer should be drawn from the raster cache
+///
+/// notes:			simple fills and strokes are quicker to draw directly than to cache, so the default is NO. Renderers that
+///					blur, roughen, hatch or repeat images along a path should return YES. See DKDrawableObject's raster cache.
+///
+///********************************************************************************************************************
+
+- (BOOL)			isExpensiveToRender
+{
+	return NO;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			canBeRasterCached
+/// scope:			public method
+/// overrides:
+/// description:	can the rasterizer's output be captured in a bitmap and drawn from that later?
+/// 
+/// parameters:		none
+/// result:			YES if the rendered result can be cached
+///
+/// notes:			the cached image is rendered against a transparent background and is valid only while the object's
+///					geometry, metadata and style remain the same. A renderer that blends with what's already drawn, or
+///					whose output depends on anything else, must return NO.
+///
+///********************************************************************************************************************
+
+- (BOOL)			canBeRasterCached
+{
+	return YES;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			supportsLowQualityDrawing
+/// scope:			public method
+/// overrides:
+/// description:	does the rasterizer draw noticeably faster when asked for low quality?
+/// 
+/// parameters:		none
+/// result:			YES if the rasterizer has a cheaper low quality mode
+///
+/// notes:			only rasterizers returning YES are timed by the frame budget and so can be degraded by it. The default
+///					is NO; subclasses that take shortcuts when -useLowQualityDrawingForObject: is YES should override.
+///
+///********************************************************************************************************************
+
+- (BOOL)			supportsLowQualityDrawing
+{
+	return NO;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			useLowQualityDrawingForObject:
+/// scope:			public method
+/// overrides:
+/// description:	should the rasterizer draw the object at low quality?
+/// 
+/// parameters:		<object> the object being rendered
+/// result:			YES if shortcuts may be taken
+///
+/// notes:			YES if the object asks for low quality, or if the active frame budget has degraded this class of
+///					rasterizer to keep the current frame within its time. Subclasses should call this rather than asking
+///					the object directly.
+///
+///********************************************************************************************************************
+
+- (BOOL)			useLowQualityDrawingForObject:(id<DKRenderable>) object
+{
+	if([object useLowQualityDrawing])
+		return YES;
+	
+	return [self supportsLowQualityDrawing] && [[DKFrameBudget activeBudget] shouldDegradeRenderer:self];
 }
 
 
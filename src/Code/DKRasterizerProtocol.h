@@ -25,6 +25,7 @@
 
 @optional
 - (NSMutableDictionary*)	renderingCache;				//!< return a mutable dictionary that a renderer can store information into for caching purposes
+- (BOOL)					isBeingHitTested;			//!< return YES if the object is being drawn for hit-testing, so renderers must not take shortcuts
 
 @end
 
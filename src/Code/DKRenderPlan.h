@@ -0,0 +1,52 @@
+///**********************************************************************************************************************************
+///  DKRenderPlan.h
+///  DrawKit ©2005-2008 Apptree.net
+///
+///  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file. 
+///
+///**********************************************************************************************************************************
+
+#import <Cocoa/Cocoa.h>
+#import "DKRasterizerProtocol.h"
+
+
+@class DKRastGroup;
+
+typedef struct _DKRenderPlanStep DKRenderPlanStep;
+
+
+@interface DKRenderPlan : NSObject
+{
+@private
+	DKRenderPlanStep*	mSteps;
+	NSUInteger			mCount;
+	NSUInteger			mDirectCount;
+}
+
++ (DKRenderPlan*)		renderPlanForGroup:(DKRastGroup*) group;
+
+- (id)					initWithGroup:(DKRastGroup*) group;
+
+- (NSUInteger)			countOfSteps;
+- (NSUInteger)			countOfDirectSteps;
+- (BOOL)				isEmpty;
+
+- (void)				render:(id<DKRenderable>) object;
+
+@end
+
+
+/*
+
+A render plan is a flattened, immutable snapshot of a rasterizer group (normally a style) that renders the same result as the group, with
+much less work per object. Disabled renderers and empty groups are left out and plain nested groups are merged into their parent. Plain
+fills and strokes, which make up most styles, become direct steps that hold their colour and stroke attributes already looked up. These
+are drawn with Quartz, sharing the object's rendering path and one save and restore of the graphics state for each run of them. Anything
+else is rendered by asking its rasterizer as usual, within one save and restore of the graphics state for the whole plan as the group would.
+
+A plan doesn't observe the group it was made from, so it must be discarded whenever the group changes - DKStyle does this from
+its change notifications. Dash patterns are read as each object is drawn, as they can be edited in place.
+
+*/
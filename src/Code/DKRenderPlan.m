@@ -0,0 +1,423 @@
+///**********************************************************************************************************************************
+///  DKRenderPlan.m
+///  DrawKit ©2005-2008 Apptree.net
+///
+///  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file. 
+///
+///**********************************************************************************************************************************
+
+#import "DKRenderPlan.h"
+#import "DKRastGroup.h"
+#import "DKFill.h"
+#import "DKStroke.h"
+#import "DKStrokeDash.h"
+#import "DKFrameBudget.h"
+#import "DKDrawKitMacros.h"
+#import "NSBezierPath+Geometry.h"
+
+
+typedef enum
+{
+	kDKRenderPlanRasterizer		= 0,	// ask the rasterizer to render the object
+	kDKRenderPlanFill			= 1,	// fill the rendering path with a solid colour
+	kDKRenderPlanStroke			= 2		// stroke the rendering path with a solid colour
+}
+DKRenderPlanOperation;
+
+
+struct _DKRenderPlanStep
+{
+	DKRenderPlanOperation	operation;
+	DKRasterizer*			rasterizer;		// retained
+	NSColor*				colour;			// retained, direct steps only
+	DKStrokeDash*			dash;			// retained, strokes only
+	CGFloat					width;
+	CGFloat					miterLimit;
+	CGLineCap				cap;
+	CGLineJoin				join;
+};
+
+
+@interface DKRenderPlan (Private)
+
+- (void)				addStepsFromGroup:(DKRastGroup*) group capacity:(NSUInteger*) capacity;
+- (void)				addStep:(DKRenderPlanStep) step capacity:(NSUInteger*) capacity;
+
+@end
+
+
+#pragma mark -
+@implementation DKRenderPlan
+#pragma mark As a DKRenderPlan
+
+///*********************************************************************************************************************
+///
+/// method:			renderPlanForGroup:
+/// scope:			public class method
+/// overrides:
+/// description:	compiles a render plan for a rasterizer group
+/// 
+/// parameters:		<group> a group or style
+/// result:			an autoreleased plan
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
++ (DKRenderPlan*)		renderPlanForGroup:(DKRastGroup*) group
+{
+	return [[[self alloc] initWithGroup:group] autorelease];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			initWithGroup:
+/// scope:			public instance method
+/// overrides:
+/// description:	compiles a render plan for a rasterizer group
+/// 
+/// parameters:		<group> a group or style
+/// result:			the plan
+///
+/// notes:			the plan reflects the group as it is now - later changes to the group are not picked up. The group's
+///					own enabled state is not considered, that's for the caller to check as the plan is drawn.
+///
+///********************************************************************************************************************
+
+- (id)					initWithGroup:(DKRastGroup*) group
+{
+	self = [super init];
+	if( self )
+	{
+		NSUInteger capacity = 0;
+		[self addStepsFromGroup:group capacity:&capacity];
+	}
+	
+	return self;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			countOfSteps
+/// scope:			public instance method
+/// overrides:
+/// description:	the number of steps in the plan
+/// 
+/// parameters:		none
+/// result:			the number of steps
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (NSUInteger)			countOfSteps
+{
+	return mCount;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			countOfDirectSteps
+/// scope:			public instance method
+/// overrides:
+/// description:	the number of fills and strokes that the plan draws itself, rather than asking the rasterizer
+/// 
+/// parameters:		none
+/// result:			the number of direct steps
+///
+/// notes:			mainly useful for checking how well a style compiles
+///
+///********************************************************************************************************************
+
+- (NSUInteger)			countOfDirectSteps
+{
+	return mDirectCount;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isEmpty
+/// scope:			public instance method
+/// overrides:
+/// description:	does the plan draw anything?
+/// 
+/// parameters:		none
+/// result:			YES if the plan has no steps
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (BOOL)				isEmpty
+{
+	return mCount == 0;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			render:
+/// scope:			public instance method
+/// overrides:
+/// description:	renders the object by executing the plan
+/// 
+/// parameters:		<object> the object to render
+/// result:			none
+///
+/// notes:			the rendering path is obtained once and shared by all the direct steps. Consecutive direct steps
+///					are bracketed by a single Quartz save and restore. If there are other steps, the whole plan is
+///					bracketed by a save and restore of the graphics context, as the group would be, so that whatever
+///					they leave behind doesn't affect later drawing. Direct steps never change the object's path.
+///					While a frame budget is active, rasterizers that have a low quality mode are timed and reported to it.
+///
+///********************************************************************************************************************
+
+- (void)				render:(id<DKRenderable>) object
+{
+	if( mCount == 0 )
+		return;
+	
+	CGContextRef	context = [[NSGraphicsContext currentContext] graphicsPort];
+	NSBezierPath*	path = nil;
+	CGPathRef		cgPath = NULL;
+	BOOL			pathIsEmpty = NO;
+	BOOL			inRun = NO;
+	BOOL			saved = ( mDirectCount < mCount );
+	DKFrameBudget*	budget = [object isBeingHitTested]? nil : [DKFrameBudget activeBudget];
+	NSUInteger		i;
+	
+	if( saved )
+		[NSGraphicsContext saveGraphicsState];
+	
+	@try
+	{
+		for( i = 0; i < mCount; ++i )
+		{
+			DKRenderPlanStep* step = &mSteps[i];
+			
+			if( step->operation == kDKRenderPlanRasterizer )
+			{
+				if( inRun )
+				{
+					CGContextRestoreGState( context );
+					inRun = NO;
+				}
+				
+				// rasterizers that can be degraded are timed so that the frame budget knows which are costing the most
+				
+				if( budget && [step->rasterizer supportsLowQualityDrawing])
+				{
+					NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+					[step->rasterizer render:object];
+					[budget renderer:step->rasterizer didRenderObject:object inTime:[NSDate timeIntervalSinceReferenceDate] - start];
+				}
+				else
+					[step->rasterizer render:object];
+				
+				continue;
+			}
+			
+			// direct steps all use the same path, which the rasterizer supplies so that the level of detail is honoured
+			
+			if( path == nil )
+			{
+				path = [step->rasterizer renderingPathForObject:object];
+				pathIsEmpty = ( path == nil || [path isEmpty]);
+				
+				if( !pathIsEmpty )
+					cgPath = [path newQuartzPath];
+			}
+			
+			if( pathIsEmpty || cgPath == NULL )
+				continue;
+			
+			if( !inRun )
+			{
+				CGContextSaveGState( context );
+				inRun = YES;
+			}
+			
+			if( step->operation == kDKRenderPlanFill )
+			{
+				// as DKFill, paths with no area are not filled
+				
+				NSRect pb = [path bounds];
+				
+				if( pb.size.width <= 0.0 || pb.size.height <= 0.0 )
+					continue;
+				
+				[step->colour setFill];
+				CGContextAddPath( context, cgPath );
+				
+				if([path windingRule] == NSEvenOddWindingRule )
+					CGContextEOFillPath( context );
+				else
+					CGContextFillPath( context );
+			}
+			else
+			{
+				[step->colour setStroke];
+				CGContextSetLineWidth( context, step->width );
+				CGContextSetLineCap( context, step->cap );
+				CGContextSetLineJoin( context, step->join );
+				CGContextSetMiterLimit( context, step->miterLimit );
+				
+				// equivalent to -[DKStrokeDash applyToPath:]
+				
+				if( step->dash && [step->dash count] > 0 )
+				{
+					CGFloat		pattern[8];
+					NSInteger	count = 0;
+					CGFloat		phase = LIMIT([step->dash phase], 0, [step->dash length]);
+					CGFloat		scale = [step->dash scalesToLineWidth]? step->width : 1.0;
+					NSInteger	j;
+					
+					[step->dash getDashPattern:pattern count:&count];
+					count = MIN( count, 8 );
+					
+					for( j = 0; j < count; ++j )
+						pattern[j] *= scale;
+					
+					CGContextSetLineDash( context, -phase * scale, pattern, count );
+				}
+				else
+					CGContextSetLineDash( context, 0, NULL, 0 );
+				
+				CGContextAddPath( context, cgPath );
+				CGContextStrokePath( context );
+			}
+		}
+	}
+	@finally
+	{
+		if( inRun )
+			CGContextRestoreGState( context );
+		
+		CGPathRelease( cgPath );
+		
+		if( saved )
+			[NSGraphicsContext restoreGraphicsState];
+	}
+}
+
+
+#pragma mark -
+#pragma mark As an NSObject
+- (void)				dealloc
+{
+	NSUInteger i;
+	
+	for( i = 0; i < mCount; ++i )
+	{
+		[mSteps[i].rasterizer release];
+		[mSteps[i].colour release];
+		[mSteps[i].dash release];
+	}
+	
+	free( mSteps );
+	[super dealloc];
+}
+
+
+- (NSString*)			description
+{
+	return [NSString stringWithFormat:@"%@ {%lu steps, %lu direct}", [super description], (unsigned long)[self countOfSteps], (unsigned long)[self countOfDirectSteps]];
+}
+
+
+@end
+
+
+#pragma mark -
+@implementation DKRenderPlan (Private)
+
+- (void)				addStepsFromGroup:(DKRastGroup*) group capacity:(NSUInteger*) capacity
+{
+	NSEnumerator*	iter = [[group renderList] objectEnumerator];
+	DKRasterizer*	rend;
+	
+	while(( rend = [iter nextObject]))
+	{
+		if(![rend enabled])
+			continue;
+		
+		DKRenderPlanStep step;
+		
+		bzero( &step, sizeof( step ));
+		step.operation = kDKRenderPlanRasterizer;
+		step.rasterizer = rend;
+		
+		if([rend class] == [DKRastGroup class])
+		{
+			// a plain group only saves and restores the graphics state around its renderers, which do the same themselves,
+			// so its contents can be merged into this plan. Empty groups disappear entirely.
+			
+			[self addStepsFromGroup:(DKRastGroup*)rend capacity:capacity];
+			continue;
+		}
+		
+		// only the base fill and stroke classes are drawn directly - subclasses override how the path is obtained or drawn.
+		// Shadows, gradients, trimming and offsets are left to the rasterizer.
+		
+		if([rend class] == [DKFill class] && [rend clipping] == kDKClippingNone )
+		{
+			DKFill* fill = (DKFill*) rend;
+			
+			if([fill shadow] == nil && [fill gradient] == nil )
+			{
+				// a fill with neither colour nor gradient draws nothing
+				
+				if([fill colour] == nil )
+					continue;
+				
+				step.operation = kDKRenderPlanFill;
+				step.colour = [fill colour];
+			}
+		}
+		else if([rend class] == [DKStroke class] && [rend clipping] == kDKClippingNone )
+		{
+			DKStroke* stroke = (DKStroke*) rend;
+			
+			if([stroke shadow] == nil && [stroke trimLength] <= 0.0 && [stroke lateralOffset] == 0.0 && [stroke colour] != nil )
+			{
+				step.operation = kDKRenderPlanStroke;
+				step.colour = [stroke colour];
+				step.dash = [stroke dash];
+				step.width = [stroke width];
+				step.miterLimit = [stroke miterLimit];
+				step.cap = (CGLineCap)[stroke lineCapStyle];
+				step.join = (CGLineJoin)[stroke lineJoinStyle];
+			}
+		}
+		
+		[self addStep:step capacity:capacity];
+	}
+}
+
+
+- (void)				addStep:(DKRenderPlanStep) step capacity:(NSUInteger*) capacity
+{
+	if( mCount >= *capacity )
+	{
+		*capacity = MAX( 4, *capacity * 2 );
+		mSteps = realloc( mSteps, sizeof( DKRenderPlanStep ) * *capacity );
+	}
+	
+	[step.rasterizer retain];
+	[step.colour retain];
+	[step.dash retain];
+	
+	if( step.operation != kDKRenderPlanRasterizer )
+		++mDirectCount;
+	
+	mSteps[mCount++] = step;
+}
+
+
+@end
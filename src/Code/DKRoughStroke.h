@@ -10,6 +10,9 @@
 #import "DKStroke.h"
 
 
+@class DKLRUCache;
+
+
 /*!
  
  DKRoughStroke is a stroke rasterizer that randomly varies the stroke width about its nominal set width by some factor. The result is a rough stroke
@@ -17,9 +20,11 @@
  
  The nominal width, colour, etc are all inherited from DKStroke. <roughness> is the amount of randomness and is a fraction of the stroke width.
  
- Because a roughened path is both fairly complicated to compute and has a lot of randomness that is different every time, this object caches the roughened
- paths it generates and re-uses them as much as it can. A path is cached based on its bounds, width and length, giving a key that is likely to be unique in practice.
- Paths are cached up to the maximum number set by the constant, after which least used cached paths are discarded.
+ Because a roughened path is both fairly complicated to compute and has a lot of randomness that is different every time, rough paths are cached and re-used
+ as much as possible. A path is keyed by a 64-bit hash of its shape (independent of its position) combined with the roughness and the stroke attributes
+ applied to it, so the key is cheap to compute and identical shapes share one rough path. The cache is shared by all rough strokes and is limited by an
+ estimate of the memory used rather than by the number of paths - least recently used paths are discarded first. The shared cache keeps hit and miss counts
+ for tuning the budget.
  
  
  */
@@ -27,19 +32,20 @@
 {
 @private
 	CGFloat					mRoughness;
-	NSMutableDictionary*	mPathCache;
-	NSMutableArray*			mCacheList;
 }
 
++ (DKLRUCache*)				sharedPathCache;
++ (void)					setPathCacheByteBudget:(NSUInteger) bytes;
+
 @property (nonatomic) CGFloat roughness;
 
-- (NSString*)				pathKeyForPath:(NSBezierPath*) path;
+- (NSNumber*)				pathKeyForPath:(NSBezierPath*) path;
 - (void)					invalidateCache;
 - (NSBezierPath*)			roughPathFromPath:(NSBezierPath*) path;
 
 @end
 
 
-#define		kDKRoughPathCacheMaximumCapacity	99
+#define		kDKRoughPathCacheDefaultByteBudget		(4 * 1024 * 1024)
 
 
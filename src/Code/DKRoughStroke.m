@@ -9,36 +9,80 @@
 
 #import "DKRoughStroke.h"
 #import "NSBezierPath+Geometry.h"
+#import "NSBezierPath+Editing.h"
+#import "DKLRUCache.h"
 //#import "NSBezierPath+GPC.h"
 
+
+static DKLRUCache*	sRoughPathCache = nil;
+
+
 @implementation DKRoughStroke
 #pragma mark As a DKRoughStroke
-@synthesize roughness = mRoughness;
 
-- (void)					setRoughness:(CGFloat) roughness
++ (DKLRUCache*)				sharedPathCache
 {
-	if( roughness != mRoughness )
+	// the cache of rough paths shared by all instances. Its hit/miss statistics can be used to tune the budget. Rough strokes may
+	// render on several threads at once, so the cache is created under a lock.
+	
+	@synchronized([DKRoughStroke class])
 	{
-		mRoughness = roughness;
-		[self invalidateCache];
+		if( sRoughPathCache == nil )
+			sRoughPathCache = [[DKLRUCache alloc] initWithCostLimit:kDKRoughPathCacheDefaultByteBudget];
 	}
+	
+	return sRoughPathCache;
 }
 
 
-- (NSString*)				pathKeyForPath:(NSBezierPath*) path
++ (void)					setPathCacheByteBudget:(NSUInteger) bytes
 {
-	// form a simple hash from the path's size, length and current stroke width. Note that the precision is deliberately set to just 1 decimal
-	// place so that minor rounding errors when doing path transforms don't generate different keys. Do not rely on this format, or attempt
-	// to interpret it.
+	// sets the approximate memory that cached rough paths may use. Reducing it discards paths as necessary.
 	
-	return [NSString stringWithFormat:@"%.1f.%.1f.%.1f.%.1f", [path bounds].size.width, [path bounds].size.height, [path length], [self width]];
+	[[self sharedPathCache] setCostLimit:bytes];
+}
+
+
+@synthesize roughness = mRoughness;
+
+
+- (NSNumber*)				pathKeyForPath:(NSBezierPath*) path
+{
+	// the key combines the path's position-independent shape hash with everything else that affects the roughened result - the roughness and the stroke
+	// attributes applied to the path. This only walks the path's elements, unlike measuring it. Do not rely on the value, or attempt to interpret it.
+	
+	DKContentHash	h = [path shapeHash];
+	CGFloat*		dash;
+	NSInteger		i, dashCount = 0;
+	CGFloat			phase = 0;
+	
+	[path getLineDash:NULL count:&dashCount phase:NULL];
+	
+	dash = malloc( sizeof( CGFloat ) * MAX( 1, dashCount ));
+	[path getLineDash:dash count:NULL phase:&phase];
+	
+	h = DKHashFloat( h, [self roughness]);
+	h = DKHashFloat( h, [path lineWidth]);
+	h = DKHashCombine( h, [path lineCapStyle]);
+	h = DKHashCombine( h, [path lineJoinStyle]);
+	h = DKHashFloat( h, [path miterLimit]);
+	h = DKHashFloat( h, phase );
+	
+	for( i = 0; i < dashCount; ++i )
+		h = DKHashFloat( h, dash[i] );
+	
+	free( dash );
+	
+	return [NSNumber numberWithUnsignedLongLong:h];
 }
 
 
 - (void)					invalidateCache
 {
-	[mPathCache removeAllObjects];
-	[mCacheList removeAllObjects];
+	// discards all cached rough paths. Note that the cache is shared by all rough strokes, and there's normally no need to call this as changing any
+	// parameter of the stroke also changes the key used to find its cached paths.
+	
+	[[[self class] sharedPathCache] removeAllObjects];
 }
 
 
@@ -46,8 +90,9 @@
 {
 	// is this path in the cache?
 	
-	NSString*			key = [self pathKeyForPath:path];
-	NSBezierPath*		cp = [mPathCache objectForKey:key];
+	DKLRUCache*			cache = [[self class] sharedPathCache];
+	NSNumber*			key = [self pathKeyForPath:path];
+	NSBezierPath*		cp = [cache objectForKey:key];
 	NSAffineTransform*	tfm = [NSAffineTransform transform];
 	NSRect				pb = [path bounds];
 	
@@ -64,35 +109,15 @@
 			[tfm translateXBy:-pb.origin.x yBy:-pb.origin.y];
 			NSBezierPath* temp = [tfm transformBezierPath:cp];
 			
-			// cache it for future re-use
-			
-			[mPathCache setObject:temp forKey:key];
-			[mCacheList insertObject:temp atIndex:0];
-			
-			//NSLog(@"DKRoughStroke cached new path, key = %@", key );
+			// cache it for future re-use. The cost is an estimate of the memory used by the path's elements.
 			
-			// if cache list capacity exceeded, discard oldest (least frequently re-used)
-			
-			if([mCacheList count] > kDKRoughPathCacheMaximumCapacity )
-			{
-				id oldest = [mCacheList lastObject];
-				
-				NSArray* keys = [mPathCache allKeysForObject:oldest];
-				[mPathCache removeObjectsForKeys:keys];
-				[mCacheList removeObject:oldest];
-				
-				//NSLog(@"DKRoughStroke discarded cached path");
-			}
+			NSUInteger cost = [temp elementCount] * ( 3 * sizeof( NSPoint ) + sizeof( NSBezierPathElement )) + 64;
+			[cache setObject:temp forKey:key cost:cost];
 		}
 	}
 	else
 	{
-		// was cached, so move it to the head of the cache list so it is marked as recently used
-		
-		[mCacheList removeObject:cp];
-		[mCacheList insertObject:cp atIndex:0];
-		
-		// align it to the path being rendered
+		// was cached, so align it to the path being rendered
 		
 		[tfm translateXBy:pb.origin.x yBy:pb.origin.y];
 		cp = [tfm transformBezierPath:cp];
@@ -111,8 +136,6 @@
 	self = [super initWithWidth:width colour:colour];
 	if( self != nil )
 	{
-		mPathCache = [[NSMutableDictionary alloc] init];
-		mCacheList = [[NSMutableArray alloc] init];
 		[self setRoughness:0.25];
 	}
 	
@@ -143,20 +166,49 @@
 }
 
 
-- (void)					setDash:(DKStrokeDash*) dash
+#pragma mark -
+#pragma mark As a DKRasterizer
+
+- (BOOL)					isSafeForConcurrentRendering
 {
-	[super setDash:dash];
-	[self invalidateCache];
+	// roughening a path temporarily changes NSBezierPath's default flatness, which affects all threads
+	
+	return NO;
 }
 
-#pragma mark -
-#pragma mark As a NSObject
 
-- (void)					dealloc
+- (BOOL)					isExpensiveToRender
+{
+	// even when the rough path is cached, filling it is costly as it has a great many elements
+	
+	return YES;
+}
+
+
+- (BOOL)					supportsLowQualityDrawing
+{
+	// at low quality the path is stroked plainly
+	
+	return YES;
+}
+
+
+- (void)					render:(id<DKRenderable>) obj
 {
-	[mPathCache release];
-	[mCacheList release];
-	[super dealloc];
+	if([self enabled] && [obj conformsToProtocol:@protocol(DKRenderable)] && [self useLowQualityDrawingForObject:obj])
+	{
+		// stroke the path at its nominal width rather than fill the much more complex roughened outline
+		
+		NSBezierPath* pc = [[[self renderingPathForObject:obj] copy] autorelease];
+		
+		[NSGraphicsContext saveGraphicsState];
+		[[self colour] setStroke];
+		[self applyAttributesToPath:pc];
+		[pc stroke];
+		[NSGraphicsContext restoreGraphicsState];
+	}
+	else
+		[super render:obj];
 }
 
 
@@ -183,8 +235,6 @@
 - (id)						initWithCoder:(NSCoder*) coder
 {
 	if (self = [super initWithCoder:coder]) {
-	mPathCache = [[NSMutableDictionary alloc] init];
-	mCacheList = [[NSMutableArray alloc] init];
 	[self setRoughness:[coder decodeDoubleForKey:@"DKRoughStroke_roughness"]];
 	}
 	
@@ -928,6 +928,35 @@
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			isSafeForConcurrentRendering
+/// scope:			public instance method
+/// overrides:		DKDrawableObject
+/// description:	can the group be drawn on a secondary thread?
+/// 
+/// parameters:		none
+/// result:			YES if all of the visible objects in the group can be
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
+- (BOOL)				isSafeForConcurrentRendering
+{
+	NSEnumerator*		iter = [[self groupObjects] objectEnumerator];
+	DKDrawableObject*	od;
+	
+	while(( od = [iter nextObject]))
+	{
+		if([od visible] && ![od isSafeForConcurrentRendering])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			drawSelectedState
@@ -15,6 +15,14 @@
 #import "NSShadow+Scaling.h"
 #import "DKDrawableObject.h"
 #import "DKDrawing.h"
+#import "NSBezierPath+Editing.h"
+
+
+@interface DKStroke (Private)
+
+- (void)		renderPath:(NSBezierPath*) path withCachedShadow:(NSShadow*) shadow;
+
+@end
 
 
 @implementation DKStroke
@@ -301,6 +309,30 @@
 }
 
 
+- (BOOL)		isSafeForConcurrentRendering
+{
+	// a lateral offset is computed with NSBezierPath's default flatness temporarily changed, which affects all threads
+	
+	return mLateralOffset == 0.0;
+}
+
+
+- (BOOL)		isExpensiveToRender
+{
+	// blurred shadows are slow to draw, so a shadowed stroke is worth caching
+	
+	return [self shadow] != nil && [DKStyle willDrawShadows];
+}
+
+
+- (BOOL)		supportsLowQualityDrawing
+{
+	// at low quality the shadow is approximated
+	
+	return [self shadow] != nil && [DKStyle willDrawShadows];
+}
+
+
 
 
 #pragma mark -
@@ -309,7 +341,7 @@
 {
 	return [[super observableKeyPaths] arrayByAddingObjectsFromArray:[NSArray arrayWithObjects:@"colour", @"width", @"dash",
 																					@"shadow", @"lineCapStyle", @"lineJoinStyle",
-																					@"lateralOffset", @"trimLength", nil]];
+																					@"lateralOffset", @"trimLength", @"miterLimit", nil]];
 }
 
 
@@ -324,6 +356,7 @@
 	[self setActionName:@"#kind# Line Join Style" forKeyPath:@"lineJoinStyle"];
 	[self setActionName:@"#kind# Stroke Offset" forKeyPath:@"lateralOffset"];
 	[self setActionName:@"#kind# Trim Length" forKeyPath:@"trimLength"];
+	[self setActionName:@"#kind# Mitre Limit" forKeyPath:@"miterLimit"];
 }
 
 
@@ -358,26 +391,66 @@
 	if( ![obj conformsToProtocol:@protocol(DKRenderable)] || ![self enabled])
 		return;
 
-	BOOL lowQuality = [obj useLowQualityDrawing];
+	BOOL lowQuality = [self useLowQualityDrawingForObject:obj];
 		
 	SAVE_GRAPHICS_CONTEXT		//[NSGraphicsContext saveGraphicsState];
-		
+	
+	// the shadow can be drawn from the shadow cache once the stroked path is known, which needs it passed through to the stroking code.
+	// Subclasses that stroke in their own way get the shadow set as usual.
+	
+	BOOL cachedShadow = NO;
+	
 	if([self shadow] != nil && [DKStyle willDrawShadows])
 	{
-		if ( !lowQuality)
-			[[self shadow] setAbsolute];
-		else
+		if ( lowQuality )
 			[[self shadow] drawApproximateShadowWithPath:[obj renderingPath] operation:kDKShadowDrawStroke strokeWidth:[self width]];
+		else if([NSShadow shadowCachingEnabled] && [self methodForSelector:@selector(renderPath:)] == [DKStroke instanceMethodForSelector:@selector(renderPath:)])
+			cachedShadow = YES;
+		else
+			[[self shadow] setAbsolute];
 	}
 	
+	if( cachedShadow )
+	{
+		// as DKRasterizer's -render:
 		
-	[super render:obj];
+		NSBezierPath* path = [self renderingPathForObject:obj];
+		
+		switch([self clipping])
+		{
+			default:
+			case kDKClippingNone:
+				break;
+				
+			case kDKClipInsidePath:
+				[path addClip];
+				break;
+				
+			case kDKClipOutsidePath:
+				[path addInverseClip];
+				break;
+		}
+		
+		[self renderPath:path withCachedShadow:[self shadow]];
+	}
+	else
+		[super render:obj];
+	
 	RESTORE_GRAPHICS_CONTEXT	//[NSGraphicsContext restoreGraphicsState];
 }
 
 
 - (void)		renderPath:(NSBezierPath*) path
 {
+	[self renderPath:path withCachedShadow:nil];
+}
+
+
+#pragma mark -
+#pragma mark As a DKStroke (Private)
+- (void)		renderPath:(NSBezierPath*) path withCachedShadow:(NSShadow*) shadow
+{
+	// strokes the path, first drawing <shadow> from the shadow cache if given. If the shadow can't be cached it is set instead.
 	// copy path as we are about to change many of its properties
 	
 	NSBezierPath* pc;
@@ -400,6 +473,14 @@
 	[[self colour] setStroke];
 	[self applyAttributesToPath:pc];
 	
+	if( shadow )
+	{
+		NSColor* rgb = [[self colour] colorUsingColorSpaceName:NSDeviceRGBColorSpace];
+		
+		if( rgb == nil || ![shadow drawCachedShadowWithPath:pc operation:kDKShadowDrawStroke opacity:[rgb alphaComponent]])
+			[shadow setAbsolute];
+	}
+	
 	[pc stroke];
 }
 
@@ -8,12 +8,13 @@
 //
 
 #import <Cocoa/Cocoa.h>
+#import "DKContentHash.h"
 
 
 /*!
  This stores a particular dash pattern for stroking an NSBezierPath, and can be owned by a DKStroke.
  */
-@interface DKStrokeDash : NSObject <NSCoding, NSCopying>
+@interface DKStrokeDash : NSObject <NSCoding, NSCopying, DKContentHashing>
 {
 @private
 	CGFloat		m_pattern[8];
@@ -419,6 +419,21 @@ static NSUInteger euclid_hcf( NSUInteger a, NSUInteger b )
 }
 
 
+#pragma mark -
+#pragma mark As part of DKContentHashing Protocol
+- (DKContentHash)	contentHash
+{
+	DKContentHash	h = DKHashCombine( kDKContentHashSeed, m_count );
+	NSUInteger		i;
+	
+	for( i = 0; i < m_count; ++i )
+		h = DKHashFloat( h, m_pattern[i]);
+	
+	h = DKHashFloat( h, m_phase );
+	return DKHashCombine( h, m_scaleToLineWidth );
+}
+
+
 #pragma mark -
 #pragma mark As part of NSCopying Protocol
 - (id)			copyWithZone:(NSZone*) zone
@@ -12,7 +12,7 @@
 #import "DKRastGroup.h"
 
 
-@class	DKDrawableObject, DKUndoManager;
+@class	DKDrawableObject, DKUndoManager, DKRenderPlan;
 
 //! swatch types that can be passed to -styleSwatchWithSize:type:
 typedef NS_ENUM(NSInteger, DKStyleSwatchType)
@@ -52,6 +52,9 @@ typedef NS_ENUM(NSInteger, DKDerivedStyleOptions)
 	NSTimeInterval			m_lastModTime;			//!< timestamp to determine when styles have been updated
 	NSUInteger				m_clientCount;			//!< keeps count of the clients using the style
 	NSMutableDictionary*	mSwatchCache;			//!< cache of swatches at various sizes previously requested
+	DKContentHash			mContentHash;			//!< cached structural hash of the renderers and text attributes
+	BOOL					mContentHashValid;		//!< YES if mContentHash is up to date
+	DKRenderPlan*			mRenderPlan;			//!< flattened form of the render list, built when first drawn
 }
 
 // basic standard styles:
@@ -121,6 +124,7 @@ typedef NS_ENUM(NSInteger, DKDerivedStyleOptions)
 @property (readonly) NSTimeInterval lastModificationTimestamp;
 
 - (BOOL)				isEqualToStyle:(DKStyle*) aStyle;
+- (DKContentHash)		contentHash;
 
 // undo:
 
@@ -161,6 +165,11 @@ typedef NS_ENUM(NSInteger, DKDerivedStyleOptions)
 
 - (id)					currentRenderClient;
 
+// compiled form of the render list, used for drawing:
+
+- (DKRenderPlan*)		renderPlan;
+- (void)				invalidateRenderPlan;
+
 // making derivative styles:
 
 - (DKStyle*)			styleByMergingFromStyle:(DKStyle*) otherStyle;
@@ -26,6 +26,7 @@
 #import "DKDrawableShape.h"
 #import "DKGeometryUtilities.h"
 #import "NSImage+DKAdditions.h"
+#import "DKRenderPlan.h"
 
 
 #pragma mark Contants (Non-localized)
@@ -572,6 +573,8 @@ static BOOL					sSubstitute = NO;
 	// invalidate any swatch cache to ensure cache is forced to be rebuilt after a change
 	
 	[mSwatchCache removeAllObjects];
+	mContentHashValid = NO;
+	[self invalidateRenderPlan];
 	
 	[[NSNotificationCenter defaultCenter] postNotificationName:kDKStyleDidChangeNotification object:self];
 }
@@ -984,21 +987,54 @@ static BOOL					sSubstitute = NO;
 /// parameters:		<aStyle> a style to compare this with
 /// result:			YES if the styles ar the same, NO otherwise
 ///
-/// notes:			Styles are considered equal if they have the same unique ID and the same timestamp.
+/// notes:			Styles are considered equal if they have the same unique ID and the same content, as determined
+///					by the content hash. The timestamp is not used, as it can't tell apart two copies of a style that were
+///					edited at the same moment, and differs between copies that have been edited back to the same state.
 ///
 ///********************************************************************************************************************
 
 - (BOOL)				isEqualToStyle:(DKStyle*) aStyle
 {
+	if( aStyle == self )
+		return YES;
+	
 	BOOL same = NO;
 	
 	if([[self uniqueKey] isEqualToString:[aStyle uniqueKey]])
-		same = ([self lastModificationTimestamp] == [aStyle lastModificationTimestamp]);
+		same = ([self contentHash] == [aStyle contentHash]);
 
 	return same;
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			contentHash
+/// scope:			public method
+/// overrides:		DKRastGroup
+/// description:	returns a structural hash of the style
+/// 
+/// parameters:		none
+/// result:			a hash value
+///
+/// notes:			covers the complete renderer tree and the text attributes, but not the name or unique key, so two
+///					styles that would draw identically have the same hash. This is the preferred key for caches of
+///					rendered output. It is cached, and recalculated only after the style changes. Do not persist it.
+///
+///********************************************************************************************************************
+
+- (DKContentHash)		contentHash
+{
+	if( !mContentHashValid )
+	{
+		mContentHash = DKHashObject([super contentHash], [self textAttributes]);
+		mContentHashValid = YES;
+	}
+	
+	return mContentHash;
+}
+
+
 #pragma mark -
 #pragma mark - undo
 
@@ -1091,8 +1127,12 @@ static BOOL					sSubstitute = NO;
 		while(( stroke = [iter nextObject]))
 			[stroke scaleWidthBy:scale];
 		
+		// the render plan holds the stroke widths, so it must be rebuilt even when the change is made quietly
+		
 		if ( ! quiet)
 			[self notifyClientsAfterChange];
+		else
+			[self invalidateRenderPlan];
 	}
 }
 
@@ -1806,16 +1846,68 @@ static BOOL					sSubstitute = NO;
 /// result:			the current rendering object
 ///
 /// notes:			this is only valid when called while rendering is in progress - mainly for the benefit of renderers
-///					that are part of this style
+///					that are part of this style. A style shared by several objects may be rendering on more than one
+///					thread at once, so the client is recorded per thread for any thread other than the main one.
 ///
 ///********************************************************************************************************************
 
 - (id)					currentRenderClient
 {
+	if(![NSThread isMainThread])
+		return [[[[NSThread currentThread] threadDictionary] objectForKey:[NSValue valueWithNonretainedObject:self]] nonretainedObjectValue];
+	
 	return m_renderClientRef;
 }
 
 
+#pragma mark -
+#pragma mark - render plan
+///*********************************************************************************************************************
+///
+/// method:			renderPlan
+/// scope:			public method
+/// overrides:		
+/// description:	returns the flattened form of the style that is used to draw it
+/// 
+/// parameters:		none
+/// result:			a render plan, or nil
+///
+/// notes:			the plan is compiled the first time it's needed after the style changes, on the main thread only.
+///					Secondary threads get nil if there isn't one yet and draw the render list directly instead.
+///
+///********************************************************************************************************************
+
+- (DKRenderPlan*)		renderPlan
+{
+	if( mRenderPlan == nil && [NSThread isMainThread])
+		mRenderPlan = [[DKRenderPlan alloc] initWithGroup:self];
+	
+	return mRenderPlan;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			invalidateRenderPlan
+/// scope:			public method
+/// overrides:		
+/// description:	discards the style's render plan so that it is recompiled when next drawn
+/// 
+/// parameters:		none
+/// result:			none
+///
+/// notes:			called whenever the style changes. Only needs to be called directly if a contained renderer is
+///					changed in a way that doesn't notify the style.
+///
+///********************************************************************************************************************
+
+- (void)				invalidateRenderPlan
+{
+	[mRenderPlan release];
+	mRenderPlan = nil;
+}
+
+
 ///*********************************************************************************************************************
 ///
 /// method:			styleByMergingFromStyle:
@@ -2081,7 +2173,8 @@ static BOOL					sSubstitute = NO;
 ///
 /// description:	renders the object using this style
 ///
-/// notes:			sets the value of the client for the duration of rendering
+/// notes:			sets the value of the client for the duration of rendering. Draws using the style's render plan
+///					rather than walking the render list.
 ///
 ///********************************************************************************************************************
 
@@ -2100,11 +2193,26 @@ static BOOL					sSubstitute = NO;
 			[[NSGraphicsContext currentContext] setImageInterpolation:NSImageInterpolationNone];
 		}
 		
-		m_renderClientRef = object;
+		NSMutableDictionary*	threadDict = nil;
+		NSValue*				clientKey = nil;
+		
+		if([NSThread isMainThread])
+			m_renderClientRef = object;
+		else
+		{
+			threadDict = [[NSThread currentThread] threadDictionary];
+			clientKey = [NSValue valueWithNonretainedObject:self];
+			[threadDict setObject:[NSValue valueWithNonretainedObject:object] forKey:clientKey];
+		}
 		
 		@try
 		{
-			[super render:object];
+			DKRenderPlan* plan = [self renderPlan];
+			
+			if( plan )
+				[plan render:object];
+			else
+				[super render:object];
 		}
 		@catch( NSException* exception )
 		{
@@ -2115,7 +2223,10 @@ static BOOL					sSubstitute = NO;
 			
 			NSLog(@"An exception occurred while rendering the style - PLEASE FIX - %@. Exception = %@", self, exception);
 		}
-		m_renderClientRef = nil;
+		if( clientKey )
+			[threadDict removeObjectForKey:clientKey];
+		else
+			m_renderClientRef = nil;
 		
 		[pool drain];
 	}
@@ -2205,6 +2316,7 @@ static BOOL					sSubstitute = NO;
 	[mSwatchCache release];
 	[m_textAttributes release];
 	[m_uniqueKey release];
+	[mRenderPlan release];
 	
 	[super dealloc];
 }
@@ -2241,7 +2353,7 @@ static BOOL					sSubstitute = NO;
 	return [NSString stringWithFormat:@"%@ <%p> '%@' [%@]", NSStringFromClass([self class]), self, [self name], [self uniqueKey]];
 }
 
-// n.b. isEqual: defines equality more loosely than isEqualToStyle: which also considers the timestamp
+// n.b. isEqual: defines equality more loosely than isEqualToStyle:, which also compares the content hash
 
 - (BOOL)				isEqual:(id) anObject
 {
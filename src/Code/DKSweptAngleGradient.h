@@ -9,11 +9,15 @@
 ///**********************************************************************************************************************************
 
 #import "DKGradient.h"
+#import "DKContentHash.h"
+
+
+@class DKLRUCache;
 
 
 typedef union
 {
-	unsigned long pixel;
+	uint32_t pixel;
 	struct
 	{
 		unsigned char a;
@@ -30,23 +34,44 @@ pix_int;
 @interface DKSweptAngleGradient : DKGradient
 {
 	CGImageRef		m_sa_image;
-	CGContextRef	m_sa_bitmap;
 	pix_int*		m_sa_colours;
 	NSInteger				m_sa_segments;
-	NSPoint			m_sa_centre;
 	CGFloat			m_sa_startAngle;
 	NSInteger				m_sa_img_width;
+	DKContentHash	m_sa_coloursHash;
+	BOOL			m_sa_coloursValid;
 	BOOL			m_ditherColours;
 }
 
 + (DKGradient*)		sweptAngleGradient;
 + (DKGradient*)		sweptAngleGradientWithStartingColor:(NSColor*) c1 endingColor:(NSColor*) c2;
 
++ (DKLRUCache*)		sharedImageCache;
++ (void)			setImageCacheByteBudget:(NSUInteger) bytes;
+
 - (void)			setNumberOfAngularSegments:(NSInteger) ns;
 - (NSInteger)				numberOfAngularSegments;
+- (void)			setDitherColours:(BOOL) dither;
+- (BOOL)			ditherColours;
 
 - (void)			preloadColours;
 - (void)			createGradientImageWithRect:(NSRect) rect;
 - (void)			invalidateCache;
 
 @end
+
+#define		kDKSweptAngleGradientCacheDefaultByteBudget		(16 * 1024 * 1024)
+#define		kDKSweptAngleGradientMinimumImageSize			32
+#define		kDKSweptAngleGradientMaximumImageSize			2048
+
+
+/*
+
+The swept angle gradient is drawn from a square image with the apex of the cone at its centre. Since the colour at any point only depends on
+its angle about the apex, one image serves any size of fill by being scaled to cover it - the image is only rebuilt when the fill's size on
+screen crosses into another power-of-two bucket, or the colours change, so resizing a conical fill interactively doesn't stutter.
+
+Images are held in a cache shared by all swept angle gradients, keyed by the colour table, the image size and dithering, so objects whose
+gradients have the same colours share the same image. The colour table is sampled from the gradient's lookup table.
+
+*/
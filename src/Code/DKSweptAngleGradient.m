@@ -11,13 +11,14 @@
 #import "DKSweptAngleGradient.h"
 
 #import "DKGeometryUtilities.h"
-#import "DKRandom.h"
+#import "DKLRUCache.h"
 #import "LogEvent.h"
 
 
-@interface DKGradient (Private)
-- (void)			private_colorAtValue:(CGFloat) val components:(CGFloat*) components randomAccess:(BOOL) ra;
-@end
+static DKLRUCache*	sImageCache = nil;
+
+
+static inline float		fastAtan2( float y, float x );
 
 
 #pragma mark -
@@ -41,11 +42,32 @@
 }
 
 
++ (DKLRUCache*)		sharedImageCache
+{
+	// the cache of gradient images shared by all swept angle gradients
+	
+	if( sImageCache == nil )
+		sImageCache = [[DKLRUCache alloc] initWithCostLimit:kDKSweptAngleGradientCacheDefaultByteBudget];
+	
+	return sImageCache;
+}
+
+
++ (void)			setImageCacheByteBudget:(NSUInteger) bytes
+{
+	[[self sharedImageCache] setCostLimit:bytes];
+}
+
+
 #pragma mark -
 
 - (void)			setNumberOfAngularSegments:(NSInteger) ns
 {
-	m_sa_segments = ns;
+	if( ns != m_sa_segments )
+	{
+		m_sa_segments = ns;
+		m_sa_coloursValid = NO;
+	}
 }
 
 
@@ -55,11 +77,29 @@
 }
 
 
+- (void)			setDitherColours:(BOOL) dither
+{
+	if( dither != m_ditherColours )
+	{
+		m_ditherColours = dither;
+		[self invalidateCache];
+	}
+}
+
+
+- (BOOL)			ditherColours
+{
+	return m_ditherColours;
+}
+
+
 
 - (void)			preloadColours
 {
 	// creates a cache of colours representing the complete gradient preformatted in the pixel format of the image. This cache
 	// is then used to look up the colour value for a pixel when building the image much faster than computing it directly.
+	// The colours are sampled from the gradient's lookup table, and hashed so that the image can be shared with other
+	// gradients having the same colours.
 	
 	NSInteger i;
 	
@@ -67,17 +107,23 @@
 		free( m_sa_colours );
 		
 	m_sa_colours = malloc( sizeof(pix_int) * m_sa_segments );
+	m_sa_coloursValid = NO;
 	
 	if ( m_sa_colours )
 	{
-		CGFloat	components[4];
-		CGFloat	v;
+		const float*	table = [self lookupTable];
+		CGFloat			components[4];
+		CGFloat			v, p;
+		NSInteger		j, indx;
 		
 		for( i = 0; i < m_sa_segments; ++i )
 		{
-			v = (CGFloat) i / (CGFloat)(m_sa_segments - 1);
+			v = (CGFloat) i * ( kDKGradientLookupTableSize - 1 ) / (CGFloat)(m_sa_segments - 1);
+			indx = MIN((NSInteger) v, kDKGradientLookupTableSize - 2 );
+			p = v - indx;
 			
-			[self private_colorAtValue:v components:components randomAccess:NO];
+			for( j = 0; j < 4; ++j )
+				components[j] = ( table[( indx + 1 ) * 4 + j] - table[indx * 4 + j]) * p + table[indx * 4 + j];
 		
 			m_sa_colours[i].c.a = components[3] * 255;
 
@@ -87,65 +133,100 @@
 			m_sa_colours[i].c.g = components[1] * components[3] * 255;
 			m_sa_colours[i].c.b = components[2] * components[3] * 255;
 		}
+		
+		m_sa_coloursHash = DKHashBytes( DKHashCombine( kDKContentHashSeed, m_sa_segments ), m_sa_colours, sizeof(pix_int) * m_sa_segments );
+		m_sa_coloursValid = YES;
 	}
 }
 
 
 - (void)			createGradientImageWithRect:(NSRect) rect
 {
+	// sets m_sa_image to a square image large enough to cover <rect> (in device pixels) at one pixel per pixel, rounded up to
+	// the next power of two. The image is fetched from the shared cache if another gradient with the same colours already made it.
+	
+	NSInteger size = kDKSweptAngleGradientMinimumImageSize;
+	
+	while( size < MAX( rect.size.width, rect.size.height ) && size < kDKSweptAngleGradientMaximumImageSize )
+		size *= 2;
+	
+	if ( m_sa_image != NULL && size == m_sa_img_width )
+		return;
+	
+	[self invalidateCache];
+	
+	DKContentHash	h = DKHashCombine( DKHashCombine( m_sa_coloursHash, size ), m_ditherColours );
+	NSNumber*		key = [NSNumber numberWithUnsignedLongLong:h];
+	DKLRUCache*		cache = [[self class] sharedImageCache];
+	CGImageRef		image = (CGImageRef)[cache objectForKey:key];
+	
+	if ( image )
+	{
+		m_sa_image = CGImageRetain( image );
+		m_sa_img_width = size;
+		return;
+	}
+	
 	CGColorSpaceRef		cSpace = CGColorSpaceCreateWithName( kCGColorSpaceGenericRGB );
 	NSUInteger			width, height;
 	
 	// directly create a bitmap context of the desired size then convert it to an image - this is much easier than messing about with data
 	// providers, etc
 	
-	width = MAX( 1, (NSInteger)( rect.size.width * 1.5f));
-	height = MAX( 1, (NSInteger)( rect.size.height * 1.5f ));
+	width = height = size;
 	
-	NSUInteger		bufferSize = 4 * width * ( height + 1 );
+	NSUInteger		bufferSize = 4 * width * height;
 	unsigned char*	buffer;
 	
 	buffer = (unsigned char*) malloc( bufferSize );
 	
 	if ( buffer )
 	{
-		m_sa_bitmap = CGBitmapContextCreate( buffer, width, height, 8, 4 * width, cSpace, kCGImageAlphaPremultipliedFirst );
-		
-		LogEvent_(kInfoEvent, @"bitmap = %@", m_sa_bitmap );
+		CGContextRef bitmap = CGBitmapContextCreate( buffer, width, height, 8, 4 * width, cSpace, kCGImageAlphaPremultipliedFirst );
 		
-		// scan through the buffer and set all the pixels
-		
-		NSPoint		cp = m_sa_centre;
-		
-		cp.x -= rect.origin.x;
-		cp.y -= rect.origin.y;
+		// scan through the buffer and set all the pixels. The angle of each pixel about the centre is computed a row at a time
+		// in a tight loop free of branches and calls so that it vectorizes, then the colours are looked up and dithered in a
+		// second pass over the row.
 		
 		pix_int*	colours = m_sa_colours;
-		NSUInteger	nColours = m_sa_segments;
-		CGFloat		angle, twopi;
-		NSUInteger	x,	y, colour;
-		
-		// offset cp to account for 50% extra size of the image
+		NSInteger	nColours = m_sa_segments;
+		float		centre = (float) size * 0.5f;
+		float		scale = (float) nColours / (float)( 2.0 * M_PI );
+		float*		row = malloc( sizeof(float) * width );
+		uint32_t	seed = 0x9E3779B9;	// fixed, so the same image is made every time
+		NSUInteger	x, y;
+		NSInteger	colour;
+		float		dy;
 		
-		cp.x *= 1.5;
-		cp.y *= 1.5;
-		twopi = 2 * M_PI;
+		uint32_t* p = (uint32_t*) buffer;
 		
-		unsigned long* p = (unsigned long*) buffer;
-		
-		for( y = 0; y < height; ++y )
+		for( y = 0; y < height && row != NULL; ++y )
 		{
+			dy = (float) y + 0.5f - centre;
+			
+			// need to know angle of x,y relative to centre point which gives us an index into the colour table
+			
+			for( x = 0; x < width; ++x )
+				row[x] = ( fastAtan2( dy, (float) x + 0.5f - centre ) + (float) M_PI ) * scale;
+			
 			for( x = 0; x < width; ++x )
 			{
-				// need to know angle of x,y relative to centre point which gives us an index into the colour table
-				
-				angle = atan2((CGFloat) y - cp.y, (CGFloat) x - cp.x ) + M_PI;
-				colour = (NSUInteger)(( angle * (CGFloat) nColours ) / twopi );
-				
-				// add a bit of random dither to the colour
+				// add a bit of random dither to the colour. The table wraps around, since the gradient is circular
 				
 				if ( m_ditherColours )
-					colour = (NSInteger)( colour + [DKRandom randomPositiveOrNegativeNumber] * 2.0 ) % nColours;
+				{
+					seed ^= seed << 13;
+					seed ^= seed >> 17;
+					seed ^= seed << 5;
+					colour = (NSInteger) floorf( row[x] + (float)( seed & 0xFFFF ) / 32768.0f - 1.0f );
+				}
+				else
+					colour = (NSInteger) row[x];
+				
+				if ( colour < 0 )
+					colour += nColours;
+				else if ( colour >= nColours )
+					colour -= nColours;
 					
 				// write the colour to the image in one fell swoop
 				
@@ -153,9 +234,19 @@
 			}
 		}
 		
+		free( row );
+		
 		// convert to an image.
 		
-		m_sa_image = CGBitmapContextCreateImage( m_sa_bitmap );
+		m_sa_image = CGBitmapContextCreateImage( bitmap );
+		m_sa_img_width = size;
+		CGContextRelease( bitmap );
+		free( buffer );
+		
+		LogEvent_(kInfoEvent, @"swept angle gradient image created, size = %ld", (long) size );
+		
+		if ( m_sa_image )
+			[cache setObject:(id) m_sa_image forKey:key cost:bufferSize];
 	}
 	
 	CGColorSpaceRelease( cSpace );
@@ -164,16 +255,13 @@
 
 - (void)			invalidateCache
 {
-	unsigned char*	buffer;
+	// discards this gradient's reference to its image - the shared cache may still hold it for other gradients
 
 	if ( m_sa_image )
 	{
 		CGImageRelease( m_sa_image );
 		m_sa_image = NULL;
-		buffer = CGBitmapContextGetData( m_sa_bitmap );
-		free( buffer );
-		CGContextRelease( m_sa_bitmap );
-		m_sa_bitmap = NULL;
+		m_sa_img_width = 0;
 	}
 }
 
@@ -186,57 +274,69 @@
 	#pragma unused(ep)
 	#pragma unused(er)
 	
+	if([path isEmpty])
+		return;
+	
 	NSInteger		segments = [self numberOfAngularSegments];
 	NSRect	rect = [path bounds];
 	CGFloat	sa = [self angle];
-	BOOL	inval = NO;
 	
 	if ( segments == 0 )
 		segments = 512;
-		
-	if ( segments != m_sa_segments )
-	{
-		m_sa_segments = MAX( segments, 2 );
-		inval = YES;
-	}
-
-	if ( m_sa_image != NULL && (rect.size.width > CGImageGetWidth( m_sa_image ) || rect.size.height > CGImageGetHeight( m_sa_image )))
-		inval = YES;
-		
-	if( m_sa_image == NULL )
-		inval = YES;
 	
-	if ( inval )
-	{
-		m_sa_centre = p;
-		[self invalidateCache];
-		[self preloadColours];
-		[self createGradientImageWithRect:rect];
-	}
-	
-	// centre the image rect on <rect>, rotated to <sa>
+	// the apex of the cone, relative to the centre of <rect> in the rotated space that the image is drawn in, and the radius
+	// the image must have to cover the whole of <rect> from there
 	
 	NSPoint rcp = NSMakePoint( NSMidX( rect ), NSMidY( rect ));
-	NSRect imgRect = NSMakeRect( 0, 0, CGImageGetWidth( m_sa_image ), CGImageGetHeight( m_sa_image ));
-	
-	rect.origin.x = -rect.size.width / 2;
-	rect.origin.y = -rect.size.height / 2;
-	
-	NSRect ir = CentreRectInRect( imgRect, rect );
+	NSPoint apex = NSMakePoint(( p.x - rcp.x ) * 1.5, ( p.y - rcp.y ) * 1.5 );
+	CGFloat	radius = hypot( rect.size.width, rect.size.height ) * 0.5 + hypot( apex.x, apex.y );
 	
 	SAVE_GRAPHICS_CONTEXT		//[NSGraphicsContext saveGraphicsState];
 	[path addClip];
 
-	CGContextRef context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGContextRef		context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGAffineTransform	ctm = CGContextGetCTM( context );
+	CGFloat				pixels = 2.0 * radius * sqrt( fabs( ctm.a * ctm.d - ctm.b * ctm.c ));
+	CGImageRef			image;
 	
-	CGContextTranslateCTM( context, rcp.x, rcp.y );
-	CGContextRotateCTM( context, sa );
+	// the image is shared state, so guard against the same gradient being drawn on several threads at once
 	
-	CGContextDrawImage( context, *(CGRect*)&ir, m_sa_image );
+	@synchronized( self )
+	{
+		if ( segments != m_sa_segments )
+			[self setNumberOfAngularSegments:MAX( segments, 2 )];
+		
+		if ( !m_sa_coloursValid )
+		{
+			[self invalidateCache];
+			[self preloadColours];
+		}
+		
+		[self createGradientImageWithRect:NSMakeRect( 0, 0, pixels, pixels )];
+		image = CGImageRetain( m_sa_image );
+	}
+	
+	if ( image )
+	{
+		CGContextTranslateCTM( context, rcp.x, rcp.y );
+		CGContextRotateCTM( context, sa );
+		CGContextSetInterpolationQuality( context, kCGInterpolationLow );
+		CGContextDrawImage( context, CGRectMake( apex.x - radius, apex.y - radius, radius * 2.0, radius * 2.0 ), image );
+		CGImageRelease( image );
+	}
 	RESTORE_GRAPHICS_CONTEXT	//[NSGraphicsContext restoreGraphicsState];
 }
 
 
+- (void)			invalidateLookupTable
+{
+	// the colour table is derived from the lookup table, so must be rebuilt too
+	
+	[super invalidateLookupTable];
+	m_sa_coloursValid = NO;
+}
+
+
 #pragma mark -
 #pragma mark As an NSObject
 - (id)				init
@@ -245,10 +345,8 @@
 	if (self != nil)
 	{
 		NSAssert(m_sa_image == nil, @"Expected init to zero");
-		NSAssert(m_sa_bitmap == nil, @"Expected init to zero");
 		NSAssert(m_sa_colours == nil, @"Expected init to zero");
 		NSAssert(m_sa_segments == 0, @"Expected init to zero");
-		NSAssert(NSEqualPoints(m_sa_centre, NSZeroPoint), @"Expected init to zero");
 		NSAssert(m_sa_startAngle == 0, @"Expected init to zero");
 		NSAssert(m_sa_img_width == 0, @"Expected init to zero");
 		NSAssert(!m_ditherColours, @"Expected init to NO");
@@ -262,9 +360,31 @@
 - (void)			dealloc
 {
 	[self invalidateCache];
+	
+	if ( m_sa_colours )
+		free( m_sa_colours );
+	
 	[super dealloc];
 }
 
 
 @end
 
+
+#pragma mark -
+static inline float		fastAtan2( float y, float x )
+{
+	// polynomial approximation of atan2, accurate to about 2e-4 radians - a small fraction of a segment of the gradient. Written with
+	// selects rather than branches so that loops calling it can be vectorized by the compiler.
+	
+	float ax = fabsf( x );
+	float ay = fabsf( y );
+	float mx = fmaxf( ax, ay );
+	float a = fminf( ax, ay ) / ( mx > 0.0f? mx : 1.0f );
+	float s = a * a;
+	float r = ((( -0.0464964749f * s + 0.15931422f ) * s - 0.327622764f ) * s * a ) + a;
+	
+	r = ( ay > ax )? 1.57079637f - r : r;
+	r = ( x < 0.0f )? 3.14159274f - r : r;
+	return ( y < 0.0f )? -r : r;
+}
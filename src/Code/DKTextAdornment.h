@@ -12,7 +12,7 @@
 #import "DKCommonTypes.h"
 
 
-@class DKStyle, DKTextSubstitutor;
+@class DKStyle, DKTextSubstitutor, DKLRUCache;
 
 
 
@@ -38,6 +38,7 @@
 	NSColor*					mTextKnockoutColour;		// colour for text knockout, default = white
 	NSColor*					mTextKnockoutStrokeColour;	// colour for stroking the text knockout, default = black
 	NSMutableDictionary*		mTACache;					// private cache used for various text layout caching
+	DKLRUCache*					mLayoutCache;				// substituted and laid out text for each object drawn, created lazily
 	NSDictionary*				mDefaultAttributes;			// saves default attributes for when text is deleted altogether
 }
 
@@ -217,6 +218,7 @@
 
 
 #define DEFAULT_BASELINE_OFFSET_MAX		16
+#define kDKTextAdornmentLayoutCacheCostLimit	( 4 * 1024 * 1024 )		// approximate bytes of laid out text kept per adornment
 
 // these keys are used to access text adornment properties in the -textAttributes dictionary. Using this dictionary allows these settings to
 // be more portable especially when cuttign and pasting styles between objects. These are placed alongside any Cocoa attributes defined in the
@@ -258,6 +260,16 @@ this mode such as angle and vertical alignment. However all textual attributes a
  similar lengthy recalculations. The caching is transparent to client objects but may need to be taken into account if subclassing or
  using alternative helper objects, etc.
  
+ Separately, the text drawn for each object - the substituted string and its layout - is kept in a layout cache, so that an adornment shared
+ by many objects through a style doesn't perform substitution and layout for every object on every render. Each object's text is
+ substituted again only when its metadata or ghosted state changes, and laid out again only when the space it's laid out in changes. Changes
+ to the adornment's own text or settings empty the layout cache.
+ 
+ When drawing to the screen, text whose first font would be smaller than the drawing's text greeking threshold in device pixels is greeked
+ automatically - lines are drawn as grey bars taken from the cached layout, and text on a path as glyph rectangles - and text smaller than the
+ hiding threshold isn't drawn at all. Knockouts are skipped for greeked text. Printing, PDF output and hit-testing always draw the real text,
+ as does an adornment whose greeking is set explicitly. See -[DKDrawing setTextGreekingThreshold:].
+ 
  The text content is stored and suplied by DKTextSubstitutor which is able to build strings by reading an object's metadata and combining it with
  other fixed content. See that class for details.
 
@@ -27,13 +27,53 @@
 #import "DKStroke.h"
 #import "DKTextSubstitutor.h"
 #import "DKGreekingLayoutManager.h"
+#import "DKLRUCache.h"
+#import "NSBezierPath+Editing.h"
+#import "DKDrawing.h"
 
 
+// the text drawn for one object, and its layout once it has been laid out
+
+@interface DKTextLayoutCacheEntry : NSObject
+{
+@public
+	DKContentHash		mTextKey;			// the object's metadata, geometry and ghosting that the text was substituted for
+	NSTextStorage*		mText;				// the text to draw
+	DKContentHash		mLayoutKey;			// the space and settings the text was laid out for
+	NSLayoutManager*	mLayoutManager;		// the layout, nil until laid out (owned by mText)
+	NSRange				mGlyphRange;		// the glyphs that fitted
+	NSRect				mUsedRect;			// the area used by the text
+	NSSize				mLayoutSize;		// the size of the space the text was laid out in
+	BOOL				mFittedAllText;		// YES if all of the text fitted
+}
+
+@end
+
+
+@implementation DKTextLayoutCacheEntry
+
+- (void)					dealloc
+{
+	// the text storage owns the layout manager
+	
+	[mText release];
+	[super dealloc];
+}
+
+@end
+
+
+#pragma mark -
 
 @interface DKTextAdornment (Private)
 
-- (void)					drawText:(NSTextStorage*) contents withObject:(id<DKRenderable>) obj withPath:(NSBezierPath*) path;
+- (DKTextLayoutCacheEntry*)	layoutCacheEntryForObject:(id<DKRenderable>) obj;
+- (BOOL)					substitutesPropertyKeys;
+- (DKTextLayoutCacheEntry*)	layoutForObject:(id<DKRenderable>) obj withPath:(NSBezierPath*) path;
+- (void)					drawTextLayout:(DKTextLayoutCacheEntry*) layout greeked:(BOOL) greek;
 - (void)					drawText:(NSTextStorage*) contents withObject:(id<DKRenderable>) obj withPath:(NSBezierPath*) path layoutManager:(NSLayoutManager*) lm;
+- (NSLayoutManager*)		newLayoutManagerWithGreeking:(DKGreeking) greeking;
+- (CGFloat)					projectedFontSizeOfText:(NSAttributedString*) str;
 - (void)					drawText:(NSTextStorage*) contents centredAtPoint:(NSPoint) p;
 - (NSAffineTransform*)		textTransformForObject:(id<DKRenderable>) obj;
 - (void)					drawKnockoutWithObject:(id<DKRenderable>) obj;
@@ -186,6 +226,7 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 	[str retain];
 	[mPlaceholder release];
 	mPlaceholder = str;
+	[self invalidateCache];
 }
 
 
@@ -1043,6 +1084,10 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 		
 		if( mSubstitutor )
 			[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(masterStringChanged:) name:kDKTextSubstitutorNewStringNotification object:mSubstitutor];
+		
+		// the cached text was substituted from the old substitutor
+		
+		[self invalidateCache];
 	}
 }
 
@@ -1064,6 +1109,7 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 	// empties the cache, causing all information it contains to be recalculated as needed
 	
 	[mTACache removeAllObjects];
+	[mLayoutCache removeAllObjects];
 }
 
 
@@ -1204,12 +1250,6 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 }
 
 
-- (void)					drawText:(NSTextStorage*) contents withObject:(id<DKRenderable>) obj withPath:(NSBezierPath*) path
-{
-	[self drawText:contents withObject:obj withPath:path layoutManager:[self layoutManager]];
-}
-
-
 - (void)					drawText:(NSTextStorage*) contents withObject:(id<DKRenderable>) obj withPath:(NSBezierPath*) path layoutManager:(NSLayoutManager*) lm
 {
 	NSAssert( lm != nil, @"there must be a valid layout manager when calling -drawText:withObject:withPath:layoutManager:");
@@ -1298,6 +1338,216 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 
 
 
+- (DKTextLayoutCacheEntry*)	layoutCacheEntryForObject:(id<DKRenderable>) obj
+{
+	// returns the cached text for the object, substituting it afresh if the object's metadata, geometry or ghosted state has changed, since
+	// $size, $angle and the like are substituted from the object's properties. The key is the object itself - each object keeps one entry,
+	// replaced when it goes out of date.
+	
+	BOOL			ghost = [obj respondsToSelector:@selector(isGhosted)] && [(id)obj isGhosted];
+	NSUInteger		meta = [obj respondsToSelector:@selector(metadataChecksum)]? [(id)obj metadataChecksum] : 0;
+	DKContentHash	textKey = DKHashCombine( DKHashCombine( kDKContentHashSeed, meta ), ghost );
+	
+	textKey = DKHashFloat( DKHashCombine( textKey, [obj geometryChecksum]), [obj angle]);
+	
+	if( mLayoutCache == nil )
+		mLayoutCache = [[DKLRUCache alloc] initWithCostLimit:kDKTextAdornmentLayoutCacheCostLimit];
+	
+	NSNumber*					key = [NSNumber numberWithUnsignedLongLong:(uintptr_t) obj];
+	DKTextLayoutCacheEntry*		entry = [mLayoutCache objectForKey:key];
+	
+	// other property keys, such as $style.name, can change without any of the above changing, so text using them is always substituted
+	// again - but the existing layout is kept if the result is the same
+	
+	NSTextStorage* text = nil;
+	
+	if( entry != nil && entry->mTextKey == textKey && [self substitutesPropertyKeys])
+	{
+		text = [self textToDraw:obj];
+		
+		if(![text isEqualToAttributedString:entry->mText])
+			entry = nil;
+	}
+	
+	if( entry == nil || entry->mTextKey != textKey )
+	{
+		entry = [[[DKTextLayoutCacheEntry alloc] init] autorelease];
+		entry->mTextKey = textKey;
+		entry->mText = [( text? text : [self textToDraw:obj]) retain];
+		
+		// the cost is a rough estimate of the memory used by the text and its glyphs once laid out
+		
+		[mLayoutCache setObject:entry forKey:key cost:[entry->mText length] * 64 + 1024];
+	}
+	
+	return entry;
+}
+
+
+- (BOOL)					substitutesPropertyKeys
+{
+	// YES if the text contains any $keypath keys, which are substituted from the object's properties rather than its metadata
+	
+	NSEnumerator*	iter = [[[self textSubstitutor] allKeys] objectEnumerator];
+	NSString*		subKey;
+	
+	while(( subKey = [iter nextObject]))
+	{
+		if([subKey hasPrefix:@"$"])
+			return YES;
+	}
+	
+	return NO;
+}
+
+
+- (DKTextLayoutCacheEntry*)	layoutForObject:(id<DKRenderable>) obj withPath:(NSBezierPath*) path
+{
+	// returns the object's cached text laid out for drawing in the object's bounds or flowed in <path>. The text is laid out again only if the space
+	// it's laid out in, or a setting that affects layout, has changed. In flowed mode <path> is also the object's path.
+
+	DKTextLayoutCacheEntry*		entry = [self layoutCacheEntryForObject:obj];
+	NSSize						osize = [obj size];
+	NSBezierPath*				textLayoutPath = nil;
+	
+	if([self layoutMode] == kDKTextLayoutFlowedInPath)
+	{
+		// if the text angle is rel to the object, the layout path should be the unrotated path
+		// so the the text is laid out unrotated, then transformed into place. So detect that case here
+		// and compensate the path for the angle.
+		
+		NSAffineTransform* tfm = [self textTransformForObject:obj];
+		[tfm invert];
+		
+		textLayoutPath = [tfm transformBezierPath:path];
+		osize = [textLayoutPath bounds].size;
+	}
+	else if([self allowsTextToExtendHorizontally])
+		osize.width = 50000;
+	
+	DKContentHash layoutKey = DKHashFloat( DKHashFloat( kDKContentHashSeed, osize.width ), osize.height );
+	
+	layoutKey = DKHashCombine( DKHashCombine( layoutKey, [self layoutMode]), [self greeking]);
+	
+	if( textLayoutPath )
+	{
+		layoutKey = DKHashCombine( DKHashRect( layoutKey, [textLayoutPath bounds]), [textLayoutPath shapeHash]);
+		layoutKey = DKHashFloat( layoutKey, [self flowedTextPathInset]);
+	}
+	
+	if( entry->mLayoutManager == nil || entry->mLayoutKey != layoutKey )
+	{
+		if( entry->mLayoutManager )
+			[entry->mText removeLayoutManager:entry->mLayoutManager];
+		
+		NSLayoutManager*		lm = [self newLayoutManagerWithGreeking:[self greeking]];
+		DKBezierTextContainer*	bc = (id)[[lm textContainers] lastObject];
+		
+		if( textLayoutPath )
+		{
+			if([self flowedTextPathInset] != 0.0 )
+				[bc setLineFragmentPadding:[self flowedTextPathInset]];
+			
+			[bc setBezierPath:textLayoutPath];
+		}
+		
+		[bc setContainerSize:osize];
+		[entry->mText addLayoutManager:lm];
+		[lm release];
+		
+		// Force layout of the text and find out how much of it fits in the container.
+		
+		entry->mGlyphRange = [lm glyphRangeForTextContainer:bc];
+		
+		NSRange fullRange = [lm glyphRangeForCharacterRange:NSMakeRange( 0, [entry->mText length]) actualCharacterRange:NULL];
+		
+		entry->mFittedAllText = NSEqualRanges( fullRange, entry->mGlyphRange );
+		entry->mUsedRect = [lm usedRectForTextContainer:bc];
+		entry->mLayoutSize = osize;
+		entry->mLayoutManager = lm;
+		entry->mLayoutKey = layoutKey;
+	}
+	
+	return entry;
+}
+
+
+- (void)					drawTextLayout:(DKTextLayoutCacheEntry*) layout greeked:(BOOL) greek
+{
+	// draws the laid out text, or if <greek> is YES, a bar for each line of it as kDKGreekingByLineRectangle does. Greeked lines are filled
+	// straight from the cached line fragments, so no glyphs are drawn.
+	
+	// flag whether all the text was laid out. This can be queried to see if a "more text" marker should be shown
+	// by the bject that is using this service.
+	
+	mLastLayoutFittedAllText = layout->mFittedAllText;
+	
+	// because of the object transform applied, draw the text at the origin
+	
+	if ( layout->mGlyphRange.length > 0 )
+	{
+		NSLayoutManager*	lm = layout->mLayoutManager;
+		NSSize				textSize = layout->mUsedRect.size;
+		NSRange				grange;
+		
+		// if not wrapping lines, draw only the first line
+		
+		if(! [self wrapsLines])
+		{
+			NSRect frag = [lm lineFragmentUsedRectForGlyphAtIndex:0 effectiveRange:&grange];
+			textSize.height = frag.size.height;
+		}
+		else
+			grange = layout->mGlyphRange;
+		
+		NSPoint textOrigin = [self textOriginForSize:textSize objectSize:layout->mLayoutSize];
+		
+		if ([self layoutMode] == kDKTextLayoutFlowedInPath && [self flowedTextPathInset] != 0.0 )
+			textOrigin.y += [self flowedTextPathInset] * 0.5;
+		
+		if( greek )
+		{
+			NSUInteger	glyphIndex = grange.location;
+			NSRange		lineRange;
+			NSRect		frag;
+			
+			[[NSColor lightGrayColor] setFill];
+			
+			while( glyphIndex < NSMaxRange( grange ))
+			{
+				frag = [lm lineFragmentUsedRectForGlyphAtIndex:glyphIndex effectiveRange:&lineRange];
+				NSRectFillUsingOperation( NSOffsetRect( frag, textOrigin.x, textOrigin.y ), NSCompositeSourceOver );
+				glyphIndex = NSMaxRange( lineRange );
+			}
+		}
+		else
+		{
+			[lm drawBackgroundForGlyphRange:grange atPoint:textOrigin];
+			[lm drawGlyphsForGlyphRange:grange atPoint:textOrigin];
+		}
+	}
+}
+
+
+- (CGFloat)					projectedFontSizeOfText:(NSAttributedString*) str
+{
+	// returns the size of the text's first font in device pixels, or 0 if not drawing to the screen, when the size doesn't matter
+	
+	if(![NSGraphicsContext currentContextDrawingToScreen])
+		return 0;
+	
+	NSFont* font = [str attribute:NSFontAttributeName atIndex:0 effectiveRange:NULL];
+	
+	if( font == nil )
+		return 0;
+	
+	CGAffineTransform	ctm = CGContextGetCTM([[NSGraphicsContext currentContext] graphicsPort]);
+	CGFloat				det = fabs( ctm.a * ctm.d - ctm.b * ctm.c );
+	
+	return [font pointSize] * sqrt( det );
+}
+
+
 - (CGFloat)					baselineOffset
 {
 	return [self baselineOffsetForTextHeight:0];
@@ -1357,6 +1607,16 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 	if([self layoutMode] == kDKTextLayoutAlongReversedPath ||
 	   [self layoutMode] == kDKTextLayoutAlongPath )
 		return NSZeroRect;
+	else if([self layoutMode] != kDKTextLayoutFlowedInPath )
+	{
+		// the layout is the one used to draw the text, so is usually already cached
+		
+		DKTextLayoutCacheEntry*	layout = [self layoutForObject:object withPath:nil];
+		NSRect					tlr = layout->mUsedRect;
+		
+		tlr.origin.y += [self verticalTextOffsetForTextSize:tlr.size objectSize:layout->mLayoutSize];
+		return tlr;
+	}
 	else
 	{
 		NSTextStorage*	str = [self textToDraw:object];
@@ -1537,23 +1797,40 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 {
 	if([self greeking] == kDKGreekingNone )
 		return sharedDrawingLayoutManager();
+	else
+		return [[self newLayoutManagerWithGreeking:[self greeking]] autorelease];
+}
+
+
+- (NSLayoutManager*)		newLayoutManagerWithGreeking:(DKGreeking) greeking
+{
+	// returns a new layout manager (retained) set up as the shared drawing layout manager is, or a greeking layout manager if <greeking> is set
+	
+	NSLayoutManager* lm;
+	
+	if( greeking == kDKGreekingNone )
+		lm = [[NSLayoutManager alloc] init];
 	else
 	{
 		// greeking is implemented using a greeking layout manager
 		
-		DKGreekingLayoutManager* glm = [[DKGreekingLayoutManager alloc] init];
-		[glm setGreeking:[self greeking]];
-		
-		DKBezierTextContainer* tc = [[DKBezierTextContainer alloc] initWithContainerSize:NSMakeSize(1.0e6, 1.0e6)];
-		[tc setWidthTracksTextView:NO];
-		[tc setHeightTracksTextView:NO];
-		[glm addTextContainer:tc];
-		[tc release];
-		
-		[glm setUsesScreenFonts:NO];
-		
-		return [glm autorelease];
+		lm = [[DKGreekingLayoutManager alloc] init];
+		[(DKGreekingLayoutManager*)lm setGreeking:greeking];
 	}
+	
+	DKBezierTextContainer* tc = [[DKBezierTextContainer alloc] initWithContainerSize:NSMakeSize(1.0e6, 1.0e6)];
+	[tc setWidthTracksTextView:NO];
+	[tc setHeightTracksTextView:NO];
+	
+	if( greeking == kDKGreekingNone )
+		[tc setLineFragmentPadding:0];
+	
+	[lm addTextContainer:tc];
+	[tc release];
+	
+	[lm setUsesScreenFonts:NO];
+	
+	return lm;
 }
 
 
@@ -1566,6 +1843,27 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 }
 
 
+- (BOOL)					isSafeForConcurrentRendering
+{
+	// text is laid out using the Cocoa text system, which is main thread only
+	
+	return NO;
+}
+
+
+- (DKContentHash)			contentHash
+{
+	// the text and its complete attributes, and the settings that aren't observable, are added to the observable ones
+	
+	DKContentHash h = [super contentHash];
+	
+	h = DKHashObject( h, [self string]);
+	h = DKHashObject( h, [self textAttributes]);
+	h = DKHashRect( h, [self textRect]);
+	return DKHashCombine( h, [self greeking]);
+}
+
+
 - (NSSize)					extraSpaceNeeded
 {
 	NSSize es = NSZeroSize;
@@ -1615,6 +1913,7 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 	
 	// check the cache for the last client of this renderer. If it's not the same one, any cached information can't be reliable
 	// so the cache must be invalidated. For TAs associated with text objects, the client object will invariably be the same one.
+	// The layout cache is kept per object, so is not affected.
 	
 	@try
 	{
@@ -1622,17 +1921,37 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 		cs = [(id)object metadataChecksum];
 		if( cs != ccs )
 		{
-			[self invalidateCache];
-			[mTACache setObject:[NSNumber numberWithInteger:ccs] forKey:kDKTextAdornmentMetadataChecksumCacheKey];
+			[mTACache removeAllObjects];
+			[mTACache setObject:[NSNumber numberWithInteger:cs] forKey:kDKTextAdornmentMetadataChecksumCacheKey];
 		}
 
-		NSTextStorage*	str = [self textToDraw:object];
+		DKTextLayoutCacheEntry*	layout = [self layoutCacheEntryForObject:object];
+		NSTextStorage*			str = layout->mText;
 		
 		// if no text, nothing to do
 		
 		if ( str == nil || [str length] == 0 )
 			return;
 		
+		// on screen, text too small to read is greeked or not drawn at all according to the drawing's settings, unless the adornment
+		// is greeked already
+		
+		BOOL autoGreek = NO;
+		
+		if([self greeking] == kDKGreekingNone && ![object isBeingHitTested] && [object respondsToSelector:@selector(drawing)])
+		{
+			DKDrawing*	drawing = [(id)object drawing];
+			CGFloat		fontPixels = [self projectedFontSizeOfText:str];
+			
+			if( drawing != nil && fontPixels > 0 )
+			{
+				if( fontPixels < [drawing textHidingThreshold])
+					return;
+				
+				autoGreek = ( fontPixels < [drawing textGreekingThreshold]);
+			}
+		}
+		
 		// draw it according to settings with the object's path bounds
 		
 		if([self layoutMode] == kDKTextLayoutAtCentroid )
@@ -1643,7 +1962,17 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 			if([object respondsToSelector:@selector(pointForTextLayout)])
 			{
 				NSPoint tp = [(NSObject*)object pointForTextLayout];
-				[self drawText:str centredAtPoint:tp];
+				
+				if( autoGreek )
+				{
+					NSSize	ts = [str size];
+					NSRect	tr = NSMakeRect( tp.x - ts.width * 0.5, tp.y - ts.height * 0.5, ts.width, ts.height );
+					
+					[[NSColor lightGrayColor] setFill];
+					NSRectFillUsingOperation( tr, NSCompositeSourceOver );
+				}
+				else
+					[self drawText:str centredAtPoint:tp];
 			}
 		}
 		else
@@ -1659,7 +1988,7 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 			{
 				// draw any knockout behind the text - warning: potentially expensive.
 				
-				if([self greeking] == kDKGreekingNone )
+				if([self greeking] == kDKGreekingNone && !autoGreek )
 					[self drawKnockoutWithObject:object];
 
 				// measure the text height for the centring option based on the font of the first character
@@ -1678,6 +2007,15 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 				
 				if([self greeking] != kDKGreekingNone )
 					lm = [self layoutManager];
+				else if( autoGreek )
+				{
+					static NSLayoutManager* sAutoGreekingLM = nil;
+					
+					if( sAutoGreekingLM == nil )
+						sAutoGreekingLM = [self newLayoutManagerWithGreeking:kDKGreekingByGlyphRectangle];
+					
+					lm = sAutoGreekingLM;
+				}
 				
 				// passing nil as lm causes text on path to be laid out using its own shared lm for the purpose
 				
@@ -1690,15 +2028,15 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 				
 				// draw any knockout behind the text - warning: potentially expensive.
 				
-				if([self greeking] == kDKGreekingNone )
+				if([self greeking] == kDKGreekingNone && !autoGreek )
 					[self drawKnockoutWithObject:object];
 
 				NSAffineTransform* tfm = [self textTransformForObject:object];
 				[tfm concat];
 				
-				// draw the text
+				// draw the text, laying it out only if necessary
 				
-				[self drawText:str withObject:object withPath:path];
+				[self drawTextLayout:[self layoutForObject:object withPath:path] greeked:autoGreek];
 			}
 			RESTORE_GRAPHICS_CONTEXT	//[NSGraphicsContext restoreGraphicsState];
 		}
@@ -1757,6 +2095,7 @@ static CGFloat s_maximumVerticalOffset = DEFAULT_BASELINE_OFFSET_MAX;
 {
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
 	[mTACache release];
+	[mLayoutCache release];
 	[mSubstitutor release];
 	[mTextKnockoutColour release];
 	[mTextKnockoutStrokeColour release];
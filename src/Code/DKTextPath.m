@@ -979,6 +979,14 @@ static NSString*	sDefault_string = @"Double-click to edit this text";
 }
 
 
+- (BOOL)					isSafeForConcurrentRendering
+{
+	// text layout is main thread only
+	
+	return NO;
+}
+
+
 - (void)					drawSelectedState
 {
 	if(![[self textAdornment] allTextWasFitted] && [DKTextShape showsTextOverflowIndicator])
@@ -1694,6 +1694,14 @@ static NSString*	sDefault_string = @"Double-click to edit this text";
 }
 
 
+- (BOOL)				isSafeForConcurrentRendering
+{
+	// text layout is main thread only
+	
+	return NO;
+}
+
+
 - (void)				drawSelectedState
 {
 	// draw a "more text" indicator if the current text can't be fully laid out in the box
@@ -0,0 +1,94 @@
+//
+//  DKTiledImagePyramid.h
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file.
+//
+
+#import <Cocoa/Cocoa.h>
+
+
+@class DKLRUCache;
+
+
+@interface DKTiledImagePyramid : NSObject
+{
+@private
+	NSString*				mSourcePath;			// the image file the pyramid is made from
+	NSString*				mTileDirectory;			// where this image's tiles are kept on disk
+	NSString*				mBuildDirectory;		// where the tiles are written while building, or nil once they are in place
+	int						mLockFile;				// file descriptor of the build lock file, or -1
+	BOOL					mHoldsBuildLock;		// YES while the build lock is held
+	NSSize					mPixelSize;				// pixel size of the full resolution image
+	NSSize					mSize;					// size of the image in points, allowing for its resolution
+	NSUInteger				mLevelCount;			// number of levels, the coarsest being a single tile
+	NSUInteger				mFirstLevel;			// the finest level made - 0 unless the image is too big to decode whole
+	NSUInteger				mLevelsBuilt;			// levels mFirstLevel..mLevelsBuilt - 1 are on disk (main thread only)
+	volatile BOOL			mCancelled;				// set to stop a background build
+	NSBitmapImageRep*		mPreview;				// small whole-image preview drawn until the needed level is built
+	DKLRUCache*				mTileCache;				// decoded tiles, keyed by level/column/row
+}
+
++ (NSString*)			defaultCacheDirectory;
++ (BOOL)				imageAtPathNeedsTiling:(NSString*) path;
++ (void)				trimCacheDirectory:(NSString*) cacheDir toByteBudget:(unsigned long long) bytes;
+
+- (id)					initWithContentsOfFile:(NSString*) path cacheDirectory:(NSString*) cacheDir;
+
+- (NSString*)			sourcePath;
+- (NSSize)				pixelSize;
+- (NSSize)				size;
+- (NSUInteger)			levelCount;
+- (NSSize)				pixelSizeOfLevel:(NSUInteger) level;
+
+- (BOOL)				isComplete;
+- (void)				cancelBuilding;
+
+- (void)				setTileCacheByteBudget:(NSUInteger) bytes;
+- (NSUInteger)			tileCacheByteBudget;
+
+- (void)				drawInRect:(NSRect) destRect operation:(NSCompositingOperation) op fraction:(CGFloat) opacity;
+
+@end
+
+
+extern NSString*		kDKTiledImagePyramidDidUpdate;
+
+
+#define kDKTiledImagePyramidTileSize					256						// tiles are this many pixels square, except at the edges
+#define kDKTiledImagePyramidPreviewSize					1024					// longest side of the preview, in pixels
+#define kDKTiledImagePyramidDefaultTileCacheByteBudget	( 64 * 1024 * 1024 )	// memory allowed for decoded tiles
+#define kDKTiledImagePyramidTilingThreshold				( 4096 * 4096 )			// images with more pixels than this are worth tiling
+#define kDKTiledImagePyramidMaximumDecodeBytes			( 256 * 1024 * 1024 )	// largest image decoded whole to make the first level
+#define kDKTiledImagePyramidDefaultDiskByteBudget		( 2ULL * 1024 * 1024 * 1024 )	// disk space allowed for the tiles of all images
+
+
+/*
+
+A tiled image pyramid displays an image far too large to hold in memory, such as a survey backdrop tens of thousands of pixels across. The
+image is cut into square tiles at full resolution and at a series of levels each half the size of the one before, down to a level that
+fits in one tile. The tiles are kept on disk, in a directory for the image within the cache directory, so the work is done only once per image
+file - the directory is named from the file's path, size and modification date and is reused as long as they are unchanged. Initialising a pyramid
+for a file that already has one returns the existing pyramid, so there is only ever one build per directory within a process. The tiles are
+built into a temporary directory that is moved into place, with a manifest, only when complete - so an incomplete build can never leave a
+directory that looks usable. The temporary directory is guarded by a lock file held while building, so that two processes don't build the
+same tiles at once, and a build interrupted by quitting or a crash is cleared away by the next build of the same file. Before each build, the
+cache directory is trimmed to kDKTiledImagePyramidDefaultDiskByteBudget by removing the tiles of the least recently used images.
+
+The tiles are built on a background thread. A TIFF is read in bands one tile high to cut the full resolution level, so it is never held
+decoded all at once. Other formats can't be read a part at a time, so they are decoded once at the finest level that fits within
+kDKTiledImagePyramidMaximumDecodeBytes, and no finer levels are made - very large images in those formats are drawn at that resolution
+however far they are zoomed into. Each coarser level is then made from the four tiles below it, so only a few tiles are held at a time. A
+small preview of the whole image is made first, and is drawn for any area whose level hasn't been built yet. kDKTiledImagePyramidDidUpdate is
+posted on the main thread when the preview is ready and each time a level is finished, so that clients can redraw.
+
+-drawInRect:operation:fraction: picks the level with at least one pixel per device pixel under the current transformation, and draws only
+the tiles that intersect the current clip - which, within a view's -drawRect:, is the area being updated. Decoded tiles are kept in an LRU
+cache whose size in bytes is bounded by the tile cache budget, so memory use doesn't depend on the size of the image.
+
+DKImageOverlayLayer uses a tiled pyramid for large image files - see +imageAtPathNeedsTiling:.
+
+*/
+
@@ -0,0 +1,1006 @@
+//
+//  DKTiledImagePyramid.m
+///  DrawKit ©2005-2008 Apptree.net
+//
+//  Created 19/10/2026.
+///
+///	 This software is released subject to licensing conditions as detailed in DRAWKIT-LICENSING.TXT, which must accompany this source file.
+//
+
+#import "DKTiledImagePyramid.h"
+#import "DKLRUCache.h"
+#import "DKContentHash.h"
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+
+NSString*		kDKTiledImagePyramidDidUpdate		= @"kDKTiledImagePyramidDidUpdate";
+
+
+static NSMutableDictionary*	sPyramids = nil;		// live pyramids, not retained, keyed by tile directory
+
+
+@interface DKTiledImagePyramid (Private)
+
+- (NSString*)			tilePathForLevel:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row;
+- (NSDictionary*)		manifest;
+- (NSUInteger)			levelForDeviceSize:(NSSize) deviceSize;
+- (NSBitmapImageRep*)	tileAtLevel:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row;
+
+// background building:
+
+- (void)				buildTiles:(id) obj;
+- (BOOL)				acquireBuildLock;
+- (BOOL)				buildFirstLevelFromSource:(CGImageSourceRef) source;
+- (BOOL)				buildLevel:(NSUInteger) level;
+- (CGImageRef)			newTileImageAtLevel:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row;
+- (BOOL)				writeTileImage:(CGImageRef) image level:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row;
+
+// called on the main thread by the build:
+
+- (void)				previewDidBuild:(NSBitmapImageRep*) preview;
+- (void)				levelDidBuild:(NSNumber*) levelsBuilt;
+- (void)				buildDidFinish:(id) obj;
+
+@end
+
+
+#pragma mark -
+
+@implementation DKTiledImagePyramid
+
+///*********************************************************************************************************************
+///
+/// method:			defaultCacheDirectory
+/// scope:			public class method
+/// overrides:
+/// description:	returns the directory in which tiles are kept unless another is given
+///
+/// parameters:		none
+/// result:			a directory within the user's caches folder
+///
+/// notes:			the directory is created when first used
+///
+///********************************************************************************************************************
+
++ (NSString*)			defaultCacheDirectory
+{
+	NSArray* paths = NSSearchPathForDirectoriesInDomains( NSCachesDirectory, NSUserDomainMask, YES );
+
+	if([paths count] == 0 )
+		return [NSTemporaryDirectory() stringByAppendingPathComponent:@"net.apptree.drawkit.tiles"];
+
+	return [[paths objectAtIndex:0] stringByAppendingPathComponent:@"net.apptree.drawkit.tiles"];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			imageAtPathNeedsTiling:
+/// scope:			public class method
+/// overrides:
+/// description:	is the image file large enough to be worth displaying from a tiled pyramid?
+///
+/// parameters:		<path> the image file
+/// result:			YES if it has more than kDKTiledImagePyramidTilingThreshold pixels
+///
+/// notes:			only the file's header is read
+///
+///********************************************************************************************************************
+
++ (BOOL)				imageAtPathNeedsTiling:(NSString*) path
+{
+	if( path == nil )
+		return NO;
+
+	CGImageSourceRef	source = CGImageSourceCreateWithURL((CFURLRef)[NSURL fileURLWithPath:path], NULL );
+	NSDictionary*		props = nil;
+
+	if( source != NULL )
+	{
+		if( CGImageSourceGetCount( source ) > 0 )
+			props = [(NSDictionary*) CGImageSourceCopyPropertiesAtIndex( source, 0, NULL ) autorelease];
+
+		CFRelease( source );
+	}
+
+	double pixels = [[props objectForKey:(NSString*) kCGImagePropertyPixelWidth] doubleValue] * [[props objectForKey:(NSString*) kCGImagePropertyPixelHeight] doubleValue];
+
+	return pixels > kDKTiledImagePyramidTilingThreshold;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			trimCacheDirectory:toByteBudget:
+/// scope:			public class method
+/// overrides:
+/// description:	removes the tiles of the least recently used images until the cache directory is within a size
+///
+/// parameters:		<cacheDir> the cache directory, or nil for the default
+///					<bytes> the most disk space the tiles may use
+/// result:			none
+///
+/// notes:			only complete sets of tiles are removed, and never those of a pyramid in use in this process. A set's last use
+///					is the date of its manifest, which is updated each time it is reused. Called before each build; it may take a
+///					while for a large cache, so call it on a secondary thread.
+///
+///********************************************************************************************************************
+
++ (void)				trimCacheDirectory:(NSString*) cacheDir toByteBudget:(unsigned long long) bytes
+{
+	if( cacheDir == nil )
+		cacheDir = [self defaultCacheDirectory];
+
+	NSFileManager*			fm = [[[NSFileManager alloc] init] autorelease];
+	NSEnumerator*			iter = [[fm contentsOfDirectoryAtPath:cacheDir error:NULL] objectEnumerator];
+	NSMutableArray*			sets = [NSMutableArray array];
+	NSString*				name;
+	NSString*				dir;
+	NSDictionary*			attrs;
+	NSDirectoryEnumerator*	files;
+	unsigned long long		size, total = 0;
+
+	while(( name = [iter nextObject]))
+	{
+		// tile directories have no extension - temporary directories and lock files have one
+
+		if([[name pathExtension] length] > 0 )
+			continue;
+
+		dir = [cacheDir stringByAppendingPathComponent:name];
+		attrs = [fm attributesOfItemAtPath:[dir stringByAppendingPathComponent:@"manifest.plist"] error:NULL];
+
+		if( attrs == nil )
+			continue;
+
+		files = [fm enumeratorAtPath:dir];
+		size = 0;
+
+		while([files nextObject])
+			size += [[files fileAttributes] fileSize];
+
+		total += size;
+		[sets addObject:[NSDictionary dictionaryWithObjectsAndKeys:dir, @"path", [attrs fileModificationDate], @"date", [NSNumber numberWithUnsignedLongLong:size], @"size", nil]];
+	}
+
+	NSSortDescriptor*	byDate = [[[NSSortDescriptor alloc] initWithKey:@"date" ascending:YES] autorelease];
+	NSDictionary*		set;
+	BOOL				inUse;
+
+	iter = [[sets sortedArrayUsingDescriptors:[NSArray arrayWithObject:byDate]] objectEnumerator];
+
+	while( total > bytes && ( set = [iter nextObject]))
+	{
+		dir = [set objectForKey:@"path"];
+
+		@synchronized([DKTiledImagePyramid class])
+		{
+			inUse = [sPyramids objectForKey:dir] != nil;
+		}
+
+		if( !inUse && [fm removeItemAtPath:dir error:NULL])
+			total -= [[set objectForKey:@"size"] unsignedLongLongValue];
+	}
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			initWithContentsOfFile:cacheDirectory:
+/// scope:			public instance method
+/// overrides:
+/// description:	initialises a pyramid for an image file, starting to build its tiles if they aren't already on disk
+///
+/// parameters:		<path> the image file
+///					<cacheDir> the directory in which to keep the tiles, or nil for the default
+/// result:			the pyramid, or nil if the file isn't an image ImageIO can read
+///
+/// notes:			returns at once - the tiles are built on a background thread. If a pyramid already exists for the same tile
+///					directory, this one is released and the existing one returned, unless its build was cancelled.
+///
+///********************************************************************************************************************
+
+- (id)					initWithContentsOfFile:(NSString*) path cacheDirectory:(NSString*) cacheDir
+{
+	self = [super init];
+	if( self )
+	{
+		CGImageSourceRef	source = NULL;
+		NSDictionary*		props = nil;
+		BOOL				isTIFF = NO;
+
+		mLockFile = -1;
+
+		if( path != nil )
+			source = CGImageSourceCreateWithURL((CFURLRef)[NSURL fileURLWithPath:path], NULL );
+
+		if( source != NULL )
+		{
+			if( CGImageSourceGetCount( source ) > 0 )
+				props = [(NSDictionary*) CGImageSourceCopyPropertiesAtIndex( source, 0, NULL ) autorelease];
+
+			isTIFF = [(NSString*) CGImageSourceGetType( source ) isEqualToString:@"public.tiff"];
+			CFRelease( source );
+		}
+
+		mPixelSize.width = [[props objectForKey:(NSString*) kCGImagePropertyPixelWidth] doubleValue];
+		mPixelSize.height = [[props objectForKey:(NSString*) kCGImagePropertyPixelHeight] doubleValue];
+
+		if( mPixelSize.width < 1 || mPixelSize.height < 1 )
+		{
+			[self autorelease];
+			return nil;
+		}
+
+		// the size in points allows for the image's resolution, as NSImage's does
+
+		CGFloat dpiX = [[props objectForKey:(NSString*) kCGImagePropertyDPIWidth] doubleValue];
+		CGFloat dpiY = [[props objectForKey:(NSString*) kCGImagePropertyDPIHeight] doubleValue];
+
+		mSize.width = ( dpiX > 0 )? mPixelSize.width * 72.0 / dpiX : mPixelSize.width;
+		mSize.height = ( dpiY > 0 )? mPixelSize.height * 72.0 / dpiY : mPixelSize.height;
+
+		// levels halve in size until the whole image fits in one tile
+
+		NSUInteger longest = (NSUInteger) MAX( mPixelSize.width, mPixelSize.height );
+
+		mLevelCount = 1;
+
+		while( longest > kDKTiledImagePyramidTileSize )
+		{
+			longest = ( longest + 1 ) / 2;
+			++mLevelCount;
+		}
+
+		// ImageIO can read the strips or tiles of a TIFF a part at a time, but other formats must be decoded whole. Those are decoded once,
+		// reduced to the finest level that fits within kDKTiledImagePyramidMaximumDecodeBytes, and no finer levels are made.
+
+		NSSize fs;
+
+		while( !isTIFF && mFirstLevel < mLevelCount - 1 )
+		{
+			fs = [self pixelSizeOfLevel:mFirstLevel];
+
+			if( fs.width * fs.height * 4 <= kDKTiledImagePyramidMaximumDecodeBytes )
+				break;
+
+			++mFirstLevel;
+		}
+
+		mLevelsBuilt = mFirstLevel;
+
+		mSourcePath = [path copy];
+		mTileCache = [[DKLRUCache alloc] initWithCostLimit:kDKTiledImagePyramidDefaultTileCacheByteBudget];
+
+		// the tiles of an image file live in a directory named for the file's path, size and modification date, so a changed file
+		// gets new tiles
+
+		NSDictionary*	attrs = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:NULL];
+		DKContentHash	h = kDKContentHashSeed;
+
+		h = DKHashObject( h, path );
+		h = DKHashCombine( h, [attrs fileSize]);
+		h = DKHashFloat( h, [[attrs fileModificationDate] timeIntervalSinceReferenceDate]);
+
+		if( cacheDir == nil )
+			cacheDir = [[self class] defaultCacheDirectory];
+
+		mTileDirectory = [[cacheDir stringByAppendingPathComponent:[NSString stringWithFormat:@"%016llx", (unsigned long long) h]] retain];
+
+		// share the pyramid already made for this directory, if any, so that two pyramids never build the same tiles
+
+		DKTiledImagePyramid* shared = nil;
+
+		@synchronized([DKTiledImagePyramid class])
+		{
+			shared = [[sPyramids objectForKey:mTileDirectory] nonretainedObjectValue];
+
+			if( shared != nil && !shared->mCancelled )
+				[shared retain];
+			else
+			{
+				shared = nil;
+
+				if( sPyramids == nil )
+					sPyramids = [[NSMutableDictionary alloc] init];
+
+				[sPyramids setObject:[NSValue valueWithNonretainedObject:self] forKey:mTileDirectory];
+			}
+		}
+
+		if( shared != nil )
+		{
+			[self release];
+			return shared;
+		}
+
+		// if a previous build completed, its tiles can be used straight away - the manifest's date is updated to mark them as recently
+		// used. Otherwise they are built into a temporary directory which replaces the tile directory when complete.
+
+		NSString*		manifestPath = [mTileDirectory stringByAppendingPathComponent:@"manifest.plist"];
+		NSDictionary*	existing = [NSDictionary dictionaryWithContentsOfFile:manifestPath];
+
+		if([existing isEqualToDictionary:[self manifest]])
+		{
+			mLevelsBuilt = mLevelCount;
+			[[NSFileManager defaultManager] setAttributes:[NSDictionary dictionaryWithObject:[NSDate date] forKey:NSFileModificationDate] ofItemAtPath:manifestPath error:NULL];
+		}
+		else
+		{
+			mBuildDirectory = [[mTileDirectory stringByAppendingPathExtension:@"building"] retain];
+			[NSThread detachNewThreadSelector:@selector(buildTiles:) toTarget:self withObject:nil];
+		}
+	}
+
+	return self;
+}
+
+
+- (NSString*)			sourcePath
+{
+	return mSourcePath;
+}
+
+
+- (NSSize)				pixelSize
+{
+	return mPixelSize;
+}
+
+
+- (NSSize)				size
+{
+	return mSize;
+}
+
+
+- (NSUInteger)			levelCount
+{
+	return mLevelCount;
+}
+
+
+- (NSSize)				pixelSizeOfLevel:(NSUInteger) level
+{
+	CGFloat scale = ldexp( 1.0, -(int) MIN( level, mLevelCount - 1 ));
+
+	return NSMakeSize( ceil( mPixelSize.width * scale ), ceil( mPixelSize.height * scale ));
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			isComplete
+/// scope:			public instance method
+/// overrides:
+/// description:	have all the levels been built?
+///
+/// parameters:		none
+/// result:			YES if every level is available on disk
+///
+/// notes:
+///
+///********************************************************************************************************************
+
+- (BOOL)				isComplete
+{
+	return mLevelsBuilt == mLevelCount;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			cancelBuilding
+/// scope:			public instance method
+/// overrides:
+/// description:	stops the background build, if one is running
+///
+/// parameters:		none
+/// result:			none
+///
+/// notes:			the build stops after the tile it is working on, and its temporary directory is removed when the pyramid is
+///					released. An incomplete build is started again from scratch the next time a pyramid is made for the file. As
+///					pyramids are shared, this stops the build for every client of this one.
+///
+///********************************************************************************************************************
+
+- (void)				cancelBuilding
+{
+	mCancelled = YES;
+}
+
+
+- (void)				setTileCacheByteBudget:(NSUInteger) bytes
+{
+	[mTileCache setCostLimit:bytes];
+}
+
+
+- (NSUInteger)			tileCacheByteBudget
+{
+	return [mTileCache costLimit];
+}
+
+
+#pragma mark -
+
+///*********************************************************************************************************************
+///
+/// method:			drawInRect:operation:fraction:
+/// scope:			public instance method
+/// overrides:
+/// description:	draws the tiles of the image that fall within the current clip
+///
+/// parameters:		<destRect> the rect the whole image occupies
+///					<op> the compositing operation
+///					<opacity> the opacity to draw at
+/// result:			none
+///
+/// notes:			the level is chosen to have at least one pixel per device pixel, or is the finest level there is. If it hasn't been
+///					built yet the preview is drawn instead. The image is drawn upright whether or not the context is flipped. Tile
+///					edges are snapped to device pixels and not antialiased, so that adjacent tiles don't leave seams. Main thread only.
+///
+///********************************************************************************************************************
+
+- (void)				drawInRect:(NSRect) destRect operation:(NSCompositingOperation) op fraction:(CGFloat) opacity
+{
+	if( NSWidth( destRect ) <= 0 || NSHeight( destRect ) <= 0 )
+		return;
+
+	NSGraphicsContext*	gc = [NSGraphicsContext currentContext];
+	CGContextRef		ctx = [gc graphicsPort];
+	NSUInteger			level = 0;
+
+	if([NSGraphicsContext currentContextDrawingToScreen])
+	{
+		CGAffineTransform	ctm = CGContextGetCTM( ctx );
+		NSSize				ds;
+
+		ds.width = NSWidth( destRect ) * hypot( ctm.a, ctm.b );
+		ds.height = NSHeight( destRect ) * hypot( ctm.c, ctm.d );
+		level = [self levelForDeviceSize:ds];
+	}
+
+	level = MAX( level, mFirstLevel );
+
+	NSRect vis = NSIntersectionRect( destRect, NSRectFromCGRect( CGContextGetClipBoundingBox( ctx )));
+
+	if( NSIsEmptyRect( vis ))
+		return;
+
+	if( level >= mLevelsBuilt )
+	{
+		[mPreview drawInRect:destRect fromRect:NSZeroRect operation:op fraction:opacity respectFlipped:YES hints:nil];
+		return;
+	}
+
+	// find the range of tiles under the visible area, in the level's pixels, whose origin is at the top left
+
+	NSSize		ls = [self pixelSizeOfLevel:level];
+	CGFloat		sx = ls.width / NSWidth( destRect );
+	CGFloat		sy = ls.height / NSHeight( destRect );
+	CGFloat		ts = kDKTiledImagePyramidTileSize;
+	BOOL		flipped = [gc isFlipped];
+	CGFloat		px0, px1, py0, py1;
+	NSInteger	c0, c1, r0, r1, col, row;
+
+	px0 = ( NSMinX( vis ) - NSMinX( destRect )) * sx;
+	px1 = ( NSMaxX( vis ) - NSMinX( destRect )) * sx;
+
+	if( flipped )
+	{
+		py0 = ( NSMinY( vis ) - NSMinY( destRect )) * sy;
+		py1 = ( NSMaxY( vis ) - NSMinY( destRect )) * sy;
+	}
+	else
+	{
+		py0 = ( NSMaxY( destRect ) - NSMaxY( vis )) * sy;
+		py1 = ( NSMaxY( destRect ) - NSMinY( vis )) * sy;
+	}
+
+	c0 = MAX( 0, (NSInteger) floor( px0 / ts ));
+	c1 = MIN((NSInteger) ceil( ls.width / ts ) - 1, (NSInteger) ceil( px1 / ts ) - 1 );
+	r0 = MAX( 0, (NSInteger) floor( py0 / ts ));
+	r1 = MIN((NSInteger) ceil( ls.height / ts ) - 1, (NSInteger) ceil( py1 / ts ) - 1 );
+
+	NSBitmapImageRep*	tile;
+	NSRect				tr;
+	CGRect				dr;
+	CGAffineTransform	ctm = CGContextGetCTM( ctx );
+	BOOL				snap = ( ctm.b == 0 && ctm.c == 0 );
+
+	CGContextSaveGState( ctx );
+	CGContextSetShouldAntialias( ctx, NO );
+
+	for( row = r0; row <= r1; ++row )
+	{
+		for( col = c0; col <= c1; ++col )
+		{
+			tile = [self tileAtLevel:level column:col row:row];
+
+			if( tile == nil )
+				continue;
+
+			tr.size.width = [tile pixelsWide] / sx;
+			tr.size.height = [tile pixelsHigh] / sy;
+			tr.origin.x = NSMinX( destRect ) + ( col * ts ) / sx;
+
+			if( flipped )
+				tr.origin.y = NSMinY( destRect ) + ( row * ts ) / sy;
+			else
+				tr.origin.y = NSMaxY( destRect ) - ( row * ts + [tile pixelsHigh]) / sy;
+
+			// rounding each edge rather than the size means that adjacent tiles share the same device pixel edge
+
+			if( snap )
+			{
+				dr = CGContextConvertRectToDeviceSpace( ctx, NSRectToCGRect( tr ));
+				dr = CGRectMake( round( CGRectGetMinX( dr )), round( CGRectGetMinY( dr )),
+								 round( CGRectGetMaxX( dr )) - round( CGRectGetMinX( dr )), round( CGRectGetMaxY( dr )) - round( CGRectGetMinY( dr )));
+				tr = NSRectFromCGRect( CGContextConvertRectToUserSpace( ctx, dr ));
+			}
+
+			[tile drawInRect:tr fromRect:NSZeroRect operation:op fraction:opacity respectFlipped:YES hints:nil];
+		}
+	}
+
+	CGContextRestoreGState( ctx );
+}
+
+
+#pragma mark -
+
+- (NSString*)			tilePathForLevel:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row
+{
+	// while building, tiles are written to and read from the temporary directory
+
+	NSString* dir = mBuildDirectory? mBuildDirectory : mTileDirectory;
+
+	return [dir stringByAppendingPathComponent:[NSString stringWithFormat:@"%lu_%lu_%lu.png", (unsigned long) level, (unsigned long) col, (unsigned long) row]];
+}
+
+
+- (NSDictionary*)		manifest
+{
+	// written when the build completes - if the one on disk matches, the tiles are complete and usable
+
+	return [NSDictionary dictionaryWithObjectsAndKeys:
+				mSourcePath, @"source",
+				[NSNumber numberWithDouble:mPixelSize.width], @"width",
+				[NSNumber numberWithDouble:mPixelSize.height], @"height",
+				[NSNumber numberWithUnsignedInteger:kDKTiledImagePyramidTileSize], @"tileSize",
+				[NSNumber numberWithUnsignedInteger:mLevelCount], @"levels",
+				[NSNumber numberWithUnsignedInteger:mFirstLevel], @"firstLevel",
+				nil];
+}
+
+
+- (NSUInteger)			levelForDeviceSize:(NSSize) deviceSize
+{
+	// the smallest level that still covers the device size
+
+	NSUInteger	level = mLevelCount;
+	NSSize		ls;
+
+	while( level-- > 0 )
+	{
+		ls = [self pixelSizeOfLevel:level];
+
+		if( ls.width >= deviceSize.width && ls.height >= deviceSize.height )
+			return level;
+	}
+
+	return 0;
+}
+
+
+- (NSBitmapImageRep*)	tileAtLevel:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row
+{
+	// returns the decoded tile from the memory cache, reading it from disk if necessary
+
+	NSString*			key = [NSString stringWithFormat:@"%lu/%lu/%lu", (unsigned long) level, (unsigned long) col, (unsigned long) row];
+	NSBitmapImageRep*	tile = [mTileCache objectForKey:key];
+
+	if( tile == nil )
+	{
+		CGImageRef image = [self newTileImageAtLevel:level column:col row:row];
+
+		if( image == NULL )
+			return nil;
+
+		tile = [[NSBitmapImageRep alloc] initWithCGImage:image];
+		[tile setSize:NSMakeSize([tile pixelsWide], [tile pixelsHigh])];
+		[mTileCache setObject:tile forKey:key cost:[tile pixelsWide] * [tile pixelsHigh] * 4];
+		[tile autorelease];
+		CGImageRelease( image );
+	}
+
+	return tile;
+}
+
+
+#pragma mark -
+
+- (void)				buildTiles:(id) obj
+{
+	#pragma unused(obj)
+
+	// background thread entry point - makes the preview, then each level in turn from the finest up
+
+	NSAutoreleasePool*	pool = [NSAutoreleasePool new];
+	CGImageSourceRef	source = CGImageSourceCreateWithURL((CFURLRef)[NSURL fileURLWithPath:mSourcePath], NULL );
+
+	if( source != NULL )
+	{
+		NSDictionary*	options = [NSDictionary dictionaryWithObjectsAndKeys:
+									[NSNumber numberWithBool:YES], (NSString*) kCGImageSourceCreateThumbnailFromImageAlways,
+									[NSNumber numberWithUnsignedInteger:kDKTiledImagePyramidPreviewSize], (NSString*) kCGImageSourceThumbnailMaxPixelSize,
+									nil];
+		CGImageRef		preview = CGImageSourceCreateThumbnailAtIndex( source, 0, (CFDictionaryRef) options );
+
+		if( preview != NULL )
+		{
+			NSBitmapImageRep* rep = [[[NSBitmapImageRep alloc] initWithCGImage:preview] autorelease];
+			[self performSelectorOnMainThread:@selector(previewDidBuild:) withObject:rep waitUntilDone:NO];
+			CGImageRelease( preview );
+		}
+
+		// wait until no other process is building these tiles. If one has completed them meanwhile, they are used as they are. Otherwise the
+		// temporary directory left by any interrupted build is cleared, and space made for the new tiles.
+
+		NSFileManager*	fm = [[[NSFileManager alloc] init] autorelease];
+		NSUInteger		level = 0;
+		BOOL			ok = [self acquireBuildLock];
+
+		if( ok && [[NSDictionary dictionaryWithContentsOfFile:[mTileDirectory stringByAppendingPathComponent:@"manifest.plist"]] isEqualToDictionary:[self manifest]])
+		{
+			[self performSelectorOnMainThread:@selector(levelDidBuild:) withObject:[NSNumber numberWithUnsignedInteger:mLevelCount] waitUntilDone:NO];
+			[self performSelectorOnMainThread:@selector(buildDidFinish:) withObject:nil waitUntilDone:NO];
+			ok = NO;
+		}
+		else if( ok )
+		{
+			[fm removeItemAtPath:mBuildDirectory error:NULL];
+			ok = [fm createDirectoryAtPath:mBuildDirectory withIntermediateDirectories:YES attributes:nil error:NULL];
+			[[self class] trimCacheDirectory:[mTileDirectory stringByDeletingLastPathComponent] toByteBudget:kDKTiledImagePyramidDefaultDiskByteBudget];
+		}
+
+		for( level = mFirstLevel; level < mLevelCount && ok && !mCancelled; ++level )
+		{
+			if( level == mFirstLevel )
+				ok = [self buildFirstLevelFromSource:source];
+			else
+				ok = [self buildLevel:level];
+
+			if( ok )
+				[self performSelectorOnMainThread:@selector(levelDidBuild:) withObject:[NSNumber numberWithUnsignedInteger:level + 1] waitUntilDone:NO];
+		}
+
+		if( ok && level == mLevelCount && !mCancelled && [[self manifest] writeToFile:[mBuildDirectory stringByAppendingPathComponent:@"manifest.plist"] atomically:YES])
+			[self performSelectorOnMainThread:@selector(buildDidFinish:) withObject:nil waitUntilDone:NO];
+
+		CFRelease( source );
+	}
+
+	[pool drain];
+}
+
+
+- (BOOL)				acquireBuildLock
+{
+	// takes the lock on the temporary directory, waiting while another process holds it. The lock is released by the system if the process
+	// quits or crashes, so a lock is never left behind. Returns NO if cancelled while waiting or the lock file can't be opened.
+
+	mLockFile = open([[mBuildDirectory stringByAppendingPathExtension:@"lock"] fileSystemRepresentation], O_RDWR | O_CREAT, 0644 );
+
+	if( mLockFile < 0 )
+		return NO;
+
+	while( flock( mLockFile, LOCK_EX | LOCK_NB ) != 0 )
+	{
+		if( mCancelled )
+			return NO;
+
+		[NSThread sleepForTimeInterval:1.0];
+	}
+
+	mHoldsBuildLock = YES;
+	return YES;
+}
+
+
+- (BOOL)				buildFirstLevelFromSource:(CGImageSourceRef) source
+{
+	// cuts the finest level into tiles, one row of tiles at a time. At full resolution - only for a TIFF - the image isn't cached by ImageIO,
+	// and each row is read into a band just one tile high from the TIFF's strips or tiles, so the whole image is never held decoded at once.
+	// Otherwise the image is decoded once at the reduced size of the first level, which is small enough to be held, and the bands drawn from that.
+
+	NSSize			ls = [self pixelSizeOfLevel:mFirstLevel];
+	NSDictionary*	options;
+	CGImageRef		image;
+
+	if( mFirstLevel == 0 )
+	{
+		options = [NSDictionary dictionaryWithObject:[NSNumber numberWithBool:NO] forKey:(NSString*) kCGImageSourceShouldCache];
+		image = CGImageSourceCreateImageAtIndex( source, 0, (CFDictionaryRef) options );
+	}
+	else
+	{
+		options = [NSDictionary dictionaryWithObjectsAndKeys:
+					[NSNumber numberWithBool:YES], (NSString*) kCGImageSourceCreateThumbnailFromImageAlways,
+					[NSNumber numberWithBool:YES], (NSString*) kCGImageSourceShouldCacheImmediately,
+					[NSNumber numberWithUnsignedInteger:(NSUInteger) MAX( ls.width, ls.height )], (NSString*) kCGImageSourceThumbnailMaxPixelSize,
+					nil];
+		image = CGImageSourceCreateThumbnailAtIndex( source, 0, (CFDictionaryRef) options );
+	}
+
+	if( image == NULL )
+		return NO;
+
+	NSUInteger			ts = kDKTiledImagePyramidTileSize;
+	NSUInteger			w = (NSUInteger) ls.width;
+	NSUInteger			h = (NSUInteger) ls.height;
+	NSUInteger			col, row, bh;
+	CGColorSpaceRef		space = CGColorSpaceCreateDeviceRGB();
+	CGContextRef		ctx;
+	CGImageRef			strip, band, tile;
+	NSAutoreleasePool*	pool;
+	BOOL				ok = YES;
+
+	for( row = 0; row * ts < h && ok && !mCancelled; ++row )
+	{
+		pool = [NSAutoreleasePool new];
+
+		bh = MIN( ts, h - row * ts );
+		ctx = CGBitmapContextCreate( NULL, w, bh, 8, 0, space, kCGImageAlphaPremultipliedLast );
+
+		if( ctx == NULL )
+		{
+			ok = NO;
+			[pool drain];
+			break;
+		}
+
+		// the image's rows are counted from the top, so the strip for this row fills the band context exactly. A reduced image, whose size may
+		// differ from the level's by rounding, is drawn whole at the level's size, positioned so that this row falls within the band.
+
+		if( mFirstLevel == 0 )
+		{
+			strip = CGImageCreateWithImageInRect( image, CGRectMake( 0, row * ts, w, bh ));
+			CGContextDrawImage( ctx, CGRectMake( 0, 0, w, bh ), strip );
+			CGImageRelease( strip );
+		}
+		else
+		{
+			CGContextSetInterpolationQuality( ctx, kCGInterpolationHigh );
+			CGContextDrawImage( ctx, CGRectMake( 0, (CGFloat) bh + row * ts - h, w, h ), image );
+		}
+
+		band = CGBitmapContextCreateImage( ctx );
+		CGContextRelease( ctx );
+
+		for( col = 0; col * ts < w && ok && !mCancelled; ++col )
+		{
+			tile = CGImageCreateWithImageInRect( band, CGRectMake( col * ts, 0, MIN( ts, w - col * ts ), bh ));
+			ok = [self writeTileImage:tile level:mFirstLevel column:col row:row];
+			CGImageRelease( tile );
+		}
+
+		CGImageRelease( band );
+		[pool drain];
+	}
+
+	CGColorSpaceRelease( space );
+	CGImageRelease( image );
+
+	return ok && !mCancelled;
+}
+
+
+- (BOOL)				buildLevel:(NSUInteger) level
+{
+	// makes each tile of the level by drawing the four tiles below it at half size, so only a few tiles are in memory at once
+
+	NSSize				ls = [self pixelSizeOfLevel:level];
+	NSUInteger			ts = kDKTiledImagePyramidTileSize;
+	NSUInteger			w = (NSUInteger) ls.width;
+	NSUInteger			h = (NSUInteger) ls.height;
+	NSUInteger			col, row, tw, th, dx, dy;
+	CGColorSpaceRef		space = CGColorSpaceCreateDeviceRGB();
+	CGContextRef		ctx;
+	CGImageRef			child, tile;
+	CGFloat				cw, ch;
+	NSAutoreleasePool*	pool;
+	BOOL				ok = YES;
+
+	for( row = 0; row * ts < h && ok && !mCancelled; ++row )
+	{
+		pool = [NSAutoreleasePool new];
+
+		for( col = 0; col * ts < w && ok && !mCancelled; ++col )
+		{
+			tw = MIN( ts, w - col * ts );
+			th = MIN( ts, h - row * ts );
+			ctx = CGBitmapContextCreate( NULL, tw, th, 8, 0, space, kCGImageAlphaPremultipliedLast );
+
+			if( ctx == NULL )
+			{
+				ok = NO;
+				break;
+			}
+
+			CGContextSetInterpolationQuality( ctx, kCGInterpolationHigh );
+
+			for( dy = 0; dy < 2; ++dy )
+			{
+				for( dx = 0; dx < 2; ++dx )
+				{
+					child = [self newTileImageAtLevel:level - 1 column:col * 2 + dx row:row * 2 + dy];
+
+					if( child != NULL )
+					{
+						// children are placed from the top left, but the context's origin is at the bottom left
+
+						cw = CGImageGetWidth( child ) * 0.5;
+						ch = CGImageGetHeight( child ) * 0.5;
+						CGContextDrawImage( ctx, CGRectMake( dx * ts * 0.5, th - dy * ts * 0.5 - ch, cw, ch ), child );
+						CGImageRelease( child );
+					}
+				}
+			}
+
+			tile = CGBitmapContextCreateImage( ctx );
+			ok = [self writeTileImage:tile level:level column:col row:row];
+			CGImageRelease( tile );
+			CGContextRelease( ctx );
+		}
+
+		[pool drain];
+	}
+
+	CGColorSpaceRelease( space );
+
+	return ok && !mCancelled;
+}
+
+
+- (CGImageRef)			newTileImageAtLevel:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row
+{
+	// reads and decodes a tile from disk - the caller must release the result
+
+	NSURL*				url = [NSURL fileURLWithPath:[self tilePathForLevel:level column:col row:row]];
+	CGImageSourceRef	source = CGImageSourceCreateWithURL((CFURLRef) url, NULL );
+	CGImageRef			image = NULL;
+
+	if( source != NULL )
+	{
+		NSDictionary* options = [NSDictionary dictionaryWithObject:[NSNumber numberWithBool:YES] forKey:(NSString*) kCGImageSourceShouldCacheImmediately];
+
+		if( CGImageSourceGetCount( source ) > 0 )
+			image = CGImageSourceCreateImageAtIndex( source, 0, (CFDictionaryRef) options );
+
+		CFRelease( source );
+	}
+
+	return image;
+}
+
+
+- (BOOL)				writeTileImage:(CGImageRef) image level:(NSUInteger) level column:(NSUInteger) col row:(NSUInteger) row
+{
+	// tiles are stored as PNG so that transparency is kept
+
+	if( image == NULL )
+		return NO;
+
+	NSURL*					url = [NSURL fileURLWithPath:[self tilePathForLevel:level column:col row:row]];
+	CGImageDestinationRef	dest = CGImageDestinationCreateWithURL((CFURLRef) url, CFSTR("public.png"), 1, NULL );
+	BOOL					ok = NO;
+
+	if( dest != NULL )
+	{
+		CGImageDestinationAddImage( dest, image, NULL );
+		ok = CGImageDestinationFinalize( dest );
+		CFRelease( dest );
+	}
+
+	return ok;
+}
+
+
+- (void)				previewDidBuild:(NSBitmapImageRep*) preview
+{
+	[preview retain];
+	[mPreview release];
+	mPreview = preview;
+
+	[[NSNotificationCenter defaultCenter] postNotificationName:kDKTiledImagePyramidDidUpdate object:self];
+}
+
+
+- (void)				levelDidBuild:(NSNumber*) levelsBuilt
+{
+	mLevelsBuilt = [levelsBuilt unsignedIntegerValue];
+
+	// once complete the preview is never drawn again
+
+	if([self isComplete])
+	{
+		[mPreview release];
+		mPreview = nil;
+	}
+
+	[[NSNotificationCenter defaultCenter] postNotificationName:kDKTiledImagePyramidDidUpdate object:self];
+}
+
+
+- (void)				buildDidFinish:(id) obj
+{
+	#pragma unused(obj)
+
+	// moves the completed tiles into place, replacing any stale tile directory, then releases the build lock. If another process has already
+	// put a complete set there, that is used instead. Tiles continue to be read from the temporary directory, and the lock held, if it can't
+	// be moved.
+
+	NSFileManager*	fm = [NSFileManager defaultManager];
+	NSDictionary*	existing = [NSDictionary dictionaryWithContentsOfFile:[mTileDirectory stringByAppendingPathComponent:@"manifest.plist"]];
+
+	if([existing isEqualToDictionary:[self manifest]])
+		[fm removeItemAtPath:mBuildDirectory error:NULL];
+	else
+	{
+		[fm removeItemAtPath:mTileDirectory error:NULL];
+
+		if(![fm moveItemAtPath:mBuildDirectory toPath:mTileDirectory error:NULL])
+			return;
+	}
+
+	[mBuildDirectory release];
+	mBuildDirectory = nil;
+
+	close( mLockFile );
+	mLockFile = -1;
+	mHoldsBuildLock = NO;
+}
+
+
+#pragma mark -
+#pragma mark As an NSObject
+
+- (oneway void)			release
+{
+	// the registry of pyramids doesn't retain them, so a pyramid is removed from it under the same lock as lookups just before it is
+	// freed - this prevents it being found and retained by another thread while it is being deallocated
+
+	@synchronized([DKTiledImagePyramid class])
+	{
+		if([self retainCount] == 1 && mTileDirectory != nil && [[sPyramids objectForKey:mTileDirectory] nonretainedObjectValue] == self )
+			[sPyramids removeObjectForKey:mTileDirectory];
+
+		[super release];
+	}
+}
+
+
+- (void)				dealloc
+{
+	// an unfinished build's tiles are of no further use - but if the lock was never taken, the directory belongs to another process
+
+	if( mBuildDirectory != nil && mHoldsBuildLock )
+		[[NSFileManager defaultManager] removeItemAtPath:mBuildDirectory error:NULL];
+
+	if( mLockFile >= 0 )
+		close( mLockFile );
+
+	[mSourcePath release];
+	[mTileDirectory release];
+	[mBuildDirectory release];
+	[mPreview release];
+	[mTileCache release];
+	[super dealloc];
+}
+
+
+@end
@@ -120,6 +120,9 @@ static NSTimer* s_autoscrollTimer = nil;
 
 - (void)				setViewNeedsDisplay:(NSNumber*) updateBoolValue
 {
+	if([updateBoolValue boolValue] && [[self view] isKindOfClass:[DKDrawingView class]])
+		[(DKDrawingView*)[self view] invalidateAllTiles];
+	
 	[[self view] setNeedsDisplay:[updateBoolValue boolValue]];
 }
 
@@ -169,6 +172,10 @@ static NSTimer* s_autoscrollTimer = nil;
 	
 	[[self view] setFrameSize:fr];
 	[[self view] setBoundsSize:[drawingSizeValue sizeValue]];
+	
+	if([[self view] isKindOfClass:[DKDrawingView class]])
+		[(DKDrawingView*)[self view] invalidateAllTiles];
+	
 	[[self view] setNeedsDisplay:YES];
 }
 
@@ -47,7 +47,8 @@ restrictions: both operand paths must be closed.
 how it works:
 
 first, the points where the paths intersect are found by searching for intersections between flattened versions of the paths. This is the slowest part of the
-operation because every path segments needs to be tested against every path segment of the second path (after weeding out obvious non-intersecting points).
+operation, so each path keeps a cached bounding volume hierarchy of its segments' bounds. The two hierarchies are descended together and only segment pairs whose
+bounds overlap are tested, rather than every segment against every segment of the second path. The hierarchy is rebuilt if the path's checksum changes.
 
 then, the paths are split up into new path fragments at the intersecting points. Depending on which operation is being performed, some of these paths will be
 thrown away, and the rest joined up into the new path.
@@ -10,10 +10,49 @@
 #import "NSBezierPath+Combinatorial.h"
 #import "NSBezierPath-OAExtensions.h"
 #import "NSBezierPath+Geometry.h"
+#import "NSBezierPath+Editing.h"
+#import "DKGeometryUtilities.h"
+#import <objc/runtime.h>
+
+
+// segment bounds tree node. Leaf nodes have no children and refer to a run of <count> entries in the tree's element index list starting at <first>.
+
+typedef struct
+{
+	NSRect		bounds;
+	NSInteger	child[2];
+	NSInteger	first;
+	NSInteger	count;
+}
+_dkSegmentNode;
+
+
+// bounding volume hierarchy over the walked elements of a path, so that intersection searches only need to test element pairs whose bounds overlap.
+
+@interface DKPathSegmentTree : NSObject
+{
+@private
+	NSBezierPath*		mPath;			// the path that is indexed (possibly a renormalized version of the path it's cached by)
+	DKContentHash		mSourceHash;
+	NSInteger			mElementCount;
+	NSInteger*			mElements;		// element index of each walked element, reordered into leaf order during the build
+	NSRect*				mElementBounds;
+	_dkSegmentNode*		mNodes;
+	NSInteger			mNodeCount;
+}
+
+- (id)					initWithPath:(NSBezierPath*) path sourceHash:(DKContentHash) hash;
+- (NSBezierPath*)		path;
+- (DKContentHash)		sourceHash;
+- (PathIntersectionList)	intersectionsWithTree:(DKPathSegmentTree*) other;
+
+@end
 
 
 @interface NSBezierPath (CombinatorialPrivate)
 
+- (DKPathSegmentTree*)	segmentTreeRenormalized:(BOOL) renorm;
+
 - (void)			appendSplitElementFromPath:(NSBezierPath*) path withIntersectionInfo:(OABezierPathIntersection*) info rightOrLeft:(BOOL) isRight trailingOrLeading:(BOOL) isLeading;
 - (void)			appendElementsFromPath:(NSBezierPath*) path fromIndex:(NSInteger) firstIndex toIndex:(NSInteger) nextIndex;
 - (void)			appendElementsFromPath:(NSBezierPath*)path inRange:(NSRange) range;
@@ -26,12 +65,42 @@
 
 @implementation NSBezierPath (Combinatorial)
 
+static char		sSegmentTreeKey;
+static char		sRenormalizedSegmentTreeKey;
+
+
+- (DKPathSegmentTree*)	segmentTreeRenormalized:(BOOL) renorm
+{
+	// returns the segment bounds tree for the receiver (or its renormalized version), which is cached with the path. The cache is validated against the
+	// path's content hash so that a path that is mutated after the tree was built doesn't use stale bounds.
+	
+	void*				key = renorm? &sRenormalizedSegmentTreeKey : &sSegmentTreeKey;
+	DKContentHash		hash = [self contentHash];
+	DKPathSegmentTree*	tree = objc_getAssociatedObject( self, key );
+	
+	if( tree == nil || [tree sourceHash] != hash )
+	{
+		NSBezierPath* indexed = renorm? [self renormalizePath] : self;
+		
+		// don't let the tree retain the receiver itself, which would create a retain cycle through the associated object
+		
+		if( indexed == self )
+			indexed = [[self copy] autorelease];
+		
+		tree = [[DKPathSegmentTree alloc] initWithPath:indexed sourceHash:hash];
+		objc_setAssociatedObject( self, key, tree, OBJC_ASSOCIATION_RETAIN_NONATOMIC );
+		[tree release];
+	}
+	
+	return tree;
+}
+
 
 - (void)	showIntersectionsWithPath:(NSBezierPath*) path
 {
 	// test method, uses the Omni code to find the intersections, then draws a blob at the found points.
 	
-	PathIntersectionList	ptList = [self allIntersectionsWithPath:path];
+	PathIntersectionList	ptList = [[self segmentTreeRenormalized:NO] intersectionsWithTree:[path segmentTreeRenormalized:NO]];
 	// walk the list, and draw
 	
 	OABezierPathIntersection	ps;
@@ -293,13 +362,17 @@
 	// first renormalize both contributing paths
 	
 	NSBezierPath* leftPath, *rightPath;
+	DKPathSegmentTree* leftTree, *rightTree;
 	
-	leftPath = [self renormalizePath];
-	rightPath = [path renormalizePath];
+	leftTree = [self segmentTreeRenormalized:YES];
+	rightTree = [path segmentTreeRenormalized:YES];
+	
+	leftPath = [leftTree path];
+	rightPath = [rightTree path];
 	
 	// find the intersections
 	
-	PathIntersectionList	ptList = [leftPath allIntersectionsWithPath:rightPath];
+	PathIntersectionList	ptList = [leftTree intersectionsWithTree:rightTree];
 	
 	// assemble the new path. We start at the first intersection point, which will begin the new path. This point is common to all operations, unlike the first point
 	// of either source path, which may not be included in an intersection.
@@ -457,13 +530,17 @@
 	// normalize
 	
 	NSBezierPath* left, *right;
+	DKPathSegmentTree* leftTree, *rightTree;
+	
+	leftTree = [self segmentTreeRenormalized:YES];
+	rightTree = [path segmentTreeRenormalized:YES];
 	
-	left = [self renormalizePath];
-	right = [path renormalizePath];
+	left = [leftTree path];
+	right = [rightTree path];
 	
 	// find the intersections
 	
-	PathIntersectionList ptList = [left allIntersectionsWithPath:right];
+	PathIntersectionList ptList = [leftTree intersectionsWithTree:rightTree];
 	
 	leftParts = [left breakApartWithIntersectionInfo:ptList rightOrLeft:NO];
 	//rightParts = [right breakApartWithIntersectionInfo:ptList rightOrLeft:YES];
@@ -478,3 +555,256 @@
 
 
 @end
+
+
+
+#pragma mark -
+
+#define		kDKSegmentTreeLeafSize		4			// max elements per leaf node
+#define		kDKSegmentTreeTolerance		0.001		// bounds are outset by this so that horizontal and vertical lines have some area
+
+
+static int			compareElementPairs( const void* a, const void* b )
+{
+	const OABezierPathElementPair* pa = a;
+	const OABezierPathElementPair* pb = b;
+	
+	if( pa->left != pb->left )
+		return ( pa->left < pb->left )? -1 : 1;
+	
+	if( pa->right != pb->right )
+		return ( pa->right < pb->right )? -1 : 1;
+	
+	return 0;
+}
+
+
+static inline BOOL	boundsOverlap( NSRect a, NSRect b )
+{
+	// unlike NSIntersectsRect, this is inclusive at the edges
+	
+	return NSMinX( a ) <= NSMaxX( b ) && NSMinX( b ) <= NSMaxX( a ) && NSMinY( a ) <= NSMaxY( b ) && NSMinY( b ) <= NSMaxY( a );
+}
+
+
+@implementation DKPathSegmentTree
+
+
+- (NSInteger)		buildNodeWithFirst:(NSInteger) first count:(NSInteger) count
+{
+	// recursively builds the tree over the element range given, splitting at the median of the longest axis of the range's bounds. Returns the node index.
+	
+	NSInteger	nodeIndex = mNodeCount++;
+	NSRect		bounds = mElementBounds[first];
+	NSInteger	i, j;
+	
+	for( i = first + 1; i < first + count; ++i )
+		bounds = NSUnionRect( bounds, mElementBounds[i] );
+	
+	mNodes[nodeIndex].bounds = bounds;
+	mNodes[nodeIndex].first = first;
+	mNodes[nodeIndex].count = count;
+	mNodes[nodeIndex].child[0] = mNodes[nodeIndex].child[1] = -1;
+	
+	if( count <= kDKSegmentTreeLeafSize )
+		return nodeIndex;
+	
+	// sort the range by the centre of each element along the longest axis - a simple insertion sort is fine as ranges are already roughly in order
+	// because consecutive path elements are spatially coherent.
+	
+	BOOL horizontal = NSWidth( bounds ) >= NSHeight( bounds );
+	
+	for( i = first + 1; i < first + count; ++i )
+	{
+		NSRect		br = mElementBounds[i];
+		NSInteger	be = mElements[i];
+		CGFloat		c = horizontal? NSMidX( br ) : NSMidY( br );
+		
+		for( j = i - 1; j >= first && ( horizontal? NSMidX( mElementBounds[j] ) : NSMidY( mElementBounds[j] )) > c; --j )
+		{
+			mElementBounds[j + 1] = mElementBounds[j];
+			mElements[j + 1] = mElements[j];
+		}
+		mElementBounds[j + 1] = br;
+		mElements[j + 1] = be;
+	}
+	
+	NSInteger half = count / 2;
+	NSInteger left = [self buildNodeWithFirst:first count:half];
+	NSInteger right = [self buildNodeWithFirst:first + half count:count - half];
+	
+	mNodes[nodeIndex].child[0] = left;
+	mNodes[nodeIndex].child[1] = right;
+	
+	return nodeIndex;
+}
+
+
+- (id)				initWithPath:(NSBezierPath*) path sourceHash:(DKContentHash) hash
+{
+	NSAssert( path != nil, @"can't build a segment tree for a nil path");
+	
+	self = [super init];
+	if( self )
+	{
+		mPath = [path retain];
+		mSourceHash = hash;
+		
+		// walk the path exactly as the intersection code will, so that element indexes match. Lines are bounded by their end points, curves by their control hull.
+		
+		subpathWalkingState	iter;
+		NSInteger			size = 16;
+		
+		mElements = malloc( sizeof( NSInteger ) * size );
+		mElementBounds = malloc( sizeof( NSRect ) * size );
+		
+		if( initializeSubpathWalkingState( &iter, path, 0, NO ))
+		{
+			while( nextSubpathElement( &iter ))
+			{
+				NSRect br;
+				
+				if( mElementCount >= size )
+				{
+					size += ( size >> 1 );
+					mElements = realloc( mElements, sizeof( NSInteger ) * size );
+					mElementBounds = realloc( mElementBounds, sizeof( NSRect ) * size );
+				}
+				
+				if( iter.what == NSCurveToBezierPathElement )
+					br = NSUnionRect( NSRectFromTwoPoints( iter.points[0], iter.points[3] ), NSRectFromTwoPoints( iter.points[1], iter.points[2] ));
+				else
+					br = NSRectFromTwoPoints( iter.points[0], iter.points[1] );
+				
+				mElements[mElementCount] = iter.currentElt;
+				mElementBounds[mElementCount] = NSInsetRect( br, -kDKSegmentTreeTolerance, -kDKSegmentTreeTolerance );
+				++mElementCount;
+			}
+		}
+		
+		if( mElementCount > 0 )
+		{
+			mNodes = malloc( sizeof( _dkSegmentNode ) * mElementCount * 2 );
+			[self buildNodeWithFirst:0 count:mElementCount];
+		}
+	}
+	
+	return self;
+}
+
+
+- (NSBezierPath*)	path
+{
+	return mPath;
+}
+
+
+- (DKContentHash)	sourceHash
+{
+	return mSourceHash;
+}
+
+
+- (PathIntersectionList)	intersectionsWithTree:(DKPathSegmentTree*) other
+{
+	// finds the intersections between the indexed paths. The two trees are descended together so that only elements whose bounds overlap are
+	// passed to the (expensive) curve intersection code.
+	
+	NSAssert( other != nil, @"can't intersect with a nil tree");
+	
+	if( mNodeCount == 0 || other->mNodeCount == 0 )
+		return (PathIntersectionList){ 0, NULL };
+	
+	NSUInteger					pairCount = 0, pairSize = 64;
+	OABezierPathElementPair*	pairs = malloc( sizeof( OABezierPathElementPair ) * pairSize );
+	NSInteger					stackSize = 64, sp = 0;
+	NSInteger*					stack = malloc( sizeof( NSInteger ) * stackSize * 2 );
+	
+	stack[sp++] = 0;
+	stack[sp++] = 0;
+	
+	while( sp > 0 )
+	{
+		NSInteger			bi = stack[--sp];
+		NSInteger			ai = stack[--sp];
+		_dkSegmentNode*		a = &mNodes[ai];
+		_dkSegmentNode*		b = &other->mNodes[bi];
+		
+		if( !boundsOverlap( a->bounds, b->bounds ))
+			continue;
+		
+		BOOL aLeaf = ( a->child[0] < 0 );
+		BOOL bLeaf = ( b->child[0] < 0 );
+		
+		if( aLeaf && bLeaf )
+		{
+			NSInteger i, j;
+			
+			for( i = a->first; i < a->first + a->count; ++i )
+			{
+				for( j = b->first; j < b->first + b->count; ++j )
+				{
+					if( boundsOverlap( mElementBounds[i], other->mElementBounds[j] ))
+					{
+						if( pairCount >= pairSize )
+						{
+							pairSize += ( pairSize >> 1 );
+							pairs = realloc( pairs, sizeof( OABezierPathElementPair ) * pairSize );
+						}
+						pairs[pairCount].left = mElements[i];
+						pairs[pairCount].right = other->mElements[j];
+						++pairCount;
+					}
+				}
+			}
+			continue;
+		}
+		
+		if( sp + 4 > stackSize * 2 )
+		{
+			stackSize *= 2;
+			stack = realloc( stack, sizeof( NSInteger ) * stackSize * 2 );
+		}
+		
+		// descend into the larger node (or the only non-leaf one)
+		
+		if( bLeaf || ( !aLeaf && NSWidth( a->bounds ) * NSHeight( a->bounds ) >= NSWidth( b->bounds ) * NSHeight( b->bounds )))
+		{
+			stack[sp++] = a->child[0];
+			stack[sp++] = bi;
+			stack[sp++] = a->child[1];
+			stack[sp++] = bi;
+		}
+		else
+		{
+			stack[sp++] = ai;
+			stack[sp++] = b->child[0];
+			stack[sp++] = ai;
+			stack[sp++] = b->child[1];
+		}
+	}
+	
+	free( stack );
+	
+	// the intersection code requires the pairs in path order so that the resulting list is ordered the same as a brute force search
+	
+	qsort( pairs, pairCount, sizeof( OABezierPathElementPair ), compareElementPairs );
+	
+	PathIntersectionList result = [mPath allIntersectionsWithPath:other->mPath elementPairs:pairs count:pairCount];
+	free( pairs );
+	
+	return result;
+}
+
+
+- (void)			dealloc
+{
+	[mPath release];
+	free( mElements );
+	free( mElementBounds );
+	free( mNodes );
+	[super dealloc];
+}
+
+
+@end
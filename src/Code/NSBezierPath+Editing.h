@@ -9,9 +9,10 @@
 ///**********************************************************************************************************************************
 
 #import <Cocoa/Cocoa.h>
+#import "DKContentHash.h"
 
 
-@interface NSBezierPath (DKEditing)
+@interface NSBezierPath (DKEditing) <DKContentHashing>
 
 + (void)				setConstraintAngle:(CGFloat) radians;
 + (NSPoint)				colinearPointForPoint:(NSPoint) p centrePoint:(NSPoint) q;
@@ -28,6 +29,8 @@
 
 - (BOOL)				isPathClosed;
 - (NSUInteger)			checksum;
+- (DKContentHash)		contentHash;
+- (DKContentHash)		shapeHash;
 
 - (BOOL)				subpathContainingElementIsClosed:(NSInteger) element;
 - (NSInteger)			subpathStartingElementForElement:(NSInteger) element;
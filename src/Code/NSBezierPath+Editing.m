@@ -399,32 +399,75 @@ static inline NSInteger		elementIndexForPartcode( const NSInteger pc );
 {
 	// returns a value that may be considered unique for this path. Comparing a path's checksum with a previous value can be used to determine whether the path has changed.
 	// Do not rely on the actual value returned, only whether it's the same as a previous value or another path. Do not archive or persist this value. Note that two paths
-	// with identical contents will return the same value, which might be a useful trait.
+	// with identical contents will return the same value, which might be a useful trait. This is now simply the content hash, which is exact rather than rounded.
 	
-	NSUInteger			cs = 157145267; // start with arbitrary number
-	NSUInteger			ec = (NSUInteger)[self elementCount];
+	return (NSUInteger)[self contentHash];
+}
+
+
+- (DKContentHash)		contentHash
+{
+	// returns a 64-bit hash of the path's element types and the exact values of all of its points. Any change to the path, however small, gives a different
+	// value, and unrelated paths are very unlikely to collide, so this is suitable as a cache key. Only the geometry is considered - the line width, dash and
+	// so on are not included. As with -checksum, do not persist the value.
+	
+	NSInteger			i, ec = [self elementCount];
 	NSPoint				p[3];
-	NSInteger					i;
 	NSBezierPathElement	element;
+	DKContentHash		h = DKHashCombine( kDKContentHashSeed, (uint64_t) ec );
+	
+	for( i = 0; i < ec; ++i )
+	{
+		element = [self elementAtIndex:i associatedPoints:p];
+		h = DKHashCombine( h, (uint64_t) element );
+		
+		if( element == NSCurveToBezierPathElement )
+		{
+			h = DKHashPoint( h, p[0] );
+			h = DKHashPoint( h, p[1] );
+			h = DKHashPoint( h, p[2] );
+		}
+		else if( element != NSClosePathBezierPathElement )
+			h = DKHashPoint( h, p[0] );
+	}
 	
-	// munge with element count
+	return h;
+}
+
+
+- (DKContentHash)		shapeHash
+{
+	// returns a 64-bit hash of the path's element types and points, taken relative to the first point so that the same shape in a different position
+	// gives the same value. Points are quantized to 1/100 of a unit so that the tiny rounding errors introduced by transforming a path don't change the result.
+	// This only walks the elements, so it is much cheaper than anything that measures the path (e.g. -length). As with -checksum, do not persist the value.
 	
-	cs ^= ( ec << 5 );
+	NSInteger			i, ec = [self elementCount];
+	NSPoint				p[3], origin = NSZeroPoint;
+	NSBezierPathElement	element;
+	DKContentHash		h = DKHashCombine( kDKContentHashSeed, (uint64_t) ec );
 	
-	if( ![self isEmpty])
+	for( i = 0; i < ec; ++i )
 	{
-		// munge all the internal points together
+		p[1] = p[2] = NSZeroPoint;
+		element = [self elementAtIndex:i associatedPoints:p];
+		
+		if( i == 0 )
+			origin = p[0];
+		
+		h = DKHashCombine( h, (uint64_t) element );
+		h = DKHashCombine( h, (uint64_t) llround(( p[0].x - origin.x ) * 100.0 ));
+		h = DKHashCombine( h, (uint64_t) llround(( p[0].y - origin.y ) * 100.0 ));
 		
-		for( i = 0; i < [self elementCount]; ++i )
+		if( element == NSCurveToBezierPathElement )
 		{
-			p[1] = p[2] = NSZeroPoint;
-			element = [self elementAtIndex:i associatedPoints:p];
-			ec = ((NSUInteger) element << 10 ) ^ lround( p[0].x ) ^ lround( p[1].x ) ^ lround( p[2].x ) ^ lround( p[0].y ) ^ lround( p[1].y ) ^ lround( p[2].y );
-			cs ^= ec;
+			h = DKHashCombine( h, (uint64_t) llround(( p[1].x - origin.x ) * 100.0 ));
+			h = DKHashCombine( h, (uint64_t) llround(( p[1].y - origin.y ) * 100.0 ));
+			h = DKHashCombine( h, (uint64_t) llround(( p[2].x - origin.x ) * 100.0 ));
+			h = DKHashCombine( h, (uint64_t) llround(( p[2].y - origin.y ) * 100.0 ));
 		}
 	}
 	
-	return cs;
+	return h;
 }
 
 
@@ -29,6 +29,7 @@ typedef NS_ENUM(NSInteger, DKPathUnflatteningPolicy)
 
 + (NSBezierPath*)		bezierPathWithGPCPolygon:(gpc_polygon*) poly;
 @property (class) DKPathUnflatteningPolicy pathUnflatteningPolicy;
+@property (class) BOOL unflatteningUsesFastTolerance;
 
 - (gpc_polygon*)		gpcPolygon;
 - (gpc_polygon*)		gpcPolygonWithFlatness:(CGFloat) flatness;
@@ -50,6 +51,7 @@ typedef NS_ENUM(NSInteger, DKPathUnflatteningPolicy)
 // unflatten a poly-based path using curve fitting
 
 - (NSBezierPath*)		bezierPathByUnflatteningPath;
+- (NSBezierPath*)		bezierPathByUnflatteningPathUsingFastTolerance:(BOOL) fast;
 
 
 @end
@@ -62,6 +64,7 @@ BOOL		intersectingPolys( gpc_polygon* polyA, gpc_polygon* polyB );
 #define		kDKCurveFittingErrorValue		1E-4
 
 extern NSString* kDKCurveFittingPolicyDefaultsKey;
+extern NSString* kDKCurveFittingFastToleranceDefaultsKey;
 
 /*
 
@@ -78,6 +81,10 @@ shapes such as rects, etc.
 
 For simplifying a path at any other time, you must pass a flattened path. Simplifying really means "unflattening".
 
+Each subpath of the path being unflattened is independent, so on multi-core machines complex results are fitted one subpath per
+worker thread and reassembled in order. Setting the fast tolerance mode leaves short polyline runs as line segments instead of fitting
+them, which is much quicker for booleans on complex shapes at the cost of a slightly less smooth result.
+
 */
 
 #endif /* defined (qUseGPC) */
@@ -28,6 +28,7 @@ static void		logPoly( gpc_polygon* poly );
 
 
 NSString*	kDKCurveFittingPolicyDefaultsKey = @"DKCurveFittingPolicy";
+NSString*	kDKCurveFittingFastToleranceDefaultsKey = @"DKCurveFittingFastTolerance";
 
 #pragma mark -
 @implementation NSBezierPath (GPC)
@@ -122,6 +123,46 @@ NSString*	kDKCurveFittingPolicyDefaultsKey = @"DKCurveFittingPolicy";
 }
 
 
+///*********************************************************************************************************************
+///
+/// method:			setUnflatteningUsesFastTolerance:
+/// scope:			class method
+/// overrides:
+/// description:	sets whether curve fitting after a boolean op skips short polyline runs
+/// 
+/// parameters:		<fast> YES to leave short runs as line segments, NO to fit everything
+/// result:			none
+///
+/// notes:			fast mode trades a little smoothness for speed - see kDKCurveFitFastMinimumSpan
+///
+///********************************************************************************************************************
+
++ (void)				setUnflatteningUsesFastTolerance:(BOOL) fast
+{
+	[[NSUserDefaults standardUserDefaults] setBool:fast forKey:kDKCurveFittingFastToleranceDefaultsKey];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			unflatteningUsesFastTolerance
+/// scope:			class method
+/// overrides:
+/// description:	returns whether curve fitting after a boolean op skips short polyline runs
+/// 
+/// parameters:		none
+/// result:			YES if fast mode is in use
+///
+/// notes:			
+///
+///********************************************************************************************************************
+
++ (BOOL)				unflatteningUsesFastTolerance
+{
+	return [[NSUserDefaults standardUserDefaults] boolForKey:kDKCurveFittingFastToleranceDefaultsKey];
+}
+
+
 #pragma mark -
 ///*********************************************************************************************************************
 ///
@@ -594,6 +635,26 @@ NSString*	kDKCurveFittingPolicyDefaultsKey = @"DKCurveFittingPolicy";
 ///********************************************************************************************************************
 
 - (NSBezierPath*)		bezierPathByUnflatteningPath
+{
+	return [self bezierPathByUnflatteningPathUsingFastTolerance:[[self class] unflatteningUsesFastTolerance]];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			bezierPathByUnflatteningPathUsingFastTolerance:
+/// scope:			instance method
+/// extends:		NSBezierPath
+/// description:	creates a new path which is the unflattened version of this
+/// 
+/// parameters:		<fast> YES to leave short polyline runs unfitted, NO to fit everything
+/// result:			the unflattened path (curve fitted)
+///
+/// notes:			subpaths are fitted concurrently when the path is complex enough to benefit
+///
+///********************************************************************************************************************
+
+- (NSBezierPath*)		bezierPathByUnflatteningPathUsingFastTolerance:(BOOL) fast
 {
 	if([self isEmpty])
 		return self;
@@ -602,10 +663,10 @@ NSString*	kDKCurveFittingPolicyDefaultsKey = @"DKCurveFittingPolicy";
 	
 	CGFloat epsilon = MIN( ps.width, ps.height ) / 1000.0;
 	
-	LogEvent_(kInfoEvent, @"curve fit epsilon: %f", epsilon );
+	LogEvent_(kInfoEvent, @"curve fit epsilon: %f, fast: %d", epsilon, fast );
 
 #ifdef qUseCurveFit
-	return smartCurveFitPath( self, epsilon, kDKDefaultCornerThreshold );
+	return smartCurveFitPathWithMinimumSpan( self, epsilon, kDKDefaultCornerThreshold, fast? kDKCurveFitFastMinimumSpan : 0 );
 #else
 	return self;
 #endif
@@ -51,6 +51,10 @@
 - (NSBezierPath*)		bezierPathWithRoughenedStrokeOutline:(CGFloat) amount;
 - (NSBezierPath*)		bezierPathWithFragmentedLineSegments:(CGFloat) flatness;
 
+// simplifying dense paths for drawing at small scales
+
+- (NSBezierPath*)		bezierPathBySimplifyingWithTolerance:(CGFloat) tolerance;
+
 // zig-zags and waves
 
 - (NSBezierPath*)		bezierPathWithZig:(CGFloat) zig zag:(CGFloat) zag;
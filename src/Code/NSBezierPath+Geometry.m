@@ -2424,6 +2424,182 @@ static CGFloat subdivideBezierAtLength (const NSPoint bez[4],
 }
 
 
+#pragma mark -
+#pragma mark - simplifying paths (level of detail)
+
+static void			simplifyPolyline( const NSPoint* pts, NSInteger first, NSInteger last, CGFloat tolerance, BOOL* keep )
+{
+	// Douglas-Peucker - marks the points between <first> and <last> that must be kept so that no discarded point is further than <tolerance>
+	// from the simplified polyline. Uses an explicit stack rather than recursion as traced paths can have very long runs.
+	
+	NSInteger*	stack = malloc( sizeof( NSInteger ) * 2 * ( last - first + 1 ));
+	NSInteger	sp = 0;
+	
+	stack[sp++] = first;
+	stack[sp++] = last;
+	
+	while( sp > 0 )
+	{
+		NSInteger	b = stack[--sp];
+		NSInteger	a = stack[--sp];
+		NSInteger	i, farthest = -1;
+		CGFloat		d, maxDist = tolerance;
+		
+		for( i = a + 1; i < b; ++i )
+		{
+			d = PointFromLine( pts[i], pts[a], pts[b] );
+			
+			if( d > maxDist )
+			{
+				maxDist = d;
+				farthest = i;
+			}
+		}
+		
+		if( farthest >= 0 )
+		{
+			keep[farthest] = YES;
+			stack[sp++] = a;
+			stack[sp++] = farthest;
+			stack[sp++] = farthest;
+			stack[sp++] = b;
+		}
+	}
+	
+	free( stack );
+}
+
+
+static void			appendSimplifiedSubpath( NSBezierPath* path, const NSPoint* pts, NSInteger count, BOOL closed, CGFloat tolerance )
+{
+	if( count < 1 )
+		return;
+	
+	BOOL*		keep = calloc( count, sizeof( BOOL ));
+	NSInteger	i;
+	
+	keep[0] = keep[count - 1] = YES;
+	
+	if( closed && count > 2 )
+	{
+		// a closed loop's end points coincide, so anchor the simplification on the point farthest from the start as well
+		
+		NSInteger	far = 0;
+		CGFloat		d, maxDist = -1;
+		
+		for( i = 1; i < count; ++i )
+		{
+			d = DiffPointSquaredLength( pts[i], pts[0] );
+			
+			if( d > maxDist )
+			{
+				maxDist = d;
+				far = i;
+			}
+		}
+		
+		keep[far] = YES;
+		simplifyPolyline( pts, 0, far, tolerance, keep );
+		simplifyPolyline( pts, far, count - 1, tolerance, keep );
+	}
+	else if( count > 2 )
+		simplifyPolyline( pts, 0, count - 1, tolerance, keep );
+	
+	[path moveToPoint:pts[0]];
+	
+	for( i = 1; i < count; ++i )
+	{
+		if( keep[i] )
+			[path lineToPoint:pts[i]];
+	}
+	
+	if( closed )
+		[path closePath];
+	
+	free( keep );
+}
+
+
+- (NSBezierPath*)		bezierPathBySimplifyingWithTolerance:(CGFloat) tolerance
+{
+	// returns a flattened, simplified version of the path in which no point deviates from the original by more than <tolerance>. This is intended for
+	// drawing dense paths at small scales, where <tolerance> is a fraction of a device pixel in path units, so the result looks the same but has far fewer
+	// vertices. It is not suitable for editing or hit-testing. The path's stroke attributes and winding rule are copied to the result.
+	
+	NSAssert( tolerance > 0.0, @"simplifying tolerance must be greater than zero");
+	
+	NSBezierPath*	result = [NSBezierPath bezierPath];
+	NSBezierPath*	flat;
+	
+	[result setWindingRule:[self windingRule]];
+	[result setLineWidth:[self lineWidth]];
+	[result setLineCapStyle:[self lineCapStyle]];
+	[result setLineJoinStyle:[self lineJoinStyle]];
+	[result setMiterLimit:[self miterLimit]];
+	
+	NSInteger dashCount = 0;
+	[self getLineDash:NULL count:&dashCount phase:NULL];
+	
+	if( dashCount > 0 )
+	{
+		CGFloat*	dash = malloc( sizeof( CGFloat ) * dashCount );
+		CGFloat		phase;
+		
+		[self getLineDash:dash count:NULL phase:&phase];
+		[result setLineDash:dash count:dashCount phase:phase];
+		free( dash );
+	}
+	
+	// flatten at the same tolerance so that curves contribute their share of the error budget. The flatness is set on a copy rather
+	// than as the default, which is shared by all threads.
+	
+	flat = [[self copy] autorelease];
+	[flat setFlatness:tolerance];
+	flat = [flat bezierPathByFlatteningPath];
+	
+	NSInteger			i, ec = [flat elementCount];
+	NSInteger			count = 0;
+	NSPoint*			pts = malloc( sizeof( NSPoint ) * ( ec + 1 ));
+	NSPoint				ap[3];
+	NSBezierPathElement	element;
+	
+	for( i = 0; i < ec; ++i )
+	{
+		element = [flat elementAtIndex:i associatedPoints:ap];
+		
+		switch( element )
+		{
+			case NSMoveToBezierPathElement:
+				appendSimplifiedSubpath( result, pts, count, NO, tolerance );
+				pts[0] = ap[0];
+				count = 1;
+				break;
+				
+			case NSLineToBezierPathElement:
+				pts[count++] = ap[0];
+				break;
+				
+			case NSClosePathBezierPathElement:
+				if( count > 0 )
+				{
+					pts[count] = pts[0];
+					appendSimplifiedSubpath( result, pts, count + 1, YES, tolerance );
+				}
+				count = 0;
+				break;
+				
+			default:
+				break;
+		}
+	}
+	
+	appendSimplifiedSubpath( result, pts, count, NO, tolerance );
+	free( pts );
+	
+	return result;
+}
+
+
 #pragma mark -
 /* Append a Bezier path, but if it starts with a -moveToPoint, then remove
    it.  This is useful when manipulating trimmed path segments. */
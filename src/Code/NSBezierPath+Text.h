@@ -8,6 +8,9 @@
 
 #import <Cocoa/Cocoa.h>
 
+
+@class DKLRUCache;
+
 // bezier path category:
 
 @interface NSBezierPath (TextOnPath)
@@ -16,6 +19,13 @@
 + (NSDictionary*)		textOnPathDefaultAttributes;
 + (void)				setTextOnPathDefaultAttributes:(NSDictionary*) attrs;
 
+// glyph outlines are cached process-wide, keyed by font, size and glyph, so that text laid out repeatedly only transforms them into place:
+
++ (DKLRUCache*)			glyphOutlineCache;
++ (void)				setGlyphOutlineCacheByteBudget:(NSUInteger) bytes;
++ (NSBezierPath*)		outlineOfGlyph:(NSGlyph) glyph inFont:(NSFont*) font;
+- (void)				appendCachedOutlineOfGlyph:(NSGlyph) glyph inFont:(NSFont*) font;
+
 // drawing text along a path - high level methods that use a default layout manager and don't use a cache:
 
 - (BOOL)				drawTextOnPath:(NSAttributedString*) str yOffset:(CGFloat) dy;
@@ -136,6 +146,8 @@
 
 #pragma mark -
 
+#define		kDKGlyphOutlineCacheDefaultByteBudget	(2 * 1024 * 1024)
+
 // helper objects used internally when accumulating or laying glyphs
 
 @interface DKTextOnPathGlyphAccumulator	: NSObject
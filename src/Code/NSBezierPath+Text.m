@@ -12,6 +12,8 @@
 #import "DKGeometryUtilities.h"
 #import "NSShadow+Scaling.h"
 #import "DKBezierLayoutManager.h"
+#import "DKLRUCache.h"
+#import "DKContentHash.h"
 
 
 
@@ -27,6 +29,8 @@ static NSString* kDKTextOnPathGlyphPositionCacheKey			= @"DKTextOnPathGlyphPosit
 static NSString* kDKTextOnPathChecksumCacheKey				= @"DKTextOnPathChecksum";
 static NSString* kDKTextOnPathTextFittedCacheKey			= @"DKTextOnPathTextFitted";
 
+static DKLRUCache*	sGlyphOutlineCache = nil;
+
 @implementation NSBezierPath (TextOnPath)
 
 
@@ -114,6 +118,129 @@ static NSDictionary*	s_TOPTextAttributes = nil;
 }
 
 
+#pragma mark -
+#pragma mark - cached glyph outlines
+
+///*********************************************************************************************************************
+///
+/// method:			glyphOutlineCache
+/// scope:			class method
+/// overrides:
+/// description:	returns the cache of glyph outlines shared by the whole process.
+/// 
+/// parameters:		none
+/// result:			the cache
+///
+/// notes:			its hit/miss statistics can be used to tune the budget.
+///
+///********************************************************************************************************************
+
++ (DKLRUCache*)			glyphOutlineCache
+{
+	@synchronized([NSBezierPath class])
+	{
+		if( sGlyphOutlineCache == nil )
+			sGlyphOutlineCache = [[DKLRUCache alloc] initWithCostLimit:kDKGlyphOutlineCacheDefaultByteBudget];
+	}
+	
+	return sGlyphOutlineCache;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			setGlyphOutlineCacheByteBudget:
+/// scope:			class method
+/// overrides:
+/// description:	sets the approximate memory that cached glyph outlines may use.
+/// 
+/// parameters:		<bytes> the budget in bytes
+/// result:			none
+///
+/// notes:			reducing it discards outlines as necessary.
+///
+///********************************************************************************************************************
+
++ (void)				setGlyphOutlineCacheByteBudget:(NSUInteger) bytes
+{
+	[[self glyphOutlineCache] setCostLimit:bytes];
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			outlineOfGlyph:inFont:
+/// scope:			class method
+/// overrides:
+/// description:	returns the outline of a glyph, with its origin at 0,0.
+/// 
+/// parameters:		<glyph> the glyph
+///					<font> the font the glyph belongs to
+/// result:			the glyph's outline. It is shared, so must not be modified.
+///
+/// notes:			the outline is extracted from the font only the first time - after that it comes from the cache. The
+///					key covers the font's name, size and matrix as well as the glyph, so every distinct font gets its own
+///					outlines. May be called from any thread.
+///
+///********************************************************************************************************************
+
++ (NSBezierPath*)		outlineOfGlyph:(NSGlyph) glyph inFont:(NSFont*) font
+{
+	DKContentHash h = DKHashObject( kDKContentHashSeed, [font fontName]);
+	
+	h = DKHashFloat( h, [font pointSize]);
+	h = DKHashBytes( h, [font matrix], 6 * sizeof( CGFloat ));
+	h = DKHashCombine( h, glyph );
+	
+	DKLRUCache*		cache = [self glyphOutlineCache];
+	NSNumber*		key = [NSNumber numberWithUnsignedLongLong:h];
+	NSBezierPath*	outline = [cache objectForKey:key];
+	
+	if( outline == nil )
+	{
+		outline = [NSBezierPath bezierPath];
+		[outline moveToPoint:NSZeroPoint];
+		[outline appendBezierPathWithGlyph:glyph inFont:font];
+		
+		// the cost is an estimate of the memory used by the path's elements
+		
+		NSUInteger cost = [outline elementCount] * ( 3 * sizeof( NSPoint ) + sizeof( NSBezierPathElement )) + 64;
+		[cache setObject:outline forKey:key cost:cost];
+	}
+	
+	return outline;
+}
+
+
+///*********************************************************************************************************************
+///
+/// method:			appendCachedOutlineOfGlyph:inFont:
+/// scope:			instance method
+/// overrides:
+/// description:	appends the outline of a glyph at the current point, taking it from the glyph outline cache.
+/// 
+/// parameters:		<glyph> the glyph
+///					<font> the font the glyph belongs to
+/// result:			none
+///
+/// notes:			a faster equivalent of -appendBezierPathWithGlyph:inFont: for glyphs that are laid out repeatedly,
+///					except that the current point is not advanced. If the path is empty, the glyph is placed at 0,0.
+///
+///********************************************************************************************************************
+
+- (void)				appendCachedOutlineOfGlyph:(NSGlyph) glyph inFont:(NSFont*) font
+{
+	if( font == nil )
+		return;
+	
+	NSPoint				cp = [self isEmpty]? NSZeroPoint : [self currentPoint];
+	NSAffineTransform*	tfm = [NSAffineTransform transform];
+	
+	[tfm translateXBy:cp.x yBy:cp.y];
+	[self appendBezierPath:[tfm transformBezierPath:[[self class] outlineOfGlyph:glyph inFont:font]]];
+}
+
+
 #pragma mark -
 #pragma mark - drawing text along a path (high level)
 
@@ -1972,6 +2099,31 @@ static NSInteger				SortPointsHorizontally( NSValue* value1, NSValue* value2, vo
 #pragma mark - internal helper objects
 
 
+static BOOL		GlyphAttributesAreDrawableAsOutline( NSDictionary* attrs )
+{
+	// glyphs can be filled from their outlines if their attributes only affect their shape, placement and fill colour. Anything else, such as a
+	// stroke, shadow, background or attachment, needs the layout manager to draw it.
+	
+	static NSSet* sOutlineAttributes = nil;
+	
+	if( sOutlineAttributes == nil )
+		sOutlineAttributes = [[NSSet alloc] initWithObjects:NSFontAttributeName, NSForegroundColorAttributeName, NSParagraphStyleAttributeName,
+															NSKernAttributeName, NSLigatureAttributeName, nil];
+	
+	NSEnumerator*	iter = [attrs keyEnumerator];
+	NSString*		key;
+	
+	while(( key = [iter nextObject]))
+	{
+		if(![sOutlineAttributes containsObject:key])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
+
 @implementation DKTextOnPathGlyphAccumulator
 
 - (NSArray*)			glyphs
@@ -1996,7 +2148,7 @@ static NSInteger				SortPointsHorizontally( NSValue* value1, NSValue* value2, vo
 	
 	NSBezierPath* glyphTemp = [[NSBezierPath alloc] init];
 	[glyphTemp moveToPoint:NSMakePoint( 0, dy - base )];
-	[glyphTemp appendBezierPathWithGlyph:glyph inFont:font];
+	[glyphTemp appendCachedOutlineOfGlyph:glyph inFont:font];
 
 	// set up a transform to rotate the glyph to the path's local angle and flip it vertically
 	
@@ -2043,6 +2195,37 @@ static NSInteger				SortPointsHorizontally( NSValue* value1, NSValue* value2, vo
 	// this simply applies the current angle and transformation to the current context and asks the layout manager to draw the glyph. It is assumed that this is called
 	// within a valid drawing context, and that the context is flipped.
 	
+	// a glyph in plain coloured text can be filled from its cached outline instead, as DKTextOnPathGlyphAccumulator places it, which avoids
+	// the layout manager's glyph drawing machinery altogether
+	
+	if( ![lm notShownAttributeForGlyphAtIndex:glyphIndex])
+	{
+		NSUInteger		charIndex = [lm characterIndexForGlyphAtIndex:glyphIndex];
+		NSDictionary*	attrs = [[lm textStorage] attributesAtIndex:charIndex effectiveRange:NULL];
+		NSFont*			font = [attrs objectForKey:NSFontAttributeName];
+		
+		if( font != nil && GlyphAttributesAreDrawableAsOutline( attrs ))
+		{
+			NSColor* colour = [attrs objectForKey:NSForegroundColorAttributeName];
+			
+			NSBezierPath* glyphTemp = [NSBezierPath bezierPath];
+			[glyphTemp moveToPoint:NSMakePoint( 0, dy - [lm locationForGlyphAtIndex:glyphIndex].y )];
+			[glyphTemp appendCachedOutlineOfGlyph:[lm glyphAtIndex:glyphIndex] inFont:font];
+			
+			NSAffineTransform *transform = [NSAffineTransform transform];
+			[transform translateXBy:location.x yBy:location.y];
+			[transform rotateByRadians:angle];
+			[transform scaleXBy:1 yBy:-1];
+			[glyphTemp transformUsingAffineTransform:transform];
+			
+			SAVE_GRAPHICS_CONTEXT
+			[colour? colour : [NSColor blackColor] setFill];
+			[glyphTemp fill];
+			RESTORE_GRAPHICS_CONTEXT
+			return;
+		}
+	}
+	
 	SAVE_GRAPHICS_CONTEXT
 	
 	NSPoint gp = [lm locationForGlyphAtIndex:glyphIndex];
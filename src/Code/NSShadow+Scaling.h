@@ -10,6 +10,9 @@
 
 #import <Cocoa/Cocoa.h>
 
+
+@class DKLRUCache;
+
 typedef enum
 {
 	kDKShadowDrawFill	= ( 1 << 0 ),
@@ -20,6 +23,11 @@ DKShadowDrawingOperation;
 
 @interface NSShadow (DKAdditions)
 
++ (DKLRUCache*)	sharedShadowCache;
++ (void)		setShadowCacheByteBudget:(NSUInteger) bytes;
++ (void)		setShadowCachingEnabled:(BOOL) enable;
++ (BOOL)		shadowCachingEnabled;
+
 - (void)		setAbsolute;
 - (void)		setAbsoluteFlipped:(BOOL) flipped;
 
@@ -40,10 +48,15 @@ DKShadowDrawingOperation;
 - (CGFloat)		extraSpace;
 
 - (void)		drawApproximateShadowWithPath:(NSBezierPath*) path operation:(DKShadowDrawingOperation) op strokeWidth:(NSInteger) sw;
+- (BOOL)		drawCachedShadowWithPath:(NSBezierPath*) path operation:(DKShadowDrawingOperation) op opacity:(CGFloat) opacity;
 
 @end
 
 
+#define		kDKShadowCacheDefaultByteBudget			(16 * 1024 * 1024)
+#define		kDKShadowCacheMaximumPixelDimension		2048
+
+
 
 /*
 
@@ -52,4 +65,10 @@ the shadow stays fixed. This is a solution. Here, if you call setAbsolute instea
 used to set a different shadow that is scaled using the current CTM, so the original shadow appears to remain at the right size
 as you scale.
 
+Setting a shadow makes Quartz blur the shape every time it's drawn, which is slow. -drawCachedShadowWithPath:operation:opacity: draws the
+same shadow from a bitmap instead. The bitmap is keyed by the path's shape (but not its position), the stroke attributes when stroking,
+the scale and rotation of the CTM and the shadow's blur radius and colour, so moving an object only moves its shadow, and changing the
+shadow's offset doesn't need a new bitmap at all. Call it *instead* of setting the shadow, before drawing the shape itself. Bitmaps are
+kept in a shared cache limited by the memory they use.
+
 */
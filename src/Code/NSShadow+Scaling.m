@@ -10,11 +10,79 @@
 
 #import "NSShadow+Scaling.h"
 #import "NSColor+DKAdditions.h"
+#import "NSBezierPath+Editing.h"
 #import "DKDrawKitMacros.h"
+#import "DKContentHash.h"
+#import "DKLRUCache.h"
 
+
+// a cached shadow bitmap, and where it goes relative to the first point of the path it was made from, in device space
+
+@interface DKCachedShadow : NSObject
+{
+@public
+	CGImageRef		mImage;
+	CGPoint			mOrigin;
+}
+
+@end
+
+
+@implementation DKCachedShadow
+
+- (void)		dealloc
+{
+	CGImageRelease( mImage );
+	[super dealloc];
+}
+
+@end
+
+
+static DKLRUCache*	sShadowCache = nil;
+static BOOL			sShadowCachingEnabled = YES;
+
+
+#pragma mark -
 @implementation NSShadow (DKAdditions)
 #pragma mark As a NSShadow
 
++ (DKLRUCache*)	sharedShadowCache
+{
+	// the cache of shadow bitmaps shared by all shadows
+	
+	if( sShadowCache == nil )
+		sShadowCache = [[DKLRUCache alloc] initWithCostLimit:kDKShadowCacheDefaultByteBudget];
+	
+	return sShadowCache;
+}
+
+
++ (void)		setShadowCacheByteBudget:(NSUInteger) bytes
+{
+	// sets the approximate memory that cached shadows may use. Reducing it discards bitmaps as necessary.
+	
+	[[self sharedShadowCache] setCostLimit:bytes];
+}
+
+
++ (void)		setShadowCachingEnabled:(BOOL) enable
+{
+	// when disabled, -drawCachedShadowWithPath:operation:opacity: always returns NO so that callers set the shadow as usual
+	
+	sShadowCachingEnabled = enable;
+	
+	if( !enable )
+		[sShadowCache removeAllObjects];
+}
+
+
++ (BOOL)		shadowCachingEnabled
+{
+	return sShadowCachingEnabled;
+}
+
+
 - (void)		setAbsolute
 {
 	[self setAbsoluteFlipped:NO];
@@ -185,4 +253,171 @@
 }
 
 
+- (BOOL)		drawCachedShadowWithPath:(NSBezierPath*) path operation:(DKShadowDrawingOperation) op opacity:(CGFloat) opacity
+{
+	// draws the shadow that the path would cast if it were filled or stroked (according to <op>) in a colour with the given opacity, with
+	// this shadow set absolutely. The path's own line width, dash, etc. are used for stroking. Call this *instead* of setting the shadow,
+	// then draw the path normally without a shadow. Returns NO if the shadow wasn't drawn because it can't be cached, in which case the
+	// caller should set the shadow as usual. Only screen drawing is cached - printed and PDF output should keep using a real shadow.
+	
+	if( !sShadowCachingEnabled || path == nil || [path isEmpty] || opacity <= 0.0 )
+		return NO;
+	
+	if( ![NSGraphicsContext currentContextDrawingToScreen])
+		return NO;
+	
+	NSColor* colour = [[self shadowColor] colorUsingColorSpaceName:NSDeviceRGBColorSpace];
+	
+	if( colour == nil )
+		return NO;
+	
+	CGContextRef		context = [[NSGraphicsContext currentContext] graphicsPort];
+	CGAffineTransform	ctm = CGContextGetCTM( context );
+	CGAffineTransform	linear = CGAffineTransformMake( ctm.a, ctm.b, ctm.c, ctm.d, 0, 0 );
+	CGSize				unit = CGSizeApplyAffineTransform( CGSizeMake( 1, 1 ), ctm );
+	CGFloat				blur = [self shadowBlurRadius] * unit.width;
+	NSPoint				firstPoint[3];
+	
+	[path elementAtIndex:0 associatedPoints:firstPoint];
+	
+	// the key covers everything that affects the bitmap - not the shadow offset, which is applied when it's drawn, or the position
+	
+	DKContentHash h = DKHashCombine( DKHashCombine([path shapeHash], [path windingRule]), op );
+	
+	h = DKHashFloat( h, linear.a );
+	h = DKHashFloat( h, linear.b );
+	h = DKHashFloat( h, linear.c );
+	h = DKHashFloat( h, linear.d );
+	h = DKHashFloat( h, blur );
+	h = DKHashFloat( h, opacity );
+	h = DKHashFloat( h, [colour redComponent]);
+	h = DKHashFloat( h, [colour greenComponent]);
+	h = DKHashFloat( h, [colour blueComponent]);
+	h = DKHashFloat( h, [colour alphaComponent]);
+	
+	if( op & kDKShadowDrawStroke )
+	{
+		CGFloat		dash[16];
+		NSInteger	i, dashCount = 0;
+		CGFloat		phase = 0;
+		
+		[path getLineDash:NULL count:&dashCount phase:NULL];
+		
+		if( dashCount > 16 )
+			return NO;
+		
+		[path getLineDash:dash count:NULL phase:&phase];
+		
+		h = DKHashFloat( h, [path lineWidth]);
+		h = DKHashCombine( h, [path lineCapStyle]);
+		h = DKHashCombine( h, [path lineJoinStyle]);
+		h = DKHashFloat( h, [path miterLimit]);
+		h = DKHashFloat( h, phase );
+		
+		for( i = 0; i < dashCount; ++i )
+			h = DKHashFloat( h, dash[i] );
+	}
+	
+	DKLRUCache*		cache = [[self class] sharedShadowCache];
+	NSNumber*		key = [NSNumber numberWithUnsignedLongLong:h];
+	DKCachedShadow*	shadow = [cache objectForKey:key];
+	
+	if( shadow == nil )
+	{
+		// work out the device space bounds of the path, allowing for the stroke and the blur
+		
+		CGRect	db = CGRectApplyAffineTransform( NSRectToCGRect([path bounds]), linear );
+		CGFloat	pad = ceil( blur * 2.0 ) + 2.0;
+		
+		if( op & kDKShadowDrawStroke )
+		{
+			CGFloat halfWidth = [path lineWidth] * 0.5;
+			
+			if([path lineJoinStyle] == NSMiterLineJoinStyle )
+				halfWidth *= MAX( 1.0, [path miterLimit]);
+			
+			pad += ceil( halfWidth * sqrt( fabs( linear.a * linear.d - linear.b * linear.c )));
+		}
+		
+		db = CGRectIntegral( CGRectInset( db, -pad, -pad ));
+		
+		if( db.size.width > kDKShadowCacheMaximumPixelDimension || db.size.height > kDKShadowCacheMaximumPixelDimension )
+			return NO;
+		
+		size_t				w = (size_t) db.size.width;
+		size_t				ht = (size_t) db.size.height;
+		CGColorSpaceRef		cs = CGColorSpaceCreateDeviceRGB();
+		CGContextRef		bm = CGBitmapContextCreate( NULL, w, ht, 8, 0, cs, kCGImageAlphaPremultipliedFirst );
+		
+		CGColorSpaceRelease( cs );
+		
+		if( bm == NULL )
+			return NO;
+		
+		// the shape is drawn entirely outside the bitmap with the shadow offset bringing the shadow (only) back inside it. The shape
+		// is drawn in black at the caller's opacity, as the shadow's density follows the shape's.
+		
+		CGColorRef			shadowColour = [colour newQuartzColor];
+		NSGraphicsContext*	nsbm = [NSGraphicsContext graphicsContextWithGraphicsPort:bm flipped:NO];
+		CGFloat				shift = db.size.width + pad;
+		
+		CGContextSetShadowWithColor( bm, CGSizeMake( shift, 0 ), blur, shadowColour );
+		CGColorRelease( shadowColour );
+		
+		CGContextTranslateCTM( bm, -db.origin.x - shift, -db.origin.y );
+		CGContextConcatCTM( bm, linear );
+		
+		[NSGraphicsContext saveGraphicsState];
+		[NSGraphicsContext setCurrentContext:nsbm];
+		
+		if( op & kDKShadowDrawFill )
+		{
+			[[NSColor colorWithDeviceWhite:0.0 alpha:opacity] setFill];
+			[path fill];
+		}
+		
+		if( op & kDKShadowDrawStroke )
+		{
+			[[NSColor colorWithDeviceWhite:0.0 alpha:opacity] setStroke];
+			[path stroke];
+		}
+		
+		[NSGraphicsContext restoreGraphicsState];
+		
+		shadow = [[DKCachedShadow alloc] init];
+		shadow->mImage = CGBitmapContextCreateImage( bm );
+		
+		CGPoint fp = CGPointApplyAffineTransform( NSPointToCGPoint( firstPoint[0] ), linear );
+		shadow->mOrigin = CGPointMake( db.origin.x - fp.x, db.origin.y - fp.y );
+		
+		CGContextRelease( bm );
+		
+		if( shadow->mImage == NULL )
+		{
+			[shadow release];
+			return NO;
+		}
+		
+		[cache setObject:shadow forKey:key cost:w * ht * 4];
+		[shadow autorelease];
+	}
+	
+	// composite the bitmap in device space, positioned by the path's first point and the shadow offset
+	
+	CGPoint	fp = CGPointApplyAffineTransform( NSPointToCGPoint( firstPoint[0] ), ctm );
+	CGSize	offset = CGSizeApplyAffineTransform( NSSizeToCGSize([self shadowOffset]), ctm );
+	CGRect	dr;
+	
+	dr.origin = CGPointMake( fp.x + shadow->mOrigin.x + offset.width, fp.y + shadow->mOrigin.y + offset.height );
+	dr.size = CGSizeMake( CGImageGetWidth( shadow->mImage ), CGImageGetHeight( shadow->mImage ));
+	
+	CGContextSaveGState( context );
+	CGContextConcatCTM( context, CGAffineTransformInvert( ctm ));
+	CGContextDrawImage( context, dr, shadow->mImage );
+	CGContextRestoreGState( context );
+	
+	return YES;
+}
+
+
 @end
@@ -72,6 +72,14 @@ struct OABezierPathIntersectionList
 
 typedef struct OABezierPathIntersectionList PathIntersectionList;
 
+// DrawKit addition - identifies a pair of elements (one from each path) that may intersect
+
+typedef struct
+{
+	NSBezierPathSegmentIndex left, right;
+}
+OABezierPathElementPair;
+
 // Utility functions used internally, may be of use to other callers as well
 void				splitBezierCurveTo(const NSPoint *c, CGFloat t, NSPoint *l, NSPoint *r);
 
@@ -91,6 +99,9 @@ void				splitBezierCurveTo(const NSPoint *c, CGFloat t, NSPoint *l, NSPoint *r);
 // Returns a list of all the intersections between the receiver and the specified path. As a special case, if other==self, it does the useful thing and returns only the nontrivial self-intersections.
 - (struct OABezierPathIntersectionList)	allIntersectionsWithPath:(NSBezierPath*) other;
 
+// DrawKit addition: as above, but only tests the given element pairs, which must be sorted by left then right element index. Used to avoid the O(n*m) search.
+- (struct OABezierPathIntersectionList)	allIntersectionsWithPath:(NSBezierPath*) other elementPairs:(const OABezierPathElementPair*) pairs count:(NSUInteger) pairCount;
+
 - (void)			getWinding:(NSInteger *)clockwiseWindingCount andHit:(NSUInteger *)strokeHitCount forPoint:(NSPoint)point;
 
 - (NSInteger)				segmentHitByPoint:(NSPoint)point padding:(CGFloat)padding;
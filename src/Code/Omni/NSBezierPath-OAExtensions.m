@@ -398,6 +398,125 @@ static BOOL subsequent(struct OABezierPathIntersectionHalf *one, struct OABezier
 }
 #endif
 
+// The per element-pair part of -allIntersectionsWithPath:, factored out so that callers which already know which element pairs can possibly
+// intersect (see -allIntersectionsWithPath:elementPairs:count:) can skip the rest. Found intersections are inserted into the growable list in order.
+static void appendIntersectionsForElementPair(subpathWalkingState *selfIter, const NSPoint *elementCoefficients, subpathWalkingState *otherIter, BOOL sameObject,
+                                              OABezierPathIntersection **intersections, NSUInteger *intersectionCount, NSUInteger *listSize)
+{
+    NSPoint otherElementCoefficients[4];
+    NSUInteger intersectionsFound, intersectionIndex;
+    struct intersectionInfo segmentIntersections[MAX_INTERSECTIONS_PER_ELT_PAIR];
+
+    // Special case for finding self-intersections of a path
+    if (sameObject && selfIter->currentElt > otherIter->currentElt) {
+        // Avoid finding each intersection twice
+        return;
+    } else if (sameObject && selfIter->currentElt == otherIter->currentElt) {
+        // Only curvetos can self-intersect
+        if (selfIter->what == NSCurveToBezierPathElement) {
+            intersectionsFound = intersectionsBetweenCurveAndSelf(elementCoefficients, segmentIntersections);
+        } else {
+            intersectionsFound = 0;
+        }
+    } else switch(selfIter->what) {  // This is the usual case
+        case NSClosePathBezierPathElement:
+        case NSLineToBezierPathElement:
+            switch(otherIter->what) {
+                case NSClosePathBezierPathElement:
+                case NSLineToBezierPathElement:
+                    _parameterizeLine(otherElementCoefficients, otherIter->points[0], otherIter->points[1]);
+                    intersectionsFound = intersectionsBetweenLineAndLine(elementCoefficients, otherElementCoefficients, segmentIntersections);
+                    break;
+                case NSCurveToBezierPathElement:
+                    _parameterizeCurve(otherElementCoefficients, otherIter->points[0], otherIter->points[3], otherIter->points[1], otherIter->points[2]);
+                    intersectionsFound = intersectionsBetweenCurveAndLine(otherElementCoefficients, elementCoefficients, segmentIntersections);
+                    for(intersectionIndex = 0; intersectionIndex < intersectionsFound; intersectionIndex++)
+                        reverseSenseOfIntersection(&(segmentIntersections[intersectionIndex]));
+                    break;
+                default:
+                    OBASSERT_NOT_REACHED("Unexpected Bezier path element");
+                    intersectionsFound = 0;
+                    break;
+            }
+            break;
+        case NSCurveToBezierPathElement:
+            switch(otherIter->what) {
+                case NSClosePathBezierPathElement:
+                case NSLineToBezierPathElement:
+                    _parameterizeLine(otherElementCoefficients, otherIter->points[0], otherIter->points[1]);
+                    intersectionsFound = intersectionsBetweenCurveAndLine(elementCoefficients, otherElementCoefficients, segmentIntersections);
+                    break;
+                case NSCurveToBezierPathElement:
+                    _parameterizeCurve(otherElementCoefficients, otherIter->points[0], otherIter->points[3], otherIter->points[1], otherIter->points[2]);
+                    intersectionsFound = intersectionsBetweenCurveAndCurve(elementCoefficients, otherElementCoefficients, segmentIntersections);
+                    break;
+                default:
+                    OBASSERT_NOT_REACHED("Unexpected Bezier path element");
+                    intersectionsFound = 0;
+                    break;
+            }
+            break;
+        default:
+            OBASSERT_NOT_REACHED("Unexpected Bezier path element");
+            intersectionsFound = 0;
+            break;
+    }
+        
+    if (sameObject) {
+        // Remove unwanted intersection between end of each segment and beginning of the next
+#define WEPSILON 1e-4
+        
+        if (selfIter->currentElt+1 == otherIter->currentElt && intersectionsFound > 0) {
+            struct intersectionInfo i = segmentIntersections[intersectionsFound-1];
+            if (i.leftParameterDistance < EPSILON &&
+                i.leftParameter >= (1 - WEPSILON) &&
+                i.rightParameter <= (WEPSILON)) {
+                intersectionsFound --;
+            }
+        } else if (selfIter->currentElt == 1 && !hasNextSubpathElement(otherIter) && intersectionsFound > 0) {
+            struct intersectionInfo i = segmentIntersections[0];
+            if (i.leftParameterDistance < EPSILON &&
+                i.leftParameter <= (WEPSILON) &&
+                i.rightParameter >= (1 - WEPSILON)) {
+                memmove(segmentIntersections+1, segmentIntersections, sizeof(*segmentIntersections)*(--intersectionsFound));
+            }
+        }
+    }
+            
+    if (intersectionsFound + *intersectionCount > *listSize) {
+        *intersections = realloc(*intersections, sizeof(**intersections) * (*listSize += (*listSize >> 1)));
+    }
+    
+    OABezierPathIntersection *list = *intersections;
+    NSUInteger earliestInsertionPoint = *intersectionCount;
+    
+    for(intersectionIndex = 0; intersectionIndex < intersectionsFound; intersectionIndex++) {
+        NSUInteger insertionPoint = *intersectionCount;
+        double t;
+        
+        // Find where to insert this intersection so that the list remains sorted
+        while(insertionPoint > 0 &&
+              list[insertionPoint-1].left.parameter > segmentIntersections[intersectionIndex].leftParameter &&
+              list[insertionPoint-1].left.segment >= selfIter->currentElt)
+            insertionPoint --;
+        
+        // Make room, if necessary
+        if (insertionPoint < *intersectionCount)
+            memmove(&(list[insertionPoint+1]), &(list[insertionPoint]), sizeof(*list)*(*intersectionCount-insertionPoint));
+        if (insertionPoint < earliestInsertionPoint)
+            earliestInsertionPoint = insertionPoint;
+        
+        copyIntersection(&(list[insertionPoint]), &(segmentIntersections[intersectionIndex]), selfIter->currentElt, otherIter->currentElt);
+        
+        // parameterizeSubpathElement() fills the higher coefficients with 0 if they're not needed, so we can go ahead and treat everything as a cubic here.
+        t = segmentIntersections[intersectionIndex].leftParameter;
+        list[insertionPoint].location.x = (( elementCoefficients[3].x * t + elementCoefficients[2].x ) * t + elementCoefficients[1].x ) * t + elementCoefficients[0].x;
+        list[insertionPoint].location.y = (( elementCoefficients[3].y * t + elementCoefficients[2].y ) * t + elementCoefficients[1].y ) * t + elementCoefficients[0].y;
+        
+        (*intersectionCount) ++;
+    }
+}
+
 - (struct OABezierPathIntersectionList)allIntersectionsWithPath:(NSBezierPath *)other
 {
     NSUInteger intersectionCount, listSize;
@@ -419,121 +538,84 @@ static BOOL subsequent(struct OABezierPathIntersectionHalf *one, struct OABezier
         
         parameterizeSubpathElement(&selfIter, elementCoefficients);
 
-        while(nextSubpathElement(&otherIter)) {
-            NSPoint otherElementCoefficients[4];
-            NSUInteger intersectionsFound, intersectionIndex;
-            struct intersectionInfo segmentIntersections[MAX_INTERSECTIONS_PER_ELT_PAIR];
-
-            // Special case for finding self-intersections of a path
-            if (self == other && selfIter.currentElt > otherIter.currentElt) {
-                // Avoid finding each intersection twice
-                continue;
-            } else if (self == other && selfIter.currentElt == otherIter.currentElt) {
-                // Only curvetos can self-intersect
-                if (selfIter.what == NSCurveToBezierPathElement) {
-                    intersectionsFound = intersectionsBetweenCurveAndSelf(elementCoefficients, segmentIntersections);
-                } else {
-                    intersectionsFound = 0;
-                }
-            } else switch(selfIter.what) {  // This is the usual case
-                case NSClosePathBezierPathElement:
-                case NSLineToBezierPathElement:
-                    switch(otherIter.what) {
-                        case NSClosePathBezierPathElement:
-                        case NSLineToBezierPathElement:
-                            _parameterizeLine(otherElementCoefficients, otherIter.points[0], otherIter.points[1]);
-                            intersectionsFound = intersectionsBetweenLineAndLine(elementCoefficients, otherElementCoefficients, segmentIntersections);
-                            break;
-                        case NSCurveToBezierPathElement:
-                            _parameterizeCurve(otherElementCoefficients, otherIter.points[0], otherIter.points[3], otherIter.points[1], otherIter.points[2]);
-                            intersectionsFound = intersectionsBetweenCurveAndLine(otherElementCoefficients, elementCoefficients, segmentIntersections);
-                            for(intersectionIndex = 0; intersectionIndex < intersectionsFound; intersectionIndex++)
-                                reverseSenseOfIntersection(&(segmentIntersections[intersectionIndex]));
-                            break;
-                        default:
-                            OBASSERT_NOT_REACHED("Unexpected Bezier path element");
-                            intersectionsFound = 0;
-                            break;
-                    }
-                    break;
-                case NSCurveToBezierPathElement:
-                    switch(otherIter.what) {
-                        case NSClosePathBezierPathElement:
-                        case NSLineToBezierPathElement:
-                            _parameterizeLine(otherElementCoefficients, otherIter.points[0], otherIter.points[1]);
-                            intersectionsFound = intersectionsBetweenCurveAndLine(elementCoefficients, otherElementCoefficients, segmentIntersections);
-                            break;
-                        case NSCurveToBezierPathElement:
-                            _parameterizeCurve(otherElementCoefficients, otherIter.points[0], otherIter.points[3], otherIter.points[1], otherIter.points[2]);
-                            intersectionsFound = intersectionsBetweenCurveAndCurve(elementCoefficients, otherElementCoefficients, segmentIntersections);
-                            break;
-                        default:
-                            OBASSERT_NOT_REACHED("Unexpected Bezier path element");
-                            intersectionsFound = 0;
-                            break;
-                    }
-                    break;
-                default:
-                    OBASSERT_NOT_REACHED("Unexpected Bezier path element");
-                    intersectionsFound = 0;
-                    break;
-            }
-                
-            if (self == other) {
-                // Remove unwanted intersection between end of each segment and beginning of the next
-#define WEPSILON 1e-4
-                
-                if (selfIter.currentElt+1 == otherIter.currentElt && intersectionsFound > 0) {
-                    struct intersectionInfo i = segmentIntersections[intersectionsFound-1];
-                    if (i.leftParameterDistance < EPSILON &&
-                        i.leftParameter >= (1 - WEPSILON) &&
-                        i.rightParameter <= (WEPSILON)) {
-                        intersectionsFound --;
-                    }
-                } else if (selfIter.currentElt == 1 && !hasNextSubpathElement(&otherIter) && intersectionsFound > 0) {
-                    struct intersectionInfo i = segmentIntersections[0];
-                    if (i.leftParameterDistance < EPSILON &&
-                        i.leftParameter <= (WEPSILON) &&
-                        i.rightParameter >= (1 - WEPSILON)) {
-                        memmove(segmentIntersections+1, segmentIntersections, sizeof(*segmentIntersections)*(--intersectionsFound));
-                    }
-                }
-            }
-                    
-            if (intersectionsFound + intersectionCount > listSize) {
-                intersections = realloc(intersections, sizeof(*intersections) * (listSize += (listSize >> 1)));
-            }
-            
-            NSUInteger earliestInsertionPoint = intersectionCount;
-            
-            for(intersectionIndex = 0; intersectionIndex < intersectionsFound; intersectionIndex++) {
-                NSUInteger insertionPoint = intersectionCount;
-                double t;
-                
-                // Find where to insert this intersection so that the list remains sorted
-                while(insertionPoint > 0 &&
-                      intersections[insertionPoint-1].left.parameter > segmentIntersections[intersectionIndex].leftParameter &&
-                      intersections[insertionPoint-1].left.segment >= selfIter.currentElt)
-                    insertionPoint --;
-                
-                // Make room, if necessary
-                if (insertionPoint < intersectionCount)
-                    memmove(&(intersections[insertionPoint+1]), &(intersections[insertionPoint]), sizeof(*intersections)*(intersectionCount-insertionPoint));
-                if (insertionPoint < earliestInsertionPoint)
-                    earliestInsertionPoint = insertionPoint;
-                
-                copyIntersection(&(intersections[insertionPoint]), &(segmentIntersections[intersectionIndex]), selfIter.currentElt, otherIter.currentElt);
-                
-                // parameterizeSubpathElement() fills the higher coefficients with 0 if they're not needed, so we can go ahead and treat everything as a cubic here.
-                t = segmentIntersections[intersectionIndex].leftParameter;
-                intersections[insertionPoint].location.x = (( elementCoefficients[3].x * t + elementCoefficients[2].x ) * t + elementCoefficients[1].x ) * t + elementCoefficients[0].x;
-                intersections[insertionPoint].location.y = (( elementCoefficients[3].y * t + elementCoefficients[2].y ) * t + elementCoefficients[1].y ) * t + elementCoefficients[0].y;
-                
-                intersectionCount ++;
-            }
+        while(nextSubpathElement(&otherIter))
+            appendIntersectionsForElementPair(&selfIter, elementCoefficients, &otherIter, (self == other), &intersections, &intersectionCount, &listSize);
+    }
+    
+    if (listSize - intersectionCount > 8)
+        intersections = realloc(intersections, sizeof(*intersections) * (listSize = intersectionCount));
+
+    return (struct OABezierPathIntersectionList){ intersectionCount, intersections };
+}
+
+// DrawKit addition. The walker states for each element of the path's first subpath, in order, as produced by nextSubpathElement(). Returns the number of
+// states stored in <states> (which the caller must free).
+static NSInteger snapshotSubpathElements(NSBezierPath *path, subpathWalkingState **states)
+{
+    subpathWalkingState iter;
+    NSInteger count = 0, size;
+    
+    *states = NULL;
+    
+    if (!initializeSubpathWalkingState(&iter, path, 0, NO))
+        return 0;
+    
+    *states = malloc(sizeof(**states) * (size = 16));
+    
+    while(nextSubpathElement(&iter)) {
+        if (count >= size)
+            *states = realloc(*states, sizeof(**states) * (size += (size >> 1)));
+        
+        (*states)[count++] = iter;
+    }
+    
+    return count;
+}
+
+// DrawKit addition. As -allIntersectionsWithPath:, but only the listed element pairs are tested - everything else is assumed not to intersect. Element indexes
+// are those of the walked elements, i.e. the segment indexes reported in the intersection list. The pairs must be sorted by left element, then right element, so
+// that the result is in the same order as -allIntersectionsWithPath: would have produced.
+- (struct OABezierPathIntersectionList)allIntersectionsWithPath:(NSBezierPath *)other elementPairs:(const OABezierPathElementPair *)pairs count:(NSUInteger)pairCount
+{
+    NSUInteger intersectionCount, listSize, pairIndex;
+    OABezierPathIntersection *intersections;
+    subpathWalkingState *selfStates, *otherStates;
+    NSInteger selfCount, otherCount, selfFirst, otherFirst, lastLeft = -1;
+    NSPoint elementCoefficients[4];
+    
+    selfCount = snapshotSubpathElements(self, &selfStates);
+    otherCount = snapshotSubpathElements(other, &otherStates);
+    
+    if (selfCount == 0 || otherCount == 0 || pairCount == 0) {
+        free(selfStates);
+        free(otherStates);
+        return (struct OABezierPathIntersectionList){ 0, NULL };
+    }
+    
+    selfFirst = selfStates[0].currentElt;
+    otherFirst = otherStates[0].currentElt;
+    
+    intersectionCount = 0;
+    intersections = malloc(sizeof(*intersections) * (listSize = 16));
+    
+    for(pairIndex = 0; pairIndex < pairCount; pairIndex++) {
+        NSInteger li = pairs[pairIndex].left - selfFirst;
+        NSInteger ri = pairs[pairIndex].right - otherFirst;
+        
+        if (li < 0 || li >= selfCount || ri < 0 || ri >= otherCount)
+            continue;
+        
+        if (li != lastLeft) {
+            parameterizeSubpathElement(&selfStates[li], elementCoefficients);
+            lastLeft = li;
         }
+        
+        appendIntersectionsForElementPair(&selfStates[li], elementCoefficients, &otherStates[ri], (self == other), &intersections, &intersectionCount, &listSize);
     }
     
+    free(selfStates);
+    free(otherStates);
+    
     if (listSize - intersectionCount > 8)
         intersections = realloc(intersections, sizeof(*intersections) * (listSize = intersectionCount));
 
@@ -23,6 +23,7 @@ extern "C"
 
 NSBezierPath*		curveFitPath(NSBezierPath* inPath, CGFloat epsilon);
 NSBezierPath*		smartCurveFitPath( NSBezierPath* inPath, CGFloat epsilon, CGFloat cornerAngleThreshold );
+NSBezierPath*		smartCurveFitPathWithMinimumSpan( NSBezierPath* inPath, CGFloat epsilon, CGFloat cornerAngleThreshold, NSInteger minimumSpan );
 
 #ifdef __cplusplus
 }
@@ -38,4 +39,12 @@ NSBezierPath*		smartCurveFitPath( NSBezierPath* inPath, CGFloat epsilon, CGFloat
 
 #define kDKDefaultCornerThreshold		(M_PI / 6)
 
+// paths with at least this many elements (and more than one subpath) have their subpaths fitted concurrently:
+
+#define kDKCurveFitConcurrencyThreshold	64
+
+// in "fast" mode, polyline runs with fewer points than this are left as line segments rather than fitted:
+
+#define kDKCurveFitFastMinimumSpan		8
+
 #endif /* defined(qUseCurveFit) */
@@ -16,50 +16,109 @@
 
 
 
+static NSBezierPath*	curveFitPoints( const NSPoint* points, NSInteger count, CGFloat epsilon );
+
+
 NSBezierPath*			curveFitPath(NSBezierPath* inPath, CGFloat epsilon)
 {
 	// given an input path in vector form (flattened), this converts it to the C++ data structure list of points and processes it via the
 	// curve fit method in the bezier-utils lib. It then converts the result back to NSBezierPath form. Note - the caller is responsible for passing
 	// a flattened path.
 	
-	Geom::Point*	pd;
-	int				ec, i;
+	NSInteger		ec, i;
 	NSPoint			p[3];
-	NSBezierPath*	result = [NSBezierPath bezierPath];
+	NSPoint*		pts;
+	NSBezierPath*	result;
 	
 	ec = [inPath elementCount];
 	
 	if ( ec < 3 )
 	{
+		result = [NSBezierPath bezierPath];
 		[result appendBezierPath:inPath];
 		return result;
 	}
 	
-	pd = (Geom::Point*) malloc( sizeof( Geom::Point ) * ec );
+	pts = (NSPoint*) malloc( sizeof( NSPoint ) * ec );
 	
 	for( i = 0; i < ec; ++i )
 	{
 		[inPath elementAtIndex:i associatedPoints:p];
-		pd[i] = Geom::Point((Geom::Coord)p[0].x, (Geom::Coord)p[0].y);
+		pts[i] = p[0];
 	}
 	
-	// converted, now try the curve fit. Note that we don't know how much space we need to store the result, and the code doesn't give
-	// us a way to find out, so we just create a big buffer and hope for the best.
+	result = curveFitPoints( pts, ec, epsilon );
+	free( pts );
+	
+	return result;
+}
+
+
+#pragma mark -
+#pragma mark - contour-wise fitting
+
+// a flattened copy of the source path's elements. This is extracted once on the calling thread so that worker threads never message the
+// original path object, which is not guaranteed to be safe for concurrent access.
+
+typedef struct
+{
+	NSBezierPathElement		elem;
+	NSPoint					p[3];
+}
+_dkCurveFitElement;
+
+
+// a contour is the run of elements from one moveto up to (but not including) the next one.
+
+typedef struct
+{
+	const _dkCurveFitElement*	elements;
+	NSInteger					elementCount;
+	NSInteger					contourStart;
+	NSInteger					contourEnd;
+	CGFloat						epsilon;
+	CGFloat						cornerAngleThreshold;
+	NSInteger					minimumSpan;
+	NSBezierPath*				result;				// retained, owned by the caller once fitting has finished
+}
+_dkCurveFitContour;
+
+
+static NSBezierPath*	curveFitPoints( const NSPoint* points, NSInteger count, CGFloat epsilon )
+{
+	// curve fits a polyline given as an array of points. See curveFitPath() for details - this is the same thing without the need to
+	// build an intermediate NSBezierPath.
+	
+	NSBezierPath*	result = [NSBezierPath bezierPath];
+	NSInteger		i;
+	
+	if ( count < 3 )
+	{
+		if( count > 0 )
+		{
+			[result moveToPoint:points[0]];
+		
+			for( i = 1; i < count; ++i )
+				[result lineToPoint:points[i]];
+		}
+		return result;
+	}
+	
+	Geom::Point*	pd = (Geom::Point*) malloc( sizeof( Geom::Point ) * count );
 	
-	int				segments, maxSegments;
-	Geom::Point*	segBuffer;
+	for( i = 0; i < count; ++i )
+		pd[i] = Geom::Point((Geom::Coord)points[i].x, (Geom::Coord)points[i].y);
 	
-	maxSegments = 256;
-	segBuffer = (Geom::Point*) malloc( sizeof( Geom::Point ) * maxSegments * 4 );
+	// converted, now try the curve fit. Note that we don't know how much space we need to store the result, and the code doesn't give
+	// us a way to find out, so we just create a big buffer and hope for the best.
 	
-	// do the fitting:
+	int				segments, maxSegments = 256;
+	Geom::Point*	segBuffer = (Geom::Point*) malloc( sizeof( Geom::Point ) * maxSegments * 4 );
 	
-	segments = bezier_fit_cubic_r( segBuffer, pd, ec, epsilon, maxSegments );
+	segments = bezier_fit_cubic_r( segBuffer, pd, (int)count, epsilon, maxSegments );
 	
 	if ( segments > 0 )
 	{
-		//NSLog(@"curve fit generated %d segments", segments );
-		
 		// we got a result, so convert it back to an NSBezierPath. The result is returned as quads of points (presumably this means that
 		// there is a lot of duplication).
 		
@@ -80,13 +139,11 @@ NSBezierPath*			curveFitPath(NSBezierPath* inPath, CGFloat epsilon)
 			temp[1].y = segBuffer[segElement++][Geom::Y];
 			temp[2].x = segBuffer[segElement][Geom::X];
 			temp[2].y = segBuffer[segElement][Geom::Y];
-		
+			
 			[result curveToPoint:temp[2] controlPoint1:temp[0] controlPoint2:temp[1]];
 		}
 	}
 	
-	// clean up
-	
 	free( pd );
 	free( segBuffer );
 	
@@ -94,115 +151,194 @@ NSBezierPath*			curveFitPath(NSBezierPath* inPath, CGFloat epsilon)
 }
 
 
+static void		flushPolylineRun( NSBezierPath* result, const NSPoint* run, NSInteger count, CGFloat epsilon, NSInteger minimumSpan )
+{
+	// appends the accumulated polyline run to the result, curve fitting it unless it's too short to be worth it (fast mode). The run's
+	// first point is always the result's current point, so it is not re-added.
+	
+	if( count < minimumSpan )
+	{
+		NSInteger i;
+		
+		for( i = 1; i < count; ++i )
+			[result lineToPoint:run[i]];
+	}
+	else
+		[result appendBezierPathRemovingInitialMoveToPoint:curveFitPoints( run, count, epsilon )];
+}
+
+
+static void		smartCurveFitContour( void* context, size_t index )
+{
+	// fits a single contour - this is the body of the original smartCurveFitPath loop, restricted to one subpath so that contours can
+	// be processed independently (and so concurrently). Callable directly or as a dispatch_apply_f worker function.
+	
+	_dkCurveFitContour*			contour = ((_dkCurveFitContour*) context) + index;
+	const _dkCurveFitElement*	el = contour->elements;
+	NSInteger					i, ec = contour->elementCount;
+	NSInteger					runCount = 0;
+	NSPoint						lastPoint = NSZeroPoint;
+	NSPoint						firstPoint = NSZeroPoint;
+	NSPoint						np;
+	CGFloat						angle;
+	
+	NSAutoreleasePool*	pool = [[NSAutoreleasePool alloc] init];
+	NSBezierPath*		result = [[NSBezierPath alloc] init];
+	NSPoint*			run = (NSPoint*) malloc( sizeof( NSPoint ) * ( contour->contourEnd - contour->contourStart + 1 ));
+	
+	for( i = contour->contourStart; i < contour->contourEnd; ++i )
+	{
+		switch( el[i].elem )
+		{
+			case NSMoveToBezierPathElement:
+				run[0] = el[i].p[0];
+				runCount = 1;
+				[result moveToPoint:el[i].p[0]];
+				lastPoint = firstPoint = el[i].p[0];
+				break;
+				
+			case NSLineToBezierPathElement:
+				run[runCount++] = el[i].p[0];
+				
+				// find out if there is a sharp turn here, or the contributing lengths are long
+				
+				if( i < ( ec - 1 ))
+				{
+					np = el[i+1].p[0];
+					
+					if ( el[i+1].elem == NSClosePathBezierPathElement )
+						np = firstPoint;
+					
+					angle = AngleBetween( lastPoint, el[i].p[0], np );
+				}
+				else
+					angle = AngleBetween( lastPoint, el[i].p[0], firstPoint );
+				
+				lastPoint = el[i].p[0];
+				
+				// compare sharp-turniness against the threshold
+				
+				if( ABS( angle ) > contour->cornerAngleThreshold && runCount > 1 )
+				{
+					// accumulated subcurve is complete and can be processed - will then start a new run from the corner
+					
+					flushPolylineRun( result, run, runCount, contour->epsilon, contour->minimumSpan );
+					run[0] = el[i].p[0];
+					runCount = 1;
+				}
+				break;
+				
+			case NSCurveToBezierPathElement:
+				if ( runCount > 1 )
+					flushPolylineRun( result, run, runCount, contour->epsilon, contour->minimumSpan );
+				
+				runCount = 0;
+				[result curveToPoint:el[i].p[2] controlPoint1:el[i].p[0] controlPoint2:el[i].p[1]];
+				lastPoint = el[i].p[2];
+				break;
+				
+			case NSClosePathBezierPathElement:
+				if ( runCount > 1 )
+				{
+					run[runCount++] = firstPoint;
+					flushPolylineRun( result, run, runCount, contour->epsilon, contour->minimumSpan );
+				}
+				runCount = 0;
+				[result closePath];
+				lastPoint = firstPoint;
+				break;
+				
+			default:
+				assert("Encountered invalid switch case.");
+				break;
+		}
+	}
+	
+	// anything left over belongs to an open contour
+	
+	if( runCount > 1 )
+		flushPolylineRun( result, run, runCount, contour->epsilon, contour->minimumSpan );
+	
+	free( run );
+	contour->result = result;
+	[pool drain];
+}
+
+
 NSBezierPath*		smartCurveFitPath( NSBezierPath* inPath, CGFloat epsilon, CGFloat cornerAngleThreshold )
+{
+	return smartCurveFitPathWithMinimumSpan( inPath, epsilon, cornerAngleThreshold, 0 );
+}
+
+
+NSBezierPath*		smartCurveFitPathWithMinimumSpan( NSBezierPath* inPath, CGFloat epsilon, CGFloat cornerAngleThreshold, NSInteger minimumSpan )
 {
 	// this curve fits a flattened path, but is much smarter about which parts of the path to curve fit and which to leave alone. It
 	// also properly deals with separate subpaths within the original path (holes).
 	
 	// a line segment that is longer than a given threshhold is not curve-fitted, and sharp corners also define boundaries for curve
-	// segments. Existing curved segments are copied to the result without any changes.
+	// segments. Existing curved segments are copied to the result without any changes. Polyline runs of fewer than <minimumSpan> points
+	// are copied as-is rather than fitted - pass 0 to fit everything.
+	
+	// each subpath is independent of the others, so when there are several of them and enough work to be worth it they are fitted
+	// concurrently, then reassembled in their original order.
 	
 	NSInteger				i, ec = [inPath elementCount];
-	NSBezierPathElement		elem;
-	NSPoint					ap[3], np[3];
-	NSPoint					lastPoint = NSZeroPoint;
-	NSPoint					firstPoint = NSZeroPoint;
+	NSInteger				contourCount = 0;
 	NSBezierPath*			result;
-	NSBezierPath*			temp;
-	CGFloat					angle;
 	
 	result = [NSBezierPath bezierPath];
 	[result setWindingRule:[inPath windingRule]];
 	
 	if ( ec > 0 )
 	{
-		temp = [NSBezierPath bezierPath];	// holds the accumulated elements for each subsection
+		_dkCurveFitElement*	elements = (_dkCurveFitElement*) malloc( sizeof( _dkCurveFitElement ) * ec );
 		
 		for( i = 0; i < ec; ++i )
 		{
-			elem = [inPath elementAtIndex:i associatedPoints:ap];
+			elements[i].elem = [inPath elementAtIndex:i associatedPoints:elements[i].p];
 			
-			switch( elem )
+			if( elements[i].elem == NSMoveToBezierPathElement || i == 0 )
+				++contourCount;
+		}
+		
+		_dkCurveFitContour*	contours = (_dkCurveFitContour*) calloc( contourCount, sizeof( _dkCurveFitContour ));
+		NSInteger			c = -1;
+		
+		for( i = 0; i < ec; ++i )
+		{
+			if( elements[i].elem == NSMoveToBezierPathElement || i == 0 )
 			{
-				case NSMoveToBezierPathElement:
-					// if temp has accumulated anything, curve fit it and append to result
-					
-					if ([temp elementCount] > 1 )
-					{
-						[result appendBezierPathRemovingInitialMoveToPoint:curveFitPath( temp, epsilon )];
-						[temp removeAllPoints];
-					}
-					[temp moveToPoint:ap[0]];
-					[result moveToPoint:ap[0]];
-					lastPoint = firstPoint = ap[0];
-					break;
-				
-				case NSLineToBezierPathElement:
-
-					if ([temp isEmpty])
-						[temp moveToPoint:ap[0]];
-					else
-						[temp lineToPoint:ap[0]];
-						
-					// find out if there is a sharp turn here, or the contributing lengths are long
-
-					if( i < ( ec - 1 ))
-					{
-						elem = [inPath elementAtIndex:i+1 associatedPoints:np];
-						
-						if ( elem == NSClosePathBezierPathElement )
-							np[0] = firstPoint;
-						
-						angle = AngleBetween( lastPoint, ap[0], np[0] );
-					}
-					else
-						angle = AngleBetween( lastPoint, ap[0], firstPoint );
-
-					lastPoint = ap[0];
-
-					// compare sharp-turniness against the threshold
-					
-					if( ABS( angle ) > cornerAngleThreshold )
-					{
-						// accumulated subcurve is complete and can be processed
-						
-						if ([temp elementCount] > 1 )
-						{
-							[result appendBezierPathRemovingInitialMoveToPoint:curveFitPath( temp, epsilon )];
-						
-							// will now start a new temp path
-						
-							[temp removeAllPoints];
-							[temp moveToPoint:ap[0]];
-						}
-					}	
-					break;
-				
-				case NSCurveToBezierPathElement:
-					if ([temp elementCount] > 1 )
-					{
-						[result appendBezierPathRemovingInitialMoveToPoint:curveFitPath( temp, epsilon )];
-						[temp removeAllPoints];
-					}
-					[result curveToPoint:ap[2] controlPoint1:ap[0] controlPoint2:ap[1]];
-					lastPoint = ap[2];
-					break;
+				if( c >= 0 )
+					contours[c].contourEnd = i;
 				
-				case NSClosePathBezierPathElement:
-					if ([temp elementCount] > 1 )
-					{
-						[temp lineToPoint:firstPoint];
-						[result appendBezierPathRemovingInitialMoveToPoint:curveFitPath( temp, epsilon )];
-						[temp removeAllPoints];
-					}
-					[result closePath];
-					lastPoint = firstPoint;
-					break;
-				default:
-					assert("Encountered invalid switch case.");
-					break;
+				++c;
+				contours[c].elements = elements;
+				contours[c].elementCount = ec;
+				contours[c].contourStart = i;
+				contours[c].epsilon = epsilon;
+				contours[c].cornerAngleThreshold = cornerAngleThreshold;
+				contours[c].minimumSpan = MAX( 2, minimumSpan );
 			}
 		}
+		contours[c].contourEnd = ec;
+		
+		if( contourCount > 1 && ec >= kDKCurveFitConcurrencyThreshold )
+			dispatch_apply_f( contourCount, dispatch_get_global_queue( DISPATCH_QUEUE_PRIORITY_DEFAULT, 0 ), contours, smartCurveFitContour );
+		else
+		{
+			for( i = 0; i < contourCount; ++i )
+				smartCurveFitContour( contours, i );
+		}
+		
+		for( i = 0; i < contourCount; ++i )
+		{
+			[result appendBezierPath:contours[i].result];
+			[contours[i].result release];
+		}
+		
+		free( contours );
+		free( elements );
 	}
 	return result;
 }